@@ -0,0 +1,38 @@
+/**
+ * @file BenchmarkFixture.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the benchmark fixture.
+ * @details This file implements the setup shared by the benchmarks of the localization and the 2D tracking:
+ * the parameters of the stages, and the synthetic frames they are run on.
+ */
+
+#ifndef BenchmarkFixture_H
+#define BenchmarkFixture_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <detect_and_track/utils.h>
+
+/**
+ * @brief The parameters of the localization and the 2D tracking, shared by the benchmarks.
+ *
+ */
+typedef struct BenchmarkParameters{
+  GlobalParameters glo_p;
+  LocalizationParameters loc_p;
+  CameraParameters cam_p;
+  DetectionParameters det_p;
+  KalmanParameters kal_p;
+  TrackingParameters tra_p;
+  BBoxRejectionParameters bbo_p;
+} BenchmarkParameters;
+
+void getBenchmarkParameters(BenchmarkParameters&);
+void generateBenchmarkFrames(const int&, const int&, const int&, const int&, cv::Mat&,
+                             std::vector<std::vector<std::vector<BoundingBox>>>&);
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * @file Checkpoint.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the tracker checkpoints.
+ * @details This file implements a binary snapshot of the trackers, used to restore them when a node restarts.
+ */
+
+#ifndef Checkpoint_H
+#define Checkpoint_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
+
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_MAX_STATE_SIZE 64 // Larger than the state of any tracker, bounds the records of a corrupt file.
+
+class BaseTracker;
+
+/**
+ * @brief The header of a checkpoint file.
+ * @details A checkpoint file is organized as follows: \n
+ *  - a CheckpointHeader, \n
+ *  - for each tracker, a TrackerRecord followed by, for each object, an ObjectRecord, its state X (N floats),
+ *  and its covariance P (NxN floats, column major). \n
+ * All the records are made of 4 or 8 bytes fields, the file can be memory-mapped and read in place.
+ */
+typedef struct CheckpointHeader{
+  char magic[8]; // "DTCKPT" padded with 0s.
+  uint32_t version;
+  uint32_t num_trackers;
+  uint64_t parameters_hash;
+  int64_t stamp; // Wall-clock time at which the checkpoint was taken, in nanoseconds.
+  uint64_t size; // Size of the payload, in bytes.
+} CheckpointHeader;
+
+/**
+ * @brief The state of a tracker.
+ *
+ */
+typedef struct TrackerRecord{
+  uint32_t track_id_count;
+  uint32_t num_objects;
+  uint32_t state_size;
+  uint32_t padding;
+} TrackerRecord;
+
+/**
+ * @brief The counters of a tracked object.
+ *
+ */
+typedef struct ObjectRecord{
+  uint32_t id;
+  uint32_t nb_frames;
+  uint32_t nb_skipped_frames;
+  uint32_t nb_consecutive_frames;
+} ObjectRecord;
+
+/**
+ * @brief Saves and restores the state of a set of trackers.
+ * @details Static helpers to build a checkpoint in memory, and to restore trackers from a checkpoint file.
+ * Restoring uses mmap, the states are copied straight from the mapped file into the Kalman filters.
+ */
+class Checkpoint {
+  public:
+    static uint64_t hashParameters(const std::vector<BaseTracker*>&);
+    static void serialize(const std::vector<BaseTracker*>&, std::vector<char>&);
+    static bool load(const std::string&, const float&, std::vector<BaseTracker*>&);
+};
+
+/**
+ * @brief Writes checkpoints in the background.
+ * @details This class periodically snapshots a set of trackers, and writes the snapshot to disk on a separate thread.
+ * Two buffers are used: the front buffer is filled on the tracking thread, the back buffer is written by the writer thread.
+ * The buffers are swapped once the writer is idle, so the tracking thread never waits on the disk.
+ * If a write is still in progress when a new snapshot is due, the snapshot is skipped.
+ * The file is written to a temporary file, and then renamed, so a crash never leaves a partial checkpoint.
+ */
+class CheckpointWriter {
+  private:
+    std::string path_;
+    float period_;
+    std::chrono::time_point<std::chrono::steady_clock> last_save_;
+
+    std::vector<char> front_;
+    std::vector<char> back_;
+    bool pending_;
+    bool running_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+
+    void run();
+    void writeToFile(const std::vector<char>&);
+
+  public:
+    CheckpointWriter(const std::string&, const float&);
+    ~CheckpointWriter();
+    void submit(const std::vector<BaseTracker*>&);
+};
+
+#endif
@@ -0,0 +1,190 @@
+/**
+ * @file ColumnLog.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the columnar log.
+ * @details This file implements a columnar on-disk log of the detections, positions, and track states of each frame,
+ * for the post-mission analysis. The rows are written in preallocated, memory-mapped segments, where each column is
+ * a plain array: a time range can be found without reading the other columns, and the columns can be mapped as is,
+ * for instance with numpy.memmap.
+ */
+
+#ifndef ColumnLog_H
+#define ColumnLog_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <stdio.h>
+
+#include <detect_and_track/DetectionUtils.h>
+
+#define COLUMN_LOG_VERSION 1
+#define COLUMN_LOG_ALIGNMENT 65536 // The file header and the segments are aligned on the largest page size in use.
+#define COLUMN_LOG_MAX_COLUMNS 32
+#define COLUMN_LOG_NUM_STATES 9
+
+/**
+ * @brief The columns of the log.
+ * @details The stamps and the sequences are 64 bits integers, the kinds, the classes and the ids 32 bits unsigned
+ * integers, the other columns floats. The missing values are NaN.
+ */
+enum ColumnLogColumn {
+  COLUMN_STAMP = 0, // The acquisition time of the frame, in nanoseconds.
+  COLUMN_SEQUENCE = 1, // The sequence number of the frame.
+  COLUMN_KIND = 2, // COLUMN_LOG_DETECTION or COLUMN_LOG_TRACK.
+  COLUMN_CLASS_ID = 3,
+  COLUMN_ID = 4, // The id of the track, or the index of the detection in its class.
+  COLUMN_CONFIDENCE = 5, // The confidence of the detection, NaN for the tracks.
+  COLUMN_STATE = 6, // The first of the COLUMN_LOG_NUM_STATES state columns.
+  COLUMN_POSITION_X = COLUMN_STATE + COLUMN_LOG_NUM_STATES, // The position of the object in the frame of the camera, if located.
+  COLUMN_POSITION_Y = COLUMN_POSITION_X + 1,
+  COLUMN_POSITION_Z = COLUMN_POSITION_X + 2,
+  COLUMN_COUNT = COLUMN_POSITION_X + 3
+};
+
+/**
+ * @brief The kinds of rows.
+ *
+ */
+enum ColumnLogKind {
+  COLUMN_LOG_DETECTION = 0,
+  COLUMN_LOG_TRACK = 1
+};
+
+/**
+ * @brief The header of a log.
+ * @details A log is organized as follows: \n
+ *  - a ColumnLogFileHeader, padded to COLUMN_LOG_ALIGNMENT bytes, \n
+ *  - a sequence of segments of segment_size bytes. \n
+ * A segment starts with a ColumnLogSegmentHeader, followed by the columns, each an array of rows_per_segment values
+ * of column_widths[c] bytes, starting column_offsets[c] bytes from the start of the segment.
+ * The fields are in the byte order of the machine.
+ */
+typedef struct ColumnLogFileHeader{
+  uint64_t magic; // "DTCOLLOG"
+  uint32_t version;
+  uint32_t num_columns;
+  uint64_t rows_per_segment;
+  uint64_t segment_size; // In bytes, a multiple of COLUMN_LOG_ALIGNMENT.
+  uint64_t column_offsets[COLUMN_LOG_MAX_COLUMNS];
+  uint32_t column_widths[COLUMN_LOG_MAX_COLUMNS];
+} ColumnLogFileHeader;
+
+/**
+ * @brief The header of a segment, which indexes it in time.
+ * @details The rows are written before num_rows is increased: after a crash, the rows counted are complete.
+ * A segment is sealed once it is full, and its rows are on the disk. The segments that were preallocated
+ * but not used yet have no magic.
+ */
+typedef struct ColumnLogSegmentHeader{
+  uint64_t magic; // "DTCOLSEG"
+  uint64_t index;
+  std::atomic<uint64_t> num_rows;
+  int64_t min_stamp;
+  int64_t max_stamp;
+  uint32_t sorted; // 1 if the stamps of the segment never decrease, they can be searched by bisection.
+  uint32_t sealed;
+} ColumnLogSegmentHeader;
+
+/**
+ * @brief A row of the log.
+ *
+ */
+typedef struct ColumnLogRow{
+  int64_t stamp;
+  uint64_t sequence;
+  uint32_t kind;
+  uint32_t class_id;
+  uint32_t id;
+  float confidence;
+  float state[COLUMN_LOG_NUM_STATES]; // x, y, vx, vy, w, h for the 2D tracks, x, y, z, vx, vy, vz, w, d, h for the 3D tracks.
+  float position[3];
+} ColumnLogRow;
+
+/**
+ * @brief A range of consecutive rows of a segment.
+ *
+ */
+typedef struct ColumnLogSpan{
+  uint64_t segment;
+  uint64_t begin;
+  uint64_t end; // One past the last row.
+} ColumnLogSpan;
+
+/**
+ * @brief Appends rows to a log.
+ * @details The current segment is mapped, and the rows are written in place, column by column. When it is full,
+ * a background thread syncs it to the disk, seals it, and preallocates the segment after the next one, such that
+ * the calling thread never waits on the disk. An existing log is appended to: the writer continues its last segment.
+ */
+class ColumnLogWriter {
+  private:
+    std::string path_;
+    int fd_;
+    ColumnLogFileHeader layout_;
+    char* segment_;
+    ColumnLogSegmentHeader* segment_header_;
+    uint64_t segment_index_;
+    uint64_t num_rows_;
+    int64_t last_stamp_;
+
+    std::vector<char*> to_seal_;
+    uint64_t to_allocate_;
+    bool running_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+
+    bool mapSegment(const uint64_t&);
+    void run(const uint64_t&);
+    template <typename T> T* getColumn(const ColumnLogColumn&);
+
+  public:
+    ColumnLogWriter();
+    ~ColumnLogWriter();
+    bool open(const std::string&, const uint64_t&);
+    void close();
+    bool isOpen() const;
+    uint64_t getNumRows() const;
+    bool append(const ColumnLogRow&);
+    void writeFrame(const PipelineFrame&);
+};
+
+/**
+ * @brief Reads a log.
+ * @details The log is mapped read-only, the columns are read in place. A log can be read while it is written:
+ * the rows written after it was opened are not seen.
+ */
+class ColumnLogReader {
+  private:
+    const char* map_;
+    size_t map_size_;
+    ColumnLogFileHeader layout_;
+    std::vector<const ColumnLogSegmentHeader*> segments_;
+    std::vector<uint64_t> num_rows_;
+
+  public:
+    ColumnLogReader();
+    ~ColumnLogReader();
+    bool open(const std::string&);
+    void close();
+    bool isOpen() const;
+    uint64_t getNumSegments() const;
+    uint64_t getNumRows() const;
+    uint64_t getNumRows(const uint64_t&) const;
+    bool getTimeRange(int64_t&, int64_t&) const;
+    void findRange(const int64_t&, const int64_t&, std::vector<ColumnLogSpan>&) const;
+    const void* getColumn(const uint64_t&, const ColumnLogColumn&) const;
+    void readRow(const uint64_t&, const uint64_t&, ColumnLogRow&) const;
+};
+
+#endif
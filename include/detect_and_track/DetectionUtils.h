@@ -21,10 +21,68 @@
 #include <detect_and_track/ObjectDetection.h>
 #include <detect_and_track/PoseEstimator.h>
 #include <detect_and_track/Tracker.h>
+#include <detect_and_track/Pipeline.h>
+#include <detect_and_track/SharedMemory.h>
+#include <detect_and_track/Instrumentation.h>
 #include <detect_and_track/utils.h>
 
 #include <opencv2/opencv.hpp>
 
+class OfflineRunner;
+
+/**
+ * @brief The data of a frame travelling through the staged pipeline.
+ * @details Each stage fills the fields it is responsible for. The images are cv::Mat headers,
+ * they share the data they were built from: the producers must not write into a buffer once it was pushed.
+ */
+typedef struct PipelineFrame{
+  PipelineStamps stamps;
+  std::string frame_id; // The frame of the sensor data.
+  cv::Mat image; // The RGB image.
+  cv::Mat depth; // The depth image, in meters (CV_32F), or in millimeters (CV_16U), if any.
+  std::shared_ptr<const void> depth_owner; // Keeps the depth data alive when it is not owned by the cv::Mat.
+  std::vector<std::vector<BoundingBox>> bboxes;
+  std::vector<std::vector<BoundingBox3D>> bboxes3D;
+  std::vector<std::vector<float>> distances;
+  std::vector<std::vector<std::vector<float>>> points;
+  std::vector<std::map<unsigned int, std::vector<float>>> tracker_states;
+  std::vector<std::map<unsigned int, float>> track_distances;
+  std::vector<std::map<unsigned int, std::vector<float>>> track_points;
+  std::vector<TrackDelta> deltas;
+  std::vector<std::shared_ptr<const TrackSnapshot>> snapshots;
+} PipelineFrame;
+
+/**
+ * @brief Exports the frames travelling through the pipeline to other processes.
+ * @details Writes the images, the detections, and the tracks of each frame in three shared-memory
+ * ring buffers: <name>_frames, <name>_detections, and <name>_tracks. All the records of a frame carry
+ * its acquisition time. The export never waits on the readers, see SharedMemory.h.
+ */
+class SharedMemoryExporter {
+  private:
+    SharedMemoryWriter frames_;
+    SharedMemoryWriter detections_;
+    SharedMemoryWriter tracks_;
+    bool export_images_;
+
+    // Frames not exported, reported at most once per second
+    uint64_t dropped_images_;
+    uint64_t dropped_tracks_;
+    std::chrono::steady_clock::time_point last_drop_report_;
+
+    void writeImage(const cv::Mat&, const int64_t&);
+    void writeDetections(const std::vector<std::vector<BoundingBox>>&, const int64_t&);
+    void writeTracks(const PipelineFrame&, const int64_t&);
+    void reportDrops();
+
+  public:
+    SharedMemoryExporter();
+    SharedMemoryExporter(const std::string&, const unsigned int&, const int&, const int&, const bool&);
+    ~SharedMemoryExporter();
+    bool isOpen() const;
+    void write(const PipelineFrame&);
+};
+
 
 class Detect {
   protected:
@@ -38,12 +96,12 @@ class Detect {
     cv::Mat padded_image_;
 
     //Profiling variables
-#ifdef PROFILE
+    bool profile_detection_;
     std::chrono::time_point<std::chrono::system_clock> start_image_;
     std::chrono::time_point<std::chrono::system_clock> end_image_;
     std::chrono::time_point<std::chrono::system_clock> start_detection_;
     std::chrono::time_point<std::chrono::system_clock> end_detection_;
-#endif
+    LatencyHistogram* resize_histogram_;
 
     // Object detector parameters
     int num_classes_;
@@ -51,6 +109,12 @@ class Detect {
 
     ObjectDetector* OD_;
 
+    // Offline processing
+    unsigned int offline_threads_;
+
+    void addOfflineDetection(OfflineRunner&);
+    void applyOffline(const std::string&, const std::string&, const bool&, const bool&, const bool&, const bool&);
+
   public:
     Detect();
     Detect(GlobalParameters&, DetectionParameters&, NMSParameters&);
@@ -58,10 +122,17 @@ class Detect {
     ~Detect();
 
     void detectObjects(cv::Mat&, std::vector<std::vector<BoundingBox>>&);
-    void generateDetectionImage(cv::Mat&, const std::vector<std::vector<BoundingBox>>&);
+    void generateDetectionImage(cv::Mat&, const std::vector<std::vector<BoundingBox>>&, const float&);
+    void detectObjects(std::vector<cv::Mat>&, std::vector<std::vector<std::vector<BoundingBox>>>&);
     void adjustBoundingBoxes(std::vector<std::vector<BoundingBox>>&);
+    void adjustBoundingBoxes(std::vector<std::vector<BoundingBox>>&, const float&, const int&, const int&);
     void padImage(cv::Mat&);
+    void letterboxImage(const cv::Mat&, cv::Mat&, float&, int&, int&);
     void printProfilingDetection();
+    void setDetectionProfiling(const bool&);
+    void setDetectionInstrumentation(Instrumentation*);
+    bool detectFrame(PipelineFrame&);
+    void setOfflineThreads(const unsigned int&);
     void applyOnFolder(std::string, std::string, bool, bool, bool);
     void applyOnVideo(std::string, std::string, bool, bool, bool);
 };
@@ -70,12 +141,12 @@ class Detect {
 class Locate {
   protected:
     //Profiling variables
-#ifdef PROFILE
+    bool profile_localization_;
     std::chrono::time_point<std::chrono::system_clock> start_distance_;
     std::chrono::time_point<std::chrono::system_clock> end_distance_;
     std::chrono::time_point<std::chrono::system_clock> start_position_;
     std::chrono::time_point<std::chrono::system_clock> end_position_;
-#endif
+    LatencyHistogram* locate_histogram_;
 
     PoseEstimator* PE_;
 
@@ -91,6 +162,10 @@ class Locate {
                 std::vector<std::map<unsigned int, float>>&, std::vector<std::map<unsigned int, std::vector<float>>>&);
     void updateCameraInfo(const std::vector<float>&, const std::vector<float>&);
     void printProfilingLocalization();
+    void setLocalizationProfiling(const bool&, const bool&);
+    void setLocalizationInstrumentation(Instrumentation*);
+    bool locateFrame(PipelineFrame&);
+    bool locateTracksFrame(PipelineFrame&);
     void make3DBoundingBoxes(const std::vector<std::vector<std::vector<float>>>&, const std::vector<std::vector<BoundingBox>>&,
                              std::vector<std::vector<BoundingBox3D>>&);
 };
@@ -114,18 +189,20 @@ class Track2D {
     float max_bbox_height_;
 
     //Profiling variables
-#ifdef PROFILE
+    bool profile_tracking_;
     std::chrono::time_point<std::chrono::system_clock> start_tracking_;
     std::chrono::time_point<std::chrono::system_clock> end_tracking_;
-#endif
+    LatencyHistogram* associate_histogram_;
 
     // dt update for Kalman 
     float dt_;
+    int64_t last_stamp_;
     
     // Object detector parameters
     std::vector<std::string> class_map_;
 
-    std::vector<Tracker2D*> Trackers_;
+    std::vector<BaseTracker*> Trackers_;
+    CheckpointWriter* checkpoint_writer_;
 
     void cast2states(std::vector<std::vector<std::vector<float>>>&,
                      const std::vector<std::vector<BoundingBox>>&);
@@ -141,12 +218,20 @@ class Track2D {
     void track(const std::vector<std::vector<BoundingBox>>&,
               std::vector<std::map<unsigned int, std::vector<float>>>&,
               const float&);
-    void generateTrackingImage(cv::Mat&, const std::vector<std::map<unsigned int, std::vector<float>>>);
+    void generateTrackingImage(cv::Mat&, const std::vector<std::map<unsigned int, std::vector<float>>>&, const float&);
     void printProfilingTracking();
+    void setTrackingProfiling(const bool&);
+    void setTrackingInstrumentation(Instrumentation*);
+    void getDeltas(std::vector<TrackDelta>&) const;
+    void getSnapshots(std::vector<std::shared_ptr<const TrackSnapshot>>&) const;
+    bool trackFrame(PipelineFrame&);
 };
 
 
 class DetectAndLocate : public Detect, public Locate {
+  protected:
+    void applyOffline(const std::string&, const std::string&, const bool&, const bool&, const bool&, const bool&);
+
   public:
     DetectAndLocate();
     DetectAndLocate(GlobalParameters&, DetectionParameters&, NMSParameters&,
@@ -157,6 +242,9 @@ class DetectAndLocate : public Detect, public Locate {
 
 
 class DetectAndTrack2D : public Detect, public Track2D {
+  protected:
+    void applyOffline(const std::string&, const std::string&, const bool&, const bool&, const bool&, const bool&);
+
   public:
     DetectAndTrack2D();
     DetectAndTrack2D(GlobalParameters&, DetectionParameters&, NMSParameters&,
@@ -167,6 +255,9 @@ class DetectAndTrack2D : public Detect, public Track2D {
 
 
 class DetectTrack2DAndLocate : public Detect, public Locate, public Track2D {
+  protected:
+    void applyOffline(const std::string&, const std::string&, const bool&, const bool&, const bool&, const bool&);
+
   public:
     DetectTrack2DAndLocate();
     DetectTrack2DAndLocate(GlobalParameters&, DetectionParameters&, NMSParameters&,
@@ -194,18 +285,25 @@ class Track3D {
     float max_bbox_height_;
 
     //Profiling variables
-#ifdef PROFILE
+    bool profile_tracking_;
     std::chrono::time_point<std::chrono::system_clock> start_tracking_;
     std::chrono::time_point<std::chrono::system_clock> end_tracking_;
-#endif
+    LatencyHistogram* associate_histogram_;
 
     // dt update for Kalman 
     float dt_;
+    int64_t last_stamp_;
     
     // Object detector parameters
     std::vector<std::string> class_map_;
 
-    std::vector<Tracker3D*> Trackers_;
+    bool static_objects_;
+    float voxel_size_;
+    bool use_frustum_;
+    Frustum frustum_;
+
+    std::vector<BaseTracker*> Trackers_;
+    CheckpointWriter* checkpoint_writer_;
 
     void cast2states(std::vector<std::vector<std::vector<float>>>&,
                      const std::vector<std::vector<BoundingBox3D>>&);
@@ -221,11 +319,22 @@ class Track3D {
     void track(const std::vector<std::vector<BoundingBox3D>>&,
               std::vector<std::map<unsigned int, std::vector<float>>>&,
               const float&);
-    void generateTrackingImage(cv::Mat&, const std::vector<std::map<unsigned int, std::vector<float>>>);
+    void generateTrackingImage(cv::Mat&, const std::vector<std::map<unsigned int, std::vector<float>>>&, const float&);
     void printProfilingTracking();
+    void setTrackingProfiling(const bool&);
+    void setTrackingInstrumentation(Instrumentation*);
+    void getDeltas(std::vector<TrackDelta>&) const;
+    void getSnapshots(std::vector<std::shared_ptr<const TrackSnapshot>>&) const;
+    bool trackFrame(PipelineFrame&);
+    void setCameraIntrinsics(const float&, const float&, const float&, const float&, const int&, const int&);
+    void setCameraPose(const std::vector<float>&, const std::vector<float>&);
+    void invalidateCameraPose();
 };
 
 class DetectAndTrack3D : public Detect, public Locate, public Track3D {
+  protected:
+    void applyOffline(const std::string&, const std::string&, const bool&, const bool&, const bool&, const bool&);
+
   public:
     DetectAndTrack3D();
     DetectAndTrack3D(GlobalParameters&, DetectionParameters&, NMSParameters&,
@@ -0,0 +1,89 @@
+/**
+ * @file FrameArena.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the frame arena.
+ * @details This file implements a monotonic memory resource, reset after each frame, from which the
+ * temporaries of the stages of the pipeline are allocated through std::pmr containers.
+ * It only depends on the standard library.
+ */
+
+#ifndef FrameArena_H
+#define FrameArena_H
+
+#include <memory>
+#include <memory_resource>
+#include <atomic>
+#include <cstdint>
+#include <stdio.h>
+
+/**
+ * @brief A monotonic arena, reset at the end of each frame.
+ * @details The allocations are carved out of a preallocated buffer by moving a pointer, and only released when
+ * the arena is reset. The last allocation is the exception: releasing it gives its memory back, such that
+ * the temporaries created and destroyed in a loop reuse the same memory. When the buffer is full, the allocations
+ * fall back to the heap, and are counted as overflows: the buffer should then be made larger. \n
+ * An arena is owned by a single thread. The temporaries of a frame must be destroyed before the arena is reset.
+ * The code that allocates temporaries gets the arena of its thread through getResource, which returns
+ * the heap outside of the stages of the pipeline, such that it can be called from anywhere.
+ */
+class FrameArena : public std::pmr::memory_resource {
+  private:
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_;
+    size_t used_;
+    std::pmr::memory_resource* upstream_;
+    // Statistics, read from other threads
+    std::atomic<uint64_t> high_water_;
+    std::atomic<uint64_t> overflow_;
+
+    void* do_allocate(size_t, size_t) override;
+    void do_deallocate(void*, size_t, size_t) override;
+    bool do_is_equal(const std::pmr::memory_resource&) const noexcept override;
+
+  public:
+    FrameArena(const size_t&);
+    void reset();
+    size_t getCapacity() const;
+    uint64_t getHighWaterMark() const;
+    uint64_t getOverflowCount() const;
+
+    static FrameArena* setCurrent(FrameArena*);
+    static std::pmr::memory_resource* getResource();
+};
+
+/**
+ * @brief Makes an arena the arena of the calling thread for the duration of a frame, and resets it at the end.
+ * @details Does nothing if the arena is nullptr: the temporaries are then allocated on the heap.
+ */
+class FrameArenaScope {
+  private:
+    FrameArena* arena_;
+    FrameArena* previous_;
+
+  public:
+    /**
+     * @brief Enters the frame.
+     *
+     * @param arena The pointer to the arena, nullptr to allocate the temporaries on the heap.
+     */
+    FrameArenaScope(FrameArena* arena) : arena_(arena) {
+      previous_ = FrameArena::setCurrent(arena_);
+    }
+
+    /**
+     * @brief Resets the arena, and restores the previous arena of the thread.
+     *
+     */
+    ~FrameArenaScope() {
+      FrameArena::setCurrent(previous_);
+      if (arena_ != nullptr) {
+        arena_->reset();
+      }
+    }
+};
+
+#endif
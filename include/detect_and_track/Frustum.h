@@ -0,0 +1,71 @@
+/**
+ * @file Frustum.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the camera frustum class.
+ * @details This file implements a simple pin-hole frustum used to check if a point is seen by the camera,
+ * and the rigid transforms used to move the positions of the objects from the camera to the global frame.
+ */
+
+#ifndef Frustum_H
+#define Frustum_H
+
+#include <vector>
+#include <eigen3/Eigen/Dense>
+#include <math.h>
+
+/**
+ * @brief A rigid transform, as used to move points from one frame to another.
+ *
+ */
+typedef struct RigidTransform{
+  Eigen::Matrix3f rotation;
+  Eigen::Vector3f translation;
+} RigidTransform;
+
+void transformPoints(const RigidTransform&, std::vector<std::vector<std::vector<float>>>&);
+
+/**
+ * @brief The viewing volume of a camera.
+ * @details This class describes the volume of space seen by a pin-hole camera.
+ * The volume is bounded by the borders of the image, and by a minimum and maximum depth.
+ * The pose of the camera is given in the global frame, such that points expressed in the
+ * global frame can be tested directly. The frustum is only valid once both the intrinsics
+ * and the pose of the camera have been set.
+ */
+class Frustum {
+  private:
+    // Camera intrinsics
+    float fx_;
+    float fy_;
+    float cx_;
+    float cy_;
+    int image_width_;
+    int image_height_;
+
+    // Culling parameters
+    float min_depth_;
+    float max_depth_;
+    float margin_;
+
+    // Global to camera transform
+    Eigen::Matrix3f R_;
+    Eigen::Vector3f t_;
+
+    bool has_intrinsics_;
+    bool has_pose_;
+
+  public:
+    Frustum();
+    Frustum(const float&, const float&, const float&);
+    void setIntrinsics(const float&, const float&, const float&, const float&, const int&, const int&);
+    void setPose(const std::vector<float>&, const std::vector<float>&);
+    void invalidate();
+    bool isValid() const;
+    bool isVisible(const std::vector<float>&) const;
+};
+
+#endif
@@ -0,0 +1,263 @@
+/**
+ * @file Instrumentation.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the latency instrumentation.
+ * @details This file implements lock-free latency histograms, and the scoped timers recording into them.
+ * Each step of the processing (resize, preprocess, infer, decode, NMS, locate, TF, associate, publish)
+ * records its duration in its own histogram, from which the percentiles are periodically collected.
+ * It also implements the frame traces: spans recorded in a ring buffer, and exported in the Chrome trace format,
+ * and the accounting of the heap allocations made by each stage of the pipeline.
+ * It only depends on the standard library.
+ */
+
+#ifndef Instrumentation_H
+#define Instrumentation_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <stdio.h>
+#include <pthread.h>
+
+// Each power of 2 is split in 2^(LATENCY_HISTOGRAM_SUB_BITS-1) buckets, the relative error is below 2^-(LATENCY_HISTOGRAM_SUB_BITS-1).
+#define LATENCY_HISTOGRAM_SUB_BITS 6
+#define LATENCY_HISTOGRAM_SUB_COUNT (1 << LATENCY_HISTOGRAM_SUB_BITS)
+#define LATENCY_HISTOGRAM_HALF_COUNT (LATENCY_HISTOGRAM_SUB_COUNT / 2)
+#define LATENCY_HISTOGRAM_BUCKETS ((64 - LATENCY_HISTOGRAM_SUB_BITS + 1) * LATENCY_HISTOGRAM_HALF_COUNT + LATENCY_HISTOGRAM_HALF_COUNT)
+
+// The maximum number of scopes the allocations are attributed to, including the default scope.
+#define ALLOCATION_MAX_SCOPES 32
+
+/**
+ * @brief The percentiles of a histogram over a reporting period. The durations are in milliseconds.
+ *
+ */
+typedef struct LatencySummary{
+  std::string name;
+  uint64_t count; // The number of durations recorded during the period.
+  float mean;
+  float p50;
+  float p90;
+  float p99;
+  float max;
+} LatencySummary;
+
+/**
+ * @brief A lock-free histogram of durations, in nanoseconds.
+ * @details The buckets are log-linear, like in HDR histograms: the durations below 2^LATENCY_HISTOGRAM_SUB_BITS ns
+ * have their own bucket, and each following power of 2 is split in equal buckets. With the default of 6 bits,
+ * the percentiles are within 3% of the true values, at any scale, in 15KB of counters. \n
+ * Any number of threads can record at the same time, a record is two relaxed atomic increments.
+ * The histogram is read and cleared by collect, the durations recorded meanwhile are counted in either period.
+ */
+class LatencyHistogram {
+  private:
+    std::string name_;
+    std::atomic<uint64_t> counts_[LATENCY_HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+
+    static unsigned int getIndex(const uint64_t&);
+    static uint64_t getValue(const unsigned int&);
+
+  public:
+    LatencyHistogram(const std::string&);
+    const std::string& getName() const;
+    void record(const uint64_t&);
+    void collect(LatencySummary&);
+};
+
+/**
+ * @brief Records the time spent in a scope into a histogram.
+ * @details Uses the steady clock. Does nothing if the histogram is nullptr, such that the instrumentation
+ * can be disabled at no cost other than a branch.
+ */
+class ScopedTimer {
+  private:
+    LatencyHistogram* histogram_;
+    std::chrono::steady_clock::time_point start_;
+
+  public:
+    /**
+     * @brief Starts the timer.
+     *
+     * @param histogram The pointer to the histogram, nullptr to disable the timer.
+     */
+    ScopedTimer(LatencyHistogram* histogram) : histogram_(histogram) {
+      if (histogram_ != nullptr) {
+        start_ = std::chrono::steady_clock::now();
+      }
+    }
+
+    /**
+     * @brief Stops the timer, and records the duration.
+     *
+     */
+    ~ScopedTimer() {
+      if (histogram_ != nullptr) {
+        histogram_->record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+      }
+    }
+};
+
+/**
+ * @brief The histograms of a node.
+ * @details The histograms are created on first use, and live as long as the Instrumentation.
+ * The lookups take a lock, they are meant to be done once, when the stages are built, not per frame.
+ */
+class Instrumentation {
+  private:
+    std::vector<std::unique_ptr<LatencyHistogram>> histograms_;
+    std::mutex mutex_;
+
+  public:
+    Instrumentation();
+    LatencyHistogram* getHistogram(const std::string&);
+    void collect(std::vector<LatencySummary>&);
+};
+
+/**
+ * @brief A slot of the trace ring buffer.
+ * @details The fields are written by a single thread at a time, and read by the dump. The version
+ * is odd while the slot is written, and equal to 2*(index+1) once the span number index is complete.
+ */
+typedef struct TraceSlot{
+  std::atomic<uint64_t> version;
+  std::atomic<const char*> name;
+  std::atomic<int64_t> stamp; // The acquisition time of the frame, in nanoseconds.
+  std::atomic<uint64_t> sequence;
+  std::atomic<int64_t> start; // The start of the span, in nanoseconds since the creation of the buffer.
+  std::atomic<int64_t> duration; // In nanoseconds.
+  std::atomic<uint32_t> thread;
+} TraceSlot;
+
+/**
+ * @brief A lock-free ring buffer of spans, exported in the Chrome trace format.
+ * @details Each span is the time spent by a thread on a frame: in a callback, a stage of the pipeline,
+ * a TF lookup, ... The spans of a frame are keyed by its acquisition time (the stamp of the ROS header),
+ * and carry a sequence number (the one of the header for the callbacks, the one of the pipeline for the stages).
+ * Any number of threads can record at the same time, a record takes a slot with one atomic increment.
+ * The buffer is preallocated, once it is full the oldest spans are overwritten. \n
+ * The dump writes the spans in a JSON file that can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing,
+ * one track per thread, with arrows linking the spans of each frame. The names of the spans are not copied,
+ * they must outlive the buffer.
+ */
+class TraceBuffer {
+  private:
+    std::unique_ptr<TraceSlot[]> slots_;
+    size_t size_;
+    std::atomic<uint64_t> head_;
+    std::chrono::steady_clock::time_point origin_;
+
+    static uint32_t getThread();
+
+  public:
+    TraceBuffer(const size_t&);
+    void record(const char*, const int64_t&, const uint64_t&, const std::chrono::steady_clock::time_point&,
+                const std::chrono::steady_clock::time_point&);
+    bool dump(const std::string&, size_t&);
+};
+
+/**
+ * @brief Records the time spent in a scope as a span of a frame.
+ * @details Does nothing if the buffer is nullptr, such that tracing can be disabled at no cost other than a branch.
+ */
+class ScopedSpan {
+  private:
+    TraceBuffer* trace_;
+    const char* name_;
+    int64_t stamp_;
+    uint64_t sequence_;
+    std::chrono::steady_clock::time_point start_;
+
+  public:
+    /**
+     * @brief Starts the span.
+     *
+     * @param trace The pointer to the buffer, nullptr to disable the span.
+     * @param name The name of the span, it must outlive the buffer.
+     * @param stamp The reference to the acquisition time of the frame, in nanoseconds.
+     * @param sequence The reference to the sequence number of the frame.
+     */
+    ScopedSpan(TraceBuffer* trace, const char* name, const int64_t& stamp, const uint64_t& sequence) :
+               trace_(trace), name_(name), stamp_(stamp), sequence_(sequence) {
+      if (trace_ != nullptr) {
+        start_ = std::chrono::steady_clock::now();
+      }
+    }
+
+    /**
+     * @brief Stops the span, and records it.
+     *
+     */
+    ~ScopedSpan() {
+      if (trace_ != nullptr) {
+        trace_->record(name_, stamp_, sequence_, start_, std::chrono::steady_clock::now());
+      }
+    }
+};
+
+/**
+ * @brief The heap allocations made in a scope since the last collection.
+ *
+ */
+typedef struct AllocationStatistics{
+  std::string name;
+  uint64_t count; // The number of allocations.
+  uint64_t bytes; // The number of bytes requested.
+} AllocationStatistics;
+
+/**
+ * @brief Counts the heap allocations, and attributes them to the scope (usually the stage of the pipeline) of the calling thread.
+ * @details The allocations are only seen if the allocation hooks (src/AllocationHooks.cpp) are linked in the executable:
+ * they replace malloc and its variants, through which operator new, cv::Mat, and Eigen allocate. The hooks are built
+ * in the nodes with the ALLOCATION_ACCOUNTING CMake option, and always in the allocation_budget executable.
+ * The allocations made outside of any scope are attributed to the default scope, "other".
+ * Recording is lock-free, and never allocates.
+ */
+class AllocationAccounting {
+  public:
+    static void setHooked();
+    static bool isHooked();
+    static unsigned int getScope(const std::string&);
+    static unsigned int setScope(const unsigned int&);
+    static void record(const size_t&);
+    static void collect(std::vector<AllocationStatistics>&);
+};
+
+/**
+ * @brief Attributes the allocations made by the calling thread in a C++ scope to an accounting scope.
+ * @details The previous scope of the thread is restored on exit, the scopes can be nested.
+ */
+class AllocationScope {
+  private:
+    unsigned int previous_;
+
+  public:
+    /**
+     * @brief Enters the scope.
+     *
+     * @param scope The reference to the index of the scope, returned by AllocationAccounting::getScope.
+     */
+    AllocationScope(const unsigned int& scope) {
+      previous_ = AllocationAccounting::setScope(scope);
+    }
+
+    /**
+     * @brief Restores the previous scope.
+     *
+     */
+    ~AllocationScope() {
+      AllocationAccounting::setScope(previous_);
+    }
+};
+
+#endif
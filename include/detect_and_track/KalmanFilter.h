@@ -51,7 +51,7 @@ class BaseKalmanFilter {
   public:
     BaseKalmanFilter();
     explicit BaseKalmanFilter(const float&, const bool&, const bool&, const std::vector<float>&, const std::vector<float>&);
-    ~BaseKalmanFilter();
+    virtual ~BaseKalmanFilter();
 
     void predict();
     void predict(const float&);
@@ -59,6 +59,9 @@ class BaseKalmanFilter {
     void resetFilter(const std::vector<float>&);
     void getState(std::vector<float>&);
     void getUncertainty(std::vector<float>&);
+    unsigned int getStateSize() const;
+    void exportState(float*, float*) const;
+    void importState(const float*, const float*);
 };
 
 /**
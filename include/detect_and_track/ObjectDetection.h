@@ -26,6 +26,7 @@
 #include <cuda_runtime_api.h>
 #include <detect_and_track/logging.h>
 #include <detect_and_track/utils.h>
+#include <detect_and_track/Instrumentation.h>
 
 #define CUDA_CHECK(callstr)                                                    \
   {                                                                            \
@@ -54,6 +55,7 @@ class ObjectDetector {
     int input_size_;
     int output_size_;
     int buffer_size_;
+    int batch_size_;
     int num_classes_;
 
     // TensorRT primitives 
@@ -72,13 +74,19 @@ class ObjectDetector {
     std::shared_ptr<float[]> input_data_;
     std::shared_ptr<float[]> output_data_;
 
+    // Latency histograms, nullptr if the instrumentation is disabled
+    LatencyHistogram* preprocess_histogram_;
+    LatencyHistogram* infer_histogram_;
+    LatencyHistogram* decode_histogram_;
+    LatencyHistogram* nms_histogram_;
+
     void prepareEngine();
     size_t getSizeByDim(const nvinfer1::Dims&);
-    void preprocessImage(cv::Mat&);
+    void preprocessImage(cv::Mat&, const int&);
     void sendBufferToGPU();
     void getBufferFromGPU();
     void inferNetwork();
-    void nonMaximumSuppression(std::vector<std::vector<BoundingBox>>&);
+    void nonMaximumSuppression(std::vector<std::vector<BoundingBox>>&, const int&);
 
   public:
     ObjectDetector();
@@ -86,6 +94,9 @@ class ObjectDetector {
     ObjectDetector(int, DetectionParameters&, NMSParameters&);
     ~ObjectDetector();
     void detectObjects(cv::Mat, std::vector<std::vector<BoundingBox>>&);
+    void detectObjects(std::vector<cv::Mat>&, std::vector<std::vector<std::vector<BoundingBox>>>&);
+    int getBatchSize() const;
+    void setInstrumentation(Instrumentation*);
 };
 
 /**
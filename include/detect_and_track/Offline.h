@@ -0,0 +1,159 @@
+/**
+ * @file Offline.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the offline processing.
+ * @details This file implements a throughput-oriented pipeline to process folders of images and videos,
+ * without ROS: the images are decoded by several threads, detected in batches, located by several threads,
+ * and tracked in order. The results are written to a recording (see Recorder.h), which can be resumed.
+ */
+
+#ifndef Offline_H
+#define Offline_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <stdio.h>
+
+#include <detect_and_track/DetectionUtils.h>
+#include <detect_and_track/Recorder.h>
+
+/**
+ * @brief A frame travelling through the offline pipeline.
+ *
+ */
+typedef struct OfflineItem{
+  bool valid; // False if the image, or its depth, could not be read. The stages skip the invalid frames.
+  std::string name; // The name of the image without its extension, or the index of the frame in the video.
+  cv::Mat padded; // The image, letterboxed to the size of the network.
+  float ratio; // The ratio of the letterboxing.
+  int padding_rows;
+  int padding_cols;
+  PipelineFrame frame; // The sequence number is the index of the frame in the folder, or in the video.
+} OfflineItem;
+
+/**
+ * @brief The options of the offline processing.
+ *
+ */
+typedef struct OfflineOptions{
+  std::string mode; // The stages, recorded with the results: detect, locate, track2D, track2D_locate, or track3D.
+  std::string input; // The folder of images, or the video.
+  std::string output; // The recording the results are written to.
+  bool is_video; // Whether the input is a video.
+  bool with_depth; // Whether the depth images are read.
+  bool save_images; // Whether the annotated images are saved, in <output>_images.
+  bool resume; // Whether the processing starts after the last frame of an existing recording.
+  bool verbose; // Whether the progress is printed every second.
+  unsigned int num_threads; // The number of threads of the parallel stages, 0 to use one per core.
+} OfflineOptions;
+
+/**
+ * @brief A bounded queue, which hands the frames over in the order of their index.
+ * @details The frames can be pushed in any order, by several threads. A frame is only pushed once its index is
+ * within capacity of the next frame to be popped, which bounds the memory used by a slow frame holding the others.
+ * The queue is closed once all its producers are done.
+ */
+class OfflineQueue {
+  private:
+    std::map<uint64_t, std::unique_ptr<OfflineItem>> items_;
+    uint64_t next_;
+    size_t capacity_;
+    unsigned int producers_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+
+  public:
+    OfflineQueue(const uint64_t&, const size_t&, const unsigned int&);
+    void push(std::unique_ptr<OfflineItem>&&);
+    bool pop(std::unique_ptr<OfflineItem>&);
+    bool tryPop(std::unique_ptr<OfflineItem>&);
+    void close();
+};
+
+/**
+ * @brief Reads the frames of a folder of images, or of a video, with their depth.
+ * @details In a folder, the images are read from <folder>/rgb if it exists, else from <folder>, in the order
+ * of their names. The depth of <name>.<ext> is <folder>/depth/<name>.png. The depth of the frame i of <video>.<ext>
+ * is <video>_depth/<i, on 6 digits>.png. The depth images are in millimeters (16 bits), or in meters (32 bits float). \n
+ * The frames are claimed in order by the reading threads. The images of a folder are decoded in parallel,
+ * the frames of a video are decoded one after the other.
+ */
+class OfflineSource {
+  private:
+    bool is_video_;
+    bool with_depth_;
+    std::vector<std::string> images_;
+    std::string depth_folder_;
+    cv::VideoCapture capture_;
+    uint64_t next_;
+    int64_t num_frames_;
+    std::mutex mutex_;
+
+  public:
+    OfflineSource();
+    bool openFolder(const std::string&, const bool&);
+    bool openVideo(const std::string&, const bool&);
+    bool seek(const uint64_t&);
+    bool read(OfflineItem&);
+    int64_t getNumFrames() const;
+};
+
+/**
+ * @brief A throughput-oriented pipeline, for the offline processing.
+ * @details Unlike the Pipeline of the nodes, no frame is ever dropped: the stages wait on each other.
+ * The first stage reads the frames from the source, the stages with several threads process several frames at once,
+ * the batch stages process the frames waiting in their queue together, and the stages with a single thread process
+ * the frames in order. The last stage writes the results of each frame, in order, to the recording.
+ * When resuming, the frames in the recording are skipped, and the recording is appended to. The trackers start empty.
+ */
+class OfflineRunner {
+  public:
+    typedef std::function<bool(OfflineItem&)> StageFunction;
+    typedef std::function<void(std::vector<OfflineItem*>&)> BatchFunction;
+
+  private:
+    typedef struct Stage{
+      std::string name;
+      StageFunction function;
+      BatchFunction batch_function;
+      unsigned int num_threads;
+      unsigned int batch_size;
+      std::atomic<uint64_t> busy_ns;
+    } Stage;
+
+    OfflineOptions options_;
+    OfflineSource source_;
+    RecordWriter* writer_;
+    uint64_t first_;
+    StageFunction draw_;
+    std::vector<std::unique_ptr<Stage>> stages_;
+
+    bool prepareOutput();
+    void runStage(Stage*, OfflineQueue*, OfflineQueue*);
+
+  public:
+    OfflineRunner(const OfflineOptions&);
+    ~OfflineRunner();
+    bool isOpen() const;
+    unsigned int getNumThreads() const;
+    void addStage(const std::string&, const StageFunction&, const unsigned int&);
+    void addBatchStage(const std::string&, const BatchFunction&, const unsigned int&);
+    void setDrawFunction(const StageFunction&);
+    uint64_t run();
+};
+
+#endif
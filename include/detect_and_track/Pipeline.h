@@ -0,0 +1,502 @@
+/**
+ * @file Pipeline.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the staged processing pipeline.
+ * @details This file implements a multi-threaded pipeline: each stage runs on its own thread,
+ * and the stages are connected by bounded lock-free single-producer single-consumer queues.
+ */
+
+#ifndef Pipeline_H
+#define Pipeline_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <stdio.h>
+#include <pthread.h>
+
+#include <detect_and_track/Instrumentation.h>
+#include <detect_and_track/FrameArena.h>
+
+#define PIPELINE_MAX_STAGES 8
+
+/**
+ * @brief The timestamps carried by an item along the pipeline.
+ * @details The acquisition time is the time of the sensor data (the stamp of the ROS header),
+ * it is kept so that the outputs can be stamped with it. The reception time is taken when the
+ * item enters the pipeline, and the latencies are measured from it.
+ */
+typedef struct PipelineStamps{
+  uint64_t sequence; // The index of the item, incremented by each push.
+  int64_t stamp; // The acquisition time of the sensor data, in nanoseconds.
+  std::chrono::time_point<std::chrono::steady_clock> received; // The time at which the item entered the pipeline.
+  float stage_latency[PIPELINE_MAX_STAGES]; // The time in between the reception and the end of each stage, in seconds.
+} PipelineStamps;
+
+/**
+ * @brief The statistics of a stage.
+ *
+ */
+typedef struct StageStatistics{
+  std::string name;
+  uint64_t processed; // The number of items processed by the stage.
+  uint64_t dropped; // The number of items skipped because a newer one was waiting, or rejected by the stage.
+  uint64_t overflow; // The number of items lost because the input queue of the stage was full.
+  uint64_t queue_depth; // The number of items waiting in the input queue of the stage.
+  float mean_time; // The mean processing time of the stage, in milliseconds.
+  uint64_t arena_high_water; // The largest amount of memory used in the arena of the stage by an item, in bytes.
+  uint64_t arena_overflow; // The number of temporaries that did not fit in the arena of the stage.
+} StageStatistics;
+
+/**
+ * @brief Returns the time elapsed since an item entered the pipeline.
+ *
+ * @param stamps The reference to the timestamps of the item.
+ * @return The end-to-end latency, in seconds.
+ */
+inline float pipelineLatency(const PipelineStamps& stamps) {
+  return std::chrono::duration<float>(std::chrono::steady_clock::now() - stamps.received).count();
+}
+
+/**
+ * @brief A bounded lock-free single-producer single-consumer queue.
+ * @details A ring buffer whose capacity is rounded up to a power of 2. The producer only writes the tail,
+ * the consumer only writes the head, no locks are taken. popLatest empties the queue and keeps only the
+ * most recent item, it is used by the stages that only care about the latest data.
+ */
+template <typename T>
+class SPSCQueue {
+  private:
+    std::vector<T> buffer_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_; // Next slot to be read, written by the consumer.
+    alignas(64) std::atomic<size_t> tail_; // Next slot to be written, written by the producer.
+
+  public:
+    /**
+     * @brief Prefered constructor.
+     *
+     * @param capacity The reference to the minimum number of items the queue can hold.
+     */
+    SPSCQueue(const size_t& capacity) {
+      size_t size = 1;
+      while (size < capacity) {
+        size <<= 1;
+      }
+      buffer_.resize(size);
+      mask_ = size - 1;
+      head_.store(0);
+      tail_.store(0);
+    }
+
+    /**
+     * @brief Adds an item at the back of the queue. Producer side.
+     *
+     * @param item The item to be moved into the queue, it is left untouched if the queue is full.
+     * @return False if the queue is full.
+     */
+    bool push(T&& item) {
+      const size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail - head_.load(std::memory_order_acquire) > mask_) {
+        return false;
+      }
+      buffer_[tail & mask_] = std::move(item);
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * @brief Takes the item at the front of the queue. Consumer side.
+     *
+     * @param item The reference to the item.
+     * @return False if the queue is empty.
+     */
+    bool pop(T& item) {
+      const size_t head = head_.load(std::memory_order_relaxed);
+      if (head == tail_.load(std::memory_order_acquire)) {
+        return false;
+      }
+      item = std::move(buffer_[head & mask_]);
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * @brief Takes the most recent item, and discards the older ones. Consumer side.
+     *
+     * @param item The reference to the item.
+     * @return The number of items removed from the queue, 0 if the queue is empty.
+     */
+    size_t popLatest(T& item) {
+      const size_t head = head_.load(std::memory_order_relaxed);
+      const size_t tail = tail_.load(std::memory_order_acquire);
+      if (head == tail) {
+        return 0;
+      }
+      for (size_t i = head; i + 1 < tail; i++) {
+        buffer_[i & mask_] = T();
+      }
+      item = std::move(buffer_[(tail - 1) & mask_]);
+      head_.store(tail, std::memory_order_release);
+      return tail - head;
+    }
+
+    /**
+     * @brief Returns the number of items in the queue. Approximate if the queue is in use.
+     *
+     * @return The number of items.
+     */
+    size_t size() const {
+      const size_t head = head_.load(std::memory_order_acquire);
+      const size_t tail = tail_.load(std::memory_order_acquire);
+      return tail > head ? tail - head : 0;
+    }
+
+    /**
+     * @brief Checks if the queue is empty.
+     *
+     * @return True if the queue is empty.
+     */
+    bool empty() const {
+      return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+};
+
+/**
+ * @brief A staged processing pipeline.
+ * @details Each stage is a function running on a dedicated thread. The items travel from stage to stage
+ * through bounded SPSC queues, such that a slow stage never blocks the stages upstream of it: if its input
+ * queue is full, the new items are dropped and counted. Stages built with drop_stale only process the most
+ * recent item waiting in their queue (latest wins), this is what should be used for expensive stages like
+ * the inference. Stages that need every item (like the tracking, which publishes incremental outputs) should not.
+ * A stage returning false drops the item. \n
+ * The item type T must have a member "PipelineStamps stamps". Items are handed over as unique pointers,
+ * the stage that owns an item is the only one touching it. \n
+ * The consumers spin for a short while when their queue is empty, and then sleep until the producer wakes them up.
+ * The threads are named after their stage. If a trace buffer is set, each item processed by a stage is recorded as a span.
+ * The heap allocations made by a stage are counted under its name, see AllocationAccounting.
+ * If an arena size is set, each stage owns a FrameArena, reset after each item, for its temporaries.
+ */
+template <typename T>
+class Pipeline {
+  public:
+    typedef std::function<bool(T&)> StageFunction;
+
+  private:
+    typedef struct Stage{
+      std::string name;
+      StageFunction function;
+      bool drop_stale;
+      unsigned int index;
+      unsigned int allocation_scope;
+      std::unique_ptr<FrameArena> arena;
+      std::unique_ptr<SPSCQueue<std::unique_ptr<T>>> input;
+      std::thread thread;
+      // Wake-up
+      std::atomic<bool> sleeping;
+      std::mutex mutex;
+      std::condition_variable cv;
+      // Statistics
+      std::atomic<uint64_t> processed;
+      std::atomic<uint64_t> dropped;
+      std::atomic<uint64_t> overflow;
+      std::atomic<uint64_t> busy_ns;
+    } Stage;
+
+    std::vector<std::unique_ptr<Stage>> stages_;
+    size_t queue_size_;
+    size_t arena_size_;
+    uint64_t sequence_;
+    std::atomic<bool> running_;
+    TraceBuffer* trace_;
+
+    /**
+     * @brief Wakes up a stage, if it is sleeping.
+     *
+     * @param stage The pointer to the stage.
+     */
+    void wake(Stage* stage) {
+      // Pairs with the fence in wait: either the stage sees the new item, or we see it sleeping.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (stage->sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(stage->mutex);
+        stage->cv.notify_one();
+      }
+    }
+
+    /**
+     * @brief Waits for an item to be pushed in the input queue of a stage.
+     *
+     * @param stage The pointer to the stage.
+     */
+    void wait(Stage* stage) {
+      for (unsigned int i = 0; i < 64; i++) {
+        if (!stage->input->empty() || !running_.load(std::memory_order_relaxed)) {
+          return;
+        }
+        std::this_thread::yield();
+      }
+      std::unique_lock<std::mutex> lock(stage->mutex);
+      stage->sleeping.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (stage->input->empty() && running_.load(std::memory_order_relaxed)) {
+        // The timeout is only a safety net, the producer notifies the stage.
+        stage->cv.wait_for(lock, std::chrono::milliseconds(10));
+      }
+      stage->sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief The loop of a stage.
+     *
+     * @param stage The pointer to the stage.
+     * @param next The pointer to the next stage, nullptr for the last stage.
+     */
+    void run(Stage* stage, Stage* next) {
+      pthread_setname_np(pthread_self(), stage->name.substr(0, 15).c_str());
+      std::unique_ptr<T> item;
+      while (running_.load(std::memory_order_acquire)) {
+        size_t received = 0;
+        if (stage->drop_stale) {
+          received = stage->input->popLatest(item);
+        } else {
+          received = stage->input->pop(item) ? 1 : 0;
+        }
+        if (received == 0) {
+          wait(stage);
+          continue;
+        }
+        if (received > 1) {
+          stage->dropped.fetch_add(received - 1, std::memory_order_relaxed);
+        }
+        auto start = std::chrono::steady_clock::now();
+        bool keep;
+        {
+          AllocationScope scope(stage->allocation_scope);
+          FrameArenaScope arena(stage->arena.get());
+          keep = stage->function(*item);
+        }
+        auto end = std::chrono::steady_clock::now();
+        stage->busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+        stage->processed.fetch_add(1, std::memory_order_relaxed);
+        if (trace_ != nullptr) {
+          trace_->record(stage->name.c_str(), item->stamps.stamp, item->stamps.sequence, start, end);
+        }
+        if (!keep) {
+          stage->dropped.fetch_add(1, std::memory_order_relaxed);
+          item.reset();
+          continue;
+        }
+        if (stage->index < PIPELINE_MAX_STAGES) {
+          item->stamps.stage_latency[stage->index] = std::chrono::duration<float>(end - item->stamps.received).count();
+        }
+        if (next == nullptr) {
+          item.reset();
+        } else if (next->input->push(std::move(item))) {
+          wake(next);
+        } else {
+          next->overflow.fetch_add(1, std::memory_order_relaxed);
+          item.reset();
+        }
+      }
+    }
+
+  public:
+    /**
+     * @brief Default constructor.
+     * @details Default constructor. The queues in between the stages hold 4 items.
+     *
+     */
+    Pipeline() : Pipeline(4) {}
+
+    /**
+     * @brief Prefered constructor.
+     *
+     * @param queue_size The reference to the capacity of the queues in between the stages.
+     */
+    Pipeline(const size_t& queue_size) {
+      queue_size_ = queue_size > 0 ? queue_size : 1;
+      arena_size_ = 0;
+      sequence_ = 0;
+      running_.store(false);
+      trace_ = nullptr;
+    }
+
+    /**
+     * @brief Destructor.
+     * @details Destructor. Stops the stages, the items still in the queues are discarded.
+     *
+     */
+    ~Pipeline() {
+      stop();
+    }
+
+    /**
+     * @brief Appends a stage to the pipeline.
+     * @details The stages can only be added while the pipeline is stopped.
+     *
+     * @param name The reference to the name of the stage, used in the statistics.
+     * @param function The function applied to each item. Returning false drops the item.
+     * @param drop_stale If true, the stage only processes the most recent item waiting in its queue.
+     */
+    void addStage(const std::string& name, const StageFunction& function, const bool& drop_stale) {
+      if (running_.load()) {
+        printf("[ERROR ] Pipeline::%s::l%d Cannot add stage %s to a running pipeline.\n", __func__, __LINE__, name.c_str());
+        return;
+      }
+      std::unique_ptr<Stage> stage(new Stage);
+      stage->name = name;
+      stage->function = function;
+      stage->drop_stale = drop_stale;
+      stage->index = stages_.size();
+      stage->allocation_scope = AllocationAccounting::getScope(name);
+      if (arena_size_ > 0) {
+        stage->arena.reset(new FrameArena(arena_size_));
+      }
+      stage->input.reset(new SPSCQueue<std::unique_ptr<T>>(queue_size_));
+      stage->sleeping.store(false);
+      stage->processed.store(0);
+      stage->dropped.store(0);
+      stage->overflow.store(0);
+      stage->busy_ns.store(0);
+      stages_.push_back(std::move(stage));
+    }
+
+    /**
+     * @brief Sets the size of the arenas of the stages added afterwards.
+     * @details The temporaries of a stage are allocated from its arena, see FrameArena. The arena is reset after each item.
+     *
+     * @param size The reference to the size of each arena, in bytes. 0 allocates the temporaries on the heap.
+     */
+    void setArenaSize(const size_t& size) {
+      arena_size_ = size;
+    }
+
+    /**
+     * @brief Records the items processed by each stage as spans, named after the stage.
+     * @details The buffer can only be set while the pipeline is stopped, and must outlive it.
+     *
+     * @param trace The pointer to the buffer, nullptr to disable the tracing.
+     */
+    void setTrace(TraceBuffer* trace) {
+      if (running_.load()) {
+        printf("[ERROR ] Pipeline::%s::l%d Cannot set the trace of a running pipeline.\n", __func__, __LINE__);
+        return;
+      }
+      trace_ = trace;
+    }
+
+    /**
+     * @brief Starts one thread per stage.
+     *
+     * @return False if the pipeline has no stage, or is already running.
+     */
+    bool start() {
+      if (stages_.empty() || running_.load()) {
+        return false;
+      }
+      running_.store(true, std::memory_order_release);
+      for (unsigned int i = 0; i < stages_.size(); i++) {
+        Stage* next = (i + 1 < stages_.size()) ? stages_[i + 1].get() : nullptr;
+        stages_[i]->thread = std::thread(&Pipeline::run, this, stages_[i].get(), next);
+      }
+      return true;
+    }
+
+    /**
+     * @brief Stops and joins the stages.
+     * @details The item being processed by each stage is completed, the others are discarded.
+     *
+     */
+    void stop() {
+      if (!running_.exchange(false)) {
+        return;
+      }
+      for (unsigned int i = 0; i < stages_.size(); i++) {
+        {
+          std::lock_guard<std::mutex> lock(stages_[i]->mutex);
+          stages_[i]->cv.notify_one();
+        }
+        if (stages_[i]->thread.joinable()) {
+          stages_[i]->thread.join();
+        }
+      }
+    }
+
+    /**
+     * @brief Checks if the stages are running.
+     *
+     * @return True if the pipeline is running.
+     */
+    bool isRunning() const {
+      return running_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Feeds an item to the first stage.
+     * @details Stamps the item and pushes it in the queue of the first stage. Must always be called from the same thread.
+     *
+     * @param item The reference to the item, it is released if it was accepted.
+     * @param stamp The reference to the acquisition time of the data, in nanoseconds.
+     * @return False if the pipeline is stopped, or if the first queue is full. The item is then dropped.
+     */
+    bool push(std::unique_ptr<T>& item, const int64_t& stamp) {
+      if (!running_.load(std::memory_order_acquire)) {
+        item.reset();
+        return false;
+      }
+      item->stamps.sequence = sequence_;
+      item->stamps.stamp = stamp;
+      item->stamps.received = std::chrono::steady_clock::now();
+      for (unsigned int i = 0; i < PIPELINE_MAX_STAGES; i++) {
+        item->stamps.stage_latency[i] = 0;
+      }
+      sequence_ ++;
+      if (!stages_[0]->input->push(std::move(item))) {
+        stages_[0]->overflow.fetch_add(1, std::memory_order_relaxed);
+        item.reset();
+        return false;
+      }
+      wake(stages_[0].get());
+      return true;
+    }
+
+    /**
+     * @brief Collects the statistics of the stages.
+     * @details Can be called from any thread. The statistics are empty until the pipeline is started,
+     * as the stages may still be added.
+     *
+     * @param statistics The reference to the vector in which the statistics of each stage are stored.
+     */
+    void getStatistics(std::vector<StageStatistics>& statistics) const {
+      if (!running_.load(std::memory_order_acquire)) {
+        statistics.clear();
+        return;
+      }
+      statistics.resize(stages_.size());
+      for (unsigned int i = 0; i < stages_.size(); i++) {
+        statistics[i].name = stages_[i]->name;
+        statistics[i].processed = stages_[i]->processed.load(std::memory_order_relaxed);
+        statistics[i].dropped = stages_[i]->dropped.load(std::memory_order_relaxed);
+        statistics[i].overflow = stages_[i]->overflow.load(std::memory_order_relaxed);
+        statistics[i].queue_depth = stages_[i]->input->size();
+        const uint64_t busy_ns = stages_[i]->busy_ns.load(std::memory_order_relaxed);
+        statistics[i].mean_time = statistics[i].processed > 0 ? busy_ns * 1e-6 / statistics[i].processed : 0;
+        statistics[i].arena_high_water = stages_[i]->arena ? stages_[i]->arena->getHighWaterMark() : 0;
+        statistics[i].arena_overflow = stages_[i]->arena ? stages_[i]->arena->getOverflowCount() : 0;
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,119 @@
+/**
+ * @file PipelineGraph.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the pipeline graphs.
+ * @details This file implements the composition of the staged pipeline from a description, instead of
+ * a class per combination of stages. The stages are registered by name, along with the fields of the frame
+ * they read and write. A description lists the steps of the pipeline, and each step lists its branches:
+ * the branches of a step are independent, and run in parallel on the same frame, without copy.
+ */
+
+#ifndef PipelineGraph_H
+#define PipelineGraph_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <stdio.h>
+
+#include <detect_and_track/Pipeline.h>
+#include <detect_and_track/DetectionUtils.h>
+
+/**
+ * @brief The fields of a frame, as flags.
+ *
+ */
+enum FrameField {
+  FIELD_IMAGE = 1 << 0, // image
+  FIELD_DEPTH = 1 << 1, // depth, depth_owner
+  FIELD_DETECTIONS = 1 << 2, // bboxes
+  FIELD_POSITIONS = 1 << 3, // distances, points
+  FIELD_BOXES3D = 1 << 4, // bboxes3D
+  FIELD_TRACKS = 1 << 5, // tracker_states, deltas, snapshots
+  FIELD_TRACK_POSITIONS = 1 << 6 // track_distances, track_points
+};
+
+/**
+ * @brief A stage that can be used in a graph.
+ * @details A stage may only read the fields written by the steps before it, or provided by the ingestion.
+ *
+ */
+typedef struct GraphStage{
+  std::string name;
+  unsigned int reads; // The FrameField flags the stage reads.
+  unsigned int writes; // The FrameField flags the stage writes.
+  bool drop_stale; // If true, the stage only processes the most recent frame, see Pipeline::addStage.
+  Pipeline<PipelineFrame>::StageFunction function;
+} GraphStage;
+
+/**
+ * @brief The description of a graph: the steps, in order, each with the names of its branches.
+ *
+ */
+typedef std::vector<std::vector<std::string>> GraphDescription;
+
+/**
+ * @brief Runs the branches of a step in parallel on the same frame.
+ * @details The first branch runs on the thread of the stage, the others on helper threads, woken up for each frame.
+ * The frame is kept until all the branches are done: it is dropped if any branch returns false. Each helper thread
+ * owns a frame arena, and counts its allocations under the name of its branch.
+ */
+class BranchGroup {
+  private:
+    std::vector<Pipeline<PipelineFrame>::StageFunction> branches_;
+    std::vector<std::unique_ptr<FrameArena>> arenas_;
+    std::vector<unsigned int> allocation_scopes_;
+    std::vector<std::thread> threads_;
+    std::vector<char> results_;
+    PipelineFrame* frame_;
+    uint64_t generation_;
+    unsigned int pending_;
+    bool running_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+
+    void run(const unsigned int&, const std::string&);
+
+  public:
+    BranchGroup(const std::vector<GraphStage>&, const size_t&);
+    ~BranchGroup();
+    bool process(PipelineFrame&);
+};
+
+/**
+ * @brief Builds a staged pipeline from a description.
+ * @details The description is checked before the pipeline is built: the stages must be registered, appear
+ * only once, and read only the fields available at their step. The branches of a step must not write the
+ * same fields, nor read the fields written by the other branches.
+ */
+class PipelineGraph {
+  private:
+    std::map<std::string, GraphStage> stages_;
+    std::vector<std::unique_ptr<BranchGroup>> groups_;
+    size_t arena_size_;
+
+  public:
+    PipelineGraph();
+    void addStage(const GraphStage&);
+    void setArenaSize(const size_t&);
+    bool validate(const GraphDescription&, const unsigned int&, unsigned int&) const;
+    bool build(const GraphDescription&, const unsigned int&, Pipeline<PipelineFrame>&);
+    void stop();
+    static bool uses(const GraphDescription&, const std::string&);
+    static std::string getFieldNames(const unsigned int&);
+    static std::string toString(const GraphDescription&);
+};
+
+bool parseGraphDescription(const std::string&, GraphDescription&);
+
+#endif
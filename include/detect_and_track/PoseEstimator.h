@@ -16,6 +16,7 @@
 #include <execution>
 #include <opencv2/opencv.hpp>
 #include <detect_and_track/utils.h>
+#include <detect_and_track/FrameArena.h>
 #include <stdio.h>
 
 /**
@@ -54,6 +55,9 @@ class PoseEstimator {
     float cy_;
     std::vector<float> K_;
 
+    bool debug_;
+    bool profile_;
+
   public:
     PoseEstimator();
     PoseEstimator(float, float, int, int, std::vector<float>&, std::vector<float>&, std::string, std::string);
@@ -65,6 +69,7 @@ class PoseEstimator {
     void deprojectPixel2PointBrownConrady(const float&, const std::vector<float>&, std::vector<float>&);
     void deprojectPixel2PointPinHole(const float&, const std::vector<float>&, std::vector<float>& );
     void distancePixel2PointBrownConrady(const float&, const std::vector<float>&, std::vector<float>&);
+    float getDepth(const cv::Mat&, const int&, const int&);
     float getDistance(const cv::Mat&, const int&, const int&, const int&, const int&);
     float getMinDistance(const cv::Mat&, const int&, const int&, const int&, const int&);
     float getMinAverageDistance(const cv::Mat&, const int&, const int&, const int&, const int&);
@@ -72,8 +77,13 @@ class PoseEstimator {
     void distancePixel2PointPinHole(const float&, const std::vector<float>&, std::vector<float>& );
     void projectPixel2PointPinHole(const float&, const float&, const float&, float&, float&);
     void updateCameraParameters(const std::vector<float>&, const std::vector<float>&);
+    void setVerbosity(const bool&, const bool&);
     float getFx();
     float getFy();
+    float getCx();
+    float getCy();
+    int getImageWidth();
+    int getImageHeight();
 };
 
 #endif
\ No newline at end of file
@@ -1,16 +1,30 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <pthread.h>
 
 #include <detect_and_track/DetectionUtils.h>
+#include <detect_and_track/Pipeline.h>
+#include <detect_and_track/PipelineGraph.h>
+#include <detect_and_track/Recorder.h>
+#include <detect_and_track/ColumnLog.h>
 
 // Custom messages
 #include <detect_and_track/BoundingBox2D.h>
 #include <detect_and_track/BoundingBoxes2D.h>
+#include <detect_and_track/ClassNames.h>
+#include <detect_and_track/FrameResult.h>
 #include <detect_and_track/PositionBoundingBox2D.h>
 #include <detect_and_track/PositionBoundingBox2DArray.h>
 #include <detect_and_track/PositionID.h>
 #include <detect_and_track/PositionIDArray.h>
+#include <detect_and_track/TrackState.h>
+#include <detect_and_track/TrackStateDelta.h>
 
 // ROS
 #include <opencv2/opencv.hpp>
@@ -22,59 +36,407 @@
 #include <geometry_msgs/PoseArray.h>
 #include <geometry_msgs/Pose.h>
 #include <geometry_msgs/PoseStamped.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <std_srvs/Trigger.h>
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <boost/make_shared.hpp>
 #include <tf2_ros/transform_listener.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 
+// EIGEN
+#include <eigen3/Eigen/Dense>
+
+
+/**
+ * @brief Publishes a message through a shared pointer.
+ * @details Messages published through a shared pointer are handed over as is to the subscribers
+ * living in the same process (nodelets), and only serialized if there are subscribers in other processes.
+ * The content of the message is moved into the shared pointer, the message must not be used afterwards.
+ *
+ * @param pub The reference to the publisher.
+ * @param msg The reference to the message.
+ */
+template <typename M>
+void publishShared(const ros::Publisher& pub, M& msg) {
+  pub.publish(boost::make_shared<M>(std::move(msg)));
+}
+
+void readRuntimeOptions(const ros::NodeHandle&, RuntimeOptions&);
+
+/**
+ * @brief A callback queue serviced by its own threads.
+ * @details Each input of the nodes (colour images, depth images, camera info, bounding boxes) is subscribed
+ * through the node handle of its own queue, such that a slow callback never delays the callbacks of the other inputs.
+ * The callbacks of a given subscription are still called one at a time. If separate queues are disabled,
+ * the node handle uses the queue of the node, serviced by ros::spin (or by the nodelet manager).
+ * If profiling is enabled, the time between the acquisition of the messages and the start of their callbacks is printed.
+ */
+class InputQueue {
+  private:
+    std::string name_;
+    ros::CallbackQueue queue_;
+    ros::AsyncSpinner spinner_;
+    ros::NodeHandle nh_;
+    bool separate_;
+    bool running_;
+    bool profile_;
+
+    // Callback delay statistics
+    std::mutex mutex_;
+    double delay_sum_;
+    double delay_max_;
+    unsigned int delay_count_;
+
+  public:
+    InputQueue(const ros::NodeHandle&, const std::string&, const int&, const bool&, const bool&);
+    ~InputQueue();
+    ros::NodeHandle& getNodeHandle();
+    void start();
+    void stop();
+    void recordDelay(const ros::Time&);
+};
+
+/**
+ * @brief Renders and publishes the debug images on a low-priority thread.
+ * @details The publication stages only hand over the data of a frame (the image is shared, not copied),
+ * and only if somebody subscribed to a debug image, and if the last frame was handed over more than
+ * 1/rate seconds ago. The worker renders the last frame it was given, the older ones are skipped.
+ * The images can be rendered on a downscaled copy, the scale is applied to the drawn objects.
+ */
+class VisualizationWorker {
+  private:
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::function<void()> job_;
+    bool running_;
+    float scale_;
+    std::chrono::steady_clock::duration period_;
+    std::chrono::steady_clock::time_point last_submit_;
+
+    void run();
+
+  public:
+    VisualizationWorker(const float&, const float&);
+    ~VisualizationWorker();
+    bool isDue();
+    void submit(std::function<void()>&&);
+    void stop();
+    float getScale() const;
+    cv::Mat render(const cv::Mat&) const;
+};
+
+/**
+ * @brief A depth image, and the time at which it was acquired.
+ * @details The image usually points into the buffer of the ROS message, which is kept alive by the owner.
+ */
+typedef struct StampedDepth{
+  int64_t stamp; // The acquisition time of the image, in nanoseconds.
+  cv::Mat depth;
+  std::shared_ptr<const void> owner;
+} StampedDepth;
+
+/**
+ * @brief A ring buffer of the last depth images, used to pair each colour image with a depth image.
+ * @details Each colour image is paired with the depth image whose stamp is the closest to its own,
+ * among the depth images already received. No image is waited for: if none is within the tolerance,
+ * the colour image is dropped, and counted as missed. It can be used from several threads.
+ */
+class DepthBuffer {
+  private:
+    std::vector<StampedDepth> ring_;
+    unsigned int next_;
+    int64_t tolerance_;
+    uint64_t matched_;
+    uint64_t missed_;
+    std::mutex mutex_;
+
+  public:
+    DepthBuffer(const unsigned int&, const float&);
+    void push(const int64_t&, const cv::Mat&, const std::shared_ptr<const void>&);
+    bool match(const int64_t&, StampedDepth&);
+    void getStatistics(uint64_t&, uint64_t&);
+};
+
+/**
+ * @brief A cache of the transforms looked up in TF.
+ * @details Each transform is looked up once per stamp, and shared by all the stages processing the same frame.
+ * The lookups wait at most timeout seconds (0 by default): when TF did not receive the transform for a stamp yet,
+ * the lookup fails and the caller skips the frame instead of stalling the pipeline.
+ * The failures are not cached, a later lookup at the same stamp can succeed. It can be used from several threads.
+ */
+class TransformCache {
+  private:
+    typedef struct CachedTransform{
+      std::string target;
+      std::string source;
+      ros::Time stamp;
+      RigidTransform transform;
+    } CachedTransform;
+
+    tf2_ros::Buffer& buffer_;
+    ros::Duration timeout_;
+    LatencyHistogram* histogram_;
+    TraceBuffer* trace_;
+    std::vector<CachedTransform> cache_;
+    unsigned int next_;
+    unsigned int misses_;
+    std::mutex mutex_;
+
+  public:
+    TransformCache(tf2_ros::Buffer&, const unsigned int&);
+    void setTimeout(const float&);
+    void setHistogram(LatencyHistogram*);
+    void setTrace(TraceBuffer*);
+    unsigned int getMisses();
+    bool lookup(const std::string&, const std::string&, const ros::Time&, RigidTransform&);
+};
+
+/**
+ * @brief Publishes the tracks incrementally.
+ * @details Instead of publishing every track on every frame, this class publishes only the tracks
+ * that were created, corrected, or removed since the previous message. Every keyframe_period messages,
+ * a keyframe containing all the tracks is published, so that late subscribers can resynchronize.
+ * In a keyframe, all the live tracks are listed in updated, and the subscribers should replace their copy.
+ * With a keyframe period of 1 (or less), every message is a keyframe.
+ * The sequence of a message is the update count of the trackers. If an update was not published, e.g. because
+ * its frame was dropped after the tracking stage, the next message is a keyframe, and its sequence skips the update.
+ */
+class TrackDeltaPublisher {
+  private:
+    ros::Publisher pub_;
+    int keyframe_period_;
+    uint64_t last_update_;
+    bool profile_;
+
+    void addStates(const std::map<unsigned int, std::vector<float>>&, const int&, std::vector<detect_and_track::TrackState>&);
+
+  public:
+    TrackDeltaPublisher(ros::NodeHandle&, const std::string&, const int&, const bool&);
+    void publish(const std::vector<TrackDelta>&, const std::vector<std::shared_ptr<const TrackSnapshot>>&, const std_msgs::Header&);
+};
+
+/**
+ * @brief Publishes the objects of each frame in a single message.
+ * @details The boxes, confidences, classes, ids, positions and covariances of the objects are packed in parallel
+ * arrays of plain types (see FrameResult.msg), which are serialized as blocks instead of one field at a time.
+ * The class names are published once, on a latched topic, and the messages only carry the indices of the classes.
+ * The messages of the per-object topics are published through publishLegacy, such that both outputs can be compared.
+ * Measuring a frame serializes its messages a second time. If profiling is enabled, every frame is measured, and its
+ * size and serialization time are printed. Otherwise, if the latencies are recorded, one frame per sample period is
+ * measured, and its serialization times are added to the serialize_results and serialize_legacy histograms.
+ */
+class FrameResultPublisher {
+  private:
+    ros::Publisher pub_;
+    ros::Publisher class_pub_;
+    uint64_t sequence_;
+    bool profile_;
+    bool measure_; // Whether the current frame is measured.
+    std::chrono::steady_clock::duration sample_period_;
+    std::chrono::steady_clock::time_point next_sample_;
+    LatencyHistogram* results_histogram_;
+    LatencyHistogram* legacy_histogram_;
+    unsigned int legacy_messages_;
+    uint64_t legacy_bytes_;
+    uint64_t legacy_time_;
+
+    void addPosition(const std::vector<float>&, detect_and_track::FrameResult&);
+    void send(detect_and_track::FrameResult&);
+
+    /**
+     * @brief Measures the size of a message, and the time taken to serialize it.
+     *
+     * @param msg The reference to the message.
+     * @param histogram The pointer to the histogram of the serialization times, nullptr if disabled.
+     * @param time The reference to the time taken, in nanoseconds.
+     * @return The size of the serialized message, in bytes.
+     */
+    template <typename M>
+    static uint32_t measure(const M& msg, LatencyHistogram* histogram, uint64_t& time) {
+      const auto start = std::chrono::steady_clock::now();
+      ros::SerializedMessage serialized = ros::serialization::serializeMessage(msg);
+      time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      if (histogram != nullptr) {
+        histogram->record(time);
+      }
+      return serialized.num_bytes;
+    }
+
+  public:
+    FrameResultPublisher(ros::NodeHandle&, const std::vector<std::string>&, Instrumentation*, const float&, const bool&);
+    void publishDetections(const std::vector<std::vector<BoundingBox>>&, const std::vector<std::vector<std::vector<float>>>&,
+                           const std_msgs::Header&);
+    void publishTracks(const std::vector<std::map<unsigned int, std::vector<float>>>&,
+                       const std::vector<std::map<unsigned int, std::vector<float>>>&,
+                       const std::vector<std::shared_ptr<const TrackSnapshot>>&, const std_msgs::Header&);
+
+    /**
+     * @brief Publishes a message of the per-object topics, and measures it if enabled.
+     * @details The measures are accumulated until the next frame result, and printed with it.
+     *
+     * @param pub The reference to the publisher.
+     * @param msg The reference to the message, moved into the publication.
+     */
+    template <typename M>
+    void publishLegacy(const ros::Publisher& pub, M& msg) {
+      if (measure_) {
+        uint64_t time;
+        legacy_bytes_ += measure(msg, legacy_histogram_, time);
+        legacy_time_ += time;
+        legacy_messages_ ++;
+      }
+      publishShared(pub, msg);
+    }
+};
+
+/**
+ * @brief Publishes the latency percentiles of a node on /diagnostics.
+ * @details Every period, the histograms of the node are collected and cleared, and published with the
+ * number of durations recorded per second. If the node runs a pipeline, the throughput, the drops, and
+ * the depth of the queues of its stages are published as well. The level of a stage is WARN if it lost
+ * frames during the period. The timer runs on the queue of the node handle it is given.
+ */
+class DiagnosticsPublisher {
+  private:
+    ros::Publisher pub_;
+    ros::WallTimer timer_;
+    std::string name_;
+    Instrumentation* instrumentation_;
+    Pipeline<PipelineFrame>* pipeline_;
+    std::vector<StageStatistics> last_statistics_;
+    ros::WallTime last_time_;
+
+    void timerCallback(const ros::WallTimerEvent&);
+    static void addValue(diagnostic_msgs::DiagnosticStatus&, const std::string&, const double&);
+
+  public:
+    DiagnosticsPublisher(ros::NodeHandle&, const std::string&, const float&, Instrumentation*, Pipeline<PipelineFrame>*);
+    void stop();
+};
+
+/**
+ * @brief Writes the trace of a node to a file when the dump_trace service is called.
+ * @details The service (std_srvs/Trigger) is advertised in the namespace of the node. The response
+ * gives the path of the file, which can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing.
+ * If no path is given, the trace is written in /tmp, in a file named after the namespace of the node.
+ */
+class TraceService {
+  private:
+    ros::ServiceServer server_;
+    std::string path_;
+    TraceBuffer* trace_;
+
+    bool dumpCallback(std_srvs::Trigger::Request&, std_srvs::Trigger::Response&);
+
+  public:
+    TraceService(ros::NodeHandle&, const std::string&, TraceBuffer*);
+};
 
 class ROSDetect : public Detect {
   protected:
     ros::NodeHandle nh_;
     image_transport::ImageTransport it_;
     image_transport::Subscriber image_sub_;
-#ifdef PUBLISH_DETECTION_IMAGE   
     image_transport::Publisher detection_pub_;
-#endif
     ros::Publisher bboxes_pub_;
+    FrameResultPublisher* results_pub_;
 
-    // Image parameters
-    sensor_msgs::Image::Ptr image_ptr_out_;
+    // Runtime options
+    RuntimeOptions options_;
+
+    // Latency histograms and diagnostics, nullptr if disabled
+    Instrumentation* instrumentation_;
+    LatencyHistogram* publish_histogram_;
+    DiagnosticsPublisher* diagnostics_;
+    InputQueue* diagnostics_queue_;
+
+    // Frame traces, nullptr if disabled
+    TraceBuffer* trace_;
+    TraceService* trace_service_;
 
-    virtual void imageCallback(const sensor_msgs::Image::ConstPtr&);
-    void publishDetectionImage(cv::Mat&, std::vector<std::vector<BoundingBox>>&);
+    // Debug images
+    VisualizationWorker* visualization_;
+
+    // Staged pipeline
+    Pipeline<PipelineFrame>* pipeline_;
+
+    // Shared-memory export, nullptr if disabled
+    SharedMemoryExporter* shm_exporter_;
+
+    // Recording of the detections, nullptr if disabled
+    RecordWriter* recorder_;
+    std::string record_mode_;
+    int record_margin_;
+    bool record_parameters_;
+
+    // Columnar log of the detections and the tracks, nullptr if disabled
+    ColumnLogWriter* column_log_;
+
+    // Input callback queues
+    bool use_callback_queues_;
+    int callback_threads_;
+    std::vector<InputQueue*> input_queues_;
+    InputQueue* image_queue_;
+
+    InputQueue* addInputQueue(const std::string&);
+    void stopInputs();
+    void imageCallback(const sensor_msgs::Image::ConstPtr&);
+    virtual bool prepareFrame(PipelineFrame&);
+    virtual void buildPipeline();
+    bool detectStage(PipelineFrame&);
+    bool publishFrame(PipelineFrame&);
+    void exportFrame(const PipelineFrame&);
+    void recordFrame(const PipelineFrame&);
+    void getRecordedParameters(std::map<std::string, std::string>&);
+    virtual void addRecordedRegions(const PipelineFrame&, std::vector<cv::Rect>&);
+    virtual bool getRecordedPose(const PipelineFrame&, RigidTransform&);
+    void frameHeader(const PipelineFrame&, std_msgs::Header&);
+    void printProfilingPipeline(const PipelineFrame&);
+    void submitDetectionImage(const PipelineFrame&, const std_msgs::Header&);
+    void publishDetectionImage(const cv::Mat&, const std::vector<std::vector<BoundingBox>>&, const std_msgs::Header&);
     void publishDetections(std::vector<std::vector<BoundingBox>>&, std_msgs::Header&);
 
   public:
     ROSDetect();
+    ROSDetect(const ros::NodeHandle&);
     ~ROSDetect();
+    void start();
 };
 
 class ROSDetectAndLocate : public ROSDetect, public Locate { // Should be using virtual classes
   protected:
     image_transport::Subscriber depth_sub_;
     ros::Publisher pose_array_pub_;
-#ifdef PUBLISH_DETECTION_IMAGE   
-    image_transport::Publisher detection_pub_;
-#endif
     ros::Subscriber depth_info_sub_;
-#ifdef PUBLISH_DETECTION_WITH_POSITION
+    InputQueue* depth_queue_;
+    InputQueue* depth_info_queue_;
     ros::Publisher positions_bboxes_pub_;
-#else
     ros::Publisher positions_pub_;
-#endif
 
     // Image parameters
-    cv::Mat depth_image_;
-    bool depth_received_;
-
-    virtual void imageCallback(const sensor_msgs::Image::ConstPtr&) override;
+    DepthBuffer* depth_buffer_;
+    std::mutex camera_mutex_;
+    std::vector<float> camera_P_;
+    std::vector<float> camera_K_;
+
+    virtual bool prepareFrame(PipelineFrame&) override;
+    virtual void buildPipeline() override;
+    bool locateStage(PipelineFrame&);
+    bool locateTracksStage(PipelineFrame&);
+    bool publishFrame(PipelineFrame&);
+    virtual void addRecordedRegions(const PipelineFrame&, std::vector<cv::Rect>&) override;
     void depthInfoCallback(const sensor_msgs::CameraInfoConstPtr&);
     void depthCallback(const sensor_msgs::Image::ConstPtr&);
     void publishDetectionsAndPositions(std::vector<std::vector<BoundingBox>>&, std::vector<std::vector<std::vector<float>>>&, std_msgs::Header&);
     void publishPositions(std::vector<std::vector<BoundingBox>>&, std::vector<std::vector<std::vector<float>>>&, std_msgs::Header&);
+    void setupTransformCache(TransformCache&);
+    void updateCameraFrustum(Track3D&, TransformCache&, const std::string&, const std::string&, const ros::Time&);
 
   public:
     ROSDetectAndLocate();
+    ROSDetectAndLocate(const ros::NodeHandle&);
     ~ROSDetectAndLocate();
 };
 
@@ -85,22 +447,40 @@ class ROSTrack2D : public Track2D {
     image_transport::Subscriber image_sub_;
     ros::Subscriber bboxes_sub_;
     ros::Publisher bboxes_pub_;
-#ifdef PUBLISH_DETECTION_IMAGE   
+    TrackDeltaPublisher* delta_pub_;
+    FrameResultPublisher* results_pub_;
     image_transport::Publisher tracker_pub_;
-#endif
+
+    // Runtime options
+    RuntimeOptions options_;
+
+    // Latency histograms and diagnostics, nullptr if disabled
+    Instrumentation* instrumentation_;
+    LatencyHistogram* publish_histogram_;
+    DiagnosticsPublisher* diagnostics_;
+    InputQueue* diagnostics_queue_;
+
+    // Frame traces, nullptr if disabled
+    TraceBuffer* trace_;
+    TraceService* trace_service_;
     
     // Image parameters
     int num_classes_;
-    sensor_msgs::Image::Ptr image_ptr_out_;
+    VisualizationWorker* visualization_;
     std_msgs::Header header_;
-    cv::Mat image_;
+    sensor_msgs::Image::ConstPtr image_msg_;
+    std::mutex image_mutex_;
+
+    // Input callback queues
+    InputQueue* image_queue_;
+    InputQueue* bboxes_queue_;
 
     // dt update for Kalman 
     float dt_;
     ros::Time t1_;
     ros::Time t2_;   
     void ROSbboxes2bboxes(const detect_and_track::BoundingBoxes2D::ConstPtr&, std::vector<std::vector<BoundingBox>>&);
-    void publishTrackingImage(cv::Mat&, std::vector<std::map<unsigned int, std::vector<float>>>&);
+    void publishTrackingImage(const cv::Mat&, const std::vector<std::map<unsigned int, std::vector<float>>>&, const std_msgs::Header&);
     void publishDetections(std::vector<std::map<unsigned int, std::vector<float>>>&,
                           std_msgs::Header&);
     void imageCallback(const sensor_msgs::Image::ConstPtr&);
@@ -108,49 +488,50 @@ class ROSTrack2D : public Track2D {
 
   public:
     ROSTrack2D();
+    ROSTrack2D(const ros::NodeHandle&);
     ~ROSTrack2D();
+    void start();
 };
 
 class ROSDetectAndTrack2D : public ROSDetect, public Track2D { // should be using virtual classes
   protected:
-#ifdef PUBLISH_DETECTION_IMAGE   
     image_transport::Publisher tracker_pub_;
-#endif
+    TrackDeltaPublisher* delta_pub_;
 
-    // dt update for Kalman 
-    float dt_;
-    ros::Time t1_;
-    ros::Time t2_;   
-
-    void publishTrackingImage(cv::Mat&, std::vector<std::map<unsigned int, std::vector<float>>>&);
+    virtual void buildPipeline() override;
+    bool trackStage(PipelineFrame&);
+    bool publishFrame(PipelineFrame&);
+    void submitDebugImages(const PipelineFrame&, const std_msgs::Header&);
+    void publishTrackingImage(const cv::Mat&, const std::vector<std::map<unsigned int, std::vector<float>>>&, const std_msgs::Header&);
     void publishDetections(std::vector<std::map<unsigned int, std::vector<float>>>&,
                           std_msgs::Header&);
-    virtual void imageCallback(const sensor_msgs::Image::ConstPtr&) override;
 
   public:
     ROSDetectAndTrack2D();
+    ROSDetectAndTrack2D(const ros::NodeHandle&);
     ~ROSDetectAndTrack2D();
 };
 
 class ROSDetectTrack2DAndLocate : public ROSDetectAndLocate, public Track2D { // should be using virtual classes
   protected: 
-#ifdef PUBLISH_DETECTION_IMAGE   
     image_transport::Publisher tracker_pub_;
-#endif
-
-    // dt update for Kalman 
-    float dt_;
-    ros::Time t1_;
-    ros::Time t2_;
 
     tf2_ros::Buffer tf_buffer_;
     tf2_ros::TransformListener listener_;
+    TransformCache tf_cache_;
     std::string global_frame_;
     geometry_msgs::PoseStamped uav_pose_;
+    // Ground truth logged with debug_pose
+    std::string debug_target_frame_;
+    std::string debug_observer_frame_;
     csvWriter* csv_writer_;
 
-
-    void publishTrackingImage(cv::Mat&, std::vector<std::map<unsigned int, std::vector<float>>>&);
+    virtual void buildPipeline() override;
+    virtual void addRecordedRegions(const PipelineFrame&, std::vector<cv::Rect>&) override;
+    bool trackStage(PipelineFrame&);
+    bool publishFrame(PipelineFrame&);
+    void submitDebugImages(const PipelineFrame&, const std_msgs::Header&);
+    void publishTrackingImage(const cv::Mat&, const std::vector<std::map<unsigned int, std::vector<float>>>&, const std_msgs::Header&);
     void publishDetectionsAndPositions(std::vector<std::map<unsigned int, std::vector<float>>>&,
                                        std::vector<std::map<unsigned int, std::vector<float>>>&,
                                        std_msgs::Header&);
@@ -158,30 +539,30 @@ class ROSDetectTrack2DAndLocate : public ROSDetectAndLocate, public Track2D { //
                           std_msgs::Header&);
     void publishPositions(std::vector<std::map<unsigned int, std::vector<float>>>&,
                           std_msgs::Header&);
-    virtual void imageCallback(const sensor_msgs::Image::ConstPtr&) override;
 
   public:
     ROSDetectTrack2DAndLocate();
+    ROSDetectTrack2DAndLocate(const ros::NodeHandle&);
     ~ROSDetectTrack2DAndLocate();
 };
 
 class ROSDetectAndTrack3D : public ROSDetectAndLocate, public Track3D { // should be using virtual classes
   protected: 
-#ifdef PUBLISH_DETECTION_IMAGE   
     image_transport::Publisher tracker_pub_;
-#endif
-    // dt update for Kalman 
-    float dt_;
-    ros::Time t1_;
-    ros::Time t2_;   
+    TrackDeltaPublisher* delta_pub_;
 
     // Transform parameters
     tf2_ros::Buffer tf_buffer_;
     tf2_ros::TransformListener listener_;
+    TransformCache tf_cache_;
     std::string global_frame_;
+    std::string camera_frame_;
 
-
-    void publishTrackingImage(cv::Mat&, std::vector<std::map<unsigned int, std::vector<float>>>&);
+    virtual void buildPipeline() override;
+    bool locateStage(PipelineFrame&);
+    bool trackStage(PipelineFrame&);
+    bool publishFrame(PipelineFrame&);
+    void publishTrackingImage(const cv::Mat&, const std::vector<std::map<unsigned int, std::vector<float>>>&, const std_msgs::Header&);
     void publishDetectionsAndPositions(std::vector<std::map<unsigned int, std::vector<float>>>&,
                                        std::vector<std::map<unsigned int, std::vector<float>>>&,
                                        std_msgs::Header&);
@@ -189,14 +570,60 @@ class ROSDetectAndTrack3D : public ROSDetectAndLocate, public Track3D { // shoul
                           std_msgs::Header&);
     void publishPositions(std::vector<std::map<unsigned int, std::vector<float>>>&,
                           std_msgs::Header&);
-    virtual void imageCallback(const sensor_msgs::Image::ConstPtr&) override;
-    void points2Pose(std::vector<std::vector<std::vector<float>>>&);
+    virtual bool getRecordedPose(const PipelineFrame&, RigidTransform&) override;
+    bool points2Pose(std::vector<std::vector<std::vector<float>>>&, const ros::Time&);
 
   public:
     ROSDetectAndTrack3D();
+    ROSDetectAndTrack3D(const ros::NodeHandle&);
     ~ROSDetectAndTrack3D();
 };
 
+/**
+ * @brief A node whose pipeline is composed from a description.
+ * @details The stages are listed in the pipeline parameter, see PipelineGraph: ingest is implicit, then detect,
+ * locate, tf, track2D, locate_tracks, track3D, publish, and log can be combined. The trackers are owned by the node
+ * instead of being inherited, and are only built if the description uses them. The depth images are only paired
+ * with the frames if a stage reads them.
+ */
+class ROSPipelineGraph : public ROSDetectAndLocate {
+  protected:
+    GraphDescription description_;
+    PipelineGraph graph_;
+    unsigned int ingested_;
+    bool publish_tracks_;
+    bool publish_positions_;
+
+    // Trackers, nullptr if not used
+    Track2D* track2D_;
+    Track3D* track3D_;
+    TrackDeltaPublisher* delta_pub_;
+    bool use_frustum_;
+
+    // Transform parameters, nullptr if not used
+    tf2_ros::Buffer* tf_buffer_;
+    tf2_ros::TransformListener* listener_;
+    TransformCache* tf_cache_;
+    std::string global_frame_;
+    std::string camera_frame_;
+
+    void readDescription();
+    void addStages();
+    virtual bool prepareFrame(PipelineFrame&) override;
+    virtual void buildPipeline() override;
+    bool tfStage(PipelineFrame&);
+    bool track2DStage(PipelineFrame&);
+    bool track3DStage(PipelineFrame&);
+    bool publishStage(PipelineFrame&);
+    bool logStage(PipelineFrame&);
+    virtual bool getRecordedPose(const PipelineFrame&, RigidTransform&) override;
+
+  public:
+    ROSPipelineGraph();
+    ROSPipelineGraph(const ros::NodeHandle&);
+    ~ROSPipelineGraph();
+};
+
 /*class ROSDetectTrack2DAndLocateTF : public ROSDetectTrack2DAndLocate {
   protected:
     // Transform parameters
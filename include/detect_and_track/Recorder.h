@@ -0,0 +1,203 @@
+/**
+ * @file Recorder.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the detection recorder.
+ * @details This file implements a compact binary log of the inputs of the localization and the tracking:
+ * the detections, the parts of the depth images under them, the camera info, and the pose of the camera.
+ * The logs are recorded by the nodes, and replayed offline, without camera nor GPU. The same format stores
+ * the results of the offline processing of folders and videos.
+ */
+
+#ifndef Recorder_H
+#define Recorder_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
+
+#include <detect_and_track/DetectionUtils.h>
+
+#define RECORD_VERSION 1
+
+/**
+ * @brief The types of the records.
+ *
+ */
+enum RecordType {
+  RECORD_PARAMETERS = 1, // The parameters of the node, as "key=value" lines.
+  RECORD_CAMERA_INFO = 2, // The intrinsics (K, 9 floats) and the distortion (D) of the camera.
+  RECORD_FRAME = 3, // The detections of a frame, the regions of interest of its depth image, and the pose of the camera.
+  RECORD_RESULT = 4 // The detections, positions, and tracks of a frame processed offline.
+};
+
+/**
+ * @brief The header of a recording.
+ * @details A recording is organized as follows: \n
+ *  - a RecordFileHeader, \n
+ *  - a sequence of records, each made of a RecordHeader followed by size bytes of payload. \n
+ * A frame record contains, in order: the length of the frame id and its characters, a PoseRecord,
+ * the number of classes, and for each class the number of bounding boxes followed by their BoxRecords,
+ * a DepthRecord, and for each region of interest a RoiRecord followed by its rows of depth.
+ * A result record contains, in order: the length of the name of the frame and its characters, the detections
+ * (as in a frame record), the positions of the detections, the states of the tracks, and the positions of the tracks.
+ * The positions and the states are stored per class: the number of objects, then for each object its id
+ * (tracks only), the number of floats, and the floats.
+ * The records are written in the order they were made, the fields in the byte order of the machine.
+ */
+typedef struct RecordFileHeader{
+  char magic[8]; // "DTREC" padded with 0s.
+  uint32_t version;
+  uint32_t padding;
+} RecordFileHeader;
+
+/**
+ * @brief The header of a record.
+ *
+ */
+typedef struct RecordHeader{
+  uint32_t type;
+  uint32_t size; // Size of the payload, in bytes.
+  int64_t stamp; // Acquisition time of the data, in nanoseconds.
+  uint64_t sequence;
+} RecordHeader;
+
+/**
+ * @brief A bounding box, with all its fields, such that it is rebuilt bit for bit.
+ *
+ */
+typedef struct BoxRecord{
+  float x;
+  float y;
+  float w;
+  float h;
+  float x_min;
+  float x_max;
+  float y_min;
+  float y_max;
+  float area;
+  float confidence;
+  int32_t class_id;
+  uint32_t valid;
+} BoxRecord;
+
+/**
+ * @brief The pose of the camera in the global frame, if the node uses one.
+ *
+ */
+typedef struct PoseRecord{
+  uint32_t valid;
+  float rotation[9]; // Column major.
+  float translation[3];
+} PoseRecord;
+
+/**
+ * @brief The size of the depth image, and the number of regions of interest recorded.
+ *
+ */
+typedef struct DepthRecord{
+  int32_t rows;
+  int32_t cols;
+  int32_t type; // The OpenCV type, CV_16UC1 or CV_32FC1.
+  uint32_t num_rois;
+} DepthRecord;
+
+/**
+ * @brief A region of interest of the depth image.
+ *
+ */
+typedef struct RoiRecord{
+  int32_t x;
+  int32_t y;
+  int32_t width;
+  int32_t height;
+} RoiRecord;
+
+/**
+ * @brief A record, as read from a recording.
+ * @details The payload points into the memory of the reader.
+ */
+typedef struct RecordEntry{
+  RecordHeader header;
+  const char* payload;
+} RecordEntry;
+
+/**
+ * @brief Writes a recording in the background.
+ * @details The records are serialized in the front buffer by the threads of the node, which is handed over to a writer
+ * thread once it is large enough, or once it has waited for the flush period. The writer thread appends the back buffer to the file, so the node never waits on the disk.
+ * If the disk cannot keep up, and the front buffer reaches its maximum size, the new records are dropped and counted.
+ * Only the regions of the depth images under the objects are recorded, which keeps the recordings small.
+ * In blocking mode, used offline, the records are never dropped: the threads wait for the writer thread instead.
+ * A recording can be appended to, from the end of its last complete record.
+ */
+class RecordWriter {
+  private:
+    std::string path_;
+    FILE* file_;
+    size_t max_buffer_size_;
+    size_t flush_size_;
+    std::chrono::steady_clock::duration flush_period_;
+    std::chrono::steady_clock::time_point last_write_;
+    uint64_t dropped_;
+    bool blocking_;
+
+    std::vector<char> front_;
+    std::vector<char> back_;
+    bool pending_;
+    bool running_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable written_cv_;
+    std::thread thread_;
+
+    void run();
+    bool reserve(std::unique_lock<std::mutex>&, const RecordType&, const size_t&, const int64_t&, const uint64_t&);
+    void put(const void*, const size_t&);
+    void handOver();
+
+  public:
+    RecordWriter(const std::string&, const size_t&, const size_t&, const bool&, const float&);
+    ~RecordWriter();
+    bool isOpen() const;
+    uint64_t getDropped();
+    void writeParameters(const int64_t&, const std::map<std::string, std::string>&);
+    void writeCameraInfo(const int64_t&, const std::vector<float>&, const std::vector<float>&);
+    void writeFrame(const PipelineFrame&, const std::vector<cv::Rect>&, const RigidTransform*);
+    void writeResult(const PipelineFrame&, const std::string&);
+};
+
+/**
+ * @brief Reads a recording.
+ * @details The whole recording is loaded in memory when opened, such that reading it does not touch the disk.
+ * The depth images are rebuilt at their original size: the recorded regions are copied in, the rest is set to 0,
+ * which the position estimator considers invalid.
+ */
+class RecordReader {
+  private:
+    std::vector<char> data_;
+    size_t offset_;
+
+  public:
+    RecordReader();
+    bool open(const std::string&);
+    void rewind();
+    bool next(RecordEntry&);
+    size_t tell() const;
+    static bool readParameters(const RecordEntry&, std::map<std::string, std::string>&);
+    static bool readCameraInfo(const RecordEntry&, std::vector<float>&, std::vector<float>&);
+    static bool readFrame(const RecordEntry&, PipelineFrame&, RigidTransform&, bool&);
+    static bool readResult(const RecordEntry&, PipelineFrame&, std::string&);
+};
+
+#endif
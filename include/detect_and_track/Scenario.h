@@ -0,0 +1,86 @@
+/**
+ * @file Scenario.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the scenario generator.
+ * @details This file implements a generator of synthetic multi-object scenarios: ground-truth trajectories,
+ * and the noisy detections a detector would make of them, to exercise the trackers without camera nor network.
+ * It only depends on the standard library.
+ */
+
+#ifndef Scenario_H
+#define Scenario_H
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <math.h>
+
+/**
+ * @brief The parameters of a scenario.
+ * @details The positions, sizes and noises are in pixels in 2D, and in meters in 3D.
+ */
+typedef struct ScenarioParameters{
+  unsigned int num_objects;
+  bool three_dimensional; // If true the objects move in a cube, else in a square.
+  bool static_objects; // If true the objects do not move, like the landmarks of Tracker3DF.
+  float dt; // The time in between two frames, in seconds.
+  float extent; // The side of the square, or cube, the objects move in.
+  float speed; // The maximum speed of the objects, per second.
+  float size; // The mean size of the objects.
+  float position_noise; // The standard deviation of the position of the detections.
+  float size_noise; // The standard deviation of the size of the detections.
+  float detection_probability; // The probability that an object is detected in a frame.
+  float clutter_rate; // The mean number of false detections per frame, per object.
+  float crossing_ratio; // The fraction of the objects moving in pairs whose trajectories cross.
+  unsigned int crossing_frames; // The crossings happen within this number of frames from the start.
+  unsigned int seed;
+} ScenarioParameters;
+
+/**
+ * @brief A frame of a scenario.
+ * @details The states are in the layout of the observations of the trackers:
+ * x, y, vx, vy, w, h in 2D (R6), and x, y, z, vx, vy, vz, w, d, h in 3D (R9).
+ * The velocities of the detections are 0, like the ones made from bounding boxes.
+ */
+typedef struct ScenarioFrame{
+  unsigned int index;
+  std::vector<std::vector<float>> truth; // The true state of each object, indexed by object id.
+  std::vector<std::vector<float>> detections; // Shuffled, like the outputs of a detector.
+  std::vector<int> detection_ids; // The object of each detection, -1 for the false detections.
+} ScenarioFrame;
+
+/**
+ * @brief A generator of synthetic scenarios.
+ * @details The objects move at constant velocity, and bounce on the sides of the square (or cube).
+ * A fraction of them moves in pairs, set up such that the two objects of a pair cross each other,
+ * which is where the association is the hardest. Each object is detected with a given probability,
+ * with gaussian noise on its position and size, and false detections are scattered uniformly.
+ * The scenario is fully determined by its parameters, including the seed, such that runs can be compared.
+ */
+class ScenarioGenerator {
+  private:
+    ScenarioParameters p_;
+    std::mt19937 generator_;
+    unsigned int dimensions_;
+    unsigned int frame_;
+    std::vector<float> positions_; // dimensions_ floats per object.
+    std::vector<float> velocities_;
+    std::vector<float> sizes_; // 3 floats per object: w, d, h.
+
+    void initialize();
+    void move();
+    void writeState(const unsigned int&, const bool&, std::vector<float>&);
+    void detect(ScenarioFrame&);
+
+  public:
+    ScenarioGenerator(const ScenarioParameters&);
+    void reset();
+    void next(ScenarioFrame&);
+    unsigned int getStateSize() const;
+};
+
+#endif
@@ -0,0 +1,185 @@
+/**
+ * @file SharedMemory.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the shared-memory ring buffers.
+ * @details This file implements a single-producer multi-consumer ring buffer living in POSIX shared memory (/dev/shm).
+ * It is used to export the frames, the detections, and the tracks to other processes on the same machine.
+ * It only depends on the standard library, such that it can be used as a reader library by non-ROS processes.
+ */
+
+#ifndef SharedMemory_H
+#define SharedMemory_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdio.h>
+
+#define SHARED_MEMORY_VERSION 1
+
+// Types of the records
+#define SHARED_MEMORY_IMAGE 1
+#define SHARED_MEMORY_DETECTIONS 2
+#define SHARED_MEMORY_TRACKS 3
+
+// Limits of the records written by the exporter
+#define SHARED_MEMORY_MAX_OBJECTS 1024
+#define SHARED_MEMORY_MAX_STATE 16
+
+/**
+ * @brief The header of a shared-memory ring buffer.
+ * @details A ring buffer is organized as follows: \n
+ *  - a SharedMemoryHeader, padded to 64 bytes, \n
+ *  - slot_count slots of slot_stride bytes, each made of a SharedMemorySlot followed by at most slot_size bytes of payload. \n
+ * The slots are aligned on cache lines.
+ */
+typedef struct SharedMemoryHeader{
+  uint64_t magic; // "DTSHRING"
+  uint32_t version;
+  uint32_t slot_count;
+  uint64_t slot_size; // The maximum size of a payload, in bytes.
+  uint64_t slot_stride; // The distance in between two slots, in bytes.
+  std::atomic<uint64_t> sequence; // The number of records written so far.
+} SharedMemoryHeader;
+
+/**
+ * @brief The header of a slot.
+ * @details The lock is a sequence lock: it is set to 2*sequence+1 while the record is written,
+ * and to 2*sequence+2 once it is complete. A reader checks the lock before and after reading a record,
+ * if it changed, the record was overwritten in the meantime and must be discarded.
+ */
+typedef struct SharedMemorySlot{
+  std::atomic<uint64_t> lock;
+  uint32_t type;
+  uint32_t size; // The size of the payload, in bytes.
+  int64_t stamp; // The acquisition time of the data, in nanoseconds.
+} SharedMemorySlot;
+
+/**
+ * @brief A read-only view on a record.
+ * @details The data points directly into the shared memory, it is only valid as long as
+ * SharedMemoryReader::isValid returns true.
+ */
+typedef struct SharedMemoryView{
+  uint64_t sequence;
+  uint32_t type;
+  uint32_t size;
+  int64_t stamp;
+  const char* data;
+} SharedMemoryView;
+
+/**
+ * @brief The header of an image record, followed by rows*step bytes.
+ *
+ */
+typedef struct SharedImageHeader{
+  int32_t rows;
+  int32_t cols;
+  int32_t type; // The OpenCV type of the image, CV_8UC3 for RGB images.
+  int32_t step; // The size of a row, in bytes.
+} SharedImageHeader;
+
+/**
+ * @brief A detection. A detections record is made of a uint64_t count followed by count detections.
+ *
+ */
+typedef struct SharedDetection{
+  uint32_t class_id;
+  float x_min;
+  float y_min;
+  float width;
+  float height;
+  float confidence;
+} SharedDetection;
+
+/**
+ * @brief The header of a track. A tracks record is made of a uint64_t count followed by count tracks,
+ * each made of a SharedTrackHeader followed by state_size floats.
+ *
+ */
+typedef struct SharedTrackHeader{
+  uint32_t class_id;
+  uint32_t track_id;
+  uint32_t state_size;
+  uint32_t padding;
+} SharedTrackHeader;
+
+/**
+ * @brief A track, pointing into a tracks record.
+ *
+ */
+typedef struct SharedTrack{
+  uint32_t class_id;
+  uint32_t track_id;
+  uint32_t state_size;
+  const float* state;
+} SharedTrack;
+
+/**
+ * @brief The producer side of a shared-memory ring buffer.
+ * @details Creates the shared-memory segment, and writes records in it. The records are built in place:
+ * beginWrite returns a pointer to the payload of the next slot, and commitWrite publishes it.
+ * The writer never waits on the readers: the oldest record is overwritten when the ring is full.
+ * The segment is removed when the writer is destroyed.
+ */
+class SharedMemoryWriter {
+  private:
+    std::string name_;
+    char* map_;
+    size_t map_size_;
+    SharedMemoryHeader* header_;
+    SharedMemorySlot* slot_;
+    uint64_t next_;
+    uint32_t pending_size_;
+
+    SharedMemorySlot* getSlot(const uint64_t&);
+
+  public:
+    SharedMemoryWriter();
+    ~SharedMemoryWriter();
+    bool create(const std::string&, const uint32_t&, const uint64_t&);
+    void close();
+    bool isOpen() const;
+    uint64_t getSlotSize() const;
+    char* beginWrite(const uint32_t&);
+    uint64_t commitWrite(const uint32_t&, const int64_t&);
+};
+
+/**
+ * @brief The consumer side of a shared-memory ring buffer.
+ * @details Maps an existing segment read-only. Any number of readers can follow the same writer,
+ * they never block it, and never block each other. A reader that falls behind by more than the number
+ * of slots loses the oldest records, it can resume from getSequence() - 1.
+ */
+class SharedMemoryReader {
+  private:
+    const char* map_;
+    size_t map_size_;
+    const SharedMemoryHeader* header_;
+
+    const SharedMemorySlot* getSlot(const uint64_t&) const;
+
+  public:
+    SharedMemoryReader();
+    ~SharedMemoryReader();
+    bool open(const std::string&);
+    void close();
+    bool isOpen() const;
+    uint32_t getSlotCount() const;
+    uint64_t getSequence() const;
+    bool read(const uint64_t&, SharedMemoryView&) const;
+    bool isValid(const SharedMemoryView&) const;
+    bool copy(const uint64_t&, std::vector<char>&, SharedMemoryView&) const;
+
+    static bool parseImage(const SharedMemoryView&, SharedImageHeader&, const char*&);
+    static bool parseDetections(const SharedMemoryView&, uint64_t&, const SharedDetection*&);
+    static bool parseTracks(const SharedMemoryView&, std::vector<SharedTrack>&);
+};
+
+#endif
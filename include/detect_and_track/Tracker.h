@@ -15,9 +15,15 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <memory>
+#include <atomic>
 
 #include <detect_and_track/KalmanFilter.h>
 #include <detect_and_track/Hungarian.h>
+#include <detect_and_track/VoxelGrid.h>
+#include <detect_and_track/Frustum.h>
+#include <detect_and_track/Checkpoint.h>
 #include <stdio.h>
 
 /**
@@ -38,7 +44,7 @@ class Object {
   public:
     Object();
     Object(const unsigned int&, const float&, const bool&, const bool&, const std::vector<float>&, const std::vector<float>&);
-    ~Object();
+    virtual ~Object();
     virtual void setState(const std::vector<float>&);
     virtual void newFrame();
     virtual void predict();
@@ -47,6 +53,9 @@ class Object {
     virtual void getState(std::vector<float>&);
     virtual void getUncertainty(std::vector<float>&);
     virtual int getSkippedFrames();
+    unsigned int getStateSize() const;
+    void exportState(ObjectRecord&, float*, float*) const;
+    void importState(const ObjectRecord&, const float*, const float*);
 };
 
 /**
@@ -77,6 +86,7 @@ class Object3D : public Object {
     Object3D();
     Object3D(const Object3D &);
     Object3D(const unsigned int&, const float&, const bool&, const bool&, const std::vector<float>&, const std::vector<float>&);
+    void setState(const std::vector<float>&) override;
 };
 
 /**
@@ -92,8 +102,36 @@ class Object3DF : public Object {
     Object3DF();
     Object3DF(const Object3DF &);
     Object3DF(const unsigned int&, const float&, const bool&, const std::vector<float>&);
+    void setState(const std::vector<float>&) override;
+    void getState(std::vector<float>&) override;
 };
 
+/**
+ * @brief An immutable copy of the tracks.
+ * @details The states of all the tracks at the end of a tracker update.
+ * The epoch is incremented on each publication, readers can use it to detect new data.
+ * The uncertainties are the variances of the Kalman filters, in the order of their states.
+ * Once published, a snapshot is never modified, and can be read from any thread.
+ */
+typedef struct TrackSnapshot{
+  uint64_t epoch;
+  std::map<unsigned int, std::vector<float>> states;
+  std::map<unsigned int, std::vector<float>> uncertainties; // The variances of the states, the diagonal of the covariances.
+} TrackSnapshot;
+
+/**
+ * @brief The changes made by a tracker update.
+ * @details The tracks created, corrected, and removed during the last update of a tracker.
+ * The updates are counted from 1. If two deltas of a tracker do not have consecutive update counts,
+ * the changes of the updates in between are missing.
+ */
+typedef struct TrackDelta{
+  uint64_t update;
+  std::map<unsigned int, std::vector<float>> created;
+  std::map<unsigned int, std::vector<float>> updated;
+  std::vector<unsigned int> removed;
+} TrackDelta;
+
 /**
  * @brief An object tracker.
  * @details This class tracks multiple objects.
@@ -101,14 +139,13 @@ class Object3DF : public Object {
  * Then it compares their estimated position to a set observation to find the best possible match.
  * This matching is done using the Hungarian Algorithm. Once the matching is done, the matches are analyzed and confirmed.
  * The tracked objects which have an associated measurement are then updated.
+ * After each update, an immutable snapshot of the tracks can be published for other threads to read.
  * 
  */
 class BaseTracker {
   private:
     void incrementFrame();
-    bool isMatch(const std::vector<float>&, const std::vector<float>&) const;
     void computeCost(std::vector<std::vector<double>>&, const std::vector<std::vector<float>>&, std::map<int, int>&);
-    void hungarianMatching(std::vector<std::vector<double>>&, std::vector<int>&);
   protected:
     // Tracker state
     unsigned int track_id_count_;
@@ -131,15 +168,37 @@ class BaseTracker {
     // Solver
     HungarianAlgorithm* HA_;
 
+    // Changes made by the last update, recorded as they are made
+    uint64_t update_count_;
+    std::vector<unsigned int> created_ids_;
+    std::vector<unsigned int> updated_ids_;
+    std::vector<unsigned int> removed_ids_;
+
+    // Published tracks
+    uint64_t epoch_;
+    std::shared_ptr<const TrackSnapshot> snapshot_;
+    std::shared_ptr<const TrackSnapshot> retired_snapshot_; // The snapshot replaced by the last publication, reused once released.
+
     virtual float centroidsError(const std::vector<float>&, const std::vector<float>&) const;
     virtual float areaRatio(const std::vector<float>&, const std::vector<float>&) const;
     virtual void addNewObject();
+    bool isMatch(const std::vector<float>&, const std::vector<float>&) const;
+    void hungarianMatching(std::vector<std::vector<double>>&, std::vector<int>&);
     void removeOldTracks();
+    void startUpdate();
   public:
     BaseTracker();
     BaseTracker(const int&, const float&, const float&, const float&, const float&, const float&, const bool&, const bool&, const std::vector<float>&, const std::vector<float>&);
-    void update(const float&, const std::vector<std::vector<float>>&);
+    virtual void update(const float&, const std::vector<std::vector<float>>&);
     void getStates(std::map<unsigned int, std::vector<float>>&);
+    void getUncertainties(std::map<unsigned int, std::vector<float>>&);
+    void getDelta(TrackDelta&) const;
+    void publishSnapshot(const std::map<unsigned int, std::vector<float>>&);
+    std::shared_ptr<const TrackSnapshot> getSnapshot() const;
+    uint64_t hashParameters() const;
+    void serialize(std::vector<char>&) const;
+    virtual bool deserialize(const char*&, const char*);
+    virtual void clear();
 };
 
 /**
@@ -169,37 +228,55 @@ class Tracker2D : public BaseTracker {
  * Then it compares their estimated position to a set observation to find the best possible match.
  * This matching is done using the Hungarian Algorithm. Once the matching is done, the matches are analyzed and confirmed.
  * The tracked objects which have an associated measurement are then updated.
+ * Optionally, a camera frustum can be set: the tracks outside of it are frozen until they come back in view.
  * 
  */
 class Tracker3D : public BaseTracker {
   protected:
+    Frustum* frustum_;
+    std::map<unsigned int, Object*> frozen_;
+
     float IoU(const std::vector<float>&, const std::vector<float>&) const;
     float centroidsError(const std::vector<float>&, const std::vector<float>&) const;
     float areaRatio(const std::vector<float>&, const std::vector<float>&) const;
     void addNewObject() override;
+    void freezeHiddenTracks();
+    void unfreezeTracks();
   public:
     Tracker3D();
     Tracker3D(const int&, const float&, const float&, const float&, const float&, const float&, const bool&, const bool&, const std::vector<float>&, const std::vector<float>&);
+    void setFrustum(Frustum*);
+    void update(const float&, const std::vector<std::vector<float>>&) override;
 };
 
 /**
- * @brief An object tracker.
- * @details This class tracks multiple objects.
- * It uses their built-in kalman filter to estimate where the objects are going to be next.
- * Then it compares their estimated position to a set observation to find the best possible match.
- * This matching is done using the Hungarian Algorithm. Once the matching is done, the matches are analyzed and confirmed.
- * The tracked objects which have an associated measurement are then updated.
+ * @brief A fixed object tracker.
+ * @details This class tracks multiple fixed objects, or landmarks, in the world frame.
+ * Since these objects do not move, and since they build up into large maps, they are stored in a
+ * sparse voxel grid. When new observations come in, only the landmarks located in the voxels around the
+ * observations are considered. The matching is then done using the Hungarian Algorithm on this subset only.
+ * The landmarks that are not around any observation are left untouched: they are neither predicted nor aged.
+ * This keeps the cost of an update independent of the size of the map.
  * 
  */
 class Tracker3DF : public BaseTracker {
   protected:
+    VoxelGrid grid_;
+    std::vector<unsigned int> candidates_;
+
     float IoU(const std::vector<float>&, const std::vector<float>&) const;
     float centroidsError(const std::vector<float>&, const std::vector<float>&) const;
     float areaRatio(const std::vector<float>&, const std::vector<float>&) const;
     void addNewObject() override;
+    void collectCandidates(const std::vector<std::vector<float>>&);
+    void removeOldCandidates();
   public:
     Tracker3DF();
     Tracker3DF(const int&, const float&, const float&, const float&, const float&, const float&, const bool&, const bool&, const std::vector<float>&, const std::vector<float>&);
+    Tracker3DF(const int&, const float&, const float&, const float&, const float&, const float&, const bool&, const bool&, const std::vector<float>&, const std::vector<float>&, const float&);
+    void update(const float&, const std::vector<std::vector<float>>&) override;
+    bool deserialize(const char*&, const char*) override;
+    void clear() override;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+/**
+ * @file VoxelGrid.h
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The header of the voxel grid class.
+ * @details This file implements a sparse voxel hash used to index static objects in space.
+ */
+
+#ifndef VoxelGrid_H
+#define VoxelGrid_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <math.h>
+
+/**
+ * @brief A sparse voxel hash.
+ * @details This class stores a set of ids in a sparse grid of cubic voxels.
+ * Only the voxels that contain at least one id are allocated, hence, the memory footprint
+ * grows with the number of objects and not with the size of the mapped area.
+ * Inserting, moving or removing an id is done in constant time, and querying the
+ * neighbourhood of a point only visits the voxels that overlap the query radius.
+ * This makes the cost of a query independent of the total number of objects in the grid.
+ */
+class VoxelGrid {
+  private:
+    float voxel_size_;
+    float voxel_size_inv_;
+
+    std::unordered_map<int64_t, std::vector<unsigned int>> cells_;
+    std::unordered_map<unsigned int, int64_t> keys_;
+
+    int toCell(const float&) const;
+    int64_t hashKey(const int&, const int&, const int&) const;
+    void eraseFromCell(const int64_t&, const unsigned int&);
+
+  public:
+    VoxelGrid();
+    VoxelGrid(const float&);
+
+    void insert(const unsigned int&, const float&, const float&, const float&);
+    void update(const unsigned int&, const float&, const float&, const float&);
+    void remove(const unsigned int&);
+    void query(const float&, const float&, const float&, const float&, std::vector<unsigned int>&) const;
+    void clear();
+    size_t size() const;
+};
+
+#endif
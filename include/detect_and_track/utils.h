@@ -18,6 +18,15 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <stdio.h>
 
 /**
  * @brief A color palette.
@@ -121,6 +130,15 @@ typedef struct TrackingParameters{
   float area_thresh;
   int max_frames_to_skip;
   float dt; // The delta of time in between two timesteps.
+  bool static_objects = false; // Whether the tracked objects are fixed in the world frame (3D only).
+  float voxel_size = 1.0; // The size of the voxels used to index fixed objects (3D only).
+  bool use_frustum = false; // Whether the tracks outside the field of view of the camera should be frozen (3D only).
+  float frustum_min_depth = 0.1; // The minimum distance at which a track is considered visible (3D only).
+  float frustum_max_depth = 20.0; // The maximum distance at which a track is considered visible (3D only).
+  float frustum_margin = 0.0; // The margin, in pixels, added around the image (3D only).
+  std::string checkpoint_path = ""; // Where the trackers are checkpointed, no checkpoints if empty.
+  float checkpoint_period = 5.0; // The time, in seconds, in between two checkpoints.
+  float checkpoint_max_age = 30.0; // The maximum age, in seconds, of a checkpoint to be restored.
 } TrackingParameters;
 
 /**
@@ -134,27 +152,95 @@ typedef struct BBoxRejectionParameters{
   int max_bbox_width;
 } BBoxRejectionParameters;
 
+/**
+ * @brief A structure that stores the options which can be changed without rebuilding the nodes.
+ * @details These options used to be compile-time flags. When an option is disabled, its cost is a branch.
+ */
+typedef struct RuntimeOptions{
+  bool profile = false; // Whether the time taken by each stage is printed.
+  bool publish_debug_images = true; // Whether the detection and tracking images are advertised.
+  bool publish_positions_with_bboxes = true; // Whether the positions are published with the bounding boxes, or separately.
+  bool publish_legacy_topics = true; // Whether the objects are also published on the per-object topics, besides the frame results.
+  bool debug_pose = false; // Whether the position estimator prints the distance of every object.
+} RuntimeOptions;
+
+/**
+ * @brief Tests a runtime option.
+ * @details Building with RUNTIME_OPTIONS_COMPILED_OUT removes the code of the options, like the former compile-time
+ * flags did when they were not set. It is only used as the baseline of options_benchmark.
+ */
+#ifdef RUNTIME_OPTIONS_COMPILED_OUT
+#define RUNTIME_OPTION(option) false
+#else
+#define RUNTIME_OPTION(option) (option)
+#endif
+
+/**
+ * @brief The parameters of a node, as text, indexed by their name.
+ * @details Used by the tools that run without a ROS master. The lists are stored comma separated.
+ */
+typedef std::map<std::string, std::string> ParameterMap;
+
+bool loadParameters(const std::string&, ParameterMap&);
+std::vector<std::string> splitList(const std::string&);
+std::string getString(const ParameterMap&, const std::string&, const std::string&);
+float getFloat(const ParameterMap&, const std::string&, const float&);
+int getInt(const ParameterMap&, const std::string&, const int&);
+bool getBool(const ParameterMap&, const std::string&, const bool&);
+std::vector<float> getFloats(const ParameterMap&, const std::string&, const std::vector<float>&);
+void getDetectionParameters(const ParameterMap&, GlobalParameters&, DetectionParameters&, NMSParameters&);
+void getLocalizationParameters(const ParameterMap&, GlobalParameters&, LocalizationParameters&, CameraParameters&);
+void getTrackingParameters(const ParameterMap&, const bool&, DetectionParameters&, KalmanParameters&,
+                           TrackingParameters&, BBoxRejectionParameters&);
+
+/**
+ * @brief Logs rows of floats to a file, from a thread that must never wait on the disk.
+ * @details The rows are staged in two buffers of max_buffer_size rows. The calling thread fills one while a background
+ * thread formats and writes the other, the buffers are handed over through atomic flags. If both buffers are full,
+ * the new rows are dropped and counted, rather than waiting. The file stays open until the writer is destroyed. \n
+ * In text mode, each value is followed by the separator, and each row by the endline. In binary mode, the file starts
+ * with "DTCOLS" padded with 0s to 8 bytes, the number of columns (uint32), 4 bytes of padding, and for each column
+ * the length of its name (uint32) and its characters. The rows follow, as num_columns floats each, in the byte order
+ * of the machine. \n
+ * addToBuffer and flush must be called from a single thread.
+ */
 class csvWriter {
     private:
-        std::ofstream ofs_;
+        FILE* file_;
         std::string separator_;
         std::string endline_;
         std::string filename_;
+        bool binary_;
+        unsigned int num_columns_;
         unsigned int max_buffer_size_;
-        std::vector<std::vector<float>> buffer_;
 
-        void makeHeader(std::vector<std::string>);
+        // Staging, owned by the calling thread while its flag is down, by the writer thread while it is up.
+        std::vector<float> staging_[2];
+        unsigned int staged_rows_[2];
+        std::atomic<bool> full_[2];
+        unsigned int current_;
+        std::atomic<uint64_t> dropped_;
+
+        std::vector<char> text_;
+        std::atomic<bool> running_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::thread thread_;
+
+        void makeHeader(const std::vector<std::string>&);
         void createFile();
-        void writeToFile();
-        void openFile();
-        void closeFile();
+        void writeToFile(const unsigned int&);
+        void handOver();
+        void run();
     public:
         csvWriter();
-        csvWriter(std::string&, std::string&, std::string&, std::vector<std::string>&, unsigned int&);
+        csvWriter(const std::string&, const std::string&, const std::string&, const std::vector<std::string>&, const unsigned int&);
+        csvWriter(const std::string&, const std::string&, const std::string&, const std::vector<std::string>&, const unsigned int&, const bool&);
         ~csvWriter();
 
         void flush();
-        void addToBuffer(std::vector<float> data);
+        void addToBuffer(const std::vector<float>&);
+        uint64_t getDropped() const;
 };
 
 class BoundingBox {
@@ -184,6 +270,9 @@ static bool sortComparisonFunction(const BoundingBox& bbox_0, const BoundingBox&
     return bbox_0.confidence_ > bbox_1.confidence_;
 }
 
+void decodeDetections(float*, const int&, const int&, const float&, std::vector<std::vector<BoundingBox>>&);
+void suppressOverlaps(std::vector<std::vector<BoundingBox>>&, const float&, const size_t&);
+
 class BoundingBox3D : public BoundingBox{
     public:
         int class_id_;
@@ -0,0 +1,82 @@
+/**
+ * @file AllocationHooks.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The allocation hooks of the allocation accounting.
+ * @details This file replaces malloc and its variants with functions that count the allocation in the
+ * scope of the calling thread (see AllocationAccounting), and forward it to the allocator of glibc.
+ * operator new, cv::Mat, and Eigen all allocate through these functions. free is not replaced.
+ * It must be compiled in the executable itself, not in a library: the definitions of the executable
+ * take precedence over the ones of the C library, for all the libraries loaded by the process.
+ * It is only compiled with the ALLOCATION_ACCOUNTING CMake option, and in the allocation_budget and detect_and_track_benchmarks executables.
+ */
+
+#include <detect_and_track/Instrumentation.h>
+#include <errno.h>
+
+extern "C" {
+  // The allocator of glibc.
+  void* __libc_malloc(size_t);
+  void* __libc_calloc(size_t, size_t);
+  void* __libc_realloc(void*, size_t);
+  void* __libc_memalign(size_t, size_t);
+  void* __libc_valloc(size_t);
+  void* __libc_pvalloc(size_t);
+
+  void* malloc(size_t size) {
+    AllocationAccounting::record(size);
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t count, size_t size) {
+    AllocationAccounting::record(count * size);
+    return __libc_calloc(count, size);
+  }
+
+  void* realloc(void* pointer, size_t size) {
+    AllocationAccounting::record(size);
+    return __libc_realloc(pointer, size);
+  }
+
+  void* memalign(size_t alignment, size_t size) {
+    AllocationAccounting::record(size);
+    return __libc_memalign(alignment, size);
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size) {
+    AllocationAccounting::record(size);
+    return __libc_memalign(alignment, size);
+  }
+
+  int posix_memalign(void** pointer, size_t alignment, size_t size) {
+    if ((alignment % sizeof(void*) != 0) || ((alignment & (alignment - 1)) != 0) || (alignment == 0)) {
+      return EINVAL;
+    }
+    AllocationAccounting::record(size);
+    void* memory = __libc_memalign(alignment, size);
+    if (memory == nullptr) {
+      return ENOMEM;
+    }
+    *pointer = memory;
+    return 0;
+  }
+
+  void* valloc(size_t size) {
+    AllocationAccounting::record(size);
+    return __libc_valloc(size);
+  }
+
+  void* pvalloc(size_t size) {
+    AllocationAccounting::record(size);
+    return __libc_pvalloc(size);
+  }
+}
+
+/**
+ * @brief Marks the hooks as linked when the executable starts.
+ *
+ */
+static const bool allocation_hooks_linked = (AllocationAccounting::setHooked(), true);
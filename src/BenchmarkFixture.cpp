@@ -0,0 +1,75 @@
+/**
+ * @file BenchmarkFixture.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The source code of the benchmark fixture.
+ * @details This file implements the setup shared by the benchmarks of the localization and the 2D tracking:
+ * the parameters of the stages, and the synthetic frames they are run on.
+ */
+
+#include <detect_and_track/BenchmarkFixture.h>
+#include <random>
+
+/**
+ * @brief Fills the parameters of the benchmarks.
+ * @details Fills the parameters of the benchmarks: a 640x480 pin-hole camera, a single class, and the
+ * tracking thresholds of the default configuration.
+ *
+ * @param p The reference to the parameters to fill.
+ */
+void getBenchmarkParameters(BenchmarkParameters& p) {
+  p.glo_p = GlobalParameters{480, 640};
+  p.loc_p = LocalizationParameters{0.1, 0.1, "min_distance"};
+  p.cam_p = CameraParameters{{600, 600, 320, 240}, {0, 0, 0, 0, 0}, "pin_hole"};
+  p.det_p = DetectionParameters{"None", 2, 1, {"object"}};
+  p.kal_p = KalmanParameters{{9.0, 9.0, 200.0, 200.0, 5.0, 5.0}, {2.0, 2.0, 200.0, 200.0, 2.0, 2.0}, true, false};
+  p.tra_p = TrackingParameters();
+  p.tra_p.distance_thresh = 150.0;
+  p.tra_p.center_thresh = 80.0;
+  p.tra_p.body_ratio = 0.5;
+  p.tra_p.area_thresh = 2.0;
+  p.tra_p.max_frames_to_skip = 10;
+  p.tra_p.dt = 0.033;
+  p.bbo_p = BBoxRejectionParameters{0, 1000, 0, 1000};
+}
+
+/**
+ * @brief Generates the synthetic frames of the benchmarks.
+ * @details Generates a random depth image, and objects moving slowly across it. The seed is fixed, such
+ * that every benchmark runs on the same frames.
+ *
+ * @param num_frames The reference to the number of frames.
+ * @param num_objects The reference to the number of objects per frame.
+ * @param rows The reference to the number of rows of the depth image.
+ * @param cols The reference to the number of columns of the depth image.
+ * @param depth The reference to the depth image.
+ * @param frames The reference to the bounding boxes of each frame.
+ */
+void generateBenchmarkFrames(const int& num_frames, const int& num_objects, const int& rows, const int& cols,
+                             cv::Mat& depth, std::vector<std::vector<std::vector<BoundingBox>>>& frames) {
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> distance(1.0, 5.0);
+  std::uniform_real_distribution<float> position(0.1, 0.7);
+  depth = cv::Mat(rows, cols, CV_32FC1);
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      depth.at<float>(i, j) = distance(generator);
+    }
+  }
+  std::vector<float> x(num_objects);
+  std::vector<float> y(num_objects);
+  for (int k = 0; k < num_objects; k++) {
+    x[k] = position(generator) * cols;
+    y[k] = position(generator) * rows;
+  }
+  frames.resize(num_frames);
+  for (int f = 0; f < num_frames; f++) {
+    frames[f].resize(1);
+    for (int k = 0; k < num_objects; k++) {
+      frames[f][0].push_back(BoundingBox(x[k] + f % 20, y[k], 80, 80, 0.9, 0));
+    }
+  }
+}
@@ -0,0 +1,244 @@
+/**
+ * @file Checkpoint.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The source code of the tracker checkpoints.
+ * @details This file implements a binary snapshot of the trackers, used to restore them when a node restarts.
+ */
+
+#include <detect_and_track/Checkpoint.h>
+#include <detect_and_track/Tracker.h>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char CheckpointMagic[8] = {'D','T','C','K','P','T','\0','\0'};
+
+/**
+ * @brief Hashes the parameters of a set of trackers.
+ * @details Combines the hashes of the parameters of each tracker, and their number.
+ *
+ * @param trackers The reference to the trackers.
+ * @return The hash of the parameters.
+ */
+uint64_t Checkpoint::hashParameters(const std::vector<BaseTracker*>& trackers) {
+  uint64_t hash = trackers.size();
+  for (unsigned int i=0; i < trackers.size(); i++) {
+    hash ^= trackers[i]->hashParameters() + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  }
+  return hash;
+}
+
+/**
+ * @brief Builds a checkpoint in memory.
+ * @details Builds a complete checkpoint, header included, in the given buffer.
+ * The buffer is cleared but its memory is kept, so that consecutive checkpoints do not reallocate.
+ *
+ * @param trackers The reference to the trackers.
+ * @param buffer The reference to the buffer in which the checkpoint will be stored.
+ */
+void Checkpoint::serialize(const std::vector<BaseTracker*>& trackers, std::vector<char>& buffer) {
+  buffer.resize(sizeof(CheckpointHeader));
+  for (unsigned int i=0; i < trackers.size(); i++) {
+    trackers[i]->serialize(buffer);
+  }
+  CheckpointHeader header;
+  memcpy(header.magic, CheckpointMagic, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.num_trackers = trackers.size();
+  header.parameters_hash = hashParameters(trackers);
+  header.stamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  header.size = buffer.size() - sizeof(CheckpointHeader);
+  memcpy(buffer.data(), &header, sizeof(CheckpointHeader));
+}
+
+/**
+ * @brief Restores a set of trackers from a checkpoint file.
+ * @details Maps the checkpoint file in memory, checks it, and restores the trackers from it.
+ * The checkpoint is rejected if: its version differs, it was built with different parameters,
+ * it is truncated, or it is older than the maximum age. If it is rejected, the trackers are left empty.
+ *
+ * @param path The reference to the path of the checkpoint file.
+ * @param max_age The reference to the maximum age of the checkpoint, in seconds. If negative or 0, the age is not checked.
+ * @param trackers The reference to the trackers to be restored.
+ * @return True if the trackers were restored.
+ */
+bool Checkpoint::load(const std::string& path, const float& max_age, std::vector<BaseTracker*>& trackers) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    printf("[INFO  ] Checkpoint::%s::l%d No checkpoint found at %s.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+  struct stat file_stat;
+  if ((fstat(fd, &file_stat) != 0) || (file_stat.st_size < (off_t) sizeof(CheckpointHeader))) {
+    printf("[ERROR ] Checkpoint::%s::l%d Invalid checkpoint %s.\n", __func__, __LINE__, path.c_str());
+    close(fd);
+    return false;
+  }
+  void* map = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    printf("[ERROR ] Checkpoint::%s::l%d Could not map checkpoint %s.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+
+  bool success = false;
+  const char* data = static_cast<const char*>(map);
+  const char* end = data + file_stat.st_size;
+  CheckpointHeader header;
+  memcpy(&header, data, sizeof(CheckpointHeader));
+  const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  const double age = (now - header.stamp) * 1e-9;
+
+  if (memcmp(header.magic, CheckpointMagic, sizeof(header.magic)) != 0) {
+    printf("[ERROR ] Checkpoint::%s::l%d %s is not a checkpoint.\n", __func__, __LINE__, path.c_str());
+  } else if (header.version != CHECKPOINT_VERSION) {
+    printf("[ERROR ] Checkpoint::%s::l%d Checkpoint version %d, expected %d.\n", __func__, __LINE__, header.version, CHECKPOINT_VERSION);
+  } else if ((header.num_trackers != trackers.size()) || (header.parameters_hash != hashParameters(trackers))) {
+    printf("[WARN  ] Checkpoint::%s::l%d Checkpoint built with different parameters, ignoring it.\n", __func__, __LINE__);
+  } else if (header.size != (uint64_t) (end - data) - sizeof(CheckpointHeader)) {
+    printf("[ERROR ] Checkpoint::%s::l%d Truncated checkpoint %s.\n", __func__, __LINE__, path.c_str());
+  } else if ((max_age > 0) && (age > max_age)) {
+    printf("[WARN  ] Checkpoint::%s::l%d Checkpoint is %.1f s old, ignoring it.\n", __func__, __LINE__, age);
+  } else {
+    data += sizeof(CheckpointHeader);
+    success = true;
+    for (unsigned int i=0; i < trackers.size(); i++) {
+      if (!trackers[i]->deserialize(data, end)) {
+        success = false;
+        break;
+      }
+    }
+    if (success) {
+      printf("[INFO  ] Checkpoint::%s::l%d Restored %d trackers from a %.1f s old checkpoint.\n", __func__, __LINE__, header.num_trackers, age);
+    } else {
+      printf("[ERROR ] Checkpoint::%s::l%d Corrupted checkpoint %s.\n", __func__, __LINE__, path.c_str());
+      // Do not keep half restored trackers.
+      for (unsigned int i=0; i < trackers.size(); i++) {
+        trackers[i]->clear();
+      }
+    }
+  }
+  munmap(map, file_stat.st_size);
+  return success;
+}
+
+/**
+ * @brief Prefered constructor.
+ * @details Prefered constructor. Starts the writer thread.
+ *
+ * @param path The reference to the path of the checkpoint file.
+ * @param period The reference to the minimum time, in seconds, in between two checkpoints.
+ */
+CheckpointWriter::CheckpointWriter(const std::string& path, const float& period) {
+  path_ = path;
+  period_ = period;
+  last_save_ = std::chrono::steady_clock::now();
+  pending_ = false;
+  running_ = true;
+  thread_ = std::thread(&CheckpointWriter::run, this);
+}
+
+/**
+ * @brief Destructor.
+ * @details Destructor. Waits for the last checkpoint to be written, and stops the writer thread.
+ *
+ */
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+/**
+ * @brief Snapshots the trackers if a checkpoint is due.
+ * @details Called on the tracking thread after each update. If the period has elapsed, and the writer is idle,
+ * the trackers are serialized in the front buffer, which is then handed over to the writer thread.
+ *
+ * @param trackers The reference to the trackers.
+ */
+void CheckpointWriter::submit(const std::vector<BaseTracker*>& trackers) {
+  auto now = std::chrono::steady_clock::now();
+  if (std::chrono::duration<float>(now - last_save_).count() < period_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_) {
+      return;
+    }
+  }
+  Checkpoint::serialize(trackers, front_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    front_.swap(back_);
+    pending_ = true;
+  }
+  cv_.notify_one();
+  last_save_ = now;
+}
+
+/**
+ * @brief The loop of the writer thread.
+ * @details Waits for a snapshot to be handed over, and writes it to disk.
+ *
+ */
+void CheckpointWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this]{return pending_ || !running_;});
+    if (pending_) {
+      // The back buffer is not touched by the tracking thread while pending_ is set.
+      lock.unlock();
+      writeToFile(back_);
+      lock.lock();
+      pending_ = false;
+    }
+    if (!running_) {
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Writes a checkpoint to disk.
+ * @details Writes the checkpoint to a temporary file, syncs it to the disk, and renames it. A crash leaves
+ * either the previous checkpoint or the new one, never a truncated one.
+ *
+ * @param buffer The reference to the checkpoint.
+ */
+void CheckpointWriter::writeToFile(const std::vector<char>& buffer) {
+  const std::string tmp_path = path_ + ".tmp";
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    printf("[ERROR ] CheckpointWriter::%s::l%d Could not open %s.\n", __func__, __LINE__, tmp_path.c_str());
+    return;
+  }
+  size_t written = 0;
+  while (written < buffer.size()) {
+    const ssize_t n = write(fd, buffer.data() + written, buffer.size() - written);
+    if ((n < 0) && (errno == EINTR)) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    written += n;
+  }
+  const bool synced = (written == buffer.size()) && (fsync(fd) == 0);
+  if ((close(fd) != 0) || !synced) {
+    printf("[ERROR ] CheckpointWriter::%s::l%d Could not write %s.\n", __func__, __LINE__, tmp_path.c_str());
+    return;
+  }
+  if (std::rename(tmp_path.c_str(), path_.c_str()) != 0) {
+    printf("[ERROR ] CheckpointWriter::%s::l%d Could not rename %s.\n", __func__, __LINE__, tmp_path.c_str());
+  }
+}
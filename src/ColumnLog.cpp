@@ -0,0 +1,622 @@
+/**
+ * @file ColumnLog.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The source code of the columnar log.
+ * @details This file implements the writer and the reader of the columnar log of the detections and the tracks.
+ */
+
+#include <detect_and_track/ColumnLog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <limits>
+
+static const uint64_t ColumnLogMagic = 0x474f4c4c4f435444ULL; // "DTCOLLOG" in little endian.
+static const uint64_t ColumnLogSegmentMagic = 0x4745534c4f435444ULL; // "DTCOLSEG" in little endian.
+
+/**
+ * @brief Rounds a size up to a multiple of an alignment.
+ *
+ * @param size The reference to the size, in bytes.
+ * @param alignment The reference to the alignment, a power of 2.
+ * @return The rounded size, in bytes.
+ */
+static uint64_t alignTo(const uint64_t& size, const uint64_t& alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * @brief Computes the layout of the segments.
+ * @details The columns are aligned on cache lines, the segments on COLUMN_LOG_ALIGNMENT.
+ *
+ * @param rows_per_segment The reference to the number of rows of a segment.
+ * @param layout The reference to the header of the log.
+ */
+static void makeLayout(const uint64_t& rows_per_segment, ColumnLogFileHeader& layout) {
+  memset(&layout, 0, sizeof(ColumnLogFileHeader));
+  layout.magic = ColumnLogMagic;
+  layout.version = COLUMN_LOG_VERSION;
+  layout.num_columns = COLUMN_COUNT;
+  layout.rows_per_segment = rows_per_segment;
+  uint64_t offset = alignTo(sizeof(ColumnLogSegmentHeader), 64);
+  for (unsigned int c = 0; c < COLUMN_COUNT; c++) {
+    layout.column_widths[c] = c <= COLUMN_SEQUENCE ? 8 : 4;
+    layout.column_offsets[c] = offset;
+    offset = alignTo(offset + rows_per_segment * layout.column_widths[c], 64);
+  }
+  layout.segment_size = alignTo(offset, COLUMN_LOG_ALIGNMENT);
+}
+
+/**
+ * @brief Checks the header of a log.
+ *
+ * @param layout The reference to the header of the log.
+ * @param path The reference to the path of the log, for the error messages.
+ * @return True if the log can be read by this version.
+ */
+static bool checkLayout(const ColumnLogFileHeader& layout, const std::string& path) {
+  if (layout.magic != ColumnLogMagic) {
+    printf("[ERROR ] ColumnLog::%s::l%d %s is not a column log.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+  if ((layout.version != COLUMN_LOG_VERSION) || (layout.num_columns != COLUMN_COUNT)) {
+    printf("[ERROR ] ColumnLog::%s::l%d %s has version %u and %u columns, expected version %d and %d columns.\n",
+           __func__, __LINE__, path.c_str(), layout.version, layout.num_columns, COLUMN_LOG_VERSION, COLUMN_COUNT);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Default constructor.
+ *
+ */
+ColumnLogWriter::ColumnLogWriter() {
+  fd_ = -1;
+  segment_ = nullptr;
+  segment_header_ = nullptr;
+  segment_index_ = 0;
+  num_rows_ = 0;
+  last_stamp_ = 0;
+  to_allocate_ = 0;
+  running_ = false;
+}
+
+/**
+ * @brief Destructor. Syncs the current segment, and closes the log.
+ *
+ */
+ColumnLogWriter::~ColumnLogWriter() {
+  close();
+}
+
+/**
+ * @brief Opens a log for appending.
+ * @details Creates the log if it does not exist. Otherwise, the segments preallocated after the last used one,
+ * and the segment being allocated when the writer stopped, are dropped, and the writer continues the last segment,
+ * or starts a new one if it was sealed.
+ *
+ * @param path The reference to the path of the log.
+ * @param rows_per_segment The reference to the number of rows of a segment, for a new log.
+ * @return True if the log can be written.
+ */
+bool ColumnLogWriter::open(const std::string& path, const uint64_t& rows_per_segment) {
+  close();
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    printf("[ERROR ] ColumnLogWriter::%s::l%d Could not open %s.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+  struct stat file_stat;
+  fstat(fd, &file_stat);
+  ColumnLogFileHeader layout;
+  memset(&layout, 0, sizeof(ColumnLogFileHeader));
+  if (pread(fd, &layout, sizeof(ColumnLogFileHeader), 0) < 0) {
+    layout.magic = 0;
+  }
+
+  uint64_t index = 0;
+  if (layout.magic != 0) {
+    if (!checkLayout(layout, path)) {
+      ::close(fd);
+      return false;
+    }
+    if (layout.rows_per_segment != rows_per_segment) {
+      printf("[INFO  ] ColumnLogWriter::%s::l%d %s has %lu rows per segment, they are kept.\n", __func__, __LINE__,
+             path.c_str(), layout.rows_per_segment);
+    }
+    const uint64_t num_segments = file_stat.st_size > COLUMN_LOG_ALIGNMENT ?
+                                  (file_stat.st_size - COLUMN_LOG_ALIGNMENT) / layout.segment_size : 0;
+    // The unused segments have no magic, the used ones are contiguous.
+    uint64_t num_used = num_segments;
+    ColumnLogSegmentHeader segment_header;
+    while (num_used > 0) {
+      if ((pread(fd, &segment_header, sizeof(ColumnLogSegmentHeader),
+                 COLUMN_LOG_ALIGNMENT + (num_used - 1) * layout.segment_size) == sizeof(ColumnLogSegmentHeader)) &&
+          (segment_header.magic == ColumnLogSegmentMagic)) {
+        break;
+      }
+      num_used --;
+    }
+    if (ftruncate(fd, COLUMN_LOG_ALIGNMENT + num_used * layout.segment_size) != 0) {
+      printf("[ERROR ] ColumnLogWriter::%s::l%d Could not truncate %s.\n", __func__, __LINE__, path.c_str());
+      ::close(fd);
+      return false;
+    }
+    // The header of the last used segment was read above, there is none without used segments.
+    if (num_used > 0) {
+      // A full segment may not be sealed, if the writer stopped before its sealing thread.
+      const bool full = segment_header.sealed || (segment_header.num_rows.load() >= layout.rows_per_segment);
+      index = full ? num_used : num_used - 1;
+    }
+  } else {
+    // A new log, or a log that crashed before its header was written.
+    makeLayout(std::max(rows_per_segment, (uint64_t) 1), layout);
+    if ((ftruncate(fd, 0) != 0) || (ftruncate(fd, COLUMN_LOG_ALIGNMENT) != 0) ||
+        (pwrite(fd, &layout, sizeof(ColumnLogFileHeader), 0) != sizeof(ColumnLogFileHeader)) || (fsync(fd) != 0)) {
+      printf("[ERROR ] ColumnLogWriter::%s::l%d Could not write the header of %s.\n", __func__, __LINE__, path.c_str());
+      ::close(fd);
+      return false;
+    }
+  }
+
+  path_ = path;
+  fd_ = fd;
+  layout_ = layout;
+  if (!mapSegment(index)) {
+    ::close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  running_ = true;
+  to_allocate_ = segment_index_ + 2;
+  thread_ = std::thread(&ColumnLogWriter::run, this, segment_index_ + 1);
+  return true;
+}
+
+/**
+ * @brief Syncs the current segment to the disk, and closes the log.
+ *
+ */
+void ColumnLogWriter::close() {
+  if (fd_ < 0) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_.join();
+  if (segment_ != nullptr) {
+    msync(segment_, layout_.segment_size, MS_SYNC);
+    munmap(segment_, layout_.segment_size);
+    segment_ = nullptr;
+    segment_header_ = nullptr;
+  }
+  ::close(fd_);
+  fd_ = -1;
+}
+
+/**
+ * @brief Checks if the log was opened.
+ *
+ * @return True if the rows can be appended.
+ */
+bool ColumnLogWriter::isOpen() const {
+  return segment_ != nullptr;
+}
+
+/**
+ * @brief Returns the number of rows in the log.
+ *
+ * @return The number of rows, including the ones of the sealed segments.
+ */
+uint64_t ColumnLogWriter::getNumRows() const {
+  return segment_index_ * layout_.rows_per_segment + num_rows_;
+}
+
+/**
+ * @brief Maps a segment, and initializes its header if it was never used.
+ *
+ * @param index The reference to the index of the segment.
+ * @return True if the segment was mapped.
+ */
+bool ColumnLogWriter::mapSegment(const uint64_t& index) {
+  const off_t offset = COLUMN_LOG_ALIGNMENT + index * layout_.segment_size;
+  // Unlike ftruncate, posix_fallocate never shrinks the file: it cannot undo a preallocation of the sealing thread.
+  if (posix_fallocate(fd_, offset, layout_.segment_size) != 0) {
+    printf("[ERROR ] ColumnLogWriter::%s::l%d Could not allocate the segment %lu of %s.\n", __func__, __LINE__, index, path_.c_str());
+    return false;
+  }
+  void* map = mmap(nullptr, layout_.segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, offset);
+  if (map == MAP_FAILED) {
+    printf("[ERROR ] ColumnLogWriter::%s::l%d Could not map the segment %lu of %s.\n", __func__, __LINE__, index, path_.c_str());
+    return false;
+  }
+  segment_ = static_cast<char*>(map);
+  segment_header_ = reinterpret_cast<ColumnLogSegmentHeader*>(segment_);
+  segment_index_ = index;
+  if (segment_header_->magic != ColumnLogSegmentMagic) {
+    segment_header_->index = index;
+    segment_header_->num_rows.store(0, std::memory_order_relaxed);
+    segment_header_->min_stamp = std::numeric_limits<int64_t>::max();
+    segment_header_->max_stamp = std::numeric_limits<int64_t>::min();
+    segment_header_->sorted = 1;
+    segment_header_->sealed = 0;
+    // The magic is written last, the readers ignore the segment until then.
+    std::atomic_thread_fence(std::memory_order_release);
+    segment_header_->magic = ColumnLogSegmentMagic;
+  }
+  num_rows_ = std::min(segment_header_->num_rows.load(std::memory_order_acquire), layout_.rows_per_segment);
+  last_stamp_ = num_rows_ > 0 ? getColumn<int64_t>(COLUMN_STAMP)[num_rows_ - 1] : std::numeric_limits<int64_t>::min();
+  return true;
+}
+
+/**
+ * @brief Returns a column of the current segment.
+ *
+ * @param column The reference to the column.
+ * @return A pointer to the first value of the column.
+ */
+template <typename T>
+T* ColumnLogWriter::getColumn(const ColumnLogColumn& column) {
+  return reinterpret_cast<T*>(segment_ + layout_.column_offsets[column]);
+}
+
+/**
+ * @brief Appends a row.
+ * @details The values are written in the columns of the current segment, then the row is counted. When the segment
+ * is full, it is handed over to the sealing thread, and the next one is mapped.
+ *
+ * @param row The reference to the row.
+ * @return False if the log is not open.
+ */
+bool ColumnLogWriter::append(const ColumnLogRow& row) {
+  if (segment_ == nullptr) {
+    return false;
+  }
+  const uint64_t r = num_rows_;
+  getColumn<int64_t>(COLUMN_STAMP)[r] = row.stamp;
+  getColumn<uint64_t>(COLUMN_SEQUENCE)[r] = row.sequence;
+  getColumn<uint32_t>(COLUMN_KIND)[r] = row.kind;
+  getColumn<uint32_t>(COLUMN_CLASS_ID)[r] = row.class_id;
+  getColumn<uint32_t>(COLUMN_ID)[r] = row.id;
+  getColumn<float>(COLUMN_CONFIDENCE)[r] = row.confidence;
+  for (unsigned int s = 0; s < COLUMN_LOG_NUM_STATES; s++) {
+    getColumn<float>((ColumnLogColumn) (COLUMN_STATE + s))[r] = row.state[s];
+  }
+  for (unsigned int p = 0; p < 3; p++) {
+    getColumn<float>((ColumnLogColumn) (COLUMN_POSITION_X + p))[r] = row.position[p];
+  }
+  segment_header_->min_stamp = std::min(segment_header_->min_stamp, row.stamp);
+  segment_header_->max_stamp = std::max(segment_header_->max_stamp, row.stamp);
+  if (row.stamp < last_stamp_) {
+    segment_header_->sorted = 0;
+  }
+  last_stamp_ = row.stamp;
+  num_rows_ ++;
+  segment_header_->num_rows.store(num_rows_, std::memory_order_release);
+
+  if (num_rows_ == layout_.rows_per_segment) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      to_seal_.push_back(segment_);
+      to_allocate_ = std::max(to_allocate_, segment_index_ + 3);
+    }
+    cv_.notify_one();
+    segment_ = nullptr;
+    segment_header_ = nullptr;
+    if (!mapSegment(segment_index_ + 1)) {
+      printf("[ERROR ] ColumnLogWriter::%s::l%d The next rows of %s are dropped.\n", __func__, __LINE__, path_.c_str());
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Appends the detections and the tracks of a frame.
+ * @details One row per valid detection, with its position if it was located, and one row per track of the
+ * tracker states of the frame, whether or not it was corrected in this frame, with its position if it was located. The detections are stored as 2D states: x, y, 0, 0, w, h.
+ *
+ * @param frame The reference to the frame.
+ */
+void ColumnLogWriter::writeFrame(const PipelineFrame& frame) {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  ColumnLogRow row;
+  row.stamp = frame.stamps.stamp;
+  row.sequence = frame.stamps.sequence;
+
+  row.kind = COLUMN_LOG_DETECTION;
+  for (unsigned int c = 0; c < frame.bboxes.size(); c++) {
+    for (unsigned int i = 0; i < frame.bboxes[c].size(); i++) {
+      const BoundingBox& bbox = frame.bboxes[c][i];
+      if (!bbox.valid_) {
+        continue;
+      }
+      row.class_id = c;
+      row.id = i;
+      row.confidence = bbox.confidence_;
+      std::fill(row.state, row.state + COLUMN_LOG_NUM_STATES, nan);
+      row.state[0] = bbox.x_;
+      row.state[1] = bbox.y_;
+      row.state[2] = 0;
+      row.state[3] = 0;
+      row.state[4] = bbox.w_;
+      row.state[5] = bbox.h_;
+      const bool located = (c < frame.points.size()) && (i < frame.points[c].size()) && (frame.points[c][i].size() >= 3);
+      for (unsigned int p = 0; p < 3; p++) {
+        row.position[p] = located ? frame.points[c][i][p] : nan;
+      }
+      append(row);
+    }
+  }
+
+  row.kind = COLUMN_LOG_TRACK;
+  row.confidence = nan;
+  for (unsigned int c = 0; c < frame.tracker_states.size(); c++) {
+    for (auto & element : frame.tracker_states[c]) {
+      row.class_id = c;
+      row.id = element.first;
+      const unsigned int state_size = std::min((unsigned int) element.second.size(), (unsigned int) COLUMN_LOG_NUM_STATES);
+      std::copy(element.second.begin(), element.second.begin() + state_size, row.state);
+      std::fill(row.state + state_size, row.state + COLUMN_LOG_NUM_STATES, nan);
+      std::map<unsigned int, std::vector<float>>::const_iterator point;
+      const bool located = (c < frame.track_points.size()) &&
+                           ((point = frame.track_points[c].find(element.first)) != frame.track_points[c].end()) &&
+                           (point->second.size() >= 3);
+      for (unsigned int p = 0; p < 3; p++) {
+        row.position[p] = located ? point->second[p] : nan;
+      }
+      append(row);
+    }
+  }
+}
+
+/**
+ * @brief The loop of the sealing thread.
+ * @details Syncs the full segments to the disk before sealing them: once sealed, a segment survives a crash of the
+ * machine. Preallocates the segments ahead of the writer, such that the disk blocks are not allocated on its thread.
+ *
+ * @param num_allocated The reference to the number of segments already allocated.
+ */
+void ColumnLogWriter::run(const uint64_t& num_allocated) {
+  uint64_t allocated = num_allocated;
+  std::vector<char*> to_seal;
+  while (true) {
+    uint64_t to_allocate;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this, &allocated]{return !to_seal_.empty() || (to_allocate_ > allocated) || !running_;});
+      if (!running_ && to_seal_.empty()) {
+        break;
+      }
+      to_seal.swap(to_seal_);
+      to_allocate = to_allocate_;
+    }
+    for (unsigned int s = 0; s < to_seal.size(); s++) {
+      ColumnLogSegmentHeader* header = reinterpret_cast<ColumnLogSegmentHeader*>(to_seal[s]);
+      msync(to_seal[s], layout_.segment_size, MS_SYNC);
+      header->sealed = 1;
+      msync(to_seal[s], sizeof(ColumnLogSegmentHeader), MS_SYNC);
+      munmap(to_seal[s], layout_.segment_size);
+    }
+    to_seal.clear();
+    for (; allocated < to_allocate; allocated++) {
+      posix_fallocate(fd_, COLUMN_LOG_ALIGNMENT + allocated * layout_.segment_size, layout_.segment_size);
+    }
+  }
+}
+
+/**
+ * @brief Default constructor.
+ *
+ */
+ColumnLogReader::ColumnLogReader() {
+  map_ = nullptr;
+  map_size_ = 0;
+  memset(&layout_, 0, sizeof(ColumnLogFileHeader));
+}
+
+/**
+ * @brief Destructor. Unmaps the log.
+ *
+ */
+ColumnLogReader::~ColumnLogReader() {
+  close();
+}
+
+/**
+ * @brief Maps a log, and reads the headers of its segments.
+ *
+ * @param path The reference to the path of the log.
+ * @return True if the log can be read.
+ */
+bool ColumnLogReader::open(const std::string& path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    printf("[ERROR ] ColumnLogReader::%s::l%d Could not open %s.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+  struct stat file_stat;
+  if ((fstat(fd, &file_stat) != 0) || (file_stat.st_size < COLUMN_LOG_ALIGNMENT)) {
+    printf("[ERROR ] ColumnLogReader::%s::l%d %s is not a column log.\n", __func__, __LINE__, path.c_str());
+    ::close(fd);
+    return false;
+  }
+  void* map = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    printf("[ERROR ] ColumnLogReader::%s::l%d Could not map %s.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+  map_ = static_cast<const char*>(map);
+  map_size_ = file_stat.st_size;
+  memcpy(&layout_, map_, sizeof(ColumnLogFileHeader));
+  if (!checkLayout(layout_, path) || (layout_.segment_size == 0)) {
+    close();
+    return false;
+  }
+  const uint64_t num_segments = (map_size_ - COLUMN_LOG_ALIGNMENT) / layout_.segment_size;
+  for (uint64_t s = 0; s < num_segments; s++) {
+    const ColumnLogSegmentHeader* header = reinterpret_cast<const ColumnLogSegmentHeader*>(map_ + COLUMN_LOG_ALIGNMENT + s * layout_.segment_size);
+    if (header->magic != ColumnLogSegmentMagic) {
+      continue;
+    }
+    segments_.push_back(header);
+    num_rows_.push_back(std::min(header->num_rows.load(std::memory_order_acquire), layout_.rows_per_segment));
+  }
+  return true;
+}
+
+/**
+ * @brief Unmaps the log.
+ *
+ */
+void ColumnLogReader::close() {
+  if (map_ != nullptr) {
+    munmap(const_cast<char*>(map_), map_size_);
+  }
+  map_ = nullptr;
+  map_size_ = 0;
+  segments_.clear();
+  num_rows_.clear();
+}
+
+/**
+ * @brief Checks if a log was opened.
+ *
+ * @return True if the log can be read.
+ */
+bool ColumnLogReader::isOpen() const {
+  return map_ != nullptr;
+}
+
+/**
+ * @brief Returns the number of segments in use.
+ *
+ * @return The number of segments.
+ */
+uint64_t ColumnLogReader::getNumSegments() const {
+  return segments_.size();
+}
+
+/**
+ * @brief Returns the number of rows of the log.
+ *
+ * @return The number of rows.
+ */
+uint64_t ColumnLogReader::getNumRows() const {
+  uint64_t num_rows = 0;
+  for (unsigned int s = 0; s < num_rows_.size(); s++) {
+    num_rows += num_rows_[s];
+  }
+  return num_rows;
+}
+
+/**
+ * @brief Returns the number of rows of a segment.
+ *
+ * @param segment The reference to the index of the segment.
+ * @return The number of rows.
+ */
+uint64_t ColumnLogReader::getNumRows(const uint64_t& segment) const {
+  return num_rows_[segment];
+}
+
+/**
+ * @brief Returns the first and the last stamps of the log, from the headers of the segments.
+ *
+ * @param min_stamp The reference to the first stamp, in nanoseconds.
+ * @param max_stamp The reference to the last stamp, in nanoseconds.
+ * @return False if the log has no rows.
+ */
+bool ColumnLogReader::getTimeRange(int64_t& min_stamp, int64_t& max_stamp) const {
+  min_stamp = std::numeric_limits<int64_t>::max();
+  max_stamp = std::numeric_limits<int64_t>::min();
+  for (unsigned int s = 0; s < segments_.size(); s++) {
+    if (num_rows_[s] > 0) {
+      min_stamp = std::min(min_stamp, segments_[s]->min_stamp);
+      max_stamp = std::max(max_stamp, segments_[s]->max_stamp);
+    }
+  }
+  return min_stamp <= max_stamp;
+}
+
+/**
+ * @brief Finds the rows whose stamp is in a time range.
+ * @details The segments are selected from their headers, only the stamps of the selected segments are read.
+ * In a sorted segment, the first and the last rows are found by bisection.
+ *
+ * @param start The reference to the start of the range, in nanoseconds, included.
+ * @param end The reference to the end of the range, in nanoseconds, included.
+ * @param spans The reference to the ranges of rows, in the order of the segments.
+ */
+void ColumnLogReader::findRange(const int64_t& start, const int64_t& end, std::vector<ColumnLogSpan>& spans) const {
+  spans.clear();
+  for (uint64_t s = 0; s < segments_.size(); s++) {
+    const uint64_t num_rows = num_rows_[s];
+    if ((num_rows == 0) || (segments_[s]->max_stamp < start) || (segments_[s]->min_stamp > end)) {
+      continue;
+    }
+    const int64_t* stamps = static_cast<const int64_t*>(getColumn(s, COLUMN_STAMP));
+    if (segments_[s]->sorted) {
+      const uint64_t begin = std::lower_bound(stamps, stamps + num_rows, start) - stamps;
+      const uint64_t stop = std::upper_bound(stamps + begin, stamps + num_rows, end) - stamps;
+      if (begin < stop) {
+        spans.push_back(ColumnLogSpan{s, begin, stop});
+      }
+      continue;
+    }
+    for (uint64_t r = 0; r < num_rows; r++) {
+      if ((stamps[r] < start) || (stamps[r] > end)) {
+        continue;
+      }
+      if (!spans.empty() && (spans.back().segment == s) && (spans.back().end == r)) {
+        spans.back().end ++;
+      } else {
+        spans.push_back(ColumnLogSpan{s, r, r + 1});
+      }
+    }
+  }
+}
+
+/**
+ * @brief Returns a column of a segment.
+ *
+ * @param segment The reference to the index of the segment.
+ * @param column The reference to the column.
+ * @return A pointer to the first value of the column, of the type given in ColumnLogColumn.
+ */
+const void* ColumnLogReader::getColumn(const uint64_t& segment, const ColumnLogColumn& column) const {
+  return reinterpret_cast<const char*>(segments_[segment]) + layout_.column_offsets[column];
+}
+
+/**
+ * @brief Reads all the columns of a row.
+ *
+ * @param segment The reference to the index of the segment.
+ * @param row The reference to the index of the row in the segment.
+ * @param value The reference to the row.
+ */
+void ColumnLogReader::readRow(const uint64_t& segment, const uint64_t& row, ColumnLogRow& value) const {
+  value.stamp = static_cast<const int64_t*>(getColumn(segment, COLUMN_STAMP))[row];
+  value.sequence = static_cast<const uint64_t*>(getColumn(segment, COLUMN_SEQUENCE))[row];
+  value.kind = static_cast<const uint32_t*>(getColumn(segment, COLUMN_KIND))[row];
+  value.class_id = static_cast<const uint32_t*>(getColumn(segment, COLUMN_CLASS_ID))[row];
+  value.id = static_cast<const uint32_t*>(getColumn(segment, COLUMN_ID))[row];
+  value.confidence = static_cast<const float*>(getColumn(segment, COLUMN_CONFIDENCE))[row];
+  for (unsigned int s = 0; s < COLUMN_LOG_NUM_STATES; s++) {
+    value.state[s] = static_cast<const float*>(getColumn(segment, (ColumnLogColumn) (COLUMN_STATE + s)))[row];
+  }
+  for (unsigned int p = 0; p < 3; p++) {
+    value.position[p] = static_cast<const float*>(getColumn(segment, (ColumnLogColumn) (COLUMN_POSITION_X + p)))[row];
+  }
+}
@@ -1,9 +1,9 @@
 #include <detect_and_track/DetectionUtils.h>
 
-Detect::Detect() : OD_() {}
+Detect::Detect() : OD_(), profile_detection_(false), resize_histogram_(nullptr), offline_threads_(0) {}
 
 Detect::Detect(GlobalParameters& global_parameters, DetectionParameters& detection_parameters,
-               NMSParameters& nms_parameters) : OD_() {
+               NMSParameters& nms_parameters) : OD_(), profile_detection_(false), resize_histogram_(nullptr), offline_threads_(0) {
   // Object detector parameters
   image_rows_ = global_parameters.image_height;
   image_cols_ = global_parameters.image_width;
@@ -35,35 +35,61 @@ void Detect::buildDetect(GlobalParameters& global_parameters, DetectionParameter
 Detect::~Detect() {}
 
 void Detect::padImage(cv::Mat& image) {
-  r_ = (float) image_size_ / std::max(image.rows, image.cols);
+  letterboxImage(image, padded_image_, r_, padding_rows_, padding_cols_);
+}
+
+/**
+ * @brief Resizes an image to fit the network, and pads it to a square.
+ * @details Only reads the parameters of the detector, such that it can be called from several threads.
+ *
+ * @param image The reference to the image.
+ * @param padded The reference to the square image in which the resized image will be centered.
+ * It is allocated if it does not have the size of the network, its borders must be black.
+ * @param ratio The reference to the ratio in between the size of the resized image and the size of the image.
+ * @param padding_rows The reference to the number of rows added above the resized image.
+ * @param padding_cols The reference to the number of columns added left of the resized image.
+ */
+void Detect::letterboxImage(const cv::Mat& image, cv::Mat& padded, float& ratio, int& padding_rows, int& padding_cols) {
+  ratio = (float) image_size_ / std::max(image.rows, image.cols);
   cv::Mat tmp;
-  printf("DEBUG: %f\n",r_);
-  //if (r_ != 1) {
-  cv::resize(image, tmp, cv::Size(), r_, r_, cv::INTER_AREA);
-    //printf("Not implemented\n");
-  //}
-  //printf("rows %d, cols%d\n", image.rows, image.cols);
-  padding_rows_ = (image_size_ - tmp.rows)/2;
-  padding_cols_ = (image_size_ - tmp.cols)/2;
-  tmp.copyTo(padded_image_(cv::Range(padding_rows_,padding_rows_+tmp.rows),cv::Range(padding_cols_,padding_cols_+tmp.cols)));  
+  cv::resize(image, tmp, cv::Size(), ratio, ratio, cv::INTER_AREA);
+  padding_rows = (image_size_ - tmp.rows)/2;
+  padding_cols = (image_size_ - tmp.cols)/2;
+  if ((padded.rows != image_size_) || (padded.cols != image_size_) || (padded.type() != CV_8UC3)) {
+    padded = cv::Mat::zeros(image_size_, image_size_, CV_8UC3);
+  }
+  tmp.copyTo(padded(cv::Range(padding_rows,padding_rows+tmp.rows),cv::Range(padding_cols,padding_cols+tmp.cols)));
 }
 
 void Detect::adjustBoundingBoxes(std::vector<std::vector<BoundingBox>>& bboxes) {
+  adjustBoundingBoxes(bboxes, r_, padding_rows_, padding_cols_);
+}
+
+/**
+ * @brief Moves the bounding boxes from the letterboxed image back to the original image.
+ *
+ * @param bboxes The reference to the bounding boxes.
+ * @param ratio The reference to the ratio of the letterboxing, see letterboxImage.
+ * @param padding_rows The reference to the number of rows added above the resized image.
+ * @param padding_cols The reference to the number of columns added left of the resized image.
+ */
+void Detect::adjustBoundingBoxes(std::vector<std::vector<BoundingBox>>& bboxes, const float& ratio,
+                                 const int& padding_rows, const int& padding_cols) {
   for (unsigned int i=0; i < bboxes.size(); i++) {
     for (unsigned int j=0; j < bboxes[i].size(); j++) {
       if (!bboxes[i][j].valid_) {
         continue;
       }
-      bboxes[i][j].x_ -= padding_cols_;
-      bboxes[i][j].y_ -= padding_rows_;
-      bboxes[i][j].x_ /= r_;
-      bboxes[i][j].y_ /= r_;
-      bboxes[i][j].x_min_ = bboxes[i][j].x_ - bboxes[i][j].w_/(2*r_);
-      bboxes[i][j].x_max_ = bboxes[i][j].x_ + bboxes[i][j].w_/(2*r_);
-      bboxes[i][j].y_min_ = bboxes[i][j].y_ - bboxes[i][j].h_/(2*r_);
-      bboxes[i][j].y_max_ = bboxes[i][j].y_ + bboxes[i][j].h_/(2*r_);
-      bboxes[i][j].h_ = bboxes[i][j].h_ / r_;
-      bboxes[i][j].w_ = bboxes[i][j].w_ / r_;
+      bboxes[i][j].x_ -= padding_cols;
+      bboxes[i][j].y_ -= padding_rows;
+      bboxes[i][j].x_ /= ratio;
+      bboxes[i][j].y_ /= ratio;
+      bboxes[i][j].x_min_ = bboxes[i][j].x_ - bboxes[i][j].w_/(2*ratio);
+      bboxes[i][j].x_max_ = bboxes[i][j].x_ + bboxes[i][j].w_/(2*ratio);
+      bboxes[i][j].y_min_ = bboxes[i][j].y_ - bboxes[i][j].h_/(2*ratio);
+      bboxes[i][j].y_max_ = bboxes[i][j].y_ + bboxes[i][j].h_/(2*ratio);
+      bboxes[i][j].h_ = bboxes[i][j].h_ / ratio;
+      bboxes[i][j].w_ = bboxes[i][j].w_ / ratio;
       //bboxes[i][j].x_min_ = std::max(bboxes[i][j].x_ - bboxes[i][j].w_/(2*r_), (float) 0.0);
       //bboxes[i][j].x_max_ = std::min(bboxes[i][j].x_ + bboxes[i][j].w_/(2*r_), (float) image_cols_);
       //bboxes[i][j].y_min_ = std::max(bboxes[i][j].y_ - bboxes[i][j].h_/(2*r_), (float) 0.0);
@@ -72,15 +98,22 @@ void Detect::adjustBoundingBoxes(std::vector<std::vector<BoundingBox>>& bboxes)
   }
 }
 
-void Detect::generateDetectionImage(cv::Mat& image, const std::vector<std::vector<BoundingBox>>& bboxes) {
+/**
+ * @brief Draws the detections on an image.
+ * 
+ * @param image The reference to the image to draw on.
+ * @param bboxes The reference to the detections.
+ * @param scale The reference to the ratio in between the size of the image and the size of the image the objects were detected in.
+ */
+void Detect::generateDetectionImage(cv::Mat& image, const std::vector<std::vector<BoundingBox>>& bboxes, const float& scale) {
   for (unsigned int i=0; i<bboxes.size(); i++) {
-    for (unsigned int j=0; j<bboxes[i].size()+1; j++) {
+    for (unsigned int j=0; j<bboxes[i].size(); j++) {
       if (!bboxes[i][j].valid_) {
         continue;
       }
-      const cv::Rect rect(bboxes[i][j].x_min_, bboxes[i][j].y_min_, bboxes[i][j].w_, bboxes[i][j].h_);
+      const cv::Rect rect(bboxes[i][j].x_min_ * scale, bboxes[i][j].y_min_ * scale, bboxes[i][j].w_ * scale, bboxes[i][j].h_ * scale);
       cv::rectangle(image, rect, ColorPalette[0], 3);
-      cv::putText(image, class_map_[i], cv::Point(bboxes[i][j].x_min_,bboxes[i][j].y_min_-10), cv::FONT_HERSHEY_SIMPLEX, 0.9, ColorPalette[i], 2);
+      cv::putText(image, class_map_[i], cv::Point(bboxes[i][j].x_min_ * scale, bboxes[i][j].y_min_ * scale - 10), cv::FONT_HERSHEY_SIMPLEX, 0.9 * scale, ColorPalette[i], 2);
     }
   }
 }
@@ -89,35 +122,95 @@ void Detect::generateDetectionImage(cv::Mat& image, const std::vector<std::vecto
 void Detect::detectObjects(cv::Mat& image, std::vector<std::vector<BoundingBox>>& bboxes) {
   bboxes.clear();
   bboxes.resize(num_classes_);
-#ifdef PROFILE
-  start_image_ = std::chrono::system_clock::now();
-#endif
-  padImage(image);
-#ifdef PROFILE
-  end_image_ = std::chrono::system_clock::now();
-  start_detection_ = std::chrono::system_clock::now();
-#endif
+  if (RUNTIME_OPTION(profile_detection_)) {
+    start_image_ = std::chrono::system_clock::now();
+  }
+  {
+    ScopedTimer timer(resize_histogram_);
+    padImage(image);
+  }
+  if (RUNTIME_OPTION(profile_detection_)) {
+    end_image_ = std::chrono::system_clock::now();
+    start_detection_ = end_image_;
+  }
   OD_->detectObjects(padded_image_, bboxes);
   adjustBoundingBoxes(bboxes);
-#ifdef PROFILE
-  end_detection_ = std::chrono::system_clock::now();
-#endif
+  if (RUNTIME_OPTION(profile_detection_)) {
+    end_detection_ = std::chrono::system_clock::now();
+  }
+}
+
+/**
+ * @brief Detects the objects in several letterboxed images.
+ * @details The images are sent to the network in batches, see ObjectDetector. The bounding boxes are
+ * in the coordinates of the letterboxed images, see adjustBoundingBoxes.
+ *
+ * @param images The reference to the letterboxed images, see letterboxImage. They are converted in place.
+ * @param bboxes The reference to the vector in which the bounding boxes of each image will be stored.
+ */
+void Detect::detectObjects(std::vector<cv::Mat>& images, std::vector<std::vector<std::vector<BoundingBox>>>& bboxes) {
+  OD_->detectObjects(images, bboxes);
+  for (unsigned int k=0; k < bboxes.size(); k++) {
+    bboxes[k].resize(num_classes_);
+  }
 }
 
 void Detect::printProfilingDetection() {
-#ifdef PROFILE
+  if (!RUNTIME_OPTION(profile_detection_)) {
+    return;
+  }
   printf(" - Image processing done in %ld us\n", std::chrono::duration_cast<std::chrono::microseconds>(end_image_ - start_image_).count());
   printf(" - Object detection done in %ld ms\n", std::chrono::duration_cast<std::chrono::milliseconds>(end_detection_ - start_detection_).count());
-#endif
 }
 
-void Detect::applyOnFolder(std::string, std::string, bool, bool, bool) {}
+/**
+ * @brief Enables or disables the profiling of the detection.
+ * @details Disabled by default. When disabled, the clock is never read.
+ *
+ * @param profile True to time the pre-processing and the inference.
+ */
+void Detect::setDetectionProfiling(const bool& profile) {
+  profile_detection_ = profile;
+}
+
+/**
+ * @brief Sets the histograms in which the duration of the steps of the detection are recorded.
+ * @details The resizing is recorded by this class, the other steps by the object detector.
+ *
+ * @param instrumentation The pointer to the instrumentation of the node, nullptr to disable the timers.
+ */
+void Detect::setDetectionInstrumentation(Instrumentation* instrumentation) {
+  resize_histogram_ = instrumentation != nullptr ? instrumentation->getHistogram("resize") : nullptr;
+  if (OD_ != nullptr) {
+    OD_->setInstrumentation(instrumentation);
+  }
+}
+
+/**
+ * @brief Detection stage of the pipeline.
+ * @details Detects the objects in the RGB image of the frame.
+ *
+ * @param frame The reference to the frame.
+ * @return Always true.
+ */
+bool Detect::detectFrame(PipelineFrame& frame) {
+  detectObjects(frame.image, frame.bboxes);
+  return true;
+}
 
-void Detect::applyOnVideo(std::string, std::string, bool, bool, bool) {}
+/**
+ * @brief Sets the number of threads used by the offline processing.
+ * @details The images are decoded, and the objects located, by this many threads.
+ *
+ * @param num_threads The reference to the number of threads, 0 (default) to use one per core.
+ */
+void Detect::setOfflineThreads(const unsigned int& num_threads) {
+  offline_threads_ = num_threads;
+}
 
-Locate::Locate() : PE_() {}
+Locate::Locate() : PE_(), profile_localization_(false), locate_histogram_(nullptr) {}
 
-Locate::Locate(GlobalParameters& glo_p, LocalizationParameters& loc_p, CameraParameters& cam_p) : PE_() {
+Locate::Locate(GlobalParameters& glo_p, LocalizationParameters& loc_p, CameraParameters& cam_p) : PE_(), profile_localization_(false), locate_histogram_(nullptr) {
   // Object instantiation
   PE_ = new PoseEstimator(glo_p, loc_p, cam_p);
 }
@@ -135,45 +228,101 @@ void Locate::updateCameraInfo(const std::vector<float>& camera_parameters, const
 
 void Locate::locate(const cv::Mat& depth_image, const std::vector<std::vector<BoundingBox>>& bboxes,
                     std::vector<std::vector<float>>& distances, std::vector<std::vector<std::vector<float>>>& points){
-#ifdef PROFILE
-  start_distance_ = std::chrono::system_clock::now();
-#endif
+  ScopedTimer timer(locate_histogram_);
+  if (RUNTIME_OPTION(profile_localization_)) {
+    start_distance_ = std::chrono::system_clock::now();
+  }
   distances.clear();
   distances = PE_->extractDistanceFromDepth(depth_image, bboxes);
-#ifdef PROFILE
-  end_distance_ = std::chrono::system_clock::now();
-  start_position_ = std::chrono::system_clock::now();
-#endif
+  if (RUNTIME_OPTION(profile_localization_)) {
+    end_distance_ = std::chrono::system_clock::now();
+    start_position_ = end_distance_;
+  }
   points.clear();
   points = PE_->estimatePosition(distances, bboxes);
-#ifdef PROFILE
-  end_position_ = std::chrono::system_clock::now();
-#endif
+  if (RUNTIME_OPTION(profile_localization_)) {
+    end_position_ = std::chrono::system_clock::now();
+  }
 }
 
 void Locate::locate(const cv::Mat& depth_image, const std::vector<std::map<unsigned int, std::vector<float>>>& states,
                     std::vector<std::map<unsigned int, float>>& distances, std::vector<std::map<unsigned int, std::vector<float>>>& points){
-#ifdef PROFILE
-  start_distance_ = std::chrono::system_clock::now();
-#endif
+  ScopedTimer timer(locate_histogram_);
+  if (RUNTIME_OPTION(profile_localization_)) {
+    start_distance_ = std::chrono::system_clock::now();
+  }
   distances.clear();
   distances = PE_->extractDistanceFromDepth(depth_image, states);
-#ifdef PROFILE
-  end_distance_ = std::chrono::system_clock::now();
-  start_position_ = std::chrono::system_clock::now();
-#endif
+  if (RUNTIME_OPTION(profile_localization_)) {
+    end_distance_ = std::chrono::system_clock::now();
+    start_position_ = end_distance_;
+  }
   points.clear();
   points = PE_->estimatePosition(distances, states);
-#ifdef PROFILE
-  end_position_ = std::chrono::system_clock::now();
-#endif
+  if (RUNTIME_OPTION(profile_localization_)) {
+    end_position_ = std::chrono::system_clock::now();
+  }
+}
+
+/**
+ * @brief Localization stage of the pipeline.
+ * @details Estimates the position of the detected objects using the depth image of the frame.
+ *
+ * @param frame The reference to the frame.
+ * @return False if the frame has no depth image.
+ */
+bool Locate::locateFrame(PipelineFrame& frame) {
+  if (frame.depth.empty()) {
+    return false;
+  }
+  locate(frame.depth, frame.bboxes, frame.distances, frame.points);
+  return true;
+}
+
+/**
+ * @brief Localization stage of the pipeline, for tracked objects.
+ * @details Estimates the position of the tracked objects using the depth image of the frame.
+ *
+ * @param frame The reference to the frame.
+ * @return False if the frame has no depth image.
+ */
+bool Locate::locateTracksFrame(PipelineFrame& frame) {
+  if (frame.depth.empty()) {
+    return false;
+  }
+  locate(frame.depth, frame.tracker_states, frame.track_distances, frame.track_points);
+  return true;
 }
 
 void Locate::printProfilingLocalization(){
-#ifdef PROFILE
+  if (!RUNTIME_OPTION(profile_localization_)) {
+    return;
+  }
   printf(" - Distance estimation done in %ld us\n", std::chrono::duration_cast<std::chrono::microseconds>(end_distance_ - start_distance_).count());
   printf(" - Position estimation done in %ld us\n", std::chrono::duration_cast<std::chrono::microseconds>(end_position_ - start_position_).count());
-#endif
+}
+
+/**
+ * @brief Enables or disables the profiling and the debug prints of the localization.
+ * @details Both are disabled by default. The per-object prints are done by the PoseEstimator.
+ *
+ * @param profile True to time the distance and position estimation.
+ * @param debug True to print the distance of every object.
+ */
+void Locate::setLocalizationProfiling(const bool& profile, const bool& debug) {
+  profile_localization_ = profile;
+  if (PE_ != nullptr) {
+    PE_->setVerbosity(debug, profile);
+  }
+}
+
+/**
+ * @brief Sets the histogram in which the duration of the localization is recorded.
+ *
+ * @param instrumentation The pointer to the instrumentation of the node, nullptr to disable the timer.
+ */
+void Locate::setLocalizationInstrumentation(Instrumentation* instrumentation) {
+  locate_histogram_ = instrumentation != nullptr ? instrumentation->getHistogram("locate") : nullptr;
 }
 
 void Locate::make3DBoundingBoxes(const std::vector<std::vector<std::vector<float>>>& points, const std::vector<std::vector<BoundingBox>>& bboxes,
@@ -192,9 +341,11 @@ void Locate::make3DBoundingBoxes(const std::vector<std::vector<std::vector<float
   }
 }
 
-Track2D::Track2D(){}
+Track2D::Track2D() : checkpoint_writer_(nullptr), last_stamp_(-1), profile_tracking_(false), associate_histogram_(nullptr) {}
 
 Track2D::Track2D(DetectionParameters& det_p, KalmanParameters& kal_p, TrackingParameters& tra_p, BBoxRejectionParameters& bbo_p){
+  profile_tracking_ = false;
+  associate_histogram_ = nullptr;
   Q_ = kal_p.Q;
   R_ = kal_p.R;
   dist_threshold_ = tra_p.distance_thresh;
@@ -204,6 +355,7 @@ Track2D::Track2D(DetectionParameters& det_p, KalmanParameters& kal_p, TrackingPa
   use_dim_ = kal_p.use_dim;
   use_vel_ = kal_p.use_vel;
   dt_ = tra_p.dt;
+  last_stamp_ = -1;
   max_frames_to_skip_ = tra_p.max_frames_to_skip;
   min_bbox_width_ = bbo_p.min_bbox_width;
   max_bbox_width_ = bbo_p.max_bbox_width;
@@ -216,6 +368,11 @@ Track2D::Track2D(DetectionParameters& det_p, KalmanParameters& kal_p, TrackingPa
                       area_threshold_, body_ratio_, dt_, use_dim_,
                       use_vel_, Q_, R_)); 
   }
+  checkpoint_writer_ = nullptr;
+  if (!tra_p.checkpoint_path.empty()) {
+    Checkpoint::load(tra_p.checkpoint_path, tra_p.checkpoint_max_age, Trackers_);
+    checkpoint_writer_ = new CheckpointWriter(tra_p.checkpoint_path, tra_p.checkpoint_period);
+  }
 }
 
 void Track2D::buildTrack2D(DetectionParameters& det_p, KalmanParameters& kal_p, TrackingParameters& tra_p, BBoxRejectionParameters& bbo_p){
@@ -228,6 +385,7 @@ void Track2D::buildTrack2D(DetectionParameters& det_p, KalmanParameters& kal_p,
   use_dim_ = kal_p.use_dim;
   use_vel_ = kal_p.use_vel;
   dt_ = tra_p.dt;
+  last_stamp_ = -1;
   max_frames_to_skip_ = tra_p.max_frames_to_skip;
   min_bbox_width_ = bbo_p.min_bbox_width;
   max_bbox_width_ = bbo_p.max_bbox_width;
@@ -240,9 +398,15 @@ void Track2D::buildTrack2D(DetectionParameters& det_p, KalmanParameters& kal_p,
                       area_threshold_, body_ratio_, dt_, use_dim_,
                       use_vel_, Q_, R_)); 
   }
+  checkpoint_writer_ = nullptr;
+  if (!tra_p.checkpoint_path.empty()) {
+    Checkpoint::load(tra_p.checkpoint_path, tra_p.checkpoint_max_age, Trackers_);
+    checkpoint_writer_ = new CheckpointWriter(tra_p.checkpoint_path, tra_p.checkpoint_period);
+  }
 }
 
 Track2D::~Track2D() {
+  delete checkpoint_writer_;
   Trackers_.clear();
 }
   
@@ -252,9 +416,9 @@ void Track2D::cast2states(std::vector<std::vector<std::vector<float>>>& states,
   std::vector<std::vector<float>> state_vec;
   std::vector<float> state(6);
 
-  for (unsigned int i; i < bboxes.size(); i++) {
+  for (unsigned int i=0; i < bboxes.size(); i++) {
     state_vec.clear();
-    for (unsigned int j; j < bboxes[i].size(); j++) {
+    for (unsigned int j=0; j < bboxes[i].size(); j++) {
       if (!bboxes[i][j].valid_) {
         continue;
       }
@@ -285,59 +449,137 @@ void Track2D::cast2states(std::vector<std::vector<std::vector<float>>>& states,
 
 void Track2D::track(const std::vector<std::vector<BoundingBox>>& bboxes,
                std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states) {
-#ifdef PROFILE
-  start_tracking_ = std::chrono::system_clock::now();
-#endif 
+  ScopedTimer timer(associate_histogram_);
+  if (RUNTIME_OPTION(profile_tracking_)) {
+    start_tracking_ = std::chrono::system_clock::now();
+  }
   std::vector<std::vector<std::vector<float>>> states;
   cast2states(states, bboxes);
   for (unsigned int i=0; i < tracker_states.size(); i++){
-    std::vector<std::vector<float>> states_to_track;
-    states_to_track = states[i];
-    Trackers_[i]->update(dt_, states_to_track);
+    // The observations are passed as is, the trackers do not modify them.
+    Trackers_[i]->update(dt_, states[i]);
+    tracker_states[i].clear();
     Trackers_[i]->getStates(tracker_states[i]);
+    Trackers_[i]->publishSnapshot(tracker_states[i]);
+  }
+  if (checkpoint_writer_ != nullptr) {
+    checkpoint_writer_->submit(Trackers_);
+  }
+  if (RUNTIME_OPTION(profile_tracking_)) {
+    end_tracking_ = std::chrono::system_clock::now();
   }
-#ifdef PROFILE
-  end_tracking_ = std::chrono::system_clock::now();
-#endif
 }
 
 void Track2D::track(const std::vector<std::vector<BoundingBox>>& bboxes,
                std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states, const float& dt) {
-#ifdef PROFILE
-  start_tracking_ = std::chrono::system_clock::now();
-#endif 
+  ScopedTimer timer(associate_histogram_);
+  if (RUNTIME_OPTION(profile_tracking_)) {
+    start_tracking_ = std::chrono::system_clock::now();
+  }
   std::vector<std::vector<std::vector<float>>> states;
   cast2states(states, bboxes);
   for (unsigned int i=0; i < tracker_states.size(); i++){
-    std::vector<std::vector<float>> states_to_track;
-    states_to_track = states[i];
-    Trackers_[i]->update(dt, states_to_track);
+    // The observations are passed as is, the trackers do not modify them.
+    Trackers_[i]->update(dt, states[i]);
+    tracker_states[i].clear();
     Trackers_[i]->getStates(tracker_states[i]);
+    Trackers_[i]->publishSnapshot(tracker_states[i]);
+  }
+  if (checkpoint_writer_ != nullptr) {
+    checkpoint_writer_->submit(Trackers_);
+  }
+  if (RUNTIME_OPTION(profile_tracking_)) {
+    end_tracking_ = std::chrono::system_clock::now();
   }
-#ifdef PROFILE
-  end_tracking_ = std::chrono::system_clock::now();
-#endif
 }
 
-void Track2D::generateTrackingImage(cv::Mat& image, const std::vector<std::map<unsigned int, std::vector<float>>> tracker_states) {
+/**
+ * @brief Tracking stage of the pipeline.
+ * @details Tracks the 2D bounding boxes of the frame. The time step of the filters is taken from the
+ * acquisition time of the frames, so that the frames dropped upstream are accounted for.
+ * The first frame uses the dt parameter. The changes made by the update, and the snapshots
+ * of the trackers, are stored in the frame so that the later stages never touch the trackers.
+ *
+ * @param frame The reference to the frame.
+ * @return Always true.
+ */
+bool Track2D::trackFrame(PipelineFrame& frame) {
+  float dt = dt_;
+  if ((last_stamp_ >= 0) && (frame.stamps.stamp > last_stamp_)) {
+    dt = (float) ((frame.stamps.stamp - last_stamp_) * 1e-9);
+  }
+  last_stamp_ = frame.stamps.stamp;
+  frame.tracker_states.resize(Trackers_.size());
+  track(frame.bboxes, frame.tracker_states, dt);
+  getDeltas(frame.deltas);
+  getSnapshots(frame.snapshots);
+  return true;
+}
+
+/**
+ * @brief Draws the tracks on an image.
+ * 
+ * @param image The reference to the image to draw on.
+ * @param tracker_states The reference to the states of the tracks.
+ * @param scale The reference to the ratio in between the size of the image and the size of the image the objects were tracked in.
+ */
+void Track2D::generateTrackingImage(cv::Mat& image, const std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states, const float& scale) {
   for (unsigned int i=0; i < tracker_states.size(); i++) {
     for (auto & element : tracker_states[i]) {
-      cv::Rect rect(element.second[0] - element.second[4]/2, element.second[1]-element.second[5]/2, element.second[4], element.second[5]);
+      const float x_min = (element.second[0] - element.second[4]/2) * scale;
+      const float y_min = (element.second[1] - element.second[5]/2) * scale;
+      cv::Rect rect(x_min, y_min, element.second[4] * scale, element.second[5] * scale);
       cv::rectangle(image, rect, ColorPalette[element.first % 24], 3);
-      cv::putText(image, class_map_[i]+" "+std::to_string(element.first), cv::Point(element.second[0]-element.second[4]/2,element.second[1]-element.second[5]/2-10), cv::FONT_HERSHEY_SIMPLEX, 0.9, ColorPalette[element.first % 24], 2);
+      cv::putText(image, class_map_[i]+" "+std::to_string(element.first), cv::Point(x_min, y_min - 10), cv::FONT_HERSHEY_SIMPLEX, 0.9 * scale, ColorPalette[element.first % 24], 2);
     }
   }
 }
 
 void Track2D::printProfilingTracking(){
-#ifdef PROFILE
+  if (!RUNTIME_OPTION(profile_tracking_)) {
+    return;
+  }
   printf(" - Tracking done in %ld us\n", std::chrono::duration_cast<std::chrono::microseconds>(end_tracking_ - start_tracking_).count());
-#endif
 }
 
-Track3D::Track3D(){}
+/**
+ * @brief Enables or disables the profiling of the tracking.
+ * @details Disabled by default. When disabled, the clock is never read.
+ *
+ * @param profile True to time the update of the trackers.
+ */
+void Track2D::setTrackingProfiling(const bool& profile) {
+  profile_tracking_ = profile;
+}
+
+/**
+ * @brief Sets the histogram in which the duration of the update of the trackers is recorded.
+ *
+ * @param instrumentation The pointer to the instrumentation of the node, nullptr to disable the timer.
+ */
+void Track2D::setTrackingInstrumentation(Instrumentation* instrumentation) {
+  associate_histogram_ = instrumentation != nullptr ? instrumentation->getHistogram("associate") : nullptr;
+}
+
+void Track2D::getDeltas(std::vector<TrackDelta>& deltas) const {
+  deltas.resize(Trackers_.size());
+  for (unsigned int i=0; i < Trackers_.size(); i++) {
+    Trackers_[i]->getDelta(deltas[i]);
+  }
+}
+
+void Track2D::getSnapshots(std::vector<std::shared_ptr<const TrackSnapshot>>& snapshots) const {
+  snapshots.resize(Trackers_.size());
+  for (unsigned int i=0; i < Trackers_.size(); i++) {
+    snapshots[i] = Trackers_[i]->getSnapshot();
+  }
+}
+
+Track3D::Track3D() : checkpoint_writer_(nullptr), last_stamp_(-1), profile_tracking_(false), associate_histogram_(nullptr) {}
 
 Track3D::Track3D(DetectionParameters& det_p, KalmanParameters& kal_p, TrackingParameters& tra_p, BBoxRejectionParameters& bbo_p){
+  profile_tracking_ = false;
+  associate_histogram_ = nullptr;
   Q_ = kal_p.Q;
   R_ = kal_p.R;
   dist_threshold_ = tra_p.distance_thresh;
@@ -347,6 +589,7 @@ Track3D::Track3D(DetectionParameters& det_p, KalmanParameters& kal_p, TrackingPa
   use_dim_ = kal_p.use_dim;
   use_vel_ = kal_p.use_vel;
   dt_ = tra_p.dt;
+  last_stamp_ = -1;
   max_frames_to_skip_ = tra_p.max_frames_to_skip;
   min_bbox_width_ = bbo_p.min_bbox_width;
   max_bbox_width_ = bbo_p.max_bbox_width;
@@ -354,10 +597,30 @@ Track3D::Track3D(DetectionParameters& det_p, KalmanParameters& kal_p, TrackingPa
   max_bbox_height_ = bbo_p.max_bbox_width;
   class_map_ = det_p.class_map;
 
+  static_objects_ = tra_p.static_objects;
+  voxel_size_ = tra_p.voxel_size;
+  use_frustum_ = tra_p.use_frustum;
+  frustum_ = Frustum(tra_p.frustum_min_depth, tra_p.frustum_max_depth, tra_p.frustum_margin);
+
   for (unsigned int i=0; i<det_p.num_classes; i++){ // Create as many trackers as their are classes
-    Trackers_.push_back(new Tracker3D(max_frames_to_skip_, dist_threshold_, center_threshold_,
-                      area_threshold_, body_ratio_, dt_, use_dim_,
-                      use_vel_, Q_, R_)); 
+    if (static_objects_) {
+      Trackers_.push_back(new Tracker3DF(max_frames_to_skip_, dist_threshold_, center_threshold_,
+                        area_threshold_, body_ratio_, dt_, use_dim_,
+                        use_vel_, Q_, R_, voxel_size_));
+    } else {
+      Tracker3D* tracker = new Tracker3D(max_frames_to_skip_, dist_threshold_, center_threshold_,
+                        area_threshold_, body_ratio_, dt_, use_dim_,
+                        use_vel_, Q_, R_);
+      if (use_frustum_) {
+        tracker->setFrustum(&frustum_);
+      }
+      Trackers_.push_back(tracker); 
+    }
+  }
+  checkpoint_writer_ = nullptr;
+  if (!tra_p.checkpoint_path.empty()) {
+    Checkpoint::load(tra_p.checkpoint_path, tra_p.checkpoint_max_age, Trackers_);
+    checkpoint_writer_ = new CheckpointWriter(tra_p.checkpoint_path, tra_p.checkpoint_period);
   }
 }
 
@@ -371,6 +634,7 @@ void Track3D::buildTrack3D(DetectionParameters& det_p, KalmanParameters& kal_p,
   use_dim_ = kal_p.use_dim;
   use_vel_ = kal_p.use_vel;
   dt_ = tra_p.dt;
+  last_stamp_ = -1;
   max_frames_to_skip_ = tra_p.max_frames_to_skip;
   min_bbox_width_ = bbo_p.min_bbox_width;
   max_bbox_width_ = bbo_p.max_bbox_width;
@@ -378,25 +642,46 @@ void Track3D::buildTrack3D(DetectionParameters& det_p, KalmanParameters& kal_p,
   max_bbox_height_ = bbo_p.max_bbox_width;
   class_map_ = det_p.class_map;
 
+  static_objects_ = tra_p.static_objects;
+  voxel_size_ = tra_p.voxel_size;
+  use_frustum_ = tra_p.use_frustum;
+  frustum_ = Frustum(tra_p.frustum_min_depth, tra_p.frustum_max_depth, tra_p.frustum_margin);
+
   for (unsigned int i=0; i<det_p.num_classes; i++){ // Create as many trackers as their are classes
-    Trackers_.push_back(new Tracker3D(max_frames_to_skip_, dist_threshold_, center_threshold_,
-                      area_threshold_, body_ratio_, dt_, use_dim_,
-                      use_vel_, Q_, R_)); 
+    if (static_objects_) {
+      Trackers_.push_back(new Tracker3DF(max_frames_to_skip_, dist_threshold_, center_threshold_,
+                        area_threshold_, body_ratio_, dt_, use_dim_,
+                        use_vel_, Q_, R_, voxel_size_));
+    } else {
+      Tracker3D* tracker = new Tracker3D(max_frames_to_skip_, dist_threshold_, center_threshold_,
+                        area_threshold_, body_ratio_, dt_, use_dim_,
+                        use_vel_, Q_, R_);
+      if (use_frustum_) {
+        tracker->setFrustum(&frustum_);
+      }
+      Trackers_.push_back(tracker); 
+    }
+  }
+  checkpoint_writer_ = nullptr;
+  if (!tra_p.checkpoint_path.empty()) {
+    Checkpoint::load(tra_p.checkpoint_path, tra_p.checkpoint_max_age, Trackers_);
+    checkpoint_writer_ = new CheckpointWriter(tra_p.checkpoint_path, tra_p.checkpoint_period);
   }
 }
 
 Track3D::~Track3D() {
+  delete checkpoint_writer_;
   Trackers_.clear();
 } 
 
 void Track3D::cast2states(std::vector<std::vector<std::vector<float>>>& states, const std::vector<std::vector<BoundingBox3D>>& bboxes) {
   states.clear();
   std::vector<std::vector<float>> state_vec;
-  std::vector<float> state(6);
+  std::vector<float> state(9);
 
-  for (unsigned int i; i < bboxes.size(); i++) {
+  for (unsigned int i=0; i < bboxes.size(); i++) {
     state_vec.clear();
-    for (unsigned int j; j < bboxes[i].size(); j++) {
+    for (unsigned int j=0; j < bboxes[i].size(); j++) {
       if (!bboxes[i][j].valid_) {
         continue;
       }
@@ -431,73 +716,355 @@ void Track3D::cast2states(std::vector<std::vector<std::vector<float>>>& states,
 
 void Track3D::track(const std::vector<std::vector<BoundingBox3D>>& bboxes,
                std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states) {
-#ifdef PROFILE
-  start_tracking_ = std::chrono::system_clock::now();
-#endif 
+  ScopedTimer timer(associate_histogram_);
+  if (RUNTIME_OPTION(profile_tracking_)) {
+    start_tracking_ = std::chrono::system_clock::now();
+  }
   std::vector<std::vector<std::vector<float>>> states;
   cast2states(states, bboxes);
   for (unsigned int i=0; i < tracker_states.size(); i++){
-    std::vector<std::vector<float>> states_to_track;
-    states_to_track = states[i];
-    Trackers_[i]->update(dt_, states_to_track);
+    // The observations are passed as is, the trackers do not modify them.
+    Trackers_[i]->update(dt_, states[i]);
+    tracker_states[i].clear();
     Trackers_[i]->getStates(tracker_states[i]);
+    Trackers_[i]->publishSnapshot(tracker_states[i]);
+  }
+  if (checkpoint_writer_ != nullptr) {
+    checkpoint_writer_->submit(Trackers_);
+  }
+  if (RUNTIME_OPTION(profile_tracking_)) {
+    end_tracking_ = std::chrono::system_clock::now();
   }
-#ifdef PROFILE
-  end_tracking_ = std::chrono::system_clock::now();
-#endif
 }
 
 void Track3D::track(const std::vector<std::vector<BoundingBox3D>>& bboxes,
                std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states, const float& dt) {
-#ifdef PROFILE
-  start_tracking_ = std::chrono::system_clock::now();
-#endif 
+  ScopedTimer timer(associate_histogram_);
+  if (RUNTIME_OPTION(profile_tracking_)) {
+    start_tracking_ = std::chrono::system_clock::now();
+  }
   std::vector<std::vector<std::vector<float>>> states;
   cast2states(states, bboxes);
   for (unsigned int i=0; i < tracker_states.size(); i++){
-    std::vector<std::vector<float>> states_to_track;
-    states_to_track = states[i];
-    Trackers_[i]->update(dt, states_to_track);
+    // The observations are passed as is, the trackers do not modify them.
+    Trackers_[i]->update(dt, states[i]);
+    tracker_states[i].clear();
     Trackers_[i]->getStates(tracker_states[i]);
+    Trackers_[i]->publishSnapshot(tracker_states[i]);
   }
-#ifdef PROFILE
-  end_tracking_ = std::chrono::system_clock::now();
-#endif
+  if (checkpoint_writer_ != nullptr) {
+    checkpoint_writer_->submit(Trackers_);
+  }
+  if (RUNTIME_OPTION(profile_tracking_)) {
+    end_tracking_ = std::chrono::system_clock::now();
+  }
+}
+
+/**
+ * @brief Tracking stage of the pipeline.
+ * @details Tracks the 3D bounding boxes of the frame. The time step of the filters is taken from the
+ * acquisition time of the frames, so that the frames dropped upstream are accounted for.
+ * The first frame uses the dt parameter. The changes made by the update, and the snapshots
+ * of the trackers, are stored in the frame so that the later stages never touch the trackers.
+ *
+ * @param frame The reference to the frame.
+ * @return Always true.
+ */
+bool Track3D::trackFrame(PipelineFrame& frame) {
+  float dt = dt_;
+  if ((last_stamp_ >= 0) && (frame.stamps.stamp > last_stamp_)) {
+    dt = (float) ((frame.stamps.stamp - last_stamp_) * 1e-9);
+  }
+  last_stamp_ = frame.stamps.stamp;
+  frame.tracker_states.resize(Trackers_.size());
+  track(frame.bboxes3D, frame.tracker_states, dt);
+  getDeltas(frame.deltas);
+  getSnapshots(frame.snapshots);
+  return true;
 }
 
-void Track3D::generateTrackingImage(cv::Mat& image, const std::vector<std::map<unsigned int, std::vector<float>>> tracker_states) {
+/**
+ * @brief Draws the tracks on an image.
+ * 
+ * @param image The reference to the image to draw on.
+ * @param tracker_states The reference to the states of the tracks.
+ * @param scale The reference to the ratio in between the size of the image and the size of the image the objects were tracked in.
+ */
+void Track3D::generateTrackingImage(cv::Mat& image, const std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states, const float& scale) {
   for (unsigned int i=0; i < tracker_states.size(); i++) {
     for (auto & element : tracker_states[i]) {
-      cv::Rect rect(element.second[0] - element.second[4]/2, element.second[1]-element.second[5]/2, element.second[4], element.second[5]);
+      const float x_min = (element.second[0] - element.second[4]/2) * scale;
+      const float y_min = (element.second[1] - element.second[5]/2) * scale;
+      cv::Rect rect(x_min, y_min, element.second[4] * scale, element.second[5] * scale);
       cv::rectangle(image, rect, ColorPalette[element.first % 24], 3);
-      cv::putText(image, class_map_[i]+" "+std::to_string(element.first), cv::Point(element.second[0]-element.second[4]/2,element.second[1]-element.second[5]/2-10), cv::FONT_HERSHEY_SIMPLEX, 0.9, ColorPalette[element.first % 24], 2);
+      cv::putText(image, class_map_[i]+" "+std::to_string(element.first), cv::Point(x_min, y_min - 10), cv::FONT_HERSHEY_SIMPLEX, 0.9 * scale, ColorPalette[element.first % 24], 2);
     }
   }
 }
 
 void Track3D::printProfilingTracking(){
-#ifdef PROFILE
+  if (!RUNTIME_OPTION(profile_tracking_)) {
+    return;
+  }
   printf(" - Tracking done in %ld us\n", std::chrono::duration_cast<std::chrono::microseconds>(end_tracking_ - start_tracking_).count());
-#endif
+}
+
+/**
+ * @brief Enables or disables the profiling of the tracking.
+ * @details Disabled by default. When disabled, the clock is never read.
+ *
+ * @param profile True to time the update of the trackers.
+ */
+void Track3D::setTrackingProfiling(const bool& profile) {
+  profile_tracking_ = profile;
+}
+
+/**
+ * @brief Sets the histogram in which the duration of the update of the trackers is recorded.
+ *
+ * @param instrumentation The pointer to the instrumentation of the node, nullptr to disable the timer.
+ */
+void Track3D::setTrackingInstrumentation(Instrumentation* instrumentation) {
+  associate_histogram_ = instrumentation != nullptr ? instrumentation->getHistogram("associate") : nullptr;
+}
+
+void Track3D::getDeltas(std::vector<TrackDelta>& deltas) const {
+  deltas.resize(Trackers_.size());
+  for (unsigned int i=0; i < Trackers_.size(); i++) {
+    Trackers_[i]->getDelta(deltas[i]);
+  }
+}
+
+void Track3D::getSnapshots(std::vector<std::shared_ptr<const TrackSnapshot>>& snapshots) const {
+  snapshots.resize(Trackers_.size());
+  for (unsigned int i=0; i < Trackers_.size(); i++) {
+    snapshots[i] = Trackers_[i]->getSnapshot();
+  }
+}
+
+void Track3D::setCameraIntrinsics(const float& fx, const float& fy, const float& cx, const float& cy,
+                                  const int& image_width, const int& image_height) {
+  frustum_.setIntrinsics(fx, fy, cx, cy, image_width, image_height);
+}
+
+void Track3D::setCameraPose(const std::vector<float>& position, const std::vector<float>& orientation) {
+  frustum_.setPose(position, orientation);
+}
+
+void Track3D::invalidateCameraPose() {
+  frustum_.invalidate();
 }
 
 DetectAndLocate::DetectAndLocate() : Detect(), Locate(){}
 DetectAndLocate::DetectAndLocate(GlobalParameters& glo_p, DetectionParameters& det_p, NMSParameters& nms_p,
       LocalizationParameters& loc_p, CameraParameters& cam_p) : Detect(glo_p, det_p, nms_p), Locate(glo_p, loc_p, cam_p){}
-void DetectAndLocate::applyOnFolder(std::string, std::string, bool, bool, bool) {}
-void DetectAndLocate::applyOnVideo(std::string, std::string, bool, bool, bool) {}
 
 DetectAndTrack2D::DetectAndTrack2D() : Detect(), Track2D(){}
 DetectAndTrack2D::DetectAndTrack2D(GlobalParameters& glo_p, DetectionParameters& det_p, NMSParameters& nms_p,
       KalmanParameters& kal_p, TrackingParameters& tra_p, BBoxRejectionParameters& bbo_p) : Detect(glo_p,
       det_p, nms_p), Track2D(det_p, kal_p, tra_p, bbo_p){}
-void DetectAndTrack2D::applyOnFolder(std::string, std::string, bool, bool, bool) {}
-void DetectAndTrack2D::applyOnVideo(std::string, std::string, bool, bool, bool) {}
 
 DetectTrack2DAndLocate::DetectTrack2DAndLocate() : Detect(), Track2D(), Locate(){}
 DetectTrack2DAndLocate::DetectTrack2DAndLocate(GlobalParameters& glo_p, DetectionParameters& det_p,
       NMSParameters& nms_p, KalmanParameters& kal_p, TrackingParameters& tra_p, BBoxRejectionParameters& bbo_p, 
       LocalizationParameters& loc_p, CameraParameters& cam_p) : Detect(glo_p, det_p, nms_p), Track2D(det_p, kal_p, 
       tra_p, bbo_p), Locate(glo_p, loc_p, cam_p){}
-void DetectTrack2DAndLocate::applyOnFolder(std::string, std::string, bool, bool, bool) {}
-void DetectTrack2DAndLocate::applyOnVideo(std::string, std::string, bool, bool, bool) {}
\ No newline at end of file
+
+DetectAndTrack3D::DetectAndTrack3D() : Detect(), Locate(), Track3D(){}
+DetectAndTrack3D::DetectAndTrack3D(GlobalParameters& glo_p, DetectionParameters& det_p,
+      NMSParameters& nms_p, KalmanParameters& kal_p, TrackingParameters& tra_p, BBoxRejectionParameters& bbo_p,
+      LocalizationParameters& loc_p, CameraParameters& cam_p) : Detect(glo_p, det_p, nms_p), Locate(glo_p, loc_p, cam_p),
+      Track3D(det_p, kal_p, tra_p, bbo_p){}
+
+/**
+ * @brief Default constructor.
+ * @details Creates no ring buffers, nothing is exported.
+ *
+ */
+SharedMemoryExporter::SharedMemoryExporter() : export_images_(false), dropped_images_(0), dropped_tracks_(0) {}
+
+/**
+ * @brief Creates the shared-memory ring buffers.
+ *
+ * @param name The reference to the prefix of the segments, it must start with a "/".
+ * @param slots The reference to the number of frames kept in each ring.
+ * @param image_rows The reference to the maximum height of the images.
+ * @param image_cols The reference to the maximum width of the images.
+ * @param export_images The reference to the flag enabling the export of the images.
+ */
+SharedMemoryExporter::SharedMemoryExporter(const std::string& name, const unsigned int& slots, const int& image_rows,
+                                           const int& image_cols, const bool& export_images) :
+                                           dropped_images_(0), dropped_tracks_(0) {
+  export_images_ = export_images;
+  if (export_images_) {
+    frames_.create(name + "_frames", slots, sizeof(SharedImageHeader) + (uint64_t) image_rows * image_cols * 3);
+  }
+  detections_.create(name + "_detections", slots, sizeof(uint64_t) + SHARED_MEMORY_MAX_OBJECTS * sizeof(SharedDetection));
+  tracks_.create(name + "_tracks", slots, sizeof(uint64_t) + SHARED_MEMORY_MAX_OBJECTS * (sizeof(SharedTrackHeader) + SHARED_MEMORY_MAX_STATE * sizeof(float)));
+}
+
+/**
+ * @brief Destructor.
+ * @details The ring buffers are unmapped by their writers.
+ *
+ */
+SharedMemoryExporter::~SharedMemoryExporter() {}
+
+/**
+ * @brief Checks if the ring buffers were created.
+ *
+ * @return True if the detections and the tracks can be exported.
+ */
+bool SharedMemoryExporter::isOpen() const {
+  return detections_.isOpen() && tracks_.isOpen();
+}
+
+/**
+ * @brief Exports a frame.
+ * @details Must be called before anything is drawn on the image.
+ *
+ * @param frame The reference to the frame.
+ */
+void SharedMemoryExporter::write(const PipelineFrame& frame) {
+  const int64_t stamp = frame.stamps.stamp;
+  if (export_images_ && !frame.image.empty()) {
+    writeImage(frame.image, stamp);
+  }
+  writeDetections(frame.bboxes, stamp);
+  if (!frame.snapshots.empty() || !frame.tracker_states.empty()) {
+    writeTracks(frame, stamp);
+  }
+}
+
+/**
+ * @brief Exports an image.
+ * @details The images larger than a slot are not exported, they are counted and reported by reportDrops.
+ *
+ * @param image The reference to the image.
+ * @param stamp The reference to the acquisition time of the image.
+ */
+void SharedMemoryExporter::writeImage(const cv::Mat& image, const int64_t& stamp) {
+  const int step = image.cols * image.elemSize();
+  char* data = frames_.beginWrite(sizeof(SharedImageHeader) + image.rows * step);
+  if (data == nullptr) {
+    dropped_images_ ++;
+    reportDrops();
+    return;
+  }
+  SharedImageHeader header{image.rows, image.cols, image.type(), step};
+  memcpy(data, &header, sizeof(SharedImageHeader));
+  data += sizeof(SharedImageHeader);
+  if (image.isContinuous()) {
+    memcpy(data, image.data, image.rows * step);
+  } else {
+    for (int i = 0; i < image.rows; i++) {
+      memcpy(data + i * step, image.ptr(i), step);
+    }
+  }
+  frames_.commitWrite(SHARED_MEMORY_IMAGE, stamp);
+}
+
+/**
+ * @brief Exports the detections.
+ * @details Only the valid detections are exported, up to SHARED_MEMORY_MAX_OBJECTS.
+ *
+ * @param bboxes The reference to the bounding boxes, per class.
+ * @param stamp The reference to the acquisition time of the image.
+ */
+void SharedMemoryExporter::writeDetections(const std::vector<std::vector<BoundingBox>>& bboxes, const int64_t& stamp) {
+  uint64_t count = 0;
+  for (unsigned int i = 0; i < bboxes.size(); i++) {
+    for (unsigned int j = 0; j < bboxes[i].size(); j++) {
+      count += bboxes[i][j].valid_;
+    }
+  }
+  count = std::min(count, (uint64_t) SHARED_MEMORY_MAX_OBJECTS);
+  char* data = detections_.beginWrite(sizeof(uint64_t) + count * sizeof(SharedDetection));
+  if (data == nullptr) {
+    return;
+  }
+  memcpy(data, &count, sizeof(uint64_t));
+  SharedDetection* detections = reinterpret_cast<SharedDetection*>(data + sizeof(uint64_t));
+  uint64_t k = 0;
+  for (unsigned int i = 0; i < bboxes.size(); i++) {
+    for (unsigned int j = 0; (j < bboxes[i].size()) && (k < count); j++) {
+      const BoundingBox& bbox = bboxes[i][j];
+      if (bbox.valid_) {
+        detections[k] = SharedDetection{i, bbox.x_min_, bbox.y_min_, bbox.w_, bbox.h_, bbox.confidence_};
+        k++;
+      }
+    }
+  }
+  detections_.commitWrite(SHARED_MEMORY_DETECTIONS, stamp);
+}
+
+/**
+ * @brief Exports the tracks.
+ * @details The frames with more tracks than a slot can hold are not exported, they are counted and
+ * reported by reportDrops.
+ *
+ * @param frame The reference to the frame.
+ * @param stamp The reference to the acquisition time of the image.
+ */
+void SharedMemoryExporter::writeTracks(const PipelineFrame& frame, const int64_t& stamp) {
+  // The snapshots hold the states of all the tracks, the tracker states only the ones matched in this frame.
+  std::vector<const std::map<unsigned int, std::vector<float>>*> states;
+  if (!frame.snapshots.empty()) {
+    for (unsigned int i = 0; i < frame.snapshots.size(); i++) {
+      states.push_back(frame.snapshots[i] ? &(frame.snapshots[i]->states) : nullptr);
+    }
+  } else {
+    for (unsigned int i = 0; i < frame.tracker_states.size(); i++) {
+      states.push_back(&(frame.tracker_states[i]));
+    }
+  }
+  uint64_t count = 0;
+  uint64_t size = sizeof(uint64_t);
+  for (unsigned int i = 0; i < states.size(); i++) {
+    if (states[i] == nullptr) {
+      continue;
+    }
+    for (auto & element : *(states[i])) {
+      count++;
+      size += sizeof(SharedTrackHeader) + std::min(element.second.size(), (size_t) SHARED_MEMORY_MAX_STATE) * sizeof(float);
+    }
+  }
+  char* data = tracks_.beginWrite(size);
+  if (data == nullptr) {
+    dropped_tracks_ ++;
+    reportDrops();
+    return;
+  }
+  memcpy(data, &count, sizeof(uint64_t));
+  data += sizeof(uint64_t);
+  for (unsigned int i = 0; i < states.size(); i++) {
+    if (states[i] == nullptr) {
+      continue;
+    }
+    for (auto & element : *(states[i])) {
+      const uint32_t state_size = std::min(element.second.size(), (size_t) SHARED_MEMORY_MAX_STATE);
+      SharedTrackHeader header{i, element.first, state_size, 0};
+      memcpy(data, &header, sizeof(SharedTrackHeader));
+      data += sizeof(SharedTrackHeader);
+      memcpy(data, element.second.data(), state_size * sizeof(float));
+      data += state_size * sizeof(float);
+    }
+  }
+  tracks_.commitWrite(SHARED_MEMORY_TRACKS, stamp);
+}
+
+/**
+ * @brief Reports the frames that were not exported.
+ * @details Prints the number of images and of track records dropped since the export started,
+ * at most once per second, such that an oversized stream does not flood the console.
+ *
+ */
+void SharedMemoryExporter::reportDrops() {
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now - last_drop_report_ < std::chrono::seconds(1)) {
+    return;
+  }
+  last_drop_report_ = now;
+  printf("[WARN  ] SharedMemoryExporter::%s::l%d %lu images larger than a slot, and %lu frames with too many tracks, were not exported.\n",
+         __func__, __LINE__, (unsigned long) dropped_images_, (unsigned long) dropped_tracks_);
+}
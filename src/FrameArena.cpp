@@ -0,0 +1,133 @@
+/**
+ * @file FrameArena.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The frame arena.
+ * @details This file implements a monotonic memory resource, reset after each frame, from which the
+ * temporaries of the stages of the pipeline are allocated through std::pmr containers.
+ */
+
+#include <detect_and_track/FrameArena.h>
+
+// The arena of the calling thread, nullptr outside of the stages of the pipeline.
+static thread_local FrameArena* current_arena = nullptr;
+
+/**
+ * @brief Construct a new FrameArena object, and allocates its buffer.
+ *
+ * @param capacity The reference to the size of the buffer, in bytes.
+ */
+FrameArena::FrameArena(const size_t& capacity) {
+  capacity_ = capacity;
+  buffer_.reset(new char[capacity_]);
+  used_ = 0;
+  upstream_ = std::pmr::new_delete_resource();
+  high_water_.store(0, std::memory_order_relaxed);
+  overflow_.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Allocates memory from the buffer, or from the heap if the buffer is full.
+ *
+ * @param bytes The number of bytes.
+ * @param alignment The alignment of the memory.
+ * @return The pointer to the memory.
+ */
+void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+  const uintptr_t base = reinterpret_cast<uintptr_t>(buffer_.get());
+  const uintptr_t start = (base + used_ + alignment - 1) & ~(uintptr_t) (alignment - 1);
+  if (start + bytes > base + capacity_) {
+    overflow_.fetch_add(1, std::memory_order_relaxed);
+    return upstream_->allocate(bytes, alignment);
+  }
+  used_ = start + bytes - base;
+  if (used_ > high_water_.load(std::memory_order_relaxed)) {
+    high_water_.store(used_, std::memory_order_relaxed);
+  }
+  return reinterpret_cast<void*>(start);
+}
+
+/**
+ * @brief Releases memory. The memory of the buffer is only given back if it is the last allocation.
+ *
+ * @param pointer The pointer to the memory.
+ * @param bytes The number of bytes.
+ * @param alignment The alignment of the memory.
+ */
+void FrameArena::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+  char* memory = static_cast<char*>(pointer);
+  if ((memory < buffer_.get()) || (memory >= buffer_.get() + capacity_)) {
+    upstream_->deallocate(pointer, bytes, alignment);
+    return;
+  }
+  if (memory + bytes == buffer_.get() + used_) {
+    used_ = memory - buffer_.get();
+  }
+}
+
+/**
+ * @brief Checks if the memory allocated by another resource can be released by this one.
+ *
+ * @param other The reference to the other resource.
+ * @return True if it is the same arena.
+ */
+bool FrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+  return this == &other;
+}
+
+/**
+ * @brief Releases all the memory of the buffer, at the end of a frame.
+ *
+ */
+void FrameArena::reset() {
+  used_ = 0;
+}
+
+size_t FrameArena::getCapacity() const {
+  return capacity_;
+}
+
+/**
+ * @brief Returns the largest amount of memory used by a frame since the arena was created.
+ *
+ * @return The high-water mark, in bytes.
+ */
+uint64_t FrameArena::getHighWaterMark() const {
+  return high_water_.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the number of allocations that did not fit in the buffer, and were made on the heap.
+ *
+ * @return The number of overflows since the arena was created.
+ */
+uint64_t FrameArena::getOverflowCount() const {
+  return overflow_.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sets the arena of the calling thread.
+ *
+ * @param arena The pointer to the arena, nullptr to allocate the temporaries on the heap.
+ * @return The pointer to the previous arena of the thread.
+ */
+FrameArena* FrameArena::setCurrent(FrameArena* arena) {
+  FrameArena* previous = current_arena;
+  current_arena = arena;
+  return previous;
+}
+
+/**
+ * @brief Returns the memory resource the temporaries of the calling thread should be allocated from.
+ *
+ * @return The arena of the thread, or the heap if the thread has none.
+ */
+std::pmr::memory_resource* FrameArena::getResource() {
+  if (current_arena != nullptr) {
+    return current_arena;
+  }
+  return std::pmr::new_delete_resource();
+}
@@ -0,0 +1,153 @@
+/**
+ * @file Frustum.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The source code of the camera frustum class.
+ * @details This file implements a simple pin-hole frustum used to check if a point is seen by the camera,
+ * and the rigid transforms used to move the positions of the objects from the camera to the global frame.
+ */
+
+#include <detect_and_track/Frustum.h>
+
+/**
+ * @brief Default constructor.
+ * @details Default constructor. Points between 0.1 and 20 meters, with no pixel margin, are considered.
+ *
+ */
+Frustum::Frustum() : Frustum(0.1, 20.0, 0.0) {}
+
+/**
+ * @brief Prefered constructor.
+ * @details Prefered constructor.
+ *
+ * @param min_depth The minimum depth, in meters, at which a point is considered visible.
+ * @param max_depth The maximum depth, in meters, at which a point is considered visible.
+ * @param margin The margin, in pixels, added around the image. A positive margin keeps the objects
+ * partially outside of the image in the frustum.
+ */
+Frustum::Frustum(const float& min_depth, const float& max_depth, const float& margin) {
+  min_depth_ = min_depth;
+  max_depth_ = max_depth;
+  margin_ = margin;
+  R_ = Eigen::Matrix3f::Identity();
+  t_ = Eigen::Vector3f::Zero();
+  has_intrinsics_ = false;
+  has_pose_ = false;
+}
+
+/**
+ * @brief Sets the intrinsics of the camera.
+ * @details Sets the intrinsics of the camera, using a pin-hole model.
+ *
+ * @param fx The reference to the focal length along the x axis, in pixels.
+ * @param fy The reference to the focal length along the y axis, in pixels.
+ * @param cx The reference to the optical center along the x axis, in pixels.
+ * @param cy The reference to the optical center along the y axis, in pixels.
+ * @param image_width The reference to the width of the image.
+ * @param image_height The reference to the height of the image.
+ */
+void Frustum::setIntrinsics(const float& fx, const float& fy, const float& cx, const float& cy,
+                            const int& image_width, const int& image_height) {
+  fx_ = fx;
+  fy_ = fy;
+  cx_ = cx;
+  cy_ = cy;
+  image_width_ = image_width;
+  image_height_ = image_height;
+  has_intrinsics_ = true;
+}
+
+/**
+ * @brief Sets the pose of the camera.
+ * @details Sets the pose of the camera in the global frame. The inverse transform is stored,
+ * so that the points can be moved to the camera frame with a single product.
+ *
+ * @param position The reference to the position of the camera in the global frame, format: x,y,z.
+ * @param orientation The reference to the orientation of the camera in the global frame, format: qx,qy,qz,qw.
+ */
+void Frustum::setPose(const std::vector<float>& position, const std::vector<float>& orientation) {
+  Eigen::Quaternionf q(orientation[3], orientation[0], orientation[1], orientation[2]);
+  Eigen::Vector3f t(position[0], position[1], position[2]);
+  R_ = q.normalized().toRotationMatrix().transpose();
+  t_ = - R_ * t;
+  has_pose_ = true;
+}
+
+/**
+ * @brief Invalidates the pose of the camera.
+ * @details Invalidates the pose of the camera. Used when the pose of the camera is unknown.
+ *
+ */
+void Frustum::invalidate() {
+  has_pose_ = false;
+}
+
+/**
+ * @brief Checks if the frustum can be used.
+ * @details Checks if both the intrinsics and the pose of the camera have been set.
+ *
+ * @return True if the frustum can be used.
+ */
+bool Frustum::isValid() const {
+  return has_intrinsics_ && has_pose_;
+}
+
+/**
+ * @brief Checks if a point is inside the frustum.
+ * @details Moves the point to the camera frame, and checks its depth. Then, projects
+ * it onto the image plane and checks that it lands inside the image, plus the margin.
+ *
+ * @param state The reference to the state of the object, only its first 3 elements are used (x,y,z).
+ * @return True if the point is visible.
+ */
+bool Frustum::isVisible(const std::vector<float>& state) const {
+  const Eigen::Vector3f p = R_ * Eigen::Vector3f(state[0], state[1], state[2]) + t_;
+  if ((p(2) < min_depth_) || (p(2) > max_depth_)) {
+    return false;
+  }
+  const float u = fx_ * p(0) / p(2) + cx_;
+  const float v = fy_ * p(1) / p(2) + cy_;
+  if ((u < - margin_) || (u > image_width_ + margin_)) {
+    return false;
+  }
+  if ((v < - margin_) || (v > image_height_ + margin_)) {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Applies a transform to the positions of the objects.
+ * @details The points are gathered in a single matrix and transformed in one batch.
+ * 
+ * @param transform The reference to the transform.
+ * @param points The reference to the points, per class, overwritten with the transformed points.
+ */
+void transformPoints(const RigidTransform& transform, std::vector<std::vector<std::vector<float>>>& points) {
+  unsigned int num_points = 0;
+  for (unsigned int i=0; i < points.size(); i++) {
+    num_points += points[i].size();
+  }
+  if (num_points == 0) {
+    return;
+  }
+  Eigen::Matrix3Xf batch(3, num_points);
+  unsigned int k = 0;
+  for (unsigned int i=0; i < points.size(); i++) {
+    for (unsigned int j=0; j < points[i].size(); j++, k++) {
+      batch.col(k) << points[i][j][0], points[i][j][1], points[i][j][2];
+    }
+  }
+  batch = (transform.rotation * batch).colwise() + transform.translation;
+  k = 0;
+  for (unsigned int i=0; i < points.size(); i++) {
+    for (unsigned int j=0; j < points[i].size(); j++, k++) {
+      points[i][j][0] = batch(0, k);
+      points[i][j][1] = batch(1, k);
+      points[i][j][2] = batch(2, k);
+    }
+  }
+}
@@ -14,7 +14,9 @@
 #include <stdlib.h>
 #include <cfloat> // for DBL_MAX
 #include <cmath>  // for fabs()
+#include <algorithm> // for std::fill()
 #include <detect_and_track/Hungarian.h>
+#include <detect_and_track/FrameArena.h>
 
 
 HungarianAlgorithm::HungarianAlgorithm(){}
@@ -34,8 +36,11 @@ double HungarianAlgorithm::Solve(vector <vector<double> >& DistMatrix, vector<in
 	unsigned int nRows = DistMatrix.size();
 	unsigned int nCols = DistMatrix[0].size();
 
-	double *distMatrixIn = new double[nRows * nCols];
-	int *assignment = new int[nRows];
+	// The working buffers are temporaries of the frame, allocated from the arena of the stage.
+	std::pmr::vector<double> distMatrixBuffer(nRows * nCols, FrameArena::getResource());
+	std::pmr::vector<int> assignmentBuffer(nRows, FrameArena::getResource());
+	double *distMatrixIn = distMatrixBuffer.data();
+	int *assignment = assignmentBuffer.data();
 	double cost = 0.0;
 
 	// Fill in the distMatrixIn. Mind the index is "i + nRows * j".
@@ -53,8 +58,6 @@ double HungarianAlgorithm::Solve(vector <vector<double> >& DistMatrix, vector<in
 	for (unsigned int r = 0; r < nRows; r++)
 		Assignment.push_back(assignment[r]);
 
-	delete[] distMatrixIn;
-	delete[] assignment;
 	return cost;
 }
 
@@ -82,7 +85,8 @@ void HungarianAlgorithm::assignmentoptimal(int *assignment, double *cost, double
 	// Generate working copy of distance Matrix.
 	// Check if all matrix elements are positive.
 	nOfElements = nOfRows * nOfColumns;
-	distMatrix = (double *)malloc(nOfElements * sizeof(double));
+	std::pmr::vector<double> distMatrixBuffer(nOfElements, FrameArena::getResource());
+	distMatrix = distMatrixBuffer.data();
 	distMatrixEnd = distMatrix + nOfElements;
 
 	for (row = 0; row<nOfElements; row++)
@@ -94,12 +98,16 @@ void HungarianAlgorithm::assignmentoptimal(int *assignment, double *cost, double
 	}
 
 
-	// Memory allocation.
-	coveredColumns = (bool *)calloc(nOfColumns, sizeof(bool));
-	coveredRows = (bool *)calloc(nOfRows, sizeof(bool));
-	starMatrix = (bool *)calloc(nOfElements, sizeof(bool));
-	primeMatrix = (bool *)calloc(nOfElements, sizeof(bool));
-	newStarMatrix = (bool *)calloc(nOfElements, sizeof(bool)); /* used in step4 */
+	// Memory allocation. The flags are stored in a single buffer, from the arena of the stage.
+	std::pmr::polymorphic_allocator<bool> flagsAllocator(FrameArena::getResource());
+	const size_t nOfFlags = nOfColumns + nOfRows + 3 * nOfElements;
+	bool *flags = flagsAllocator.allocate(nOfFlags);
+	std::fill(flags, flags + nOfFlags, false);
+	coveredColumns = flags;
+	coveredRows = coveredColumns + nOfColumns;
+	starMatrix = coveredRows + nOfRows;
+	primeMatrix = starMatrix + nOfElements;
+	newStarMatrix = primeMatrix + nOfElements; /* used in step4 */
 
 	// Preliminary steps.
 	if (nOfRows <= nOfColumns)
@@ -187,12 +195,7 @@ void HungarianAlgorithm::assignmentoptimal(int *assignment, double *cost, double
 	computeassignmentcost(assignment, cost, distMatrixIn, nOfRows);
 
 	// free allocated memory.
-	free(distMatrix);
-	free(coveredColumns);
-	free(coveredRows);
-	free(starMatrix);
-	free(primeMatrix);
-	free(newStarMatrix);
+	flagsAllocator.deallocate(flags, nOfFlags);
 
 	return;
 }
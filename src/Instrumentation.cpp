@@ -0,0 +1,398 @@
+/**
+ * @file Instrumentation.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The latency instrumentation.
+ * @details This file implements lock-free latency histograms, and the scoped timers recording into them.
+ * It also implements the trace ring buffer, and its export in the Chrome trace format,
+ * and the counters of the allocation accounting.
+ */
+
+#include <detect_and_track/Instrumentation.h>
+#include <algorithm>
+#include <map>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// The names of the threads that recorded spans, shared by all the buffers of the process.
+static std::mutex trace_threads_mutex;
+static std::map<uint32_t, std::string> trace_threads;
+
+// The allocation counters. They are zero-initialized before any code runs, such that the hooks can use them at any time.
+static std::atomic<bool> allocation_hooked;
+static std::atomic<uint64_t> allocation_counts[ALLOCATION_MAX_SCOPES];
+static std::atomic<uint64_t> allocation_bytes[ALLOCATION_MAX_SCOPES];
+static thread_local unsigned int allocation_scope = 0;
+static std::mutex allocation_mutex;
+static std::vector<std::string> allocation_scopes;
+
+/**
+ * @brief Construct a new LatencyHistogram object
+ *
+ * @param name The reference to the name of the histogram, usually the name of the timed step.
+ */
+LatencyHistogram::LatencyHistogram(const std::string& name) : name_(name) {
+  for (unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the bucket of a duration.
+ *
+ * @param value The reference to the duration, in nanoseconds.
+ * @return The index of the bucket.
+ */
+unsigned int LatencyHistogram::getIndex(const uint64_t& value) {
+  if (value < LATENCY_HISTOGRAM_SUB_COUNT) {
+    return (unsigned int) value;
+  }
+  const unsigned int msb = 63 - __builtin_clzll(value);
+  const unsigned int shift = msb - (LATENCY_HISTOGRAM_SUB_BITS - 1);
+  return shift * LATENCY_HISTOGRAM_HALF_COUNT + (unsigned int) (value >> shift);
+}
+
+/**
+ * @brief Returns the duration represented by a bucket, the middle of its range.
+ *
+ * @param index The reference to the index of the bucket.
+ * @return The duration, in nanoseconds.
+ */
+uint64_t LatencyHistogram::getValue(const unsigned int& index) {
+  if (index < LATENCY_HISTOGRAM_SUB_COUNT) {
+    return index;
+  }
+  const unsigned int shift = index / LATENCY_HISTOGRAM_HALF_COUNT - 1;
+  const uint64_t top = index - shift * LATENCY_HISTOGRAM_HALF_COUNT;
+  return (top << shift) + ((1ull << shift) >> 1);
+}
+
+const std::string& LatencyHistogram::getName() const {
+  return name_;
+}
+
+/**
+ * @brief Records a duration. Lock-free, can be called from any thread.
+ *
+ * @param value The reference to the duration, in nanoseconds.
+ */
+void LatencyHistogram::record(const uint64_t& value) {
+  counts_[getIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while ((value > max) && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+}
+
+/**
+ * @brief Computes the percentiles of the durations recorded since the last call, and clears the histogram.
+ * @details Each bucket is read and cleared at once, such that no duration is lost while the histogram is recorded into.
+ *
+ * @param summary The reference to the summary, the durations are in milliseconds.
+ */
+void LatencyHistogram::collect(LatencySummary& summary) {
+  std::vector<uint64_t> counts(LATENCY_HISTOGRAM_BUCKETS);
+  uint64_t count = 0;
+  for (unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+    counts[i] = counts_[i].exchange(0, std::memory_order_relaxed);
+    count += counts[i];
+  }
+  const uint64_t sum = sum_.exchange(0, std::memory_order_relaxed);
+  const uint64_t max = max_.exchange(0, std::memory_order_relaxed);
+
+  summary.name = name_;
+  summary.count = count;
+  summary.mean = 0;
+  summary.p50 = 0;
+  summary.p90 = 0;
+  summary.p99 = 0;
+  summary.max = max * 1e-6;
+  if (count == 0) {
+    return;
+  }
+  summary.mean = sum * 1e-6 / count;
+  const double percentiles[3] = {0.5, 0.9, 0.99};
+  float* outputs[3] = {&summary.p50, &summary.p90, &summary.p99};
+  uint64_t cumulated = 0;
+  unsigned int p = 0;
+  for (unsigned int i = 0; (i < LATENCY_HISTOGRAM_BUCKETS) && (p < 3); i++) {
+    cumulated += counts[i];
+    while ((p < 3) && (cumulated >= percentiles[p] * count)) {
+      *outputs[p] = std::min(getValue(i), std::max(max, (uint64_t) 1)) * 1e-6;
+      p++;
+    }
+  }
+}
+
+Instrumentation::Instrumentation() {}
+
+/**
+ * @brief Returns the histogram of a step, and creates it if needed.
+ *
+ * @param name The reference to the name of the step.
+ * @return The pointer to the histogram, owned by the Instrumentation.
+ */
+LatencyHistogram* Instrumentation::getHistogram(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (unsigned int i = 0; i < histograms_.size(); i++) {
+    if (histograms_[i]->getName() == name) {
+      return histograms_[i].get();
+    }
+  }
+  histograms_.emplace_back(new LatencyHistogram(name));
+  return histograms_.back().get();
+}
+
+/**
+ * @brief Collects and clears all the histograms.
+ *
+ * @param summaries The reference to the vector in which the summary of each histogram is stored, in order of creation.
+ */
+void Instrumentation::collect(std::vector<LatencySummary>& summaries) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  summaries.resize(histograms_.size());
+  for (unsigned int i = 0; i < histograms_.size(); i++) {
+    histograms_[i]->collect(summaries[i]);
+  }
+}
+
+/**
+ * @brief Construct a new TraceBuffer object, and allocates its slots.
+ *
+ * @param size The reference to the number of spans kept.
+ */
+TraceBuffer::TraceBuffer(const size_t& size) {
+  size_ = size > 0 ? size : 1;
+  slots_.reset(new TraceSlot[size_]);
+  for (size_t i = 0; i < size_; i++) {
+    slots_[i].version.store(0, std::memory_order_relaxed);
+  }
+  head_.store(0, std::memory_order_relaxed);
+  origin_ = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Returns the id of the calling thread, and remembers its name on the first call.
+ *
+ * @return The id of the thread, as shown by the system tools.
+ */
+uint32_t TraceBuffer::getThread() {
+  static thread_local uint32_t thread = 0;
+  if (thread == 0) {
+    thread = (uint32_t) syscall(SYS_gettid);
+    char name[16] = {0};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    std::lock_guard<std::mutex> lock(trace_threads_mutex);
+    trace_threads[thread] = name;
+  }
+  return thread;
+}
+
+/**
+ * @brief Records a span. Lock-free, can be called from any thread.
+ *
+ * @param name The name of the span, it must outlive the buffer.
+ * @param stamp The reference to the acquisition time of the frame, in nanoseconds.
+ * @param sequence The reference to the sequence number of the frame.
+ * @param start The reference to the start of the span.
+ * @param end The reference to the end of the span.
+ */
+void TraceBuffer::record(const char* name, const int64_t& stamp, const uint64_t& sequence,
+                         const std::chrono::steady_clock::time_point& start, const std::chrono::steady_clock::time_point& end) {
+  const uint32_t thread = getThread();
+  const uint64_t index = head_.fetch_add(1, std::memory_order_relaxed);
+  TraceSlot& slot = slots_[index % size_];
+  slot.version.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.stamp.store(stamp, std::memory_order_relaxed);
+  slot.sequence.store(sequence, std::memory_order_relaxed);
+  slot.start.store(std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin_).count(), std::memory_order_relaxed);
+  slot.duration.store(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+  slot.thread.store(thread, std::memory_order_relaxed);
+  slot.version.store(2 * index + 2, std::memory_order_release);
+}
+
+/**
+ * @brief Writes the spans in the buffer to a Chrome trace file.
+ * @details The recording goes on during the dump, the spans being written are skipped.
+ * The spans of a frame (same stamp) are linked by flow events, in chronological order.
+ *
+ * @param path The reference to the path of the JSON file.
+ * @param count The reference to the number of spans written.
+ * @return False if the file could not be written.
+ */
+bool TraceBuffer::dump(const std::string& path, size_t& count) {
+  typedef struct Span{
+    const char* name;
+    int64_t stamp;
+    uint64_t sequence;
+    int64_t start;
+    int64_t duration;
+    uint32_t thread;
+  } Span;
+
+  // Copies the complete spans.
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const uint64_t first = head > size_ ? head - size_ : 0;
+  std::vector<Span> spans;
+  spans.reserve(head - first);
+  for (uint64_t i = first; i < head; i++) {
+    const TraceSlot& slot = slots_[i % size_];
+    const uint64_t version = slot.version.load(std::memory_order_acquire);
+    if (version != 2 * i + 2) {
+      continue;
+    }
+    Span span;
+    span.name = slot.name.load(std::memory_order_relaxed);
+    span.stamp = slot.stamp.load(std::memory_order_relaxed);
+    span.sequence = slot.sequence.load(std::memory_order_relaxed);
+    span.start = slot.start.load(std::memory_order_relaxed);
+    span.duration = slot.duration.load(std::memory_order_relaxed);
+    span.thread = slot.thread.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.version.load(std::memory_order_relaxed) != version) {
+      continue;
+    }
+    spans.push_back(span);
+  }
+  std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b){
+    return (a.stamp < b.stamp) || ((a.stamp == b.stamp) && (a.start < b.start));
+  });
+  std::map<uint32_t, std::string> threads;
+  {
+    std::lock_guard<std::mutex> lock(trace_threads_mutex);
+    for (unsigned int i = 0; i < spans.size(); i++) {
+      threads[spans[i].thread] = trace_threads[spans[i].thread];
+    }
+  }
+
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    printf("[ERROR ] TraceBuffer::%s::l%d Could not open %s.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+  const int pid = getpid();
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"detect_and_track\"}}", pid);
+  for (std::map<uint32_t, std::string>::iterator it = threads.begin(); it != threads.end(); it++) {
+    std::string name = it->second;
+    std::replace(name.begin(), name.end(), '"', '_');
+    std::replace(name.begin(), name.end(), '\\', '_');
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            pid, it->first, name.c_str());
+  }
+  uint64_t flow = 0;
+  for (unsigned int i = 0; i < spans.size(); i++) {
+    const Span& span = spans[i];
+    fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+            "\"args\":{\"stamp\":\"%ld.%09ld\",\"seq\":%lu}}",
+            span.name, pid, span.thread, span.start * 1e-3, span.duration * 1e-3,
+            (long) (span.stamp / 1000000000), (long) (span.stamp % 1000000000), (unsigned long) span.sequence);
+    // Links the spans of the frame, the flow events are placed in the middle of the spans they bind to.
+    const bool has_previous = (i > 0) && (spans[i - 1].stamp == span.stamp);
+    const bool has_next = (i + 1 < spans.size()) && (spans[i + 1].stamp == span.stamp);
+    if ((span.stamp == 0) || (!has_previous && !has_next)) {
+      continue;
+    }
+    if (!has_previous) {
+      flow ++;
+    }
+    const char* phase = !has_previous ? "s" : (has_next ? "t" : "f");
+    fprintf(file, ",\n{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"%s\",\"bp\":\"e\",\"id\":%lu,\"pid\":%d,\"tid\":%u,\"ts\":%.3f}",
+            phase, (unsigned long) flow, pid, span.thread, (span.start + span.duration / 2) * 1e-3);
+  }
+  fprintf(file, "\n]}\n");
+  const bool written = (fclose(file) == 0);
+  if (!written) {
+    printf("[ERROR ] TraceBuffer::%s::l%d Could not write %s.\n", __func__, __LINE__, path.c_str());
+  }
+  count = spans.size();
+  return written;
+}
+
+/**
+ * @brief Marks the allocation hooks as linked. Called by the hooks when the executable starts.
+ *
+ */
+void AllocationAccounting::setHooked() {
+  allocation_hooked.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Checks if the allocations are counted.
+ *
+ * @return True if the allocation hooks are linked in the executable.
+ */
+bool AllocationAccounting::isHooked() {
+  return allocation_hooked.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the index of a scope, and creates it if needed.
+ * @details Once all the scopes are taken, the allocations of the new ones are attributed to the default scope.
+ *
+ * @param name The reference to the name of the scope.
+ * @return The index of the scope.
+ */
+unsigned int AllocationAccounting::getScope(const std::string& name) {
+  std::lock_guard<std::mutex> lock(allocation_mutex);
+  if (allocation_scopes.empty()) {
+    allocation_scopes.push_back("other");
+  }
+  for (unsigned int i = 0; i < allocation_scopes.size(); i++) {
+    if (allocation_scopes[i] == name) {
+      return i;
+    }
+  }
+  if (allocation_scopes.size() >= ALLOCATION_MAX_SCOPES) {
+    printf("[WARN  ] AllocationAccounting::%s::l%d Too many scopes, the allocations of %s are counted in other.\n", __func__, __LINE__, name.c_str());
+    return 0;
+  }
+  allocation_scopes.push_back(name);
+  return allocation_scopes.size() - 1;
+}
+
+/**
+ * @brief Sets the scope of the calling thread.
+ *
+ * @param scope The reference to the index of the scope.
+ * @return The index of the previous scope of the thread.
+ */
+unsigned int AllocationAccounting::setScope(const unsigned int& scope) {
+  const unsigned int previous = allocation_scope;
+  allocation_scope = scope < ALLOCATION_MAX_SCOPES ? scope : 0;
+  return previous;
+}
+
+/**
+ * @brief Counts an allocation in the scope of the calling thread. Called by the hooks.
+ *
+ * @param size The reference to the number of bytes requested.
+ */
+void AllocationAccounting::record(const size_t& size) {
+  allocation_counts[allocation_scope].fetch_add(1, std::memory_order_relaxed);
+  allocation_bytes[allocation_scope].fetch_add(size, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Collects and clears the counters of all the scopes.
+ *
+ * @param statistics The reference to the vector in which the allocations of each scope are stored, the default scope first.
+ */
+void AllocationAccounting::collect(std::vector<AllocationStatistics>& statistics) {
+  std::lock_guard<std::mutex> lock(allocation_mutex);
+  if (allocation_scopes.empty()) {
+    allocation_scopes.push_back("other");
+  }
+  statistics.resize(allocation_scopes.size());
+  for (unsigned int i = 0; i < allocation_scopes.size(); i++) {
+    statistics[i].name = allocation_scopes[i];
+    statistics[i].count = allocation_counts[i].exchange(0, std::memory_order_relaxed);
+    statistics[i].bytes = allocation_bytes[i].exchange(0, std::memory_order_relaxed);
+  }
+}
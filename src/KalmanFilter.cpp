@@ -64,6 +64,42 @@ void BaseKalmanFilter::getUncertainty(std::vector<float>& uncertainty) {
   }
 }
 
+/**
+ * @brief Accessor function to get the size of the state.
+ * @details Accessor function to get the size of the state.
+ * 
+ * @return The number of variables in the state.
+ */
+unsigned int BaseKalmanFilter::getStateSize() const {
+  return X_.size();
+}
+
+/**
+ * @brief Copies the raw state of the filter.
+ * @details Copies the state X and its full covariance P into flat arrays.
+ * P is stored in column major order. Used to checkpoint the filter.
+ * 
+ * @param X A pointer to an array of getStateSize() floats.
+ * @param P A pointer to an array of getStateSize()^2 floats.
+ */
+void BaseKalmanFilter::exportState(float* X, float* P) const {
+  Eigen::Map<Eigen::VectorXf>(X, X_.size()) = X_;
+  Eigen::Map<Eigen::MatrixXf>(P, P_.rows(), P_.cols()) = P_;
+}
+
+/**
+ * @brief Restores the raw state of the filter.
+ * @details Restores the state X and its full covariance P from flat arrays.
+ * P is read in column major order. Used to restore the filter from a checkpoint.
+ * 
+ * @param X A pointer to an array of getStateSize() floats.
+ * @param P A pointer to an array of getStateSize()^2 floats.
+ */
+void BaseKalmanFilter::importState(const float* X, const float* P) {
+  X_ = Eigen::Map<const Eigen::VectorXf>(X, X_.size());
+  P_ = Eigen::Map<const Eigen::MatrixXf>(P, P_.rows(), P_.cols());
+}
+
 /**
  * @brief The prediction function of the linear Kalman filter.
  * @details This function implements the prediction step of a Kalman Filter.
@@ -1411,12 +1447,12 @@ void KalmanFilter3DF::buildH(){
  * The size of this matrix changes based on the selected parameters parameters.
  * If the user selected use_dim, then the noise on the observed height and width will be added to the matrix.
  * 
- * @param R The reference to the vector containing the noise of the measurement (R5).
+ * @param R The reference to the vector containing the noise of the measurement (R9), organized like the measurements.
  */
 void KalmanFilter3DF::buildR(const std::vector<float>& R){
   int r_size = 3;
   if (use_dim_) {
-    r_size += 3;
+    r_size += 2;
   }
   Z_ = Eigen::VectorXf::Zero(r_size);
   R_ = Eigen::MatrixXf::Zero(r_size, r_size);
@@ -1424,9 +1460,8 @@ void KalmanFilter3DF::buildR(const std::vector<float>& R){
   R_(1,1) = R[1];
   R_(2,2) = R[2];
   if (use_dim_) {
-    R_(3,3) = R[3];
-    R_(4,4) = R[4]; 
-    R_(5,5) = R[5]; 
+    R_(3,3) = R[6];
+    R_(4,4) = R[8]; 
   }
 }
 
@@ -1436,16 +1471,15 @@ void KalmanFilter3DF::buildR(const std::vector<float>& R){
  * It also ensures that the correct quantities are being observed.
  * The user must give a vector of full size even if the values are not observed (use 0s instead).
  * 
- * @param measurement The reference to the measurement vector (R6).
+ * @param measurement The reference to the measurement vector (R9).
  */
 void KalmanFilter3DF::getMeasurement(const std::vector<float>& measurement) {
-  // State is [x, y, z, vx, vy, vz, h, w, d]
+  // Measurement is [x, y, z, vx, vy, vz, w, d, h]
   Z_(0) = measurement[0];
   Z_(1) = measurement[1];
   Z_(2) = measurement[2];
   if (use_dim_) {
     Z_(3) = measurement[6];
-    Z_(4) = measurement[7];
-    Z_(5) = measurement[8];
+    Z_(4) = measurement[8];
   }
 }
\ No newline at end of file
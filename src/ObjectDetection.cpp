@@ -56,8 +56,13 @@ ObjectDetector::ObjectDetector(std::string path_to_engine, float nms_tresh, floa
   conf_tresh_ = conf_tresh;
   max_output_bbox_count_ = max_output_bbox_count;
   buffer_size_ = buffer_size;
+  batch_size_ = 1;
   image_size_ = image_size;
   num_classes_ = num_classes;
+  preprocess_histogram_ = nullptr;
+  infer_histogram_ = nullptr;
+  decode_histogram_ = nullptr;
+  nms_histogram_ = nullptr;
 
   buffers_.resize(buffer_size_);
 
@@ -86,8 +91,13 @@ ObjectDetector::ObjectDetector(int image_size, DetectionParameters& det_p, NMSPa
   conf_tresh_ = nms_p.conf_thresh;
   max_output_bbox_count_ = nms_p.max_output_bbox_count;
   buffer_size_ = det_p.num_buffers;
+  batch_size_ = 1;
   image_size_ = image_size;
   num_classes_ = det_p.num_classes;
+  preprocess_histogram_ = nullptr;
+  infer_histogram_ = nullptr;
+  decode_histogram_ = nullptr;
+  nms_histogram_ = nullptr;
   buffers_.resize(buffer_size_);
 
   prepareEngine();
@@ -188,6 +198,11 @@ void ObjectDetector::prepareEngine() {
     cudaMalloc(&buffers_[i], binding_size);
     if (engine_->bindingIsInput(i)) {
       input_dims.emplace_back(engine_->getBindingDimensions(i));
+      // Engines with an explicit batch dimension process batch_size_ images per forward pass.
+      if (!engine_->hasImplicitBatchDimension() && (input_dims.back().nbDims == 4) && (input_dims.back().d[0] > 1)) {
+        batch_size_ = input_dims.back().d[0];
+        printf("[LOG   ] ObjectDetector::%s::l%d Batch size = %d.\n", __func__, __LINE__, batch_size_);
+      }
       printf("[LOG   ] ObjectDetector::%s::l%d Input layer, size = %lu.\n", __func__, __LINE__, binding_size);
       input_size_ = (int) (binding_size / 4);
       printf("[LOG   ] ObjectDetector::%s::l%d Creating input buffer of size %d.\n", __func__, __LINE__, input_size_); 
@@ -254,10 +269,11 @@ void ObjectDetector::getBufferFromGPU(){
  * To leverage float16 operation, it may be beneficial to cast to float16 instead.
  * 
  * @param image The reference to the RGB image to be preprocessed.
+ * @param slot The reference to the index of the image in the batch.
  */
-void ObjectDetector::preprocessImage(cv::Mat& image){
+void ObjectDetector::preprocessImage(cv::Mat& image, const int& slot){
   image.convertTo(image, CV_32FC3, 1.f / 255.f);
-  int i = 0;
+  int i = slot * 3 * image_size_ * image_size_;
   for (int row = 0; row < image_size_; ++row) {
     for (int col = 0; col < image_size_; ++col) {
       input_data_.get()[i] = image.at<cv::Vec3f>(row, col)[0];
@@ -283,13 +299,76 @@ void ObjectDetector::preprocessImage(cv::Mat& image){
  */
 void ObjectDetector::detectObjects(cv::Mat image, std::vector<std::vector<BoundingBox>>& bboxes){
   bboxes.clear();
-  preprocessImage(image);
-  auto start_infer = std::chrono::system_clock::now();
-  sendBufferToGPU();
-  inferNetwork();
-  getBufferFromGPU();
-  auto end_infer = std::chrono::system_clock::now();
-  nonMaximumSuppression(bboxes);
+  {
+    ScopedTimer timer(preprocess_histogram_);
+    preprocessImage(image, 0);
+  }
+  {
+    ScopedTimer timer(infer_histogram_);
+    sendBufferToGPU();
+    inferNetwork();
+    getBufferFromGPU();
+  }
+  nonMaximumSuppression(bboxes, 0);
+}
+
+/**
+ * @brief Applies the object detector on several images.
+ * @details The images are processed batch_size_ at a time, in a single forward pass for each batch.
+ * With an engine built for a single image, this is equivalent to calling detectObjects on each image.
+ *
+ * @param images The reference to the images to be processed by the network, they are converted in place.
+ * @param bboxes The reference to the vector in which the bounding boxes of each image will be stored.
+ */
+void ObjectDetector::detectObjects(std::vector<cv::Mat>& images, std::vector<std::vector<std::vector<BoundingBox>>>& bboxes){
+  bboxes.resize(images.size());
+  for (unsigned int first = 0; first < images.size(); first += batch_size_) {
+    const unsigned int count = std::min((unsigned int) batch_size_, (unsigned int) images.size() - first);
+    {
+      ScopedTimer timer(preprocess_histogram_);
+      for (unsigned int k = 0; k < count; k++) {
+        preprocessImage(images[first + k], k);
+      }
+    }
+    {
+      ScopedTimer timer(infer_histogram_);
+      sendBufferToGPU();
+      inferNetwork();
+      getBufferFromGPU();
+    }
+    for (unsigned int k = 0; k < count; k++) {
+      bboxes[first + k].clear();
+      nonMaximumSuppression(bboxes[first + k], k);
+    }
+  }
+}
+
+/**
+ * @brief Returns the number of images processed by a forward pass of the network.
+ *
+ * @return The batch size of the engine, 1 if it has an implicit batch dimension.
+ */
+int ObjectDetector::getBatchSize() const {
+  return batch_size_;
+}
+
+/**
+ * @brief Sets the histograms in which the duration of the preprocessing, inference, decoding, and NMS are recorded.
+ * 
+ * @param instrumentation The pointer to the instrumentation of the node, nullptr to disable the timers.
+ */
+void ObjectDetector::setInstrumentation(Instrumentation* instrumentation) {
+  if (instrumentation == nullptr) {
+    preprocess_histogram_ = nullptr;
+    infer_histogram_ = nullptr;
+    decode_histogram_ = nullptr;
+    nms_histogram_ = nullptr;
+    return;
+  }
+  preprocess_histogram_ = instrumentation->getHistogram("preprocess");
+  infer_histogram_ = instrumentation->getHistogram("infer");
+  decode_histogram_ = instrumentation->getHistogram("decode");
+  nms_histogram_ = instrumentation->getHistogram("nms");
 }
 
 /**
@@ -299,51 +378,16 @@ void ObjectDetector::detectObjects(cv::Mat image, std::vector<std::vector<Boundi
  * Second, it applies the non-maximum supression to remove deuplicate detections and other outliers.
  * 
  * @param bboxes The reference to a vector of vectors of bounding boxes.
+ * @param slot The reference to the index of the image in the batch.
  */
-void ObjectDetector::nonMaximumSuppression(std::vector<std::vector<BoundingBox>> &bboxes) {
-  bboxes.resize(num_classes_);
-  int class_id;
-  float conf; 
-
-  for (int c = 0; c < num_classes_; ++c) {
-    bboxes[c].reserve(output_size_);
-  }
-  // Bounding box is min_x, min_y, width, height, conf, class1, class2, ...
-  for (int i = 0; i < output_size_; i += (num_classes_ + 5)) {
-    conf = output_data_.get()[i + 4];
-    if (conf > conf_tresh_) {
-      assert(conf <= 1.0f);
-      // Get all the probabilities that this objects belong to a given class
-      std::vector<float> probabilities(num_classes_);
-      for (unsigned int j=0; i < num_classes_; j++){
-        // 5 : minx, miny, width, height, conf
-        // i : number of objects
-        // j : number of classes
-        probabilities[j] = output_data_.get()[4 + i + j]; 
-      }
-      // Take the maximum
-      class_id = std::distance(probabilities.begin(), std::max_element(probabilities.begin(), probabilities.end()));
-      // Save to bounding box
-      bboxes[class_id].push_back(BoundingBox(output_data_.get() + i, class_id));
-    }
-  }
-  // Non-maximum supression
-  for (int c = 0; c < num_classes_; ++c) {
-    std::sort(bboxes[c].begin(), bboxes[c].end(), sortComparisonFunction);
-    const size_t bboxes_size = bboxes[c].size();
-    size_t valid_count = 0;
-
-    for (size_t i = 0; i < bboxes_size && valid_count < max_output_bbox_count_;
-         ++i) {
-      if (!bboxes[c][i].valid_) {
-        continue;
-      }
-      for (size_t j = i + 1; j < bboxes_size; ++j) {
-        bboxes[c][i].compareWith(bboxes[c][j], nms_tresh_);
-      }
-      ++valid_count;
-    }
+void ObjectDetector::nonMaximumSuppression(std::vector<std::vector<BoundingBox>> &bboxes, const int& slot) {
+  const int output_size = output_size_ / batch_size_;
+  {
+    ScopedTimer timer(decode_histogram_);
+    decodeDetections(output_data_.get() + slot * output_size, output_size, num_classes_, conf_tresh_, bboxes);
   }
+  ScopedTimer timer(nms_histogram_);
+  suppressOverlaps(bboxes, nms_tresh_, max_output_bbox_count_);
 }
 
 /**
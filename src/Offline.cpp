@@ -0,0 +1,849 @@
+/**
+ * @file Offline.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The source code of the offline processing.
+ * @details This file implements the offline pipeline, and the applyOnFolder and applyOnVideo methods of the
+ * detection classes, which process folders of images and videos with it.
+ */
+
+#include <detect_and_track/Offline.h>
+#include <filesystem>
+#include <algorithm>
+
+/**
+ * @brief Prefered constructor.
+ *
+ * @param first The reference to the index of the first frame.
+ * @param capacity The reference to the number of frames the queue can hold ahead of the next frame to be popped.
+ * @param producers The reference to the number of threads pushing frames in the queue.
+ */
+OfflineQueue::OfflineQueue(const uint64_t& first, const size_t& capacity, const unsigned int& producers) {
+  next_ = first;
+  capacity_ = std::max(capacity, (size_t) 1);
+  producers_ = producers;
+}
+
+/**
+ * @brief Adds a frame to the queue.
+ * @details Waits until the index of the frame is within capacity of the next frame to be popped.
+ *
+ * @param item The frame, the queue takes its ownership.
+ */
+void OfflineQueue::push(std::unique_ptr<OfflineItem>&& item) {
+  const uint64_t index = item->frame.stamps.sequence;
+  std::unique_lock<std::mutex> lock(mutex_);
+  not_full_.wait(lock, [this, &index]{return index < next_ + capacity_;});
+  items_[index] = std::move(item);
+  if (index == next_) {
+    not_empty_.notify_all();
+  }
+}
+
+/**
+ * @brief Takes the next frame, in the order of their index.
+ * @details Waits until the next frame is pushed, or until all the producers are done.
+ *
+ * @param item The reference to the frame.
+ * @return False once all the frames were popped.
+ */
+bool OfflineQueue::pop(std::unique_ptr<OfflineItem>& item) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  not_empty_.wait(lock, [this]{return (!items_.empty() && (items_.begin()->first == next_)) || (producers_ == 0);});
+  if (items_.empty() || (items_.begin()->first != next_)) {
+    return false;
+  }
+  item = std::move(items_.begin()->second);
+  items_.erase(items_.begin());
+  next_ ++;
+  not_full_.notify_all();
+  if (!items_.empty() && (items_.begin()->first == next_)) {
+    not_empty_.notify_one();
+  }
+  return true;
+}
+
+/**
+ * @brief Takes the next frame, if it was already pushed.
+ *
+ * @param item The reference to the frame.
+ * @return False if the next frame is not in the queue.
+ */
+bool OfflineQueue::tryPop(std::unique_ptr<OfflineItem>& item) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (items_.empty() || (items_.begin()->first != next_)) {
+    return false;
+  }
+  item = std::move(items_.begin()->second);
+  items_.erase(items_.begin());
+  next_ ++;
+  not_full_.notify_all();
+  return true;
+}
+
+/**
+ * @brief Signals that a producer is done.
+ *
+ */
+void OfflineQueue::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  producers_ --;
+  not_empty_.notify_all();
+}
+
+OfflineSource::OfflineSource() : is_video_(false), with_depth_(false), next_(0), num_frames_(0) {}
+
+/**
+ * @brief Lists the images of a folder.
+ *
+ * @param path The reference to the path of the folder.
+ * @param with_depth The reference to whether the depth images are read.
+ * @return False if the folder has no images, or no depth folder when needed.
+ */
+bool OfflineSource::openFolder(const std::string& path, const bool& with_depth) {
+  is_video_ = false;
+  with_depth_ = with_depth;
+  const std::string folder = std::filesystem::is_directory(path + "/rgb") ? path + "/rgb" : path;
+  depth_folder_ = path + "/depth";
+  if (!std::filesystem::is_directory(folder)) {
+    printf("[ERROR ] OfflineSource::%s::l%d No such folder: %s.\n", __func__, __LINE__, folder.c_str());
+    return false;
+  }
+  if (with_depth_ && !std::filesystem::is_directory(depth_folder_)) {
+    printf("[ERROR ] OfflineSource::%s::l%d No such folder: %s.\n", __func__, __LINE__, depth_folder_.c_str());
+    return false;
+  }
+  const std::vector<std::string> extensions {".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff"};
+  images_.clear();
+  for (const auto & entry : std::filesystem::directory_iterator(folder)) {
+    std::string extension = entry.path().extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (entry.is_regular_file() && (std::find(extensions.begin(), extensions.end(), extension) != extensions.end())) {
+      images_.push_back(entry.path().string());
+    }
+  }
+  std::sort(images_.begin(), images_.end());
+  num_frames_ = images_.size();
+  next_ = 0;
+  if (images_.empty()) {
+    printf("[ERROR ] OfflineSource::%s::l%d No images in %s.\n", __func__, __LINE__, folder.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Opens a video.
+ *
+ * @param path The reference to the path of the video.
+ * @param with_depth The reference to whether the depth images are read.
+ * @return False if the video could not be opened, or has no depth folder when needed.
+ */
+bool OfflineSource::openVideo(const std::string& path, const bool& with_depth) {
+  is_video_ = true;
+  with_depth_ = with_depth;
+  const std::filesystem::path video(path);
+  depth_folder_ = (video.parent_path() / video.stem()).string() + "_depth";
+  if (with_depth_ && !std::filesystem::is_directory(depth_folder_)) {
+    printf("[ERROR ] OfflineSource::%s::l%d No such folder: %s.\n", __func__, __LINE__, depth_folder_.c_str());
+    return false;
+  }
+  if (!capture_.open(path)) {
+    printf("[ERROR ] OfflineSource::%s::l%d Could not open %s.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+  num_frames_ = (int64_t) capture_.get(cv::CAP_PROP_FRAME_COUNT);
+  next_ = 0;
+  return true;
+}
+
+/**
+ * @brief Skips the first frames.
+ * @details The frames of a video are grabbed, without being decoded, such that the position is exact.
+ *
+ * @param first The reference to the index of the next frame to be read.
+ * @return False if the source has fewer frames.
+ */
+bool OfflineSource::seek(const uint64_t& first) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!is_video_) {
+    next_ = first;
+    return first <= images_.size();
+  }
+  for (; next_ < first; next_++) {
+    if (!capture_.grab()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Reads the next frame, and its depth.
+ * @details Can be called by several threads: the frames are claimed in order, and the images of a folder,
+ * and the depth images, are decoded outside of the lock. The frames of a folder use the dt of the trackers,
+ * the frames of a video are stamped with their position in the video.
+ *
+ * @param item The reference to the frame. It is marked invalid if its image, or its depth, could not be read.
+ * @return False once all the frames were read.
+ */
+bool OfflineSource::read(OfflineItem& item) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t index = next_;
+  item.frame.stamps.sequence = index;
+  item.frame.stamps.stamp = 0;
+  item.frame.stamps.received = std::chrono::steady_clock::now();
+  if (is_video_) {
+    if (!capture_.read(item.frame.image)) {
+      return false;
+    }
+    item.frame.stamps.stamp = (int64_t) (capture_.get(cv::CAP_PROP_POS_MSEC) * 1e6);
+    next_ ++;
+    lock.unlock();
+    char name[32];
+    snprintf(name, sizeof(name), "%06lu", index);
+    item.name = name;
+  } else {
+    if (index >= images_.size()) {
+      return false;
+    }
+    next_ ++;
+    lock.unlock();
+    item.name = std::filesystem::path(images_[index]).stem().string();
+    item.frame.image = cv::imread(images_[index], cv::IMREAD_COLOR);
+  }
+  item.valid = !item.frame.image.empty();
+  if (item.valid && with_depth_) {
+    item.frame.depth = cv::imread(depth_folder_ + "/" + item.name + ".png", cv::IMREAD_ANYDEPTH);
+    if (item.frame.depth.empty()) {
+      item.frame.depth = cv::imread(depth_folder_ + "/" + item.name + ".tiff", cv::IMREAD_ANYDEPTH);
+    }
+    item.valid = !item.frame.depth.empty();
+  }
+  if (!item.valid) {
+    printf("[WARN  ] OfflineSource::%s::l%d Could not read the frame %s, it is skipped.\n", __func__, __LINE__, item.name.c_str());
+  }
+  return true;
+}
+
+/**
+ * @brief Returns the number of frames of the source.
+ *
+ * @return The number of frames, as reported by the container for a video.
+ */
+int64_t OfflineSource::getNumFrames() const {
+  return num_frames_;
+}
+
+/**
+ * @brief Prefered constructor.
+ * @details Prefered constructor. Opens the source and the recording. When resuming, the source is moved
+ * past the frames already in the recording.
+ *
+ * @param options The reference to the options of the processing.
+ */
+OfflineRunner::OfflineRunner(const OfflineOptions& options) : writer_(nullptr), first_(0) {
+  options_ = options;
+  const bool opened = options_.is_video ? source_.openVideo(options_.input, options_.with_depth)
+                                        : source_.openFolder(options_.input, options_.with_depth);
+  if (!opened || !prepareOutput()) {
+    return;
+  }
+  if (!source_.seek(first_)) {
+    printf("[ERROR ] OfflineRunner::%s::l%d %s has fewer than %lu frames.\n", __func__, __LINE__, options_.input.c_str(), first_);
+    delete writer_;
+    writer_ = nullptr;
+  }
+}
+
+/**
+ * @brief Destructor.
+ * @details Destructor. Writes the results left in the buffers of the recording.
+ *
+ */
+OfflineRunner::~OfflineRunner() {
+  delete writer_;
+}
+
+/**
+ * @brief Opens the recording the results are written to.
+ * @details When resuming an existing recording, it must have been made from the same input, with the same stages.
+ * The processing restarts after its last complete result, the truncated results are overwritten.
+ *
+ * @return False if the recording could not be opened.
+ */
+bool OfflineRunner::prepareOutput() {
+  size_t append_offset = 0;
+  if (options_.resume && std::filesystem::exists(options_.output)) {
+    RecordReader reader;
+    if (!reader.open(options_.output)) {
+      return false;
+    }
+    std::map<std::string, std::string> parameters;
+    RecordEntry entry;
+    while (reader.next(entry)) {
+      RecordReader::readParameters(entry, parameters);
+      if (entry.header.type == RECORD_RESULT) {
+        first_ = entry.header.sequence + 1;
+      }
+    }
+    if ((parameters["input"] != options_.input) || (parameters["mode"] != options_.mode)) {
+      printf("[ERROR ] OfflineRunner::%s::l%d %s was made from %s (%s), not %s (%s).\n", __func__, __LINE__, options_.output.c_str(),
+             parameters["input"].c_str(), parameters["mode"].c_str(), options_.input.c_str(), options_.mode.c_str());
+      return false;
+    }
+    append_offset = reader.tell();
+    printf("[INFO  ] OfflineRunner::%s::l%d Resuming %s from the frame %lu.\n", __func__, __LINE__, options_.output.c_str(), first_);
+  }
+  writer_ = new RecordWriter(options_.output, 64 << 20, append_offset, true, 1.0);
+  if (!writer_->isOpen()) {
+    delete writer_;
+    writer_ = nullptr;
+    return false;
+  }
+  if (append_offset == 0) {
+    std::map<std::string, std::string> parameters;
+    parameters["input"] = options_.input;
+    parameters["mode"] = options_.mode;
+    writer_->writeParameters(0, parameters);
+  }
+  if (options_.save_images) {
+    std::filesystem::create_directories(options_.output + "_images");
+  }
+  return true;
+}
+
+/**
+ * @brief Checks if the source and the recording could be opened.
+ *
+ * @return True if the frames can be processed.
+ */
+bool OfflineRunner::isOpen() const {
+  return writer_ != nullptr;
+}
+
+/**
+ * @brief Returns the number of threads of the parallel stages.
+ *
+ * @return The number of threads set in the options, or the number of cores.
+ */
+unsigned int OfflineRunner::getNumThreads() const {
+  if (options_.num_threads > 0) {
+    return options_.num_threads;
+  }
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+/**
+ * @brief Adds a stage.
+ * @details The first stage reads the frames from the source. With several threads, the stage processes several
+ * frames at once, the frames still leave it in order. With a single thread, the frames are processed in order.
+ *
+ * @param name The reference to the name of the stage.
+ * @param function The reference to the function applied to each frame, returning false marks the frame invalid.
+ * @param num_threads The reference to the number of threads of the stage.
+ */
+void OfflineRunner::addStage(const std::string& name, const StageFunction& function, const unsigned int& num_threads) {
+  std::unique_ptr<Stage> stage(new Stage());
+  stage->name = name;
+  stage->function = function;
+  stage->num_threads = std::max(num_threads, 1u);
+  stage->batch_size = 1;
+  stage->busy_ns.store(0);
+  stages_.push_back(std::move(stage));
+}
+
+/**
+ * @brief Adds a batch stage.
+ * @details The stage runs on a single thread. It takes the next frame, and the frames following it that are
+ * already waiting, up to the batch size, and processes the valid ones together.
+ *
+ * @param name The reference to the name of the stage.
+ * @param function The reference to the function applied to each batch.
+ * @param batch_size The reference to the maximum number of frames in a batch.
+ */
+void OfflineRunner::addBatchStage(const std::string& name, const BatchFunction& function, const unsigned int& batch_size) {
+  std::unique_ptr<Stage> stage(new Stage());
+  stage->name = name;
+  stage->batch_function = function;
+  stage->num_threads = 1;
+  stage->batch_size = std::max(batch_size, 1u);
+  stage->busy_ns.store(0);
+  stages_.push_back(std::move(stage));
+}
+
+/**
+ * @brief Sets the function drawing the results on the image of a frame, when the images are saved.
+ *
+ * @param function The reference to the function.
+ */
+void OfflineRunner::setDrawFunction(const StageFunction& function) {
+  draw_ = function;
+}
+
+/**
+ * @brief The loop of a thread of a stage.
+ *
+ * @param stage The pointer to the stage.
+ * @param input The pointer to the input queue of the stage, nullptr to read the frames from the source.
+ * @param output The pointer to the output queue of the stage.
+ */
+void OfflineRunner::runStage(Stage* stage, OfflineQueue* input, OfflineQueue* output) {
+  std::vector<std::unique_ptr<OfflineItem>> batch;
+  std::vector<OfflineItem*> valid;
+  std::unique_ptr<OfflineItem> item;
+  while (true) {
+    batch.clear();
+    auto start = std::chrono::steady_clock::now();
+    if (input == nullptr) {
+      item.reset(new OfflineItem());
+      if (!source_.read(*item)) {
+        break;
+      }
+    } else {
+      if (!input->pop(item)) {
+        break;
+      }
+      start = std::chrono::steady_clock::now();
+    }
+    batch.push_back(std::move(item));
+    while ((input != nullptr) && (batch.size() < stage->batch_size) && input->tryPop(item)) {
+      batch.push_back(std::move(item));
+    }
+
+    if (stage->batch_function) {
+      valid.clear();
+      for (unsigned int k = 0; k < batch.size(); k++) {
+        if (batch[k]->valid) {
+          valid.push_back(batch[k].get());
+        }
+      }
+      if (!valid.empty()) {
+        stage->batch_function(valid);
+      }
+    } else if (batch[0]->valid) {
+      batch[0]->valid = stage->function(*batch[0]);
+    }
+    stage->busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    for (unsigned int k = 0; k < batch.size(); k++) {
+      output->push(std::move(batch[k]));
+    }
+  }
+  output->close();
+}
+
+/**
+ * @brief Processes all the frames of the source.
+ * @details Adds the stages saving the images, in parallel, and writing the results, in order. The calling thread
+ * waits for the frames to leave the last stage. The throughput is printed every second if verbose, and at the end,
+ * with the time each stage was busy, which points at the bottleneck.
+ *
+ * @return The number of frames processed.
+ */
+uint64_t OfflineRunner::run() {
+  if (!isOpen() || stages_.empty()) {
+    return 0;
+  }
+  if (options_.save_images) {
+    addStage("save", [this](OfflineItem& item) {
+      if (draw_) {
+        draw_(item);
+      }
+      return cv::imwrite(options_.output + "_images/" + item.name + ".jpg", item.frame.image);
+    }, getNumThreads());
+  }
+  addStage("write", [this](OfflineItem& item) {
+    writer_->writeResult(item.frame, item.name);
+    return true;
+  }, 1);
+
+  size_t capacity = 4 * getNumThreads();
+  for (unsigned int i = 0; i < stages_.size(); i++) {
+    capacity = std::max(capacity, (size_t) (2 * stages_[i]->batch_size));
+  }
+  std::vector<std::unique_ptr<OfflineQueue>> queues;
+  for (unsigned int i = 0; i < stages_.size(); i++) {
+    queues.emplace_back(new OfflineQueue(first_, capacity, stages_[i]->num_threads));
+  }
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < stages_.size(); i++) {
+    for (unsigned int j = 0; j < stages_[i]->num_threads; j++) {
+      threads.emplace_back(&OfflineRunner::runStage, this, stages_[i].get(), i > 0 ? queues[i - 1].get() : nullptr, queues[i].get());
+    }
+  }
+
+  uint64_t num_frames = 0;
+  uint64_t num_skipped = 0;
+  auto last_print = start;
+  std::unique_ptr<OfflineItem> item;
+  while (queues.back()->pop(item)) {
+    num_frames ++;
+    num_skipped += !item->valid;
+    item.reset();
+    const auto now = std::chrono::steady_clock::now();
+    if (options_.verbose && (now - last_print > std::chrono::seconds(1))) {
+      const float seconds = std::chrono::duration<float>(now - start).count();
+      printf("[INFO  ] OfflineRunner::%s::l%d Frame %lu/%ld, %.1f frames/s.\n", __func__, __LINE__,
+             first_ + num_frames, source_.getNumFrames(), num_frames / seconds);
+      last_print = now;
+    }
+  }
+  for (unsigned int i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+
+  const float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+  printf("[INFO  ] OfflineRunner::%s::l%d %lu frames (%lu skipped) in %.2f s, %.1f frames/s.\n", __func__, __LINE__,
+         num_frames, num_skipped, seconds, num_frames / std::max(seconds, 1e-6f));
+  for (unsigned int i = 0; i < stages_.size(); i++) {
+    const float busy = stages_[i]->busy_ns.load() * 1e-9;
+    printf("[INFO  ] OfflineRunner::%s::l%d  - %s: %.2f s busy on %u thread(s), %.0f%% of the time.\n", __func__, __LINE__,
+           stages_[i]->name.c_str(), busy, stages_[i]->num_threads, 100 * busy / std::max(seconds * stages_[i]->num_threads, 1e-6f));
+  }
+  return num_frames;
+}
+
+/**
+ * @brief Fills the options of the offline processing.
+ *
+ */
+static OfflineOptions makeOfflineOptions(const std::string& mode, const std::string& input, const std::string& output,
+                                         const bool& is_video, const bool& with_depth, const bool& save_images,
+                                         const bool& resume, const bool& verbose, const unsigned int& num_threads) {
+  OfflineOptions options;
+  options.mode = mode;
+  options.input = input;
+  options.output = output;
+  options.is_video = is_video;
+  options.with_depth = with_depth;
+  options.save_images = save_images;
+  options.resume = resume;
+  options.verbose = verbose;
+  options.num_threads = num_threads;
+  return options;
+}
+
+/**
+ * @brief Adds the letterboxing and the detection stages to an offline pipeline.
+ * @details The images are letterboxed by the reading threads, and detected in batches of the size of the engine.
+ *
+ * @param runner The reference to the offline pipeline.
+ */
+void Detect::addOfflineDetection(OfflineRunner& runner) {
+  runner.addStage("decode", [this](OfflineItem& item) {
+    letterboxImage(item.frame.image, item.padded, item.ratio, item.padding_rows, item.padding_cols);
+    return true;
+  }, runner.getNumThreads());
+  runner.addBatchStage("detect", [this](std::vector<OfflineItem*>& items) {
+    std::vector<cv::Mat> images(items.size());
+    std::vector<std::vector<std::vector<BoundingBox>>> bboxes;
+    for (unsigned int k = 0; k < items.size(); k++) {
+      images[k] = items[k]->padded;
+    }
+    detectObjects(images, bboxes);
+    for (unsigned int k = 0; k < items.size(); k++) {
+      items[k]->frame.bboxes = std::move(bboxes[k]);
+      adjustBoundingBoxes(items[k]->frame.bboxes, items[k]->ratio, items[k]->padding_rows, items[k]->padding_cols);
+      items[k]->padded.release();
+    }
+  }, OD_->getBatchSize());
+}
+
+/**
+ * @brief Detects the objects in a folder of images, or in a video.
+ *
+ * @param input The reference to the folder, or the video.
+ * @param output The reference to the recording the results are written to.
+ * @param is_video The reference to whether the input is a video.
+ * @param save_images The reference to whether the annotated images are saved, in <output>_images.
+ * @param resume The reference to whether the processing starts after the last frame of the recording.
+ * @param verbose The reference to whether the progress is printed every second.
+ */
+void Detect::applyOffline(const std::string& input, const std::string& output, const bool& is_video,
+                          const bool& save_images, const bool& resume, const bool& verbose) {
+  OfflineRunner runner(makeOfflineOptions("detect", input, output, is_video, false, save_images, resume, verbose, offline_threads_));
+  if (!runner.isOpen()) {
+    return;
+  }
+  addOfflineDetection(runner);
+  runner.setDrawFunction([this](OfflineItem& item) {
+    generateDetectionImage(item.frame.image, item.frame.bboxes, 1.0);
+    return true;
+  });
+  runner.run();
+}
+
+/**
+ * @brief Detects the objects in the images of a folder.
+ * @details The images are processed in the order of their names. See OfflineSource and OfflineRunner.
+ *
+ * @param input The folder of images.
+ * @param output The recording the results are written to.
+ * @param save_images Whether the annotated images are saved, in <output>_images.
+ * @param resume Whether the processing starts after the last frame of the recording.
+ * @param verbose Whether the progress is printed every second.
+ */
+void Detect::applyOnFolder(std::string input, std::string output, bool save_images, bool resume, bool verbose) {
+  applyOffline(input, output, false, save_images, resume, verbose);
+}
+
+/**
+ * @brief Detects the objects in the frames of a video.
+ * @details See OfflineSource and OfflineRunner.
+ *
+ * @param input The video.
+ * @param output The recording the results are written to.
+ * @param save_images Whether the annotated images are saved, in <output>_images.
+ * @param resume Whether the processing starts after the last frame of the recording.
+ * @param verbose Whether the progress is printed every second.
+ */
+void Detect::applyOnVideo(std::string input, std::string output, bool save_images, bool resume, bool verbose) {
+  applyOffline(input, output, true, save_images, resume, verbose);
+}
+
+/**
+ * @brief Detects and locates the objects in a folder of images, or in a video.
+ * @details The objects of several frames are located at once.
+ *
+ * @param input The reference to the folder, or the video.
+ * @param output The reference to the recording the results are written to.
+ * @param is_video The reference to whether the input is a video.
+ * @param save_images The reference to whether the annotated images are saved, in <output>_images.
+ * @param resume The reference to whether the processing starts after the last frame of the recording.
+ * @param verbose The reference to whether the progress is printed every second.
+ */
+void DetectAndLocate::applyOffline(const std::string& input, const std::string& output, const bool& is_video,
+                                   const bool& save_images, const bool& resume, const bool& verbose) {
+  OfflineRunner runner(makeOfflineOptions("locate", input, output, is_video, true, save_images, resume, verbose, offline_threads_));
+  if (!runner.isOpen()) {
+    return;
+  }
+  addOfflineDetection(runner);
+  runner.addStage("locate", [this](OfflineItem& item) {
+    item.frame.distances = PE_->extractDistanceFromDepth(item.frame.depth, item.frame.bboxes);
+    item.frame.points = PE_->estimatePosition(item.frame.distances, item.frame.bboxes);
+    return true;
+  }, runner.getNumThreads());
+  runner.setDrawFunction([this](OfflineItem& item) {
+    generateDetectionImage(item.frame.image, item.frame.bboxes, 1.0);
+    return true;
+  });
+  runner.run();
+}
+
+/**
+ * @brief Detects and locates the objects in the images of a folder.
+ * @details The depth images are read from <input>/depth. See applyOffline.
+ *
+ * @param input The folder of images.
+ * @param output The recording the results are written to.
+ * @param save_images Whether the annotated images are saved, in <output>_images.
+ * @param resume Whether the processing starts after the last frame of the recording.
+ * @param verbose Whether the progress is printed every second.
+ */
+void DetectAndLocate::applyOnFolder(std::string input, std::string output, bool save_images, bool resume, bool verbose) {
+  applyOffline(input, output, false, save_images, resume, verbose);
+}
+
+/**
+ * @brief Detects and locates the objects in the frames of a video.
+ * @details The depth images are read from the <video>_depth folder, next to the video. See applyOffline.
+ *
+ * @param input The video.
+ * @param output The recording the results are written to.
+ * @param save_images Whether the annotated images are saved, in <output>_images.
+ * @param resume Whether the processing starts after the last frame of the recording.
+ * @param verbose Whether the progress is printed every second.
+ */
+void DetectAndLocate::applyOnVideo(std::string input, std::string output, bool save_images, bool resume, bool verbose) {
+  applyOffline(input, output, true, save_images, resume, verbose);
+}
+
+/**
+ * @brief Detects and tracks the objects in a folder of images, or in a video.
+ * @details The frames are tracked in order.
+ *
+ * @param input The reference to the folder, or the video.
+ * @param output The reference to the recording the results are written to.
+ * @param is_video The reference to whether the input is a video.
+ * @param save_images The reference to whether the annotated images are saved, in <output>_images.
+ * @param resume The reference to whether the processing starts after the last frame of the recording.
+ * @param verbose The reference to whether the progress is printed every second.
+ */
+void DetectAndTrack2D::applyOffline(const std::string& input, const std::string& output, const bool& is_video,
+                                    const bool& save_images, const bool& resume, const bool& verbose) {
+  OfflineRunner runner(makeOfflineOptions("track2D", input, output, is_video, false, save_images, resume, verbose, offline_threads_));
+  if (!runner.isOpen()) {
+    return;
+  }
+  addOfflineDetection(runner);
+  runner.addStage("track", [this](OfflineItem& item) {
+    return Track2D::trackFrame(item.frame);
+  }, 1);
+  runner.setDrawFunction([this](OfflineItem& item) {
+    generateTrackingImage(item.frame.image, item.frame.tracker_states, 1.0);
+    return true;
+  });
+  runner.run();
+}
+
+/**
+ * @brief Detects and tracks the objects in the images of a folder.
+ * @details The images are tracked in the order of their names. See applyOffline.
+ *
+ * @param input The folder of images.
+ * @param output The recording the results are written to.
+ * @param save_images Whether the annotated images are saved, in <output>_images.
+ * @param resume Whether the processing starts after the last frame of the recording.
+ * @param verbose Whether the progress is printed every second.
+ */
+void DetectAndTrack2D::applyOnFolder(std::string input, std::string output, bool save_images, bool resume, bool verbose) {
+  applyOffline(input, output, false, save_images, resume, verbose);
+}
+
+/**
+ * @brief Detects and tracks the objects in the frames of a video.
+ * @details The frames are tracked in order. See applyOffline.
+ *
+ * @param input The video.
+ * @param output The recording the results are written to.
+ * @param save_images Whether the annotated images are saved, in <output>_images.
+ * @param resume Whether the processing starts after the last frame of the recording.
+ * @param verbose Whether the progress is printed every second.
+ */
+void DetectAndTrack2D::applyOnVideo(std::string input, std::string output, bool save_images, bool resume, bool verbose) {
+  applyOffline(input, output, true, save_images, resume, verbose);
+}
+
+/**
+ * @brief Detects, tracks, and locates the tracked objects in a folder of images, or in a video.
+ * @details The frames are tracked in order, the tracks of several frames are located at once.
+ *
+ * @param input The reference to the folder, or the video.
+ * @param output The reference to the recording the results are written to.
+ * @param is_video The reference to whether the input is a video.
+ * @param save_images The reference to whether the annotated images are saved, in <output>_images.
+ * @param resume The reference to whether the processing starts after the last frame of the recording.
+ * @param verbose The reference to whether the progress is printed every second.
+ */
+void DetectTrack2DAndLocate::applyOffline(const std::string& input, const std::string& output, const bool& is_video,
+                                          const bool& save_images, const bool& resume, const bool& verbose) {
+  OfflineRunner runner(makeOfflineOptions("track2D_locate", input, output, is_video, true, save_images, resume, verbose, offline_threads_));
+  if (!runner.isOpen()) {
+    return;
+  }
+  addOfflineDetection(runner);
+  runner.addStage("track", [this](OfflineItem& item) {
+    return Track2D::trackFrame(item.frame);
+  }, 1);
+  runner.addStage("locate", [this](OfflineItem& item) {
+    item.frame.track_distances = PE_->extractDistanceFromDepth(item.frame.depth, item.frame.tracker_states);
+    item.frame.track_points = PE_->estimatePosition(item.frame.track_distances, item.frame.tracker_states);
+    return true;
+  }, runner.getNumThreads());
+  runner.setDrawFunction([this](OfflineItem& item) {
+    generateTrackingImage(item.frame.image, item.frame.tracker_states, 1.0);
+    return true;
+  });
+  runner.run();
+}
+
+/**
+ * @brief Detects, tracks, and locates the tracked objects in the images of a folder.
+ * @details The depth images are read from <input>/depth. See applyOffline.
+ *
+ * @param input The folder of images.
+ * @param output The recording the results are written to.
+ * @param save_images Whether the annotated images are saved, in <output>_images.
+ * @param resume Whether the processing starts after the last frame of the recording.
+ * @param verbose Whether the progress is printed every second.
+ */
+void DetectTrack2DAndLocate::applyOnFolder(std::string input, std::string output, bool save_images, bool resume, bool verbose) {
+  applyOffline(input, output, false, save_images, resume, verbose);
+}
+
+/**
+ * @brief Detects, tracks, and locates the tracked objects in the frames of a video.
+ * @details The depth images are read from the <video>_depth folder, next to the video. See applyOffline.
+ *
+ * @param input The video.
+ * @param output The recording the results are written to.
+ * @param save_images Whether the annotated images are saved, in <output>_images.
+ * @param resume Whether the processing starts after the last frame of the recording.
+ * @param verbose Whether the progress is printed every second.
+ */
+void DetectTrack2DAndLocate::applyOnVideo(std::string input, std::string output, bool save_images, bool resume, bool verbose) {
+  applyOffline(input, output, true, save_images, resume, verbose);
+}
+
+/**
+ * @brief Detects, locates, and tracks in 3D the objects in a folder of images, or in a video.
+ * @details There is no TF offline: the camera is assumed static, and the objects are tracked in the frame of the camera.
+ * The objects of several frames are located at once, the frames are tracked in order.
+ *
+ * @param input The reference to the folder, or the video.
+ * @param output The reference to the recording the results are written to.
+ * @param is_video The reference to whether the input is a video.
+ * @param save_images The reference to whether the annotated images are saved, in <output>_images.
+ * @param resume The reference to whether the processing starts after the last frame of the recording.
+ * @param verbose The reference to whether the progress is printed every second.
+ */
+void DetectAndTrack3D::applyOffline(const std::string& input, const std::string& output, const bool& is_video,
+                                    const bool& save_images, const bool& resume, const bool& verbose) {
+  OfflineRunner runner(makeOfflineOptions("track3D", input, output, is_video, true, save_images, resume, verbose, offline_threads_));
+  if (!runner.isOpen()) {
+    return;
+  }
+  if (use_frustum_) {
+    setCameraIntrinsics(PE_->getFx(), PE_->getFy(), PE_->getCx(), PE_->getCy(), PE_->getImageWidth(), PE_->getImageHeight());
+    setCameraPose(std::vector<float>{0, 0, 0}, std::vector<float>{0, 0, 0, 1});
+  }
+  addOfflineDetection(runner);
+  runner.addStage("locate", [this](OfflineItem& item) {
+    item.frame.distances = PE_->extractDistanceFromDepth(item.frame.depth, item.frame.bboxes);
+    item.frame.points = PE_->estimatePosition(item.frame.distances, item.frame.bboxes);
+    make3DBoundingBoxes(item.frame.points, item.frame.bboxes, item.frame.bboxes3D);
+    return true;
+  }, runner.getNumThreads());
+  runner.addStage("track", [this](OfflineItem& item) {
+    return Track3D::trackFrame(item.frame);
+  }, 1);
+  runner.setDrawFunction([this](OfflineItem& item) {
+    generateDetectionImage(item.frame.image, item.frame.bboxes, 1.0);
+    return true;
+  });
+  runner.run();
+}
+
+/**
+ * @brief Detects, locates, and tracks in 3D the objects in the images of a folder.
+ * @details The camera is assumed static. See applyOffline.
+ *
+ * @param input The folder of images.
+ * @param output The recording the results are written to.
+ * @param save_images Whether the annotated images are saved, in <output>_images.
+ * @param resume Whether the processing starts after the last frame of the recording.
+ * @param verbose Whether the progress is printed every second.
+ */
+void DetectAndTrack3D::applyOnFolder(std::string input, std::string output, bool save_images, bool resume, bool verbose) {
+  applyOffline(input, output, false, save_images, resume, verbose);
+}
+
+/**
+ * @brief Detects, locates, and tracks in 3D the objects in the frames of a video.
+ * @details The camera is assumed static. See applyOffline.
+ *
+ * @param input The video.
+ * @param output The recording the results are written to.
+ * @param save_images Whether the annotated images are saved, in <output>_images.
+ * @param resume Whether the processing starts after the last frame of the recording.
+ * @param verbose Whether the progress is printed every second.
+ */
+void DetectAndTrack3D::applyOnVideo(std::string input, std::string output, bool save_images, bool resume, bool verbose) {
+  applyOffline(input, output, true, save_images, resume, verbose);
+}
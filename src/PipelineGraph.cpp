@@ -0,0 +1,368 @@
+/**
+ * @file PipelineGraph.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The source code of the pipeline graphs.
+ * @details This file implements the checks of the descriptions, the construction of the pipelines,
+ * and the parallel execution of the branches of a step.
+ */
+
+#include <detect_and_track/PipelineGraph.h>
+#include <algorithm>
+#include <pthread.h>
+
+/**
+ * @brief Construct a new BranchGroup object, and starts its helper threads.
+ *
+ * @param branches The reference to the stages of the branches, at least two.
+ * @param arena_size The reference to the size of the arenas of the helper threads, 0 to allocate on the heap.
+ */
+BranchGroup::BranchGroup(const std::vector<GraphStage>& branches, const size_t& arena_size) {
+  frame_ = nullptr;
+  generation_ = 0;
+  pending_ = 0;
+  running_ = true;
+  branches_.resize(branches.size());
+  arenas_.resize(branches.size());
+  allocation_scopes_.resize(branches.size());
+  results_.resize(branches.size(), 1);
+  for (unsigned int i = 0; i < branches.size(); i++) {
+    branches_[i] = branches[i].function;
+    allocation_scopes_[i] = AllocationAccounting::getScope(branches[i].name);
+    if (arena_size > 0) {
+      arenas_[i].reset(new FrameArena(arena_size));
+    }
+  }
+  // The first branch runs on the thread of the stage.
+  for (unsigned int i = 1; i < branches.size(); i++) {
+    threads_.push_back(std::thread(&BranchGroup::run, this, i, branches[i].name));
+  }
+}
+
+/**
+ * @brief Destroy the BranchGroup object.
+ * @details Stops and joins the helper threads. The pipeline must be stopped first.
+ *
+ */
+BranchGroup::~BranchGroup() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  start_cv_.notify_all();
+  for (unsigned int i = 0; i < threads_.size(); i++) {
+    threads_[i].join();
+  }
+}
+
+/**
+ * @brief The loop of a helper thread.
+ *
+ * @param index The reference to the index of the branch run by the thread.
+ * @param name The reference to the name of the branch, used to name the thread.
+ */
+void BranchGroup::run(const unsigned int& index, const std::string& name) {
+  pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+  uint64_t generation = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    start_cv_.wait(lock, [this, &generation]{return (generation_ != generation) || !running_;});
+    if (!running_) {
+      break;
+    }
+    generation = generation_;
+    PipelineFrame* frame = frame_;
+    lock.unlock();
+    bool keep;
+    {
+      AllocationScope scope(allocation_scopes_[index]);
+      FrameArenaScope arena(arenas_[index].get());
+      keep = branches_[index](*frame);
+    }
+    lock.lock();
+    results_[index] = keep;
+    pending_ --;
+    if (pending_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+/**
+ * @brief Runs all the branches on a frame, and waits for them.
+ * @details Called by the thread of the stage. The branches write distinct fields of the frame, see PipelineGraph.
+ *
+ * @param frame The reference to the frame.
+ * @return False if any branch returned false.
+ */
+bool BranchGroup::process(PipelineFrame& frame) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frame_ = &frame;
+    pending_ = threads_.size();
+    generation_ ++;
+  }
+  start_cv_.notify_all();
+  results_[0] = branches_[0](frame);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this]{return pending_ == 0;});
+  frame_ = nullptr;
+  for (unsigned int i = 0; i < results_.size(); i++) {
+    if (!results_[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Construct a new PipelineGraph object
+ *
+ */
+PipelineGraph::PipelineGraph() {
+  arena_size_ = 0;
+}
+
+/**
+ * @brief Registers a stage, such that the descriptions can use it.
+ * @details A stage registered under an existing name replaces it.
+ *
+ * @param stage The reference to the stage.
+ */
+void PipelineGraph::addStage(const GraphStage& stage) {
+  stages_[stage.name] = stage;
+}
+
+/**
+ * @brief Sets the size of the arenas of the helper threads of the branches.
+ *
+ * @param size The reference to the size of each arena, in bytes. 0 allocates the temporaries on the heap.
+ */
+void PipelineGraph::setArenaSize(const size_t& size) {
+  arena_size_ = size;
+}
+
+/**
+ * @brief Checks a description.
+ *
+ * @param description The reference to the description.
+ * @param ingested The reference to the FrameField flags filled before the frames enter the pipeline.
+ * @param available The reference to the flags available at the end of the pipeline.
+ * @return False if the description is invalid, the reason is printed.
+ */
+bool PipelineGraph::validate(const GraphDescription& description, const unsigned int& ingested, unsigned int& available) const {
+  available = ingested;
+  if (description.empty()) {
+    printf("[ERROR ] PipelineGraph::%s::l%d The pipeline has no stage.\n", __func__, __LINE__);
+    return false;
+  }
+  std::vector<std::string> used;
+  for (unsigned int s = 0; s < description.size(); s++) {
+    if (description[s].empty()) {
+      printf("[ERROR ] PipelineGraph::%s::l%d Step %u has no stage.\n", __func__, __LINE__, s);
+      return false;
+    }
+    unsigned int written = 0;
+    for (unsigned int b = 0; b < description[s].size(); b++) {
+      const std::string& name = description[s][b];
+      auto stage = stages_.find(name);
+      if (stage == stages_.end()) {
+        printf("[ERROR ] PipelineGraph::%s::l%d Unknown stage \"%s\".\n", __func__, __LINE__, name.c_str());
+        return false;
+      }
+      if (std::find(used.begin(), used.end(), name) != used.end()) {
+        printf("[ERROR ] PipelineGraph::%s::l%d The stage \"%s\" is used twice.\n", __func__, __LINE__, name.c_str());
+        return false;
+      }
+      used.push_back(name);
+      const unsigned int missing = stage->second.reads & ~available;
+      if (missing != 0) {
+        printf("[ERROR ] PipelineGraph::%s::l%d The stage \"%s\" reads %s, which no earlier stage writes.\n",
+               __func__, __LINE__, name.c_str(), getFieldNames(missing).c_str());
+        return false;
+      }
+      if ((stage->second.writes & written) != 0) {
+        printf("[ERROR ] PipelineGraph::%s::l%d The branches of step %u both write %s.\n", __func__, __LINE__, s,
+               getFieldNames(stage->second.writes & written).c_str());
+        return false;
+      }
+      written |= stage->second.writes;
+    }
+    // A branch must not read what another branch of the same step writes.
+    for (unsigned int b = 0; b < description[s].size(); b++) {
+      const GraphStage& stage = stages_.at(description[s][b]);
+      const unsigned int conflicts = stage.reads & (written & ~stage.writes);
+      if (conflicts != 0) {
+        printf("[ERROR ] PipelineGraph::%s::l%d The stage \"%s\" reads %s, written by a parallel branch.\n",
+               __func__, __LINE__, stage.name.c_str(), getFieldNames(conflicts).c_str());
+        return false;
+      }
+    }
+    available |= written;
+  }
+  return true;
+}
+
+/**
+ * @brief Checks a description, and adds its steps to a pipeline.
+ * @details A step with a single branch becomes a stage of the pipeline. The branches of a step with several
+ * branches run in parallel, in a stage named after them, joined by '|'. Such a stage only processes the most
+ * recent frame if one of its branches does. The pipeline must be stopped.
+ *
+ * @param description The reference to the description.
+ * @param ingested The reference to the FrameField flags filled before the frames enter the pipeline.
+ * @param pipeline The reference to the pipeline.
+ * @return False if the description is invalid, nothing is added to the pipeline.
+ */
+bool PipelineGraph::build(const GraphDescription& description, const unsigned int& ingested, Pipeline<PipelineFrame>& pipeline) {
+  unsigned int available;
+  if (!validate(description, ingested, available)) {
+    return false;
+  }
+  for (unsigned int s = 0; s < description.size(); s++) {
+    if (description[s].size() == 1) {
+      const GraphStage& stage = stages_.at(description[s][0]);
+      pipeline.addStage(stage.name, stage.function, stage.drop_stale);
+      continue;
+    }
+    std::vector<GraphStage> branches;
+    std::string name;
+    bool drop_stale = false;
+    for (unsigned int b = 0; b < description[s].size(); b++) {
+      branches.push_back(stages_.at(description[s][b]));
+      name += (b > 0 ? "|" : "") + description[s][b];
+      drop_stale |= branches.back().drop_stale;
+    }
+    groups_.push_back(std::unique_ptr<BranchGroup>(new BranchGroup(branches, arena_size_)));
+    BranchGroup* group = groups_.back().get();
+    pipeline.addStage(name, [group](PipelineFrame& frame){return group->process(frame);}, drop_stale);
+  }
+  return true;
+}
+
+/**
+ * @brief Stops the helper threads of the branches.
+ * @details Must be called once the pipeline is stopped, and before the stages are destroyed.
+ *
+ */
+void PipelineGraph::stop() {
+  groups_.clear();
+}
+
+/**
+ * @brief Checks if a description uses a stage.
+ *
+ * @param description The reference to the description.
+ * @param name The reference to the name of the stage.
+ * @return True if one of the steps has a branch with this name.
+ */
+bool PipelineGraph::uses(const GraphDescription& description, const std::string& name) {
+  for (unsigned int s = 0; s < description.size(); s++) {
+    if (std::find(description[s].begin(), description[s].end(), name) != description[s].end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Formats a set of fields, for the error messages.
+ *
+ * @param fields The reference to the FrameField flags.
+ * @return The names of the fields, comma separated.
+ */
+std::string PipelineGraph::getFieldNames(const unsigned int& fields) {
+  static const char* names[] = {"image", "depth", "detections", "positions", "3D boxes", "tracks", "track positions"};
+  std::string text;
+  for (unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (fields & (1u << i)) {
+      text += (text.empty() ? "" : ", ") + std::string(names[i]);
+    }
+  }
+  return text;
+}
+
+/**
+ * @brief Formats a description, in the syntax of parseGraphDescription.
+ *
+ * @param description The reference to the description.
+ * @return The description, as text.
+ */
+std::string PipelineGraph::toString(const GraphDescription& description) {
+  std::string text = "[";
+  for (unsigned int s = 0; s < description.size(); s++) {
+    text += (s > 0 ? ", " : "");
+    if (description[s].size() > 1) {
+      text += "[";
+    }
+    for (unsigned int b = 0; b < description[s].size(); b++) {
+      text += (b > 0 ? ", " : "") + description[s][b];
+    }
+    if (description[s].size() > 1) {
+      text += "]";
+    }
+  }
+  return text + "]";
+}
+
+/**
+ * @brief Parses a description written as a YAML flow list.
+ * @details Each item of the list is a step: either the name of a stage, or a list of stages run in parallel.
+ * For instance: [detect, [locate, track2D], locate_tracks, [publish, log]]. The outer brackets are optional.
+ *
+ * @param text The reference to the text.
+ * @param description The reference to the description in which the steps will be stored.
+ * @return False if the text is not a valid description.
+ */
+bool parseGraphDescription(const std::string& text, GraphDescription& description) {
+  description.clear();
+  size_t begin = text.find_first_not_of(" \t\n");
+  size_t end = text.find_last_not_of(" \t\n");
+  if (begin == std::string::npos) {
+    printf("[ERROR ] PipelineGraph::%s::l%d The description is empty.\n", __func__, __LINE__);
+    return false;
+  }
+  std::string body = text.substr(begin, end - begin + 1);
+  if ((body.size() >= 2) && (body.front() == '[') && (body.back() == ']')) {
+    body = body.substr(1, body.size() - 2);
+  }
+  bool nested = false;
+  std::string name;
+  body += ',';
+  for (const char c : body) {
+    if (c == '[') {
+      if (nested || !name.empty()) {
+        printf("[ERROR ] PipelineGraph::%s::l%d Unexpected '[' in %s.\n", __func__, __LINE__, text.c_str());
+        return false;
+      }
+      nested = true;
+      description.emplace_back();
+    } else if ((c == ']') || (c == ',')) {
+      if (c == ']' && !nested) {
+        printf("[ERROR ] PipelineGraph::%s::l%d Unexpected ']' in %s.\n", __func__, __LINE__, text.c_str());
+        return false;
+      }
+      if (!name.empty()) {
+        if (nested) {
+          description.back().push_back(name);
+        } else {
+          description.push_back(std::vector<std::string>(1, name));
+        }
+        name.clear();
+      }
+      if (c == ']') {
+        nested = false;
+      }
+    } else if ((c != ' ') && (c != '\t') && (c != '\n') && (c != '"') && (c != '\'')) {
+      name += c;
+    }
+  }
+  if (nested) {
+    printf("[ERROR ] PipelineGraph::%s::l%d Missing ']' in %s.\n", __func__, __LINE__, text.c_str());
+    return false;
+  }
+  return true;
+}
@@ -31,7 +31,7 @@
  *  it always ensure that the measured distance is the one of the object. \n 
  * 
  */
-PoseEstimator::PoseEstimator() {}
+PoseEstimator::PoseEstimator() : debug_(false), profile_(false) {}
 
 /**
  * @brief Builds an object dedicated to estimating the distance and position.
@@ -68,6 +68,8 @@ PoseEstimator::PoseEstimator() {}
 PoseEstimator::PoseEstimator(float rejection_threshold, float keep_threshold, int image_height, int image_width,
                              std::vector<float>& camera_parameters, std::vector<float>& K,
                              std::string distortion_model, std::string position_mode) {
+  debug_ = false;
+  profile_ = false;
   rejection_threshold_ = rejection_threshold;
   keep_threshold_ = keep_threshold;
   image_height_ = image_height;
@@ -124,6 +126,8 @@ PoseEstimator::PoseEstimator(float rejection_threshold, float keep_threshold, in
  * @param cam_p A structure that holds the parameters related to the camera.
  */
 PoseEstimator::PoseEstimator(GlobalParameters& glo_p, LocalizationParameters& loc_p, CameraParameters& cam_p) {
+  debug_ = false;
+  profile_ = false;
   rejection_threshold_ = loc_p.reject_thresh;
   keep_threshold_ = loc_p.keep_thresh;
   image_height_ = glo_p.image_height;
@@ -177,6 +181,18 @@ void PoseEstimator::updateCameraParameters(const std::vector<float>& camera_para
   K_ = lens_parameters;
 }
 
+/**
+ * @brief Enables or disables the debug and profiling prints.
+ * @details Both are disabled by default. When disabled, they only cost a branch per object.
+ * 
+ * @param debug True to print the debug messages.
+ * @param profile True to print the time taken to compute the distance of each object.
+ */
+void PoseEstimator::setVerbosity(const bool& debug, const bool& profile) {
+  debug_ = debug;
+  profile_ = profile;
+}
+
 float PoseEstimator::getFx(){
   return fx_;
 }
@@ -185,6 +201,22 @@ float PoseEstimator::getFy(){
   return fy_;
 }
 
+float PoseEstimator::getCx(){
+  return cx_;
+}
+
+float PoseEstimator::getCy(){
+  return cy_;
+}
+
+int PoseEstimator::getImageWidth(){
+  return image_width_;
+}
+
+int PoseEstimator::getImageHeight(){
+  return image_height_;
+}
+
 
 /**
  * @brief Computes the position of the pixel in the camera's local frame.
@@ -315,6 +347,23 @@ void PoseEstimator::distancePixel2PointBrownConrady(const float& dist, const std
   point[2] = z;
 }
 
+/**
+ * @brief Reads the depth of a pixel.
+ * @details The depth images can either be float images in meters, or 16 bits images in millimeters
+ * as published by the depth cameras. The latter are used as is, without converting the whole image.
+ * 
+ * @param depth_image The reference to the depth image.
+ * @param row The reference to the row of the pixel.
+ * @param col The reference to the column of the pixel.
+ * @return The depth of the pixel, in meters.
+ */
+float PoseEstimator::getDepth(const cv::Mat& depth_image, const int& row, const int& col) {
+  if (depth_image.type() == CV_16UC1) {
+    return depth_image.at<uint16_t>(row, col) * 0.001f;
+  }
+  return depth_image.at<float>(row, col);
+}
+
 /**
  * @brief Computes the distance between an object and the camera.
  * @details Computes the distance between an object and the camera.
@@ -362,13 +411,14 @@ float PoseEstimator::getDistance(const cv::Mat& depth_image, const int& x_min, c
 float PoseEstimator::getMinDistance(const cv::Mat& depth_image, const int& x_min, const int& y_min, const int& width, const int& height ) {
   float z, d, distance;
   size_t reject, keep;
-  std::vector<float> distances((int) (height*width), 0);
+  // The distances are a temporary of the frame, allocated from the arena of the stage.
+  std::pmr::vector<float> distances((int) (height*width), 0, FrameArena::getResource());
   std::vector<float> point(3,0);
   std::vector<float> pixel(2,0);
   unsigned int c = 0;
   for (int col = x_min; col < (x_min + width); col++) {
     for (int row = y_min; row < (y_min + height); row++) {
-      z = depth_image.at<float>(row, col);
+      z = getDepth(depth_image, row, col);
       if ((z > 0.3) && (z < 10.0)) { // TODO: These values could be parameters.
         pixel[0] = (float) col;
         pixel[1] = (float) row;
@@ -383,8 +433,8 @@ float PoseEstimator::getMinDistance(const cv::Mat& depth_image, const int& x_min
       }
     }
   }
-  std::vector<float> short_distances(distances.begin(), distances.begin() + c);
-  return *std::min_element(short_distances.begin(), short_distances.end());
+  distances.resize(c);
+  return *std::min_element(distances.begin(), distances.end());
 }
 
 /**
@@ -404,14 +454,15 @@ float PoseEstimator::getMinDistance(const cv::Mat& depth_image, const int& x_min
 float PoseEstimator::getMinAverageDistance(const cv::Mat& depth_image, const int& x_min, const int& y_min, const int& width, const int& height ) {
   float z, d, distance;
   size_t reject, keep;
-  std::vector<float> distances((int) (height*width), 0);
+  // The distances are a temporary of the frame, allocated from the arena of the stage.
+  std::pmr::vector<float> distances((int) (height*width), 0, FrameArena::getResource());
   std::vector<float> point(3,0);
   std::vector<float> pixel(2,0);
   unsigned int c = 0;
 
   for (int col = x_min; col < (x_min + width); col++) {
     for (int row = y_min; row < (y_min + height); row++) {
-      z = depth_image.at<float>(row, col);
+      z = getDepth(depth_image, row, col);
       if ((z > 0.3) && (z < 10.0)) {
         pixel[0] = (float) col;
         pixel[1] = (float) row;
@@ -426,11 +477,11 @@ float PoseEstimator::getMinAverageDistance(const cv::Mat& depth_image, const int
       }
     }
   }
-  std::vector<float> short_distances(distances.begin(), distances.begin() + c);
-  reject = short_distances.size() * rejection_threshold_;
-  keep = short_distances.size() * keep_threshold_;
-  std::sort(short_distances.begin(), short_distances.end(), std::less<float>());
-  return std::accumulate(short_distances.begin() + reject, short_distances.begin() + reject+keep, 0.0)/keep;
+  distances.resize(c);
+  reject = distances.size() * rejection_threshold_;
+  keep = distances.size() * keep_threshold_;
+  std::sort(distances.begin(), distances.end(), std::less<float>());
+  return std::accumulate(distances.begin() + reject, distances.begin() + reject+keep, 0.0)/keep;
 }
 
 /**
@@ -452,7 +503,7 @@ float PoseEstimator::getCenterDistance(const cv::Mat& depth_image, const int& x_
   std::vector<float> pixel(2,0);
   col = x_min + width / 2;
   row = y_min + height / 2;
-  z = depth_image.at<float>(row, col);
+  z = getDepth(depth_image, row, col);
   pixel[0] = (float) col;
   pixel[1] = (float) row;
   if (distortion_model_ == 1) {
@@ -479,9 +530,9 @@ std::vector<std::vector<float>> PoseEstimator::extractDistanceFromDepth(const cv
 
   // If the image does not exist, return -1 as distance.
   if (depth_image.empty()) {
-#ifdef DEBUG_POSE
-    printf("\e[1;31m[DEBUG  ]\e[0m PoseEstimator::%s::l%d - Depth image hasn't been received yet. Setting distance to -1.\n", __func__, __LINE__);
-#endif
+    if (RUNTIME_OPTION(debug_)) {
+      printf("\e[1;31m[DEBUG  ]\e[0m PoseEstimator::%s::l%d - Depth image hasn't been received yet. Setting distance to -1.\n", __func__, __LINE__);
+    }
     for (unsigned int i=0; i < bboxes.size(); i++) {
       distance_vector.clear();
       for (unsigned int j=0; j < bboxes[i].size(); j++) {
@@ -499,26 +550,27 @@ std::vector<std::vector<float>> PoseEstimator::extractDistanceFromDepth(const cv
   for (unsigned int i=0; i < bboxes.size(); i++) {
     distance_vector.clear();
     for (unsigned int j=0; j < bboxes[i].size(); j++) {
-#ifdef PROFILE
-    auto start_distance = std::chrono::system_clock::now();
-#endif
+      std::chrono::time_point<std::chrono::system_clock> start_distance;
+      if (RUNTIME_OPTION(profile_)) {
+        start_distance = std::chrono::system_clock::now();
+      }
       // If the bounding box is invalid use -1 as distance.
       if (!bboxes[i][j].valid_) {
-#ifdef DEBUG_POSE
-        printf("\e[1;33m[DEBUG  ]\e[0m PoseEstimator::%s::l%d - Bounding box is invalid, setting distance to -1.\n", __func__, __LINE__);
-#endif
+        if (RUNTIME_OPTION(debug_)) {
+          printf("\e[1;33m[DEBUG  ]\e[0m PoseEstimator::%s::l%d - Bounding box is invalid, setting distance to -1.\n", __func__, __LINE__);
+        }
         distance_vector.push_back(-1);
-#ifdef PROFILE
-        auto end_distance = std::chrono::system_clock::now();
-        printf("\e[1;34m[PROFILE]\e[0m PoseEstimator::%s::l%d - Obj %d distance done in %ld us\n", __func__, __LINE__,  i, std::chrono::duration_cast<std::chrono::microseconds>(end_distance - start_distance).count());
-#endif
+        if (RUNTIME_OPTION(profile_)) {
+          auto end_distance = std::chrono::system_clock::now();
+          printf("\e[1;34m[PROFILE]\e[0m PoseEstimator::%s::l%d - Obj %d distance done in %ld us\n", __func__, __LINE__,  i, std::chrono::duration_cast<std::chrono::microseconds>(end_distance - start_distance).count());
+        }
         continue;
       }
       distance_vector.push_back(getDistance(depth_image, (int) bboxes[i][j].x_min_, (int) bboxes[i][j].y_min_, (int) bboxes[i][j].w_, (int) bboxes[i][j].h_ ));
-#ifdef PROFILE
-      auto end_distance = std::chrono::system_clock::now();
-      printf("\e[1;34m[PROFILE]\e[0m PoseEstimator::%s::l%d - Obj %d distance time %ld us\n", __func__, __LINE__,  i, std::chrono::duration_cast<std::chrono::microseconds>(end_distance - start_distance).count());
-#endif
+      if (RUNTIME_OPTION(profile_)) {
+        auto end_distance = std::chrono::system_clock::now();
+        printf("\e[1;34m[PROFILE]\e[0m PoseEstimator::%s::l%d - Obj %d distance time %ld us\n", __func__, __LINE__,  i, std::chrono::duration_cast<std::chrono::microseconds>(end_distance - start_distance).count());
+      }
     }
     distance_vectors.push_back(distance_vector);
   }
@@ -544,9 +596,9 @@ std::vector<std::map<unsigned int, float>> PoseEstimator::extractDistanceFromDep
 
   // If the image does not exist, return -1 as distance.
   if (depth_image.empty()) {
-#ifdef DEBUG_POSE
-    printf("\e[1;33m[DEBUG  ]\e[0m PoseEstimator::%s::l%d - Depth image hasn't been received yet. Setting distance to -1.\n", __func__, __LINE__);
-#endif
+    if (RUNTIME_OPTION(debug_)) {
+      printf("\e[1;33m[DEBUG  ]\e[0m PoseEstimator::%s::l%d - Depth image hasn't been received yet. Setting distance to -1.\n", __func__, __LINE__);
+    }
     for (unsigned int i=0; i < tracked_states.size(); i++) {
       for (auto & element : tracked_states[i]) {
         distance_maps[i].insert(std::pair(element.first, -1));
@@ -558,18 +610,19 @@ std::vector<std::map<unsigned int, float>> PoseEstimator::extractDistanceFromDep
   // Computes the distance to all the objects.
   for (unsigned int i=0; i < tracked_states.size(); i++) {
     for (auto & element : tracked_states[i]) {
-#ifdef PROFILE
-    auto start_distance = std::chrono::system_clock::now();
-#endif
-    dist = getDistance(depth_image, (int) element.second[0], (int) element.second[1], (int) element.second[4], (int) element.second[5]);
-    distance_maps[i].insert(std::pair(element.first, dist));
-#ifdef PROFILE
-      auto end_distance = std::chrono::system_clock::now();
-      printf("\e[1;34m[PROFILE]\e[0m PoseEstimator::%s::l%d - Obj %d distance time %ld us\n", __func__, __LINE__,  i, std::chrono::duration_cast<std::chrono::microseconds>(end_distance - start_distance).count());
-#endif
-#ifdef DEBUG_POSE
-      printf("\e[1;33m[DEBUG  ]\e[0m PoseEstimator::%s::l%d - Distance of tracked object %d is %.3f.\n", __func__, __LINE__, element.first, dist);
-#endif
+      std::chrono::time_point<std::chrono::system_clock> start_distance;
+      if (RUNTIME_OPTION(profile_)) {
+        start_distance = std::chrono::system_clock::now();
+      }
+      dist = getDistance(depth_image, (int) element.second[0], (int) element.second[1], (int) element.second[4], (int) element.second[5]);
+      distance_maps[i].insert(std::pair(element.first, dist));
+      if (RUNTIME_OPTION(profile_)) {
+        auto end_distance = std::chrono::system_clock::now();
+        printf("\e[1;34m[PROFILE]\e[0m PoseEstimator::%s::l%d - Obj %d distance time %ld us\n", __func__, __LINE__,  i, std::chrono::duration_cast<std::chrono::microseconds>(end_distance - start_distance).count());
+      }
+      if (RUNTIME_OPTION(debug_)) {
+        printf("\e[1;33m[DEBUG  ]\e[0m PoseEstimator::%s::l%d - Distance of tracked object %d is %.3f.\n", __func__, __LINE__, element.first, dist);
+      }
     }
   }
   return distance_maps;
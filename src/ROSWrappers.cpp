@@ -1,5 +1,113 @@
 #include <detect_and_track/ROSWrappers.h>
 
+/**
+ * @brief Reads the runtime options of a node.
+ * @details The options are read once, when the node is built. Profiling and the debug prints are disabled by default.
+ * 
+ * @param nh The reference to the private node handle of the node.
+ * @param options The reference to the options to fill.
+ */
+void readRuntimeOptions(const ros::NodeHandle& nh, RuntimeOptions& options) {
+  nh.param("profile", options.profile, false);
+  nh.param("publish_debug_images", options.publish_debug_images, true);
+  nh.param("publish_positions_with_bboxes", options.publish_positions_with_bboxes, true);
+  nh.param("publish_legacy_topics", options.publish_legacy_topics, true);
+  nh.param("debug_pose", options.debug_pose, false);
+}
+
+/**
+ * @brief Formats the value of a parameter as text, for the recordings.
+ * @details The lists are written as comma separated values.
+ * 
+ * @param value The reference to the value of the parameter.
+ * @param text The reference to the string in which the text will be stored.
+ * @return False if the type of the parameter is not supported (structs and binary data).
+ */
+static bool formatParameter(XmlRpc::XmlRpcValue& value, std::string& text) {
+  char buffer[32];
+  switch (value.getType()) {
+    case XmlRpc::XmlRpcValue::TypeBoolean:
+      text = static_cast<bool>(value) ? "true" : "false";
+      return true;
+    case XmlRpc::XmlRpcValue::TypeInt:
+      text = std::to_string(static_cast<int>(value));
+      return true;
+    case XmlRpc::XmlRpcValue::TypeDouble:
+      snprintf(buffer, sizeof(buffer), "%.9g", static_cast<double>(value));
+      text = buffer;
+      return true;
+    case XmlRpc::XmlRpcValue::TypeString:
+      text = static_cast<std::string>(value);
+      return true;
+    case XmlRpc::XmlRpcValue::TypeArray: {
+      text.clear();
+      std::string element;
+      for (int i=0; i < value.size(); i++) {
+        if ((value[i].getType() == XmlRpc::XmlRpcValue::TypeArray) || !formatParameter(value[i], element)) {
+          return false;
+        }
+        text += (i > 0 ? "," : "") + element;
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Reads the parameters of a tracker.
+ * @details The defaults are the ones of the 2D or 3D tracking nodes.
+ * 
+ * @param nh The reference to the private node handle of the node.
+ * @param is_3D The reference to the flag selecting the 3D defaults.
+ * @param det_p The reference to the detection parameters, the classes are read.
+ * @param kal_p The reference to the Kalman parameters.
+ * @param tra_p The reference to the tracking parameters.
+ * @param bbo_p The reference to the bounding box rejection parameters.
+ */
+static void readTrackingParameters(const ros::NodeHandle& nh, const bool& is_3D, DetectionParameters& det_p,
+                                   KalmanParameters& kal_p, TrackingParameters& tra_p, BBoxRejectionParameters& bbo_p) {
+  // Model parameters
+  std::vector<std::string> default_class_map {std::string("object")};
+  nh.param("num_classes", det_p.num_classes, 1);
+  nh.param("class_map", det_p.class_map, default_class_map);
+  // Kalman parameters
+  std::vector<float> default_Q {9.0, 9.0, 200.0, 200.0, 5.0, 5.0};
+  std::vector<float> default_R {2.0, 2.0, 200.0, 200.0, 2.0, 2.0};
+  if (is_3D) {
+    default_Q = {0.25, 0.25, 0.25, 25.0, 25.0, 25.0, 0.25, 0.25, 0.25};
+    default_R = {0.125, 0.125, 0.125, 25.0, 25.0, 25.0, 0.125, 0.125, 0.125};
+  }
+  nh.param("Q", kal_p.Q, default_Q);
+  nh.param("R", kal_p.R, default_R);
+  nh.param("use_vel", kal_p.use_vel, false);
+  nh.param("use_dim", kal_p.use_dim, true);
+  // Tracking parameters
+  nh.param("center_threshold", tra_p.center_thresh, 80.0f);
+  nh.param("dist_threshold", tra_p.distance_thresh, 150.0f);
+  nh.param("body_ratio", tra_p.body_ratio, 0.5f);
+  nh.param("area_threshold", tra_p.area_thresh, 2.0f);
+  nh.param("dt", tra_p.dt, 0.02f);
+  nh.param("max_frames_to_skip", tra_p.max_frames_to_skip, 10);
+  nh.param("checkpoint_path", tra_p.checkpoint_path, tra_p.checkpoint_path);
+  nh.param("checkpoint_period", tra_p.checkpoint_period, 5.0f);
+  nh.param("checkpoint_max_age", tra_p.checkpoint_max_age, 30.0f);
+  if (is_3D) {
+    nh.param("static_objects", tra_p.static_objects, false);
+    nh.param("voxel_size", tra_p.voxel_size, tra_p.distance_thresh);
+    nh.param("use_frustum", tra_p.use_frustum, false);
+    nh.param("frustum_min_depth", tra_p.frustum_min_depth, 0.1f);
+    nh.param("frustum_max_depth", tra_p.frustum_max_depth, 20.0f);
+    nh.param("frustum_margin", tra_p.frustum_margin, 0.0f);
+  }
+  // BBox rejection
+  nh.param("min_bbox_width", bbo_p.min_bbox_width, 60);
+  nh.param("max_bbox_width", bbo_p.max_bbox_width, 400);
+  nh.param("min_bbox_height", bbo_p.min_bbox_height, 60);
+  nh.param("max_bbox_height", bbo_p.max_bbox_height, 300);
+}
+
 /**
  * @brief Constructs a ROS node to perform object detection.
  * @details This class wrapps around the object detector and integrates
@@ -9,7 +117,16 @@
  * of the original image.
  * 
  */
-ROSDetect::ROSDetect() : nh_("~"), it_(nh_), Detect() {
+ROSDetect::ROSDetect() : ROSDetect(ros::NodeHandle("~")) {}
+
+/**
+ * @brief Constructs a ROS node to perform object detection, using the given node handle.
+ * @details Used by the nodelets, which must use the node handle provided by the nodelet manager.
+ * The parameters are read from, and the outputs published in, the namespace of the node handle.
+ * 
+ * @param nh The private node handle of the node.
+ */
+ROSDetect::ROSDetect(const ros::NodeHandle& nh) : nh_(nh), it_(nh_), Detect() {
   // Empty structs
   GlobalParameters glo_p;
   DetectionParameters det_p;
@@ -29,34 +146,167 @@ ROSDetect::ROSDetect() : nh_("~"), it_(nh_), Detect() {
   nh_.param("num_classes", det_p.num_classes, 1);
   nh_.param("class_map", det_p.class_map, default_class_map);
   nh_.param("num_buffers", det_p.num_buffers, 2);
+  // Pipeline parameters
+  int queue_size;
+  int arena_size;
+  nh_.param("pipeline_queue_size", queue_size, 4);
+  nh_.param("frame_arena_size", arena_size, 1 << 20);
+  // Callback queues parameters
+  nh_.param("use_callback_queues", use_callback_queues_, true);
+  nh_.param("callback_threads", callback_threads_, 1);
+  // Runtime options
+  readRuntimeOptions(nh_, options_);
+  setDetectionProfiling(options_.profile);
+  // Diagnostics parameters
+  float diagnostics_period;
+  nh_.param("diagnostics_period", diagnostics_period, 1.0f);
+  // Tracing parameters
+  int trace_size;
+  std::string trace_path;
+  nh_.param("trace_size", trace_size, 0);
+  nh_.param("trace_path", trace_path, std::string(""));
+  // Debug images parameters
+  float visualization_rate;
+  float visualization_scale;
+  nh_.param("visualization_rate", visualization_rate, 10.0f);
+  nh_.param("visualization_scale", visualization_scale, 1.0f);
+  visualization_ = new VisualizationWorker(visualization_rate, visualization_scale);
+  // Shared-memory export parameters
+  std::string shm_name;
+  int shm_slots;
+  bool shm_export_images;
+  nh_.param("shm_name", shm_name, std::string(""));
+  nh_.param("shm_slots", shm_slots, 8);
+  nh_.param("shm_export_images", shm_export_images, true);
+  // Recording parameters
+  std::string record_path;
+  int record_buffer_size;
+  float record_flush_period;
+  nh_.param("record_path", record_path, std::string(""));
+  nh_.param("record_buffer_size", record_buffer_size, 64 << 20);
+  nh_.param("record_flush_period", record_flush_period, 1.0f);
+  nh_.param("record_margin", record_margin_, 0);
+  // Columnar log parameters
+  std::string column_log_path;
+  int column_log_segment_rows;
+  nh_.param("column_log_path", column_log_path, std::string(""));
+  nh_.param("column_log_segment_rows", column_log_segment_rows, 65536);
   // Initializes the detector
   buildDetect(glo_p, det_p, nms_p);
+  shm_exporter_ = nullptr;
+  if (!shm_name.empty()) {
+    shm_exporter_ = new SharedMemoryExporter(shm_name, shm_slots, glo_p.image_height, glo_p.image_width, shm_export_images);
+    if (!shm_exporter_->isOpen()) {
+      ROS_ERROR("Could not create the shared-memory ring buffers %s_*, the frames are not exported.", shm_name.c_str());
+    }
+  }
+  // The mode is set by the derived nodes, the parameters are recorded with the first frame.
+  record_mode_ = "detect";
+  record_parameters_ = false;
+  recorder_ = nullptr;
+  if (!record_path.empty()) {
+    recorder_ = new RecordWriter(record_path, std::max(record_buffer_size, 1 << 20), 0, false, record_flush_period);
+    if (!recorder_->isOpen()) {
+      ROS_ERROR("Could not create the recording %s, the detections are not recorded.", record_path.c_str());
+      delete recorder_;
+      recorder_ = nullptr;
+    }
+  }
+  column_log_ = nullptr;
+  if (!column_log_path.empty()) {
+    column_log_ = new ColumnLogWriter();
+    if (!column_log_->open(column_log_path, std::max(column_log_segment_rows, 1024))) {
+      ROS_ERROR("Could not open the columnar log %s, the detections and the tracks are not logged.", column_log_path.c_str());
+      delete column_log_;
+      column_log_ = nullptr;
+    }
+  }
+  // The stages are added on the first image, once the node is fully constructed.
+  pipeline_ = new Pipeline<PipelineFrame>(queue_size);
+  pipeline_->setArenaSize(std::max(arena_size, 0));
+  // The latencies are only recorded if they are published.
+  instrumentation_ = nullptr;
+  publish_histogram_ = nullptr;
+  diagnostics_ = nullptr;
+  diagnostics_queue_ = nullptr;
+  if (diagnostics_period > 0) {
+    instrumentation_ = new Instrumentation();
+    publish_histogram_ = instrumentation_->getHistogram("publish");
+    diagnostics_queue_ = addInputQueue("diagnostics");
+    diagnostics_ = new DiagnosticsPublisher(diagnostics_queue_->getNodeHandle(), nh_.getNamespace(), diagnostics_period,
+                                            instrumentation_, pipeline_);
+  }
+  setDetectionInstrumentation(instrumentation_);
+  // The spans are only recorded if tracing is enabled.
+  trace_ = nullptr;
+  trace_service_ = nullptr;
+  if (trace_size > 0) {
+    trace_ = new TraceBuffer(trace_size);
+    pipeline_->setTrace(trace_);
+    trace_service_ = new TraceService(nh_, trace_path, trace_);
+  }
 
   // Creates the subscribers and publishers
-  image_sub_ = it_.subscribe("/camera/color/image_raw", 1, &ROSDetect::imageCallback, this);
-#ifdef PUBLISH_DETECTION_IMAGE
-  detection_pub_ = it_.advertise("detection_image", 1);
-#endif
+  image_queue_ = addInputQueue("image");
+  image_sub_ = image_transport::ImageTransport(image_queue_->getNodeHandle()).subscribe("/camera/color/image_raw", 1, &ROSDetect::imageCallback, this);
+  if (options_.publish_debug_images) {
+    detection_pub_ = it_.advertise("detection_image", 1);
+  }
   bboxes_pub_ = nh_.advertise<detect_and_track::BoundingBoxes2D>("bounding_boxes", 1);
+  results_pub_ = new FrameResultPublisher(nh_, class_map_, instrumentation_, diagnostics_period, options_.profile);
 }
 
 ROSDetect::~ROSDetect() {
+  stopInputs();
+  delete trace_service_;
+  if (diagnostics_ != nullptr) {
+    diagnostics_->stop();
+  }
+  for (unsigned int i=0; i < input_queues_.size(); i++) {
+    delete input_queues_[i];
+  }
+  pipeline_->stop();
+  visualization_->stop();
+  delete diagnostics_;
+  delete pipeline_;
+  delete visualization_;
+  delete shm_exporter_;
+  delete recorder_;
+  delete column_log_;
+  delete results_pub_;
+  delete instrumentation_;
+  delete trace_;
 }
 
 /**
- * @brief 
- * @details
+ * @brief Hands the detections of a frame over to the visualization worker.
+ * @details Does nothing if nobody subscribed to the detection image, or if the last image was rendered less
+ * than a period ago. The image is shared with the frame, the worker never writes into it.
  * 
- * @param image 
- * @param bboxes 
+ * @param frame The reference to the frame.
+ * @param header The reference to the header of the outputs of the frame.
+ */
+void ROSDetect::submitDetectionImage(const PipelineFrame& frame, const std_msgs::Header& header) {
+  if ((detection_pub_.getNumSubscribers() == 0) || !visualization_->isDue()) {
+    return;
+  }
+  cv::Mat image = frame.image;
+  std::vector<std::vector<BoundingBox>> bboxes = frame.bboxes;
+  visualization_->submit([this, image, bboxes, header](){publishDetectionImage(image, bboxes, header);});
+}
+
+/**
+ * @brief Renders and publishes the detection image. Called by the visualization worker.
+ * 
+ * @param image The reference to the RGB image, it is not modified.
+ * @param bboxes The reference to the detections.
+ * @param header The reference to the header of the outputs of the frame.
  */
-void ROSDetect::publishDetectionImage(cv::Mat& image, std::vector<std::vector<BoundingBox>>& bboxes) {
-  generateDetectionImage(image, bboxes);
-  cv::cvtColor(image, image, cv::COLOR_RGB2BGR);
-  std_msgs::Header image_ptr_out_header;
-  image_ptr_out_header.stamp = ros::Time::now();
-  image_ptr_out_ = cv_bridge::CvImage(image_ptr_out_header, "bgr8", image).toImageMsg();
-  detection_pub_.publish(image_ptr_out_);
+void ROSDetect::publishDetectionImage(const cv::Mat& image, const std::vector<std::vector<BoundingBox>>& bboxes, const std_msgs::Header& header) {
+  cv::Mat render = visualization_->render(image);
+  generateDetectionImage(render, bboxes, visualization_->getScale());
+  cv::cvtColor(render, render, cv::COLOR_RGB2BGR);
+  detection_pub_.publish(cv_bridge::CvImage(header, "bgr8", render).toImageMsg());
 }
 
 /**
@@ -91,19 +341,28 @@ void ROSDetect::publishDetections(std::vector<std::vector<BoundingBox>>& bboxes,
   ros_bboxes.header.frame_id = header.frame_id;
   ros_bboxes.bboxes = vec_ros_bboxes;
 
-  bboxes_pub_.publish(ros_bboxes);
+  results_pub_->publishLegacy(bboxes_pub_, ros_bboxes);
 }
 
 /**
- * @brief
- * @details
+ * @brief Feeds the images to the pipeline.
+ * @details Converts the image, and pushes it to the pipeline. All the processing happens on the threads of
+ * the pipeline, so this callback returns quickly and the ROS queue does not drop frames.
+ * The pipeline is built and started on the first image.
  * 
  * @param msg 
  */
 void ROSDetect::imageCallback(const sensor_msgs::ImageConstPtr& msg) {
-#ifdef PROFILE
-  auto start_inference = std::chrono::system_clock::now();
-#endif
+  ScopedSpan span(trace_, "image_callback", msg->header.stamp.toNSec(), msg->header.seq);
+  image_queue_->recordDelay(msg->header.stamp);
+  if (!pipeline_->isRunning()) {
+    buildPipeline();
+    pipeline_->start();
+  }
+  std::unique_ptr<PipelineFrame> frame(new PipelineFrame);
+  if (!prepareFrame(*frame)) {
+    return;
+  }
   cv_bridge::CvImagePtr cv_ptr;
   try {
     cv_ptr = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
@@ -111,20 +370,211 @@ void ROSDetect::imageCallback(const sensor_msgs::ImageConstPtr& msg) {
     ROS_ERROR("cv_bridge exception: %s", e.what());
     return;
   }
-  cv::Mat image = cv_ptr->image;
-  cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
-  std::vector<std::vector<BoundingBox>> bboxes(num_classes_);
-  detectObjects(image, bboxes);
-#ifdef PROFILE
-  auto end_inference = std::chrono::system_clock::now();
-  ROS_INFO("Full inference done in %ld ms", std::chrono::duration_cast<std::chrono::milliseconds>(end_inference - start_inference).count());
+  frame->image = cv_ptr->image;
+  frame->frame_id = cv_ptr->header.frame_id;
+  if (!pipeline_->push(frame, cv_ptr->header.stamp.toNSec())) {
+    ROS_WARN_THROTTLE(1.0, "The pipeline is saturated, dropping frames.");
+  }
+}
+
+/**
+ * @brief Adds the data other than the image to a new frame.
+ * @details Called on the ROS thread before the frame is pushed to the pipeline.
+ * 
+ * @param frame 
+ * @return False if the frame should not be processed.
+ */
+bool ROSDetect::prepareFrame(PipelineFrame& frame) {
+  return true;
+}
+
+/**
+ * @brief Builds the stages of the pipeline: detect -> publish.
+ * 
+ */
+void ROSDetect::buildPipeline() {
+  pipeline_->addStage("detect", [this](PipelineFrame& frame){return detectStage(frame);}, true);
+  pipeline_->addStage("publish", [this](PipelineFrame& frame){return ROSDetect::publishFrame(frame);}, false);
+}
+
+/**
+ * @brief Detection stage. Only the most recent frame is processed.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSDetect::detectStage(PipelineFrame& frame) {
+  cv::cvtColor(frame.image, frame.image, cv::COLOR_BGR2RGB);
+  detectFrame(frame);
   printProfilingDetection();
-#endif
+  return true;
+}
+
+/**
+ * @brief Publication stage.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSDetect::publishFrame(PipelineFrame& frame) {
+  ScopedTimer timer(publish_histogram_);
+  std_msgs::Header header;
+  frameHeader(frame, header);
+  exportFrame(frame);
+  if (options_.publish_debug_images) {
+    submitDetectionImage(frame, header);
+  }
+  if (options_.publish_legacy_topics) {
+    publishDetections(frame.bboxes, header);
+  }
+  results_pub_->publishDetections(frame.bboxes, frame.points, header);
+  printProfilingPipeline(frame);
+  return true;
+}
+
+/**
+ * @brief Creates the callback queue of an input.
+ * 
+ * @param name The reference to the name of the input, used in the logs.
+ * @return The pointer to the queue, owned by the node.
+ */
+InputQueue* ROSDetect::addInputQueue(const std::string& name) {
+  input_queues_.push_back(new InputQueue(nh_, name, callback_threads_, use_callback_queues_, options_.profile));
+  return input_queues_.back();
+}
+
+/**
+ * @brief Starts servicing the callback queues of the inputs.
+ * @details Must be called once the node is fully constructed, the callbacks use its virtual methods.
+ * 
+ */
+void ROSDetect::start() {
+  for (unsigned int i=0; i < input_queues_.size(); i++) {
+    input_queues_[i]->start();
+  }
+}
+
+/**
+ * @brief Stops servicing the callback queues of the inputs, and waits for the running callbacks.
+ * @details Called first by the destructors, such that no callback runs on a partially destroyed node.
+ * 
+ */
+void ROSDetect::stopInputs() {
+  for (unsigned int i=0; i < input_queues_.size(); i++) {
+    input_queues_[i]->stop();
+  }
+}
+
+/**
+ * @brief Exports a frame to the shared-memory ring buffers, and records and logs it, if enabled.
+ * @details Called at the beginning of the publication stage, before anything is drawn on the image.
+ *
+ * @param frame The reference to the frame.
+ */
+void ROSDetect::exportFrame(const PipelineFrame& frame) {
+  if (shm_exporter_ != nullptr) {
+    shm_exporter_->write(frame);
+  }
+  if (recorder_ != nullptr) {
+    recordFrame(frame);
+  }
+  if (column_log_ != nullptr) {
+    column_log_->writeFrame(frame);
+  }
+}
+
+/**
+ * @brief Records the detections of a frame, with the regions of its depth image and the pose of the camera they were located with.
+ * @details The parameters of the node are recorded with the first frame, once the node is fully constructed.
+ *
+ * @param frame The reference to the frame.
+ */
+void ROSDetect::recordFrame(const PipelineFrame& frame) {
+  if (!record_parameters_) {
+    std::map<std::string, std::string> parameters;
+    getRecordedParameters(parameters);
+    recorder_->writeParameters(frame.stamps.stamp, parameters);
+    record_parameters_ = true;
+  }
+  std::vector<cv::Rect> rois;
+  RigidTransform pose;
+  addRecordedRegions(frame, rois);
+  const bool has_pose = getRecordedPose(frame, pose);
+  recorder_->writeFrame(frame, rois, has_pose ? &pose : nullptr);
+}
+
+/**
+ * @brief Reads the parameters of the node, to be recorded.
+ * @details All the parameters in the namespace of the node are read, such that the recording can be replayed
+ * with the same settings. The mode of the node is added, under the "mode" key.
+ *
+ * @param parameters The reference to the map in which the parameters will be stored, as text.
+ */
+void ROSDetect::getRecordedParameters(std::map<std::string, std::string>& parameters) {
+  std::vector<std::string> names;
+  nh_.getParamNames(names);
+  const std::string prefix = nh_.getNamespace() + "/";
+  for (unsigned int i=0; i < names.size(); i++) {
+    XmlRpc::XmlRpcValue value;
+    std::string text;
+    if ((names[i].compare(0, prefix.size(), prefix) != 0) || !nh_.getParam(names[i], value)) {
+      continue;
+    }
+    if (formatParameter(value, text)) {
+      parameters[names[i].substr(prefix.size())] = text;
+    }
+  }
+  parameters["mode"] = record_mode_;
+}
+
+/**
+ * @brief Adds the regions of the depth image read by the node to the recorded regions.
+ * @details Nothing is read from the depth image by the detection alone.
+ *
+ * @param frame The reference to the frame.
+ * @param rois The reference to the regions of interest.
+ */
+void ROSDetect::addRecordedRegions(const PipelineFrame& frame, std::vector<cv::Rect>& rois) {}
+
+/**
+ * @brief Returns the pose of the camera the positions of a frame were projected with.
+ * @details The detection alone does not use the pose of the camera.
+ *
+ * @param frame The reference to the frame.
+ * @param pose The reference to the transform in which the pose will be stored.
+ * @return False if the node does not use the pose of the camera.
+ */
+bool ROSDetect::getRecordedPose(const PipelineFrame& frame, RigidTransform& pose) {
+  return false;
+}
+
+/**
+ * @brief Rebuilds the ROS header of a frame.
+ * 
+ * @param frame 
+ * @param header 
+ */
+void ROSDetect::frameHeader(const PipelineFrame& frame, std_msgs::Header& header) {
+  header.stamp.fromNSec(frame.stamps.stamp);
+  header.frame_id = frame.frame_id;
+}
 
-#ifdef PUBLISH_DETECTION_IMAGE
-  publishDetectionImage(image, bboxes);
-#endif
-  publishDetections(bboxes, cv_ptr->header);
+/**
+ * @brief Prints the end-to-end latency of a frame, and the statistics of the stages.
+ * 
+ * @param frame 
+ */
+void ROSDetect::printProfilingPipeline(const PipelineFrame& frame) {
+  if (!RUNTIME_OPTION(options_.profile)) {
+    return;
+  }
+  std::vector<StageStatistics> statistics;
+  pipeline_->getStatistics(statistics);
+  ROS_INFO("Frame %lu done in %.1f ms", frame.stamps.sequence, pipelineLatency(frame.stamps) * 1000);
+  for (unsigned int i=0; i < statistics.size(); i++) {
+    ROS_INFO(" - %s: mean %.1f ms, %lu processed, %lu dropped, %lu overflowed", statistics[i].name.c_str(), statistics[i].mean_time,
+             statistics[i].processed, statistics[i].dropped, statistics[i].overflow);
+  }
 }
 
 
@@ -132,14 +582,19 @@ void ROSDetect::imageCallback(const sensor_msgs::ImageConstPtr& msg) {
  * @brief Construct a new ROSDetectAndLocate::ROSDetectAndLocate object
  * 
  */
-ROSDetectAndLocate::ROSDetectAndLocate() : ROSDetect(), Locate() {
+ROSDetectAndLocate::ROSDetectAndLocate() : ROSDetectAndLocate(ros::NodeHandle("~")) {}
+
+/**
+ * @brief Construct a new ROSDetectAndLocate::ROSDetectAndLocate object
+ * 
+ * @param nh The private node handle of the node.
+ */
+ROSDetectAndLocate::ROSDetectAndLocate(const ros::NodeHandle& nh) : ROSDetect(nh), Locate() {
   // Empty structs
   GlobalParameters glo_p;
   LocalizationParameters loc_p;
   CameraParameters cam_p;
 
-  depth_received_ = false;
-
   // Global parameters
   nh_.param("image_rows", glo_p.image_height, 480);
   nh_.param("image_cols", glo_p.image_width, 640);
@@ -155,53 +610,86 @@ ROSDetectAndLocate::ROSDetectAndLocate() : ROSDetect(), Locate() {
   nh_.param("camera_parameters", cam_p.camera_parameters, P);
   nh_.param("K", cam_p.lens_distortion, K);
   nh_.param("lens_distortion_model", cam_p.distortion_model, distortion_model);
+  // Depth pairing parameters
+  int depth_buffer_size;
+  float depth_tolerance;
+  nh_.param("depth_buffer_size", depth_buffer_size, 8);
+  nh_.param("depth_tolerance", depth_tolerance, 0.02f);
   // Initialize the position estimator
   buildLocate(glo_p, loc_p, cam_p);
+  setLocalizationProfiling(options_.profile, options_.debug_pose);
+  setLocalizationInstrumentation(instrumentation_);
+  depth_buffer_ = new DepthBuffer(depth_buffer_size, depth_tolerance);
+  record_mode_ = "locate";
   
-  depth_sub_ = it_.subscribe("/camera/aligned_depth_to_color/image_raw", 1, &ROSDetectAndLocate::depthCallback, this);
-  depth_info_sub_ = nh_.subscribe("/camera/aligned_depth_to_color/camera_info", 1, &ROSDetectAndLocate::depthInfoCallback, this);
+  depth_queue_ = addInputQueue("depth");
+  depth_info_queue_ = addInputQueue("camera_info");
+  depth_sub_ = image_transport::ImageTransport(depth_queue_->getNodeHandle()).subscribe("/camera/aligned_depth_to_color/image_raw", depth_buffer_size, &ROSDetectAndLocate::depthCallback, this);
+  depth_info_sub_ = depth_info_queue_->getNodeHandle().subscribe("/camera/aligned_depth_to_color/camera_info", 1, &ROSDetectAndLocate::depthInfoCallback, this);
   pose_array_pub_ = nh_.advertise<geometry_msgs::PoseArray>("detection_pose_array", 1);
-#ifdef PUBLISH_DETECTION_WITH_POSITION
-  positions_bboxes_pub_ = nh_.advertise<detect_and_track::PositionBoundingBox2DArray>("bounding_boxes_with_positions",1);
-#else
-  positions_pub_ = nh_.advertise<detect_and_track::PositionIDArray>("detection_positions",1);
-#endif
+  if (options_.publish_positions_with_bboxes) {
+    positions_bboxes_pub_ = nh_.advertise<detect_and_track::PositionBoundingBox2DArray>("bounding_boxes_with_positions",1);
+  } else {
+    positions_pub_ = nh_.advertise<detect_and_track::PositionIDArray>("detection_positions",1);
+  }
 }
 
 ROSDetectAndLocate::~ROSDetectAndLocate() {
+  stopInputs();
+  pipeline_->stop();
+  visualization_->stop();
+  delete depth_buffer_;
 }
 
 /**
- * @brief 
+ * @brief Updates the camera parameters, only when they change.
  * 
  * @param msg 
  */
 void ROSDetectAndLocate::depthInfoCallback(const sensor_msgs::CameraInfoConstPtr& msg){
+  depth_info_queue_->recordDelay(msg->header.stamp);
   //std::vector<float> P{msg->K[2], msg->K[5], msg->K[0], msg->K[4]};
   std::vector<float> P(msg->K.begin(), msg->K.end());
   std::vector<float> K(msg->D.begin(), msg->D.end());
+  // The camera info is published with every depth image, but rarely changes.
+  if ((P == camera_P_) && (K == camera_K_)) {
+    return;
+  }
+  camera_P_ = P;
+  camera_K_ = K;
+  std::lock_guard<std::mutex> lock(camera_mutex_);
   updateCameraInfo(P, K);
+  if (recorder_ != nullptr) {
+    recorder_->writeCameraInfo(msg->header.stamp.toNSec(), P, K);
+  }
 }
 
 /**
- * @brief 
+ * @brief Stores a depth image in the ring buffer.
+ * @details The image is not copied: the cv::Mat points into the message, which is kept alive by the ring buffer,
+ * and then by the frames it is paired with. 16 bits images are kept in millimeters, and 32 bits images in meters.
  * 
  * @param msg 
  */
 void ROSDetectAndLocate::depthCallback(const sensor_msgs::ImageConstPtr& msg){
-  cv_bridge::CvImagePtr cv_ptr;
+  ScopedSpan span(trace_, "depth_callback", msg->header.stamp.toNSec(), msg->header.seq);
+  depth_queue_->recordDelay(msg->header.stamp);
+  cv_bridge::CvImageConstPtr cv_ptr;
   try {
-    cv_ptr = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::TYPE_16UC1);
+    cv_ptr = cv_bridge::toCvShare(msg);
   }
   catch (cv_bridge::Exception& e) {
     ROS_ERROR("cv_bridge exception: %s", e.what());
     return;
   }
-  cv_ptr->image.convertTo(depth_image_, CV_32F, 0.001);
-  depth_received_ = true;
+  if ((cv_ptr->image.type() != CV_16UC1) && (cv_ptr->image.type() != CV_32FC1)) {
+    ROS_ERROR_THROTTLE(1.0, "Unsupported depth encoding %s, expected 16UC1 or 32FC1.", msg->encoding.c_str());
+    return;
+  }
+  std::shared_ptr<const void> owner(cv_ptr.get(), [cv_ptr](const void*){});
+  depth_buffer_->push(msg->header.stamp.toNSec(), cv_ptr->image, owner);
 }
 
-#ifdef PUBLISH_DETECTION_WITH_POSITION
 /**
  * @brief 
  * 
@@ -247,11 +735,10 @@ void ROSDetectAndLocate::publishDetectionsAndPositions(std::vector<std::vector<B
   pose_array.header = ros_bboxes.header;
   pose_array.poses = poses;
   
-  positions_bboxes_pub_.publish(ros_bboxes);
-  pose_array_pub_.publish(pose_array);
+  results_pub_->publishLegacy(positions_bboxes_pub_, ros_bboxes);
+  results_pub_->publishLegacy(pose_array_pub_, pose_array);
 }
 
-#else
 /**
  * @brief 
  * 
@@ -296,54 +783,150 @@ void ROSDetectAndLocate::publishPositions(std::vector<std::vector<BoundingBox>>&
   pose_array.header = id_positions.header;
   pose_array.poses = poses;
   
-  positions_pub_.publish(id_positions);
-  pose_array_pub_.publish(pose_array);
+  results_pub_->publishLegacy(positions_pub_, id_positions);
+  results_pub_->publishLegacy(pose_array_pub_, pose_array);
 }
-#endif
 
 /**
- * @brief 
+ * @brief Attaches the depth image closest in time to a new frame.
  * 
- * @param msg 
+ * @param frame 
+ * @return False if no depth image was received within the tolerance.
  */
-void ROSDetectAndLocate::imageCallback(const sensor_msgs::ImageConstPtr& msg){
-  if (!depth_received_) {
-    return;
+bool ROSDetectAndLocate::prepareFrame(PipelineFrame& frame) {
+  StampedDepth depth;
+  if (!depth_buffer_->match(frame.stamps.stamp, depth)) {
+    uint64_t matched, missed;
+    depth_buffer_->getStatistics(matched, missed);
+    ROS_WARN_THROTTLE(1.0, "No depth image close enough to the colour image, the frame is dropped (%lu paired, %lu dropped).", matched, missed);
+    return false;
   }
-#ifdef PROFILE
-  auto start_inference = std::chrono::system_clock::now();
-#endif
-  cv_bridge::CvImagePtr cv_ptr;
-  try {
-    cv_ptr = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
-  } catch (cv_bridge::Exception &e) {
-    ROS_ERROR("cv_bridge exception: %s", e.what());
-    return;
+  frame.depth = depth.depth;
+  frame.depth_owner = depth.owner;
+  return true;
+}
+
+/**
+ * @brief Adds the regions of the depth image under the detections to the recorded regions.
+ * @details The regions are the ones read by the position estimator, grown by the record margin.
+ * 
+ * @param frame The reference to the frame.
+ * @param rois The reference to the regions of interest.
+ */
+void ROSDetectAndLocate::addRecordedRegions(const PipelineFrame& frame, std::vector<cv::Rect>& rois) {
+  for (unsigned int i=0; i < frame.bboxes.size(); i++) {
+    for (unsigned int j=0; j < frame.bboxes[i].size(); j++) {
+      const BoundingBox& bbox = frame.bboxes[i][j];
+      rois.push_back(cv::Rect((int) bbox.x_min_ - record_margin_, (int) bbox.y_min_ - record_margin_,
+                              (int) bbox.w_ + 2 * record_margin_, (int) bbox.h_ + 2 * record_margin_));
+    }
   }
-  cv::Mat image = cv_ptr->image;
-  cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
-  std::vector<std::vector<BoundingBox>> bboxes(num_classes_);
-  std::vector<std::vector<float>> distances;
-  std::vector<std::vector<std::vector<float>>> points;
-  detectObjects(image, bboxes);
-  locate(depth_image_, bboxes, distances, points);
-
-#ifdef PROFILE
-  auto end_inference = std::chrono::system_clock::now();
-  ROS_INFO("Full inference done in %ld ms", std::chrono::duration_cast<std::chrono::milliseconds>(end_inference - start_inference).count());
-  printProfilingDetection();
+}
+
+/**
+ * @brief Builds the stages of the pipeline: detect -> locate -> publish.
+ * 
+ */
+void ROSDetectAndLocate::buildPipeline() {
+  pipeline_->addStage("detect", [this](PipelineFrame& frame){return detectStage(frame);}, true);
+  pipeline_->addStage("locate", [this](PipelineFrame& frame){return locateStage(frame);}, false);
+  pipeline_->addStage("publish", [this](PipelineFrame& frame){return ROSDetectAndLocate::publishFrame(frame);}, false);
+}
+
+/**
+ * @brief Localization stage, for the detected objects.
+ * 
+ * @param frame 
+ * @return False if the frame has no depth image.
+ */
+bool ROSDetectAndLocate::locateStage(PipelineFrame& frame) {
+  std::lock_guard<std::mutex> lock(camera_mutex_);
+  const bool located = locateFrame(frame);
+  printProfilingLocalization();
+  return located;
+}
+
+/**
+ * @brief Localization stage, for the tracked objects.
+ * 
+ * @param frame 
+ * @return False if the frame has no depth image.
+ */
+bool ROSDetectAndLocate::locateTracksStage(PipelineFrame& frame) {
+  std::lock_guard<std::mutex> lock(camera_mutex_);
+  const bool located = locateTracksFrame(frame);
   printProfilingLocalization();
-#endif
+  return located;
+}
+
+/**
+ * @brief Publication stage.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSDetectAndLocate::publishFrame(PipelineFrame& frame) {
+  ScopedTimer timer(publish_histogram_);
+  std_msgs::Header header;
+  frameHeader(frame, header);
+  exportFrame(frame);
+  if (options_.publish_debug_images) {
+    submitDetectionImage(frame, header);
+  }
+  if (options_.publish_legacy_topics) {
+    if (options_.publish_positions_with_bboxes) {
+      publishDetectionsAndPositions(frame.bboxes, frame.points, header);
+    } else {
+      publishDetections(frame.bboxes, header);
+      publishPositions(frame.bboxes, frame.points, header);
+    }
+  }
+  results_pub_->publishDetections(frame.bboxes, frame.points, header);
+  printProfilingPipeline(frame);
+  return true;
+}
+
+/**
+ * @brief Sets up a transform cache.
+ * @details Reads the timeout of the lookups, and records them in the tf histogram and in the trace.
+ * 
+ * @param tf_cache The reference to the transform cache.
+ */
+void ROSDetectAndLocate::setupTransformCache(TransformCache& tf_cache) {
+  float tf_timeout;
+  nh_.param("tf_timeout", tf_timeout, 0.0f);
+  tf_cache.setTimeout(tf_timeout);
+  tf_cache.setHistogram(instrumentation_ != nullptr ? instrumentation_->getHistogram("tf") : nullptr);
+  tf_cache.setTrace(trace_);
+}
 
-#ifdef PUBLISH_DETECTION_IMAGE
-  publishDetectionImage(image, bboxes);
-#endif
-#ifdef PUBLISH_DETECTION_WITH_POSITION
-  publishDetectionsAndPositions(bboxes, points, cv_ptr->header);
-#else
-  publishDetections(bboxes,cv_ptr->header);
-  publishPositions(bboxes, points, cv_ptr->header);
-#endif
+/**
+ * @brief Updates the frustum of the camera of a 3D tracker.
+ * @details Updates the intrinsics of the camera, and looks up its pose in the global frame.
+ * The pose comes from the transform cache, it was already looked up by the localization.
+ * If the pose cannot be found, the frustum is invalidated, and no tracks are culled for this frame.
+ * 
+ * @param track The reference to the 3D tracker.
+ * @param tf_cache The reference to the transform cache.
+ * @param global_frame The reference to the global frame.
+ * @param camera_frame The reference to the frame of the camera.
+ * @param stamp The time at which the pose of the camera is looked up.
+ */
+void ROSDetectAndLocate::updateCameraFrustum(Track3D& track, TransformCache& tf_cache, const std::string& global_frame,
+                                             const std::string& camera_frame, const ros::Time& stamp) {
+  {
+    std::lock_guard<std::mutex> lock(camera_mutex_);
+    track.setCameraIntrinsics(PE_->getFx(), PE_->getFy(), PE_->getCx(), PE_->getCy(), PE_->getImageWidth(), PE_->getImageHeight());
+  }
+  RigidTransform transform;
+  if (!tf_cache.lookup(global_frame, camera_frame, stamp, transform)) {
+    track.invalidateCameraPose();
+    return;
+  }
+  Eigen::Quaternionf rotation(transform.rotation);
+  std::vector<float> position {transform.translation.x(), transform.translation.y(), transform.translation.z()};
+  std::vector<float> orientation {rotation.x(), rotation.y(), rotation.z(), rotation.w()};
+  track.setCameraPose(position, orientation);
 }
 
 
@@ -351,85 +934,102 @@ void ROSDetectAndLocate::imageCallback(const sensor_msgs::ImageConstPtr& msg){
  * @brief Construct a new ROSDetectTrack2DAndLocate::ROSDetectTrack2DAndLocate object
  * 
  */
-ROSDetectTrack2DAndLocate::ROSDetectTrack2DAndLocate() : ROSDetectAndLocate(), Track2D(), listener_(tf_buffer_), csv_writer_() {
+ROSDetectTrack2DAndLocate::ROSDetectTrack2DAndLocate() : ROSDetectTrack2DAndLocate(ros::NodeHandle("~")) {}
+
+/**
+ * @brief Construct a new ROSDetectTrack2DAndLocate::ROSDetectTrack2DAndLocate object
+ * 
+ * @param nh The private node handle of the node.
+ */
+ROSDetectTrack2DAndLocate::ROSDetectTrack2DAndLocate(const ros::NodeHandle& nh) : ROSDetectAndLocate(nh), Track2D(), listener_(tf_buffer_), tf_cache_(tf_buffer_, 8), csv_writer_() {
   DetectionParameters det_p;
   KalmanParameters kal_p;
   TrackingParameters tra_p;
   BBoxRejectionParameters bbo_p;
-  // Model parameters
-  std::string default_path_to_engine("None");
-  std::string default_global_frame("map");
-  std::vector<std::string> default_class_map {std::string("object")};
-  nh_.param("path_to_engine", det_p.engine_path, default_path_to_engine);
-  nh_.param("num_classes", det_p.num_classes, 1);
-  nh_.param("class_map", det_p.class_map, default_class_map);
-  nh_.param("num_buffers", det_p.num_buffers, 2);
-  nh_.param("global_frame", global_frame_, default_global_frame);
-  // Kalman parameters
-  std::vector<float> default_Q {9.0, 9.0, 200.0, 200.0, 5.0, 5.0};
-  std::vector<float> default_R {2.0, 2.0, 200.0, 200.0, 2.0, 2.0};
-  Q_.resize(6);
-  R_.resize(6);
-  nh_.param("Q", kal_p.Q, default_Q);
-  nh_.param("R", kal_p.R, default_R);
-  nh_.param("use_vel", kal_p.use_vel, false);
-  nh_.param("use_dim", kal_p.use_vel, true);
-  // Tracking parameters
-  nh_.param("center_threshold", tra_p.center_thresh, 80.0f);
-  nh_.param("dist_threshold", tra_p.distance_thresh, 150.0f);
-  nh_.param("body_ratio", tra_p.body_ratio, 0.5f);
-  nh_.param("area_threshold", tra_p.area_thresh, 2.0f);
-  nh_.param("dt", tra_p.dt, 0.02f);
-  nh_.param("max_frames_to_skip", tra_p.max_frames_to_skip, 10);
-  // BBox rejection
-  nh_.param("min_bbox_width", bbo_p.min_bbox_width, 60);
-  nh_.param("max_bbox_width", bbo_p.max_bbox_width, 400);
-  nh_.param("min_bbox_height", bbo_p.min_bbox_height, 60);
-  nh_.param("max_bbox_height", bbo_p.max_bbox_height, 300);
+  readTrackingParameters(nh_, false, det_p, kal_p, tra_p, bbo_p);
+  nh_.param("global_frame", global_frame_, std::string("map"));
+  setupTransformCache(tf_cache_);
   buildTrack2D(det_p, kal_p, tra_p, bbo_p);
+  setTrackingProfiling(options_.profile);
+  setTrackingInstrumentation(instrumentation_);
+  record_mode_ = "track2D_locate";
+
+  // The ground truth of the UAV experiments is only logged with debug_pose.
+  std::string debug_csv_path;
+  nh_.param("debug_target_frame", debug_target_frame_, std::string("uav_1/base_link"));
+  nh_.param("debug_observer_frame", debug_observer_frame_, std::string("uav_2/base_link"));
+  nh_.param("debug_csv_path", debug_csv_path, std::string(""));
+  csv_writer_ = nullptr;
+  if (RUNTIME_OPTION(options_.debug_pose) && !debug_csv_path.empty()) {
+    std::vector<std::string> header;
+    header.push_back(std::string("target_x"));
+    header.push_back(std::string("target_y"));
+    header.push_back(std::string("target_z"));
+    header.push_back(std::string("observer_x"));
+    header.push_back(std::string("observer_y"));
+    header.push_back(std::string("observer_z"));
+    header.push_back(std::string("estimated_x"));
+    header.push_back(std::string("estimated_y"));
+    header.push_back(std::string("estimated_z"));
+    std::string separator(",");
+    std::string endline("\n");
+    unsigned int buffer_size(20);
+    csv_writer_ = new csvWriter(debug_csv_path, separator, endline, header, buffer_size);
+  }
 
-  std::vector<std::string> header;
-  header.push_back(std::string("target_x"));
-  header.push_back(std::string("target_y"));
-  header.push_back(std::string("target_z"));
-  header.push_back(std::string("observer_x"));
-  header.push_back(std::string("observer_y"));
-  header.push_back(std::string("observer_z"));
-  header.push_back(std::string("estimated_x"));
-  header.push_back(std::string("estimated_y"));
-  header.push_back(std::string("estimated_z"));
-  std::string name("/home/antoine/test_csv_cpp.csv");
-  std::string separator(",");
-  std::string endline("\n");
-  unsigned int buffer_size(20);
-  csv_writer_ = new csvWriter(name, separator, endline, header, buffer_size);
-
-#ifdef PUBLISH_DETECTION_IMAGE
-  tracker_pub_ = it_.advertise("tracking_image", 1);
-#endif
+  if (options_.publish_debug_images) {
+    tracker_pub_ = it_.advertise("tracking_image", 1);
+  }
 }
 
 ROSDetectTrack2DAndLocate::~ROSDetectTrack2DAndLocate(){
+  stopInputs();
+  pipeline_->stop();
+  visualization_->stop();
   delete csv_writer_;
 }
 
 /**
- * @brief 
+ * @brief Hands the detections and the tracks of a frame over to the visualization worker.
+ * @details Only the images somebody subscribed to are rendered, at most once per period.
  * 
- * @param image_tracker 
- * @param tracker_states 
+ * @param frame The reference to the frame.
+ * @param header The reference to the header of the outputs of the frame.
+ */
+void ROSDetectTrack2DAndLocate::submitDebugImages(const PipelineFrame& frame, const std_msgs::Header& header) {
+  const bool draw_detections = detection_pub_.getNumSubscribers() > 0;
+  const bool draw_tracks = tracker_pub_.getNumSubscribers() > 0;
+  if (!(draw_detections || draw_tracks) || !visualization_->isDue()) {
+    return;
+  }
+  cv::Mat image = frame.image;
+  std::vector<std::vector<BoundingBox>> bboxes = frame.bboxes;
+  std::vector<std::map<unsigned int, std::vector<float>>> tracker_states = frame.tracker_states;
+  visualization_->submit([this, image, bboxes, tracker_states, header, draw_detections, draw_tracks](){
+    if (draw_detections) {
+      publishDetectionImage(image, bboxes, header);
+    }
+    if (draw_tracks) {
+      publishTrackingImage(image, tracker_states, header);
+    }
+  });
+}
+
+/**
+ * @brief Renders and publishes the tracking image. Called by the visualization worker.
+ * 
+ * @param image The reference to the RGB image, it is not modified.
+ * @param tracker_states The reference to the states of the tracks.
+ * @param header The reference to the header of the outputs of the frame.
  */
-void ROSDetectTrack2DAndLocate::publishTrackingImage(cv::Mat& image_tracker,
-                                                    std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states) {
-  generateTrackingImage(image_tracker, tracker_states);
-  cv::cvtColor(image_tracker, image_tracker, cv::COLOR_RGB2BGR);
-  std_msgs::Header image_ptr_out_header;
-  image_ptr_out_header.stamp = ros::Time::now();
-  image_ptr_out_ = cv_bridge::CvImage(image_ptr_out_header, "bgr8", image_tracker).toImageMsg();
-  tracker_pub_.publish(image_ptr_out_);
+void ROSDetectTrack2DAndLocate::publishTrackingImage(const cv::Mat& image, const std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states,
+                                                     const std_msgs::Header& header) {
+  cv::Mat render = visualization_->render(image);
+  generateTrackingImage(render, tracker_states, visualization_->getScale());
+  cv::cvtColor(render, render, cv::COLOR_RGB2BGR);
+  tracker_pub_.publish(cv_bridge::CvImage(header, "bgr8", render).toImageMsg());
 }
 
-#ifdef PUBLISH_DETECTION_WITH_POSITION
 /**
  * @brief 
  * 
@@ -465,41 +1065,25 @@ void ROSDetectTrack2DAndLocate::publishDetectionsAndPositions(std::vector<std::m
       poses.push_back(pose);
     }
   }
-  if (poses.size() > 0) {
-  geometry_msgs::PoseStamped dummy, dummy2, true_trg_uav_pose, true_trg_uav_pose2, est_local_trg_uav_pose, est_trg_uav_pose;
-  dummy.header.stamp = ros::Time(0);
-  dummy.header.frame_id = "uav_1/base_link";
-  dummy.pose.position.z = 0.24;
-  dummy2.header.stamp = ros::Time(0);
-  dummy2.header.frame_id = "uav_2/base_link";
-  dummy2.pose.position.z = 0.24;
-  est_local_trg_uav_pose.header.stamp = ros::Time(0);
-  est_local_trg_uav_pose.header.frame_id = header.frame_id;
-  est_local_trg_uav_pose.pose.position.x = poses[0].position.x;
-  est_local_trg_uav_pose.pose.position.y = poses[0].position.y;
-  est_local_trg_uav_pose.pose.position.z = poses[0].position.z;
-  tf_buffer_.transform(dummy, true_trg_uav_pose, "map", ros::Duration(1.0));
-  tf_buffer_.transform(dummy2, true_trg_uav_pose2, "map", ros::Duration(1.0));
-  tf_buffer_.transform(est_local_trg_uav_pose, est_trg_uav_pose, "map", ros::Duration(1.0));
-  float d, d2;
-  std::vector<float> position_data;
-  position_data.push_back(true_trg_uav_pose.pose.position.x);
-  position_data.push_back(true_trg_uav_pose.pose.position.y);
-  position_data.push_back(true_trg_uav_pose.pose.position.z);
-  position_data.push_back(true_trg_uav_pose2.pose.position.x);
-  position_data.push_back(true_trg_uav_pose2.pose.position.y);
-  position_data.push_back(true_trg_uav_pose2.pose.position.z);
-  position_data.push_back(est_trg_uav_pose.pose.position.x);
-  position_data.push_back(est_trg_uav_pose.pose.position.y);
-  position_data.push_back(est_trg_uav_pose.pose.position.z);
-  csv_writer_->addToBuffer(position_data);
-  d = std::sqrt((true_trg_uav_pose.pose.position.x - est_trg_uav_pose.pose.position.x) * (true_trg_uav_pose.pose.position.x - est_trg_uav_pose.pose.position.x) +\
-      (true_trg_uav_pose.pose.position.y - est_trg_uav_pose.pose.position.y) * (true_trg_uav_pose.pose.position.y - est_trg_uav_pose.pose.position.y) +\
-      (true_trg_uav_pose.pose.position.z - est_trg_uav_pose.pose.position.z) * (true_trg_uav_pose.pose.position.z - est_trg_uav_pose.pose.position.z));
-  d2 = std::sqrt((true_trg_uav_pose.pose.position.x - true_trg_uav_pose2.pose.position.x) * (true_trg_uav_pose.pose.position.x - true_trg_uav_pose2.pose.position.x) +\
-      (true_trg_uav_pose.pose.position.y - true_trg_uav_pose2.pose.position.y) * (true_trg_uav_pose.pose.position.y - true_trg_uav_pose2.pose.position.y) +\
-      (true_trg_uav_pose.pose.position.z - true_trg_uav_pose2.pose.position.z) * (true_trg_uav_pose.pose.position.z - true_trg_uav_pose2.pose.position.z));
-  printf("%.3f, %.3f\n", d, d2);
+  // The ground truth is looked up at the stamp of the image, the frame is not logged if TF is not ready.
+  RigidTransform uav_1, uav_2, camera;
+  if (RUNTIME_OPTION(options_.debug_pose) && (poses.size() > 0) &&
+      tf_cache_.lookup(global_frame_, debug_target_frame_, header.stamp, uav_1) &&
+      tf_cache_.lookup(global_frame_, debug_observer_frame_, header.stamp, uav_2) &&
+      tf_cache_.lookup(global_frame_, header.frame_id, header.stamp, camera)) {
+    const Eigen::Vector3f offset(0, 0, 0.24);
+    const Eigen::Vector3f true_trg_uav_pose = uav_1.rotation * offset + uav_1.translation;
+    const Eigen::Vector3f true_trg_uav_pose2 = uav_2.rotation * offset + uav_2.translation;
+    const Eigen::Vector3f est_trg_uav_pose = camera.rotation * Eigen::Vector3f(poses[0].position.x, poses[0].position.y, poses[0].position.z) + camera.translation;
+    if (csv_writer_ != nullptr) {
+      std::vector<float> position_data {true_trg_uav_pose.x(), true_trg_uav_pose.y(), true_trg_uav_pose.z(),
+                                        true_trg_uav_pose2.x(), true_trg_uav_pose2.y(), true_trg_uav_pose2.z(),
+                                        est_trg_uav_pose.x(), est_trg_uav_pose.y(), est_trg_uav_pose.z()};
+      csv_writer_->addToBuffer(position_data);
+    }
+    const float d = (true_trg_uav_pose - est_trg_uav_pose).norm();
+    const float d2 = (true_trg_uav_pose - true_trg_uav_pose2).norm();
+    ROS_INFO("Pose error %.3f m, target to observer %.3f m", d, d2);
   }
   ros_bboxes.header.stamp = header.stamp;
   ros_bboxes.header.frame_id = header.frame_id;
@@ -507,12 +1091,10 @@ void ROSDetectTrack2DAndLocate::publishDetectionsAndPositions(std::vector<std::m
   pose_array.header = ros_bboxes.header;
   pose_array.poses = poses;
   
-  positions_bboxes_pub_.publish(ros_bboxes);
-  pose_array_pub_.publish(pose_array);
+  results_pub_->publishLegacy(positions_bboxes_pub_, ros_bboxes);
+  results_pub_->publishLegacy(pose_array_pub_, pose_array);
 }
 
-#else
-
 /**
  * @brief 
  * 
@@ -540,7 +1122,7 @@ void ROSDetectTrack2DAndLocate::publishDetections(std::vector<std::map<unsigned
   ros_bboxes.header.frame_id = header.frame_id;
   ros_bboxes.bboxes = vec_ros_bboxes;
 
-  bboxes_pub_.publish(ros_bboxes);
+  results_pub_->publishLegacy(bboxes_pub_, ros_bboxes);
 }
 
 /**
@@ -564,139 +1146,170 @@ void ROSDetectTrack2DAndLocate::publishPositions(std::vector<std::map<unsigned i
     }
   }
 
-  geometry_msgs::PoseStamped dummy, true_trg_uav_pose, est_local_trg_uav_pose, est_trg_uav_pose;
-  dummy.header.stamp = header.stamp;
-  dummy.header.frame_id = "uav_1/base_link";
-  est_local_trg_uav_pose.header.stamp = header.stamp;
-  est_local_trg_uav_pose.header.frame_id = header.frame_id;
-  est_local_trg_uav_pose.pose.position.x = poses[0].position.x;
-  est_local_trg_uav_pose.pose.position.y = poses[0].position.y;
-  est_local_trg_uav_pose.pose.position.z = poses[0].position.z;
-  tf_buffer_.transform(dummy, true_trg_uav_pose, "map", ros::Duration(1.0));
-  tf_buffer_.transform(est_local_trg_uav_pose, est_trg_uav_pose, "map", ros::Duration(1.0));
-  printf("%.3f, %.3f\n", true_trg_uav_pose.pose.position.x, est_trg_uav_pose.pose.position.x);
-
-
+  RigidTransform uav_1, camera;
+  if (RUNTIME_OPTION(options_.debug_pose) && (poses.size() > 0) &&
+      tf_cache_.lookup(global_frame_, debug_target_frame_, header.stamp, uav_1) &&
+      tf_cache_.lookup(global_frame_, header.frame_id, header.stamp, camera)) {
+    const Eigen::Vector3f est_trg_uav_pose = camera.rotation * Eigen::Vector3f(poses[0].position.x, poses[0].position.y, poses[0].position.z) + camera.translation;
+    ROS_INFO("Target x %.3f m, estimated x %.3f m", uav_1.translation.x(), est_trg_uav_pose.x());
+  }
 
   pose_array.header.stamp = header.stamp;
   pose_array.header.frame_id = header.frame_id;
   pose_array.poses = poses;
-  pose_array_pub_.publish(pose_array);
+  results_pub_->publishLegacy(pose_array_pub_, pose_array);
 }
-#endif
 
 /**
- * @brief 
+ * @brief Builds the stages of the pipeline: detect -> track -> locate -> publish.
  * 
- * @param msg 
  */
-void ROSDetectTrack2DAndLocate::imageCallback(const sensor_msgs::ImageConstPtr& msg){
-  t2_ = t1_;
-  t1_ = ros::Time::now();
-  ros::Duration dt = t1_ - t2_; 
-  dt_ = (float) (dt.toSec());
-#ifdef PROFILE
-  auto start_inference = std::chrono::system_clock::now();
-#endif
-  cv_bridge::CvImagePtr cv_ptr;
-  try {
-    cv_ptr = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
-  } catch (cv_bridge::Exception &e) {
-    ROS_ERROR("cv_bridge exception: %s", e.what());
-    return;
-  }
-  cv::Mat image = cv_ptr->image;
-  cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
-  std::vector<std::vector<BoundingBox>> bboxes(num_classes_);
-  std::vector<std::map<unsigned int, std::vector<float>>> tracker_states;
-  std::vector<std::map<unsigned int, std::vector<float>>> points;
-  std::vector<std::map<unsigned int, float>> distances;
-  tracker_states.resize(num_classes_);
-  detectObjects(image, bboxes);
-  cv::Mat image_tracker = image.clone();
-  track(bboxes, tracker_states, dt_);
-  locate(depth_image_, tracker_states, distances, points);
-#ifdef PROFILE
-  auto end_inference = std::chrono::system_clock::now();
-  ROS_INFO("Full inference done in %ld ms", std::chrono::duration_cast<std::chrono::milliseconds>(end_inference - start_inference).count());
-  printProfilingDetection();
+void ROSDetectTrack2DAndLocate::buildPipeline() {
+  pipeline_->addStage("detect", [this](PipelineFrame& frame){return detectStage(frame);}, true);
+  pipeline_->addStage("track", [this](PipelineFrame& frame){return trackStage(frame);}, false);
+  pipeline_->addStage("locate", [this](PipelineFrame& frame){return locateTracksStage(frame);}, false);
+  pipeline_->addStage("publish", [this](PipelineFrame& frame){return ROSDetectTrack2DAndLocate::publishFrame(frame);}, false);
+}
+
+/**
+ * @brief Adds the regions of the depth image under the detections and the tracks to the recorded regions.
+ * @details The tracks are located, the detections are recorded too such that the tracks created on the next frames are covered.
+ * 
+ * @param frame The reference to the frame.
+ * @param rois The reference to the regions of interest.
+ */
+void ROSDetectTrack2DAndLocate::addRecordedRegions(const PipelineFrame& frame, std::vector<cv::Rect>& rois) {
+  ROSDetectAndLocate::addRecordedRegions(frame, rois);
+  // The position estimator reads the tracks from their first two coordinates, with their width and height.
+  for (unsigned int i=0; i < frame.tracker_states.size(); i++) {
+    for (auto & element : frame.tracker_states[i]) {
+      rois.push_back(cv::Rect((int) element.second[0] - record_margin_, (int) element.second[1] - record_margin_,
+                              (int) element.second[4] + 2 * record_margin_, (int) element.second[5] + 2 * record_margin_));
+    }
+  }
+}
+
+/**
+ * @brief Tracking stage. Every detected frame is tracked.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSDetectTrack2DAndLocate::trackStage(PipelineFrame& frame) {
+  trackFrame(frame);
   printProfilingTracking();
-  printProfilingLocalization();
-#endif
+  return true;
+}
 
-#ifdef PUBLISH_DETECTION_IMAGE
-  publishDetectionImage(image, bboxes);
-  publishTrackingImage(image_tracker, tracker_states);
-#endif
-#ifdef PUBLISH_DETECTION_WITH_POSITION
-  publishDetectionsAndPositions(tracker_states, points, cv_ptr->header);
-#else
-  publishDetections(tracker_states, cv_ptr->header);
-  publishPositions(points, cv_ptr->header);
-#endif
+/**
+ * @brief Publication stage.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSDetectTrack2DAndLocate::publishFrame(PipelineFrame& frame) {
+  ScopedTimer timer(publish_histogram_);
+  std_msgs::Header header;
+  frameHeader(frame, header);
+  exportFrame(frame);
+  if (options_.publish_debug_images) {
+    submitDebugImages(frame, header);
+  }
+  if (options_.publish_legacy_topics) {
+    if (options_.publish_positions_with_bboxes) {
+      publishDetectionsAndPositions(frame.tracker_states, frame.track_points, header);
+    } else {
+      publishDetections(frame.tracker_states, header);
+      publishPositions(frame.track_points, header);
+    }
+  }
+  results_pub_->publishTracks(frame.tracker_states, frame.track_points, frame.snapshots, header);
+  printProfilingPipeline(frame);
+  return true;
 }
 
 /**
  * @brief Construct a new ROSDetectAndTrack2D::ROSDetectAndTrack2D object
  * 
  */
-ROSDetectAndTrack2D::ROSDetectAndTrack2D() : ROSDetect(), Track2D() {
+ROSDetectAndTrack2D::ROSDetectAndTrack2D() : ROSDetectAndTrack2D(ros::NodeHandle("~")) {}
+
+/**
+ * @brief Construct a new ROSDetectAndTrack2D::ROSDetectAndTrack2D object
+ * 
+ * @param nh The private node handle of the node.
+ */
+ROSDetectAndTrack2D::ROSDetectAndTrack2D(const ros::NodeHandle& nh) : ROSDetect(nh), Track2D() {
   DetectionParameters det_p;
   KalmanParameters kal_p;
   TrackingParameters tra_p;
   BBoxRejectionParameters bbo_p;
-  // Model parameters
-  std::string default_path_to_engine("None");
-  std::string path_to_engine;
-  std::vector<std::string> default_class_map {std::string("object")};
-  nh_.param("path_to_engine", det_p.engine_path, default_path_to_engine);
-  nh_.param("num_classes", det_p.num_classes, 1);
-  nh_.param("class_map", det_p.class_map, default_class_map);
-  nh_.param("num_buffers", det_p.num_buffers, 2);
-  // Kalman parameters
-  std::vector<float> default_Q {9.0, 9.0, 200.0, 200.0, 5.0, 5.0};
-  std::vector<float> default_R {2.0, 2.0, 200.0, 200.0, 2.0, 2.0};
-  Q_.resize(6);
-  R_.resize(6);
-  nh_.param("Q", kal_p.Q, default_Q);
-  nh_.param("R", kal_p.R, default_R);
-  nh_.param("use_vel", kal_p.use_vel, false);
-  nh_.param("use_dim", kal_p.use_vel, true);
-  // Tracking parameters
-  nh_.param("center_threshold", tra_p.center_thresh, 80.0f);
-  nh_.param("dist_threshold", tra_p.distance_thresh, 150.0f);
-  nh_.param("body_ratio", tra_p.body_ratio, 0.5f);
-  nh_.param("area_threshold", tra_p.area_thresh, 2.0f);
-  nh_.param("dt", tra_p.dt, 0.02f);
-  nh_.param("max_frames_to_skip", tra_p.max_frames_to_skip, 10);
-  // BBox rejection
-  nh_.param("min_bbox_width", bbo_p.min_bbox_width, 60);
-  nh_.param("max_bbox_width", bbo_p.max_bbox_width, 400);
-  nh_.param("min_bbox_width", bbo_p.min_bbox_height, 60);
-  nh_.param("max_bbox_width", bbo_p.max_bbox_height, 300);
+  readTrackingParameters(nh_, false, det_p, kal_p, tra_p, bbo_p);
   buildTrack2D(det_p, kal_p, tra_p, bbo_p);
+  setTrackingProfiling(options_.profile);
+  setTrackingInstrumentation(instrumentation_);
+  record_mode_ = "track2D";
+  // Incremental output
+  bool publish_track_deltas;
+  int keyframe_period;
+  nh_.param("publish_track_deltas", publish_track_deltas, false);
+  nh_.param("keyframe_period", keyframe_period, 30);
+  delta_pub_ = nullptr;
+  if (publish_track_deltas) {
+    delta_pub_ = new TrackDeltaPublisher(nh_, "tracks", keyframe_period, options_.profile);
+  }
 
-#ifdef PUBLISH_DETECTION_IMAGE
-  tracker_pub_ = it_.advertise("tracking_image", 1);
-#endif
+  if (options_.publish_debug_images) {
+    tracker_pub_ = it_.advertise("tracking_image", 1);
+  }
 }
 
-ROSDetectAndTrack2D::~ROSDetectAndTrack2D(){}
+ROSDetectAndTrack2D::~ROSDetectAndTrack2D(){
+  stopInputs();
+  pipeline_->stop();
+  visualization_->stop();
+  delete delta_pub_;
+}
 
 /**
- * @brief 
+ * @brief Hands the detections and the tracks of a frame over to the visualization worker.
+ * @details Only the images somebody subscribed to are rendered, at most once per period.
  * 
- * @param image_tracker 
- * @param tracker_states 
+ * @param frame The reference to the frame.
+ * @param header The reference to the header of the outputs of the frame.
+ */
+void ROSDetectAndTrack2D::submitDebugImages(const PipelineFrame& frame, const std_msgs::Header& header) {
+  const bool draw_detections = detection_pub_.getNumSubscribers() > 0;
+  const bool draw_tracks = tracker_pub_.getNumSubscribers() > 0;
+  if (!(draw_detections || draw_tracks) || !visualization_->isDue()) {
+    return;
+  }
+  cv::Mat image = frame.image;
+  std::vector<std::vector<BoundingBox>> bboxes = frame.bboxes;
+  std::vector<std::map<unsigned int, std::vector<float>>> tracker_states = frame.tracker_states;
+  visualization_->submit([this, image, bboxes, tracker_states, header, draw_detections, draw_tracks](){
+    if (draw_detections) {
+      publishDetectionImage(image, bboxes, header);
+    }
+    if (draw_tracks) {
+      publishTrackingImage(image, tracker_states, header);
+    }
+  });
+}
+
+/**
+ * @brief Renders and publishes the tracking image. Called by the visualization worker.
+ * 
+ * @param image The reference to the RGB image, it is not modified.
+ * @param tracker_states The reference to the states of the tracks.
+ * @param header The reference to the header of the outputs of the frame.
  */
-void ROSDetectAndTrack2D::publishTrackingImage(cv::Mat& image_tracker,
-                                               std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states) {
-  generateTrackingImage(image_tracker, tracker_states);
-  cv::cvtColor(image_tracker, image_tracker, cv::COLOR_RGB2BGR);
-  std_msgs::Header image_ptr_out_header;
-  image_ptr_out_header.stamp = ros::Time::now();
-  image_ptr_out_ = cv_bridge::CvImage(image_ptr_out_header, "bgr8", image_tracker).toImageMsg();
-  tracker_pub_.publish(image_ptr_out_);
+void ROSDetectAndTrack2D::publishTrackingImage(const cv::Mat& image, const std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states,
+                                               const std_msgs::Header& header) {
+  cv::Mat render = visualization_->render(image);
+  generateTrackingImage(render, tracker_states, visualization_->getScale());
+  cv::cvtColor(render, render, cv::COLOR_RGB2BGR);
+  tracker_pub_.publish(cv_bridge::CvImage(header, "bgr8", render).toImageMsg());
 }
 
 /**
@@ -726,118 +1339,178 @@ void ROSDetectAndTrack2D::publishDetections(std::vector<std::map<unsigned int, s
   ros_bboxes.header.frame_id = header.frame_id;
   ros_bboxes.bboxes = vec_ros_bboxes;
 
-  bboxes_pub_.publish(ros_bboxes);
+  results_pub_->publishLegacy(bboxes_pub_, ros_bboxes);
 }
 
 /**
- * @brief 
+ * @brief Builds the stages of the pipeline: detect -> track -> publish.
  * 
- * @param msg 
  */
-void ROSDetectAndTrack2D::imageCallback(const sensor_msgs::ImageConstPtr& msg){
-  t2_ = t1_;
-  t1_ = ros::Time::now();
-  ros::Duration dt = t1_ - t2_; 
-  dt_ = (float) (dt.toSec());
-#ifdef PROFILE
-  auto start_inference = std::chrono::system_clock::now();
-#endif
-  cv_bridge::CvImagePtr cv_ptr;
-  try {
-    cv_ptr = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
-  } catch (cv_bridge::Exception &e) {
-    ROS_ERROR("cv_bridge exception: %s", e.what());
-    return;
-  }
-  cv::Mat image = cv_ptr->image;
-  cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
-  std::vector<std::vector<BoundingBox>> bboxes(num_classes_);
-  std::vector<std::map<unsigned int, std::vector<float>>> tracker_states;
-  tracker_states.resize(num_classes_);
-  detectObjects(image, bboxes);
-  cv::Mat image_tracker = image.clone();
-  track(bboxes, tracker_states, dt_);
-#ifdef PROFILE
-  auto end_inference = std::chrono::system_clock::now();
-  ROS_INFO("Full inference done in %ld ms", std::chrono::duration_cast<std::chrono::milliseconds>(end_inference - start_inference).count());
-  printProfilingDetection();
+void ROSDetectAndTrack2D::buildPipeline() {
+  pipeline_->addStage("detect", [this](PipelineFrame& frame){return detectStage(frame);}, true);
+  pipeline_->addStage("track", [this](PipelineFrame& frame){return trackStage(frame);}, false);
+  pipeline_->addStage("publish", [this](PipelineFrame& frame){return ROSDetectAndTrack2D::publishFrame(frame);}, false);
+}
+
+/**
+ * @brief Tracking stage. Every detected frame is tracked.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSDetectAndTrack2D::trackStage(PipelineFrame& frame) {
+  trackFrame(frame);
   printProfilingTracking();
-#endif
+  return true;
+}
 
-#ifdef PUBLISH_DETECTION_IMAGE
-  publishDetectionImage(image, bboxes);
-  publishTrackingImage(image_tracker, tracker_states);
-#endif
-  publishDetections(tracker_states, cv_ptr->header);
+/**
+ * @brief Publication stage.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSDetectAndTrack2D::publishFrame(PipelineFrame& frame) {
+  ScopedTimer timer(publish_histogram_);
+  std_msgs::Header header;
+  frameHeader(frame, header);
+  exportFrame(frame);
+  if (options_.publish_debug_images) {
+    submitDebugImages(frame, header);
+  }
+  if (delta_pub_ != nullptr) {
+    delta_pub_->publish(frame.deltas, frame.snapshots, header);
+  } else if (options_.publish_legacy_topics) {
+    publishDetections(frame.tracker_states, header);
+  }
+  results_pub_->publishTracks(frame.tracker_states, frame.track_points, frame.snapshots, header);
+  printProfilingPipeline(frame);
+  return true;
 }
 
 /**
  * @brief Construct a new ROSTrack2D::ROSTrack2D object
  * 
  */
-ROSTrack2D::ROSTrack2D() : nh_("~"), it_(nh_), Track2D() {
+ROSTrack2D::ROSTrack2D() : ROSTrack2D(ros::NodeHandle("~")) {}
+
+/**
+ * @brief Construct a new ROSTrack2D::ROSTrack2D object
+ * 
+ * @param nh The private node handle of the node.
+ */
+ROSTrack2D::ROSTrack2D(const ros::NodeHandle& nh) : nh_(nh), it_(nh_), Track2D() {
   DetectionParameters det_p;
   KalmanParameters kal_p;
   TrackingParameters tra_p;
   BBoxRejectionParameters bbo_p;
-  // Model parameters
-  std::string default_path_to_engine("None");
-  std::string path_to_engine;
-  std::vector<std::string> default_class_map {std::string("object")};
-  nh_.param("path_to_engine", det_p.engine_path, default_path_to_engine);
-  nh_.param("num_classes", det_p.num_classes, 1);
-  nh_.param("class_map", det_p.class_map, default_class_map);
-  nh_.param("num_buffers", det_p.num_buffers, 2);
+  readTrackingParameters(nh_, false, det_p, kal_p, tra_p, bbo_p);
   num_classes_ = det_p.num_classes;
-  // Kalman parameters
-  std::vector<float> default_Q {9.0, 9.0, 200.0, 200.0, 5.0, 5.0};
-  std::vector<float> default_R {2.0, 2.0, 200.0, 200.0, 2.0, 2.0};
-  Q_.resize(6);
-  R_.resize(6);
-  nh_.param("Q", kal_p.Q, default_Q);
-  nh_.param("R", kal_p.R, default_R);
-  nh_.param("use_vel", kal_p.use_vel, false);
-  nh_.param("use_dim", kal_p.use_vel, true);
-  // Tracking parameters
-  nh_.param("center_threshold", tra_p.center_thresh, 80.0f);
-  nh_.param("dist_threshold", tra_p.distance_thresh, 150.0f);
-  nh_.param("body_ratio", tra_p.body_ratio, 0.5f);
-  nh_.param("area_threshold", tra_p.area_thresh, 2.0f);
-  nh_.param("dt", tra_p.dt, 0.02f);
-  nh_.param("max_frames_to_skip", tra_p.max_frames_to_skip, 10);
-  // BBox rejection
-  nh_.param("min_bbox_width", bbo_p.min_bbox_width, 60);
-  nh_.param("max_bbox_width", bbo_p.max_bbox_width, 400);
-  nh_.param("min_bbox_width", bbo_p.min_bbox_height, 60);
-  nh_.param("max_bbox_width", bbo_p.max_bbox_height, 300);
+  // Runtime options
+  readRuntimeOptions(nh_, options_);
+  // Diagnostics parameters, the latencies are only recorded if they are published.
+  float diagnostics_period;
+  nh_.param("diagnostics_period", diagnostics_period, 1.0f);
+  instrumentation_ = diagnostics_period > 0 ? new Instrumentation() : nullptr;
+  publish_histogram_ = instrumentation_ != nullptr ? instrumentation_->getHistogram("publish") : nullptr;
+  // Tracing parameters, the spans are only recorded if tracing is enabled.
+  int trace_size;
+  std::string trace_path;
+  nh_.param("trace_size", trace_size, 0);
+  nh_.param("trace_path", trace_path, std::string(""));
+  trace_ = trace_size > 0 ? new TraceBuffer(trace_size) : nullptr;
   buildTrack2D(det_p, kal_p, tra_p, bbo_p);
+  setTrackingProfiling(options_.profile);
+  setTrackingInstrumentation(instrumentation_);
+  // Incremental output
+  bool publish_track_deltas;
+  int keyframe_period;
+  nh_.param("publish_track_deltas", publish_track_deltas, false);
+  nh_.param("keyframe_period", keyframe_period, 30);
+  delta_pub_ = nullptr;
+  if (publish_track_deltas) {
+    delta_pub_ = new TrackDeltaPublisher(nh_, "tracks", keyframe_period, options_.profile);
+  }
 
-  cv::Mat image_;
+  // Callback queues parameters
+  bool use_callback_queues;
+  int callback_threads;
+  nh_.param("use_callback_queues", use_callback_queues, true);
+  nh_.param("callback_threads", callback_threads, 1);
+  // Debug images parameters
+  float visualization_rate;
+  float visualization_scale;
+  nh_.param("visualization_rate", visualization_rate, 10.0f);
+  nh_.param("visualization_scale", visualization_scale, 1.0f);
+  visualization_ = new VisualizationWorker(visualization_rate, visualization_scale);
+  image_queue_ = new InputQueue(nh_, "image", callback_threads, use_callback_queues, options_.profile);
+  bboxes_queue_ = new InputQueue(nh_, "bounding_boxes", callback_threads, use_callback_queues, options_.profile);
+  diagnostics_queue_ = nullptr;
+  diagnostics_ = nullptr;
+  if (instrumentation_ != nullptr) {
+    diagnostics_queue_ = new InputQueue(nh_, "diagnostics", 1, use_callback_queues, false);
+    diagnostics_ = new DiagnosticsPublisher(diagnostics_queue_->getNodeHandle(), nh_.getNamespace(), diagnostics_period,
+                                            instrumentation_, nullptr);
+  }
+  trace_service_ = nullptr;
+  if (trace_ != nullptr) {
+    trace_service_ = new TraceService(nh_, trace_path, trace_);
+  }
 
-  image_sub_ = it_.subscribe("/camera/color/image_raw", 1, &ROSTrack2D::imageCallback, this);
-  bboxes_sub_ = nh_.subscribe("bounding_boxes", 1, &ROSTrack2D::bboxesCallback, this);
-#ifdef PUBLISH_DETECTION_IMAGE
-  tracker_pub_ = it_.advertise("tracking_image", 1);
-#endif
+  image_sub_ = image_transport::ImageTransport(image_queue_->getNodeHandle()).subscribe("/camera/color/image_raw", 1, &ROSTrack2D::imageCallback, this);
+  bboxes_sub_ = bboxes_queue_->getNodeHandle().subscribe("bounding_boxes", 1, &ROSTrack2D::bboxesCallback, this);
+  if (options_.publish_debug_images) {
+    tracker_pub_ = it_.advertise("tracking_image", 1);
+  }
   bboxes_pub_ = nh_.advertise<detect_and_track::BoundingBoxes2D>("tracking_bounding_boxes", 1);
+  results_pub_ = new FrameResultPublisher(nh_, det_p.class_map, instrumentation_, diagnostics_period, options_.profile);
+}
+
+ROSTrack2D::~ROSTrack2D(){
+  delete trace_service_;
+  image_queue_->stop();
+  bboxes_queue_->stop();
+  if (diagnostics_ != nullptr) {
+    diagnostics_queue_->stop();
+    diagnostics_->stop();
+  }
+  visualization_->stop();
+  delete image_queue_;
+  delete bboxes_queue_;
+  delete diagnostics_;
+  delete diagnostics_queue_;
+  delete visualization_;
+  delete delta_pub_;
+  delete results_pub_;
+  delete instrumentation_;
+  delete trace_;
 }
 
-ROSTrack2D::~ROSTrack2D(){}
+/**
+ * @brief Starts servicing the callback queues of the inputs.
+ * 
+ */
+void ROSTrack2D::start() {
+  image_queue_->start();
+  bboxes_queue_->start();
+  if (diagnostics_queue_ != nullptr) {
+    diagnostics_queue_->start();
+  }
+}
 
 /**
- * @brief 
+ * @brief Renders and publishes the tracking image. Called by the visualization worker.
  * 
- * @param image_tracker 
- * @param tracker_states 
+ * @param image The reference to the RGB image, it is not modified.
+ * @param tracker_states The reference to the states of the tracks.
+ * @param header The reference to the header of the outputs of the frame.
  */
-void ROSTrack2D::publishTrackingImage(cv::Mat& image_tracker,
-                                               std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states) {
-  generateTrackingImage(image_tracker, tracker_states);
-  cv::cvtColor(image_tracker, image_tracker, cv::COLOR_RGB2BGR);
-  std_msgs::Header image_ptr_out_header;
-  image_ptr_out_header.stamp = ros::Time::now();
-  image_ptr_out_ = cv_bridge::CvImage(image_ptr_out_header, "bgr8", image_tracker).toImageMsg();
-  tracker_pub_.publish(image_ptr_out_);
+void ROSTrack2D::publishTrackingImage(const cv::Mat& image, const std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states,
+                                      const std_msgs::Header& header) {
+  cv::Mat render = visualization_->render(image);
+  generateTrackingImage(render, tracker_states, visualization_->getScale());
+  cv::cvtColor(render, render, cv::COLOR_RGB2BGR);
+  tracker_pub_.publish(cv_bridge::CvImage(header, "bgr8", render).toImageMsg());
 }
 
 /**
@@ -867,7 +1540,7 @@ void ROSTrack2D::publishDetections(std::vector<std::map<unsigned int, std::vecto
   ros_bboxes.header.frame_id = header.frame_id;
   ros_bboxes.bboxes = vec_ros_bboxes;
 
-  bboxes_pub_.publish(ros_bboxes);
+  results_pub_->publishLegacy(bboxes_pub_, ros_bboxes);
 }
 
 void ROSTrack2D::ROSbboxes2bboxes(const detect_and_track::BoundingBoxes2DConstPtr& msg, std::vector<std::vector<BoundingBox>>& bboxes){
@@ -888,29 +1561,61 @@ void ROSTrack2D::ROSbboxes2bboxes(const detect_and_track::BoundingBoxes2DConstPt
  * @param msg 
  */
 void ROSTrack2D::bboxesCallback(const detect_and_track::BoundingBoxes2DConstPtr& msg){
+  ScopedSpan span(trace_, "bboxes_callback", msg->header.stamp.toNSec(), msg->header.seq);
+  bboxes_queue_->recordDelay(msg->header.stamp);
+  // The image callback runs on another thread.
+  sensor_msgs::Image::ConstPtr image_msg;
+  std_msgs::Header header;
+  {
+    std::lock_guard<std::mutex> lock(image_mutex_);
+    image_msg = image_msg_;
+    header = header_;
+  }
   t2_ = t1_;
   t1_ = ros::Time::now();
   ros::Duration dt = t1_ - t2_; 
   dt_ = (float) (dt.toSec());
-#ifdef PROFILE
-  auto start_inference = std::chrono::system_clock::now();
-#endif
+  std::chrono::time_point<std::chrono::system_clock> start_inference;
+  if (RUNTIME_OPTION(options_.profile)) {
+    start_inference = std::chrono::system_clock::now();
+  }
   std::vector<std::vector<BoundingBox>> bboxes(num_classes_);
   std::vector<std::map<unsigned int, std::vector<float>>> tracker_states;
   tracker_states.resize(num_classes_);
   ROSbboxes2bboxes(msg, bboxes);
   track(bboxes, tracker_states, dt_);
-#ifdef PROFILE
-  auto end_inference = std::chrono::system_clock::now();
-  ROS_INFO("Full inference done in %ld ms", std::chrono::duration_cast<std::chrono::milliseconds>(end_inference - start_inference).count());
-  printProfilingTracking();
-#endif
+  if (RUNTIME_OPTION(options_.profile)) {
+    auto end_inference = std::chrono::system_clock::now();
+    ROS_INFO("Full inference done in %ld ms", std::chrono::duration_cast<std::chrono::milliseconds>(end_inference - start_inference).count());
+    printProfilingTracking();
+  }
 
-#ifdef PUBLISH_DETECTION_IMAGE
-  cv::Mat image_tracker = image_.clone();
-  publishTrackingImage(image_tracker, tracker_states);
-#endif
-  publishDetections(tracker_states, header_);
+  ScopedTimer timer(publish_histogram_);
+  ScopedSpan publish_span(trace_, "publish", msg->header.stamp.toNSec(), msg->header.seq);
+  // The image is only converted by the visualization worker, if somebody subscribed to the tracking image.
+  if (options_.publish_debug_images && image_msg && (tracker_pub_.getNumSubscribers() > 0) && visualization_->isDue()) {
+    visualization_->submit([this, image_msg, tracker_states, header](){
+      cv_bridge::CvImageConstPtr cv_ptr;
+      try {
+        cv_ptr = cv_bridge::toCvShare(image_msg, sensor_msgs::image_encodings::RGB8);
+      } catch (cv_bridge::Exception &e) {
+        ROS_ERROR("cv_bridge exception: %s", e.what());
+        return;
+      }
+      publishTrackingImage(cv_ptr->image, tracker_states, header);
+    });
+  }
+  if (delta_pub_ != nullptr) {
+    std::vector<TrackDelta> deltas;
+    std::vector<std::shared_ptr<const TrackSnapshot>> snapshots;
+    getDeltas(deltas);
+    getSnapshots(snapshots);
+    delta_pub_->publish(deltas, snapshots, header);
+  } else if (options_.publish_legacy_topics) {
+    publishDetections(tracker_states, header);
+  }
+  results_pub_->publishTracks(tracker_states, std::vector<std::map<unsigned int, std::vector<float>>>(),
+                              std::vector<std::shared_ptr<const TrackSnapshot>>(), header);
 }
 
 /**
@@ -919,84 +1624,75 @@ void ROSTrack2D::bboxesCallback(const detect_and_track::BoundingBoxes2DConstPtr&
  * @param msg 
  */
 void ROSTrack2D::imageCallback(const sensor_msgs::ImageConstPtr& msg){
-  cv_bridge::CvImagePtr cv_ptr;
-  try {
-    cv_ptr = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
-  } catch (cv_bridge::Exception &e) {
-    ROS_ERROR("cv_bridge exception: %s", e.what());
-    return;
-  }
-  image_ = cv_ptr->image;
-  header_ = cv_ptr->header;
-  cv::cvtColor(image_, image_, cv::COLOR_BGR2RGB);
+  ScopedSpan span(trace_, "image_callback", msg->header.stamp.toNSec(), msg->header.seq);
+  image_queue_->recordDelay(msg->header.stamp);
+  // The image is only converted when the tracks are drawn. Within a nodelet manager, no copy is made here.
+  std::lock_guard<std::mutex> lock(image_mutex_);
+  image_msg_ = msg;
+  header_ = msg->header;
 }
 
 /**
- * @brief Construct a new ROSDetectTrack2DAndLocate::ROSDetectTrack2DAndLocate object
+ * @brief Construct a new ROSDetectAndTrack3D::ROSDetectAndTrack3D object
  * 
  */
-ROSDetectAndTrack3D::ROSDetectAndTrack3D() : ROSDetectAndLocate(), Track3D(), listener_(tf_buffer_) {
+ROSDetectAndTrack3D::ROSDetectAndTrack3D() : ROSDetectAndTrack3D(ros::NodeHandle("~")) {}
+
+/**
+ * @brief Construct a new ROSDetectAndTrack3D::ROSDetectAndTrack3D object
+ * 
+ * @param nh The private node handle of the node.
+ */
+ROSDetectAndTrack3D::ROSDetectAndTrack3D(const ros::NodeHandle& nh) : ROSDetectAndLocate(nh), Track3D(), listener_(tf_buffer_), tf_cache_(tf_buffer_, 8) {
   DetectionParameters det_p;
   KalmanParameters kal_p;
   TrackingParameters tra_p;
   BBoxRejectionParameters bbo_p;
-  // Model parameters
-  std::string default_path_to_engine("None");
-  std::string default_global_frame("map");
-  std::vector<std::string> default_class_map {std::string("object")};
-  depth_received_ = false;
-  nh_.param("path_to_engine", det_p.engine_path, default_path_to_engine);
-  nh_.param("num_classes", det_p.num_classes, 1);
-  nh_.param("class_map", det_p.class_map, default_class_map);
-  nh_.param("num_buffers", det_p.num_buffers, 2);
-  nh_.param("global_frame", global_frame_, default_global_frame);
-  // Kalman parameters
-  std::vector<float> default_Q {0.25, 0.25, 0.25, 25.0, 25.0, 25.0, 0.25, 0.25, 0.25};
-  std::vector<float> default_R {0.125, 0.125, 0.125, 25.0, 25.0, 25.0, 0.125, 0.125, 0.125};
-  Q_.resize(9);
-  R_.resize(9);
-  nh_.param("Q", kal_p.Q, default_Q);
-  nh_.param("R", kal_p.R, default_R);
-  nh_.param("use_vel", kal_p.use_vel, false);
-  nh_.param("use_dim", kal_p.use_vel, true);
-  // Tracking parameters
-  nh_.param("center_threshold", tra_p.center_thresh, 80.0f);
-  nh_.param("dist_threshold", tra_p.distance_thresh, 150.0f);
-  nh_.param("body_ratio", tra_p.body_ratio, 0.5f);
-  nh_.param("area_threshold", tra_p.area_thresh, 2.0f);
-  nh_.param("dt", tra_p.dt, 0.02f);
-  nh_.param("max_frames_to_skip", tra_p.max_frames_to_skip, 10);
-  // BBox rejection
-  nh_.param("min_bbox_width", bbo_p.min_bbox_width, 60);
-  nh_.param("max_bbox_width", bbo_p.max_bbox_width, 400);
-  nh_.param("min_bbox_height", bbo_p.min_bbox_height, 60);
-  nh_.param("max_bbox_height", bbo_p.max_bbox_height, 300);
+  readTrackingParameters(nh_, true, det_p, kal_p, tra_p, bbo_p);
+  nh_.param("global_frame", global_frame_, std::string("map"));
+  nh_.param("camera_frame", camera_frame_, std::string("camera_color_optical_frame"));
+  setupTransformCache(tf_cache_);
   buildTrack3D(det_p, kal_p, tra_p, bbo_p);
+  setTrackingProfiling(options_.profile);
+  setTrackingInstrumentation(instrumentation_);
+  record_mode_ = "track3D";
+  // Incremental output
+  bool publish_track_deltas;
+  int keyframe_period;
+  nh_.param("publish_track_deltas", publish_track_deltas, false);
+  nh_.param("keyframe_period", keyframe_period, 30);
+  delta_pub_ = nullptr;
+  if (publish_track_deltas) {
+    delta_pub_ = new TrackDeltaPublisher(nh_, "tracks", keyframe_period, options_.profile);
+  }
 
-#ifdef PUBLISH_DETECTION_IMAGE
-  tracker_pub_ = it_.advertise("tracking_image", 1);
-#endif
+  if (options_.publish_debug_images) {
+    tracker_pub_ = it_.advertise("tracking_image", 1);
+  }
 }
 
-ROSDetectAndTrack3D::~ROSDetectAndTrack3D(){}
+ROSDetectAndTrack3D::~ROSDetectAndTrack3D(){
+  stopInputs();
+  pipeline_->stop();
+  visualization_->stop();
+  delete delta_pub_;
+}
 
 /**
- * @brief 
+ * @brief Renders and publishes the tracking image. Called by the visualization worker.
  * 
- * @param image_tracker 
- * @param tracker_states 
+ * @param image The reference to the RGB image, it is not modified.
+ * @param tracker_states The reference to the states of the tracks.
+ * @param header The reference to the header of the outputs of the frame.
  */
-void ROSDetectAndTrack3D::publishTrackingImage(cv::Mat& image_tracker,
-                                            std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states) {
-  generateTrackingImage(image_tracker, tracker_states);
-  cv::cvtColor(image_tracker, image_tracker, cv::COLOR_RGB2BGR);
-  std_msgs::Header image_ptr_out_header;
-  image_ptr_out_header.stamp = ros::Time::now();
-  image_ptr_out_ = cv_bridge::CvImage(image_ptr_out_header, "bgr8", image_tracker).toImageMsg();
-  tracker_pub_.publish(image_ptr_out_);
+void ROSDetectAndTrack3D::publishTrackingImage(const cv::Mat& image, const std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states,
+                                               const std_msgs::Header& header) {
+  cv::Mat render = visualization_->render(image);
+  generateTrackingImage(render, tracker_states, visualization_->getScale());
+  cv::cvtColor(render, render, cv::COLOR_RGB2BGR);
+  tracker_pub_.publish(cv_bridge::CvImage(header, "bgr8", render).toImageMsg());
 }
 
-#ifdef PUBLISH_DETECTION_WITH_POSITION
 /**
  * @brief 
  * 
@@ -1038,12 +1734,10 @@ void ROSDetectAndTrack3D::publishDetectionsAndPositions(std::vector<std::map<uns
   pose_array.header = ros_bboxes.header;
   pose_array.poses = poses;
   
-  positions_bboxes_pub_.publish(ros_bboxes);
-  pose_array_pub_.publish(pose_array);
+  results_pub_->publishLegacy(positions_bboxes_pub_, ros_bboxes);
+  results_pub_->publishLegacy(pose_array_pub_, pose_array);
 }
 
-#else
-
 /**
  * @brief 
  * 
@@ -1071,7 +1765,7 @@ void ROSDetectAndTrack3D::publishDetections(std::vector<std::map<unsigned int, s
   ros_bboxes.header.frame_id = header.frame_id;
   ros_bboxes.bboxes = vec_ros_bboxes;
 
-  bboxes_pub_.publish(ros_bboxes);
+  results_pub_->publishLegacy(bboxes_pub_, ros_bboxes);
 }
 
 /**
@@ -1097,100 +1791,1211 @@ void ROSDetectAndTrack3D::publishPositions(std::vector<std::map<unsigned int, st
   pose_array.header.stamp = header.stamp;
   pose_array.header.frame_id = header.frame_id;
   pose_array.poses = poses;
-  pose_array_pub_.publish(pose_array);
+  results_pub_->publishLegacy(pose_array_pub_, pose_array);
 }
-#endif
 
-void ROSDetectAndTrack3D::points2Pose(std::vector<std::vector<std::vector<float>>>& points){
+/**
+ * @brief Projects the positions of the objects from the camera frame into the global frame.
+ * @details The transform is looked up once, at the acquisition time of the image, and all the points
+ * are transformed at once.
+ * 
+ * @param points The reference to the positions of the objects, overwritten with their global positions.
+ * @param stamp The reference to the acquisition time of the image.
+ * @return False if the transform is not available, the points are left untouched.
+ */
+bool ROSDetectAndTrack3D::points2Pose(std::vector<std::vector<std::vector<float>>>& points, const ros::Time& stamp){
+  RigidTransform transform;
+  if (!tf_cache_.lookup(global_frame_, camera_frame_, stamp, transform)) {
+    return false;
+  }
+  transformPoints(transform, points);
+  return true;
+}
 
-  geometry_msgs::PoseStamped pose_from_cam;
-  pose_from_cam.header.frame_id = "camera_color_optical_frame";
-  pose_from_cam.header.stamp = t1_;
-  pose_from_cam.pose.orientation.x = 0;
-  pose_from_cam.pose.orientation.y = 0;
-  pose_from_cam.pose.orientation.z = 0;
-  pose_from_cam.pose.orientation.w = 1;
+/**
+ * @brief Returns the pose of the camera the positions of a frame were projected with.
+ * @details The pose comes from the transform cache, it was already looked up by the localization stage.
+ * 
+ * @param frame The reference to the frame.
+ * @param pose The reference to the transform in which the pose will be stored.
+ * @return False if the pose is not known at the stamp of the frame.
+ */
+bool ROSDetectAndTrack3D::getRecordedPose(const PipelineFrame& frame, RigidTransform& pose) {
+  ros::Time stamp;
+  stamp.fromNSec(frame.stamps.stamp);
+  return tf_cache_.lookup(global_frame_, camera_frame_, stamp, pose);
+}
 
-  for (unsigned int i=0; i<points.size(); i++) {
-    geometry_msgs::PoseStamped tmp_pose;
-    for (unsigned int j=0; j<points[i].size(); j++) {
-      try {
-        pose_from_cam.pose.position.x = points[i][j][0];
-        pose_from_cam.pose.position.y = points[i][j][1];
-        pose_from_cam.pose.position.z = points[i][j][2];
-        //tf_buffer_.lookupTransform("world", "camera_color_optical_frame", ros::Time(0));
-        tf_buffer_.transform(pose_from_cam, tmp_pose, global_frame_, ros::Duration(1.0));
-        points[i][j][0] = tmp_pose.pose.position.x;
-        points[i][j][1] = tmp_pose.pose.position.y;
-        points[i][j][2] = tmp_pose.pose.position.z;
-      } catch (tf2::TransformException &ex) {
-        ROS_WARN("%s",ex.what());
-      }
+/**
+ * @brief Builds the stages of the pipeline: detect -> locate -> track -> publish.
+ * 
+ */
+void ROSDetectAndTrack3D::buildPipeline() {
+  pipeline_->addStage("detect", [this](PipelineFrame& frame){return detectStage(frame);}, true);
+  pipeline_->addStage("locate", [this](PipelineFrame& frame){return ROSDetectAndTrack3D::locateStage(frame);}, false);
+  pipeline_->addStage("track", [this](PipelineFrame& frame){return trackStage(frame);}, false);
+  pipeline_->addStage("publish", [this](PipelineFrame& frame){return ROSDetectAndTrack3D::publishFrame(frame);}, false);
+}
+
+/**
+ * @brief Localization stage.
+ * @details Finds the position of the objects in the local frame, projects them into the global frame,
+ * and builds their 3D bounding boxes.
+ * 
+ * @param frame 
+ * @return False if the frame has no depth image, or if the camera pose is not known at its stamp.
+ */
+bool ROSDetectAndTrack3D::locateStage(PipelineFrame& frame) {
+  {
+    std::lock_guard<std::mutex> lock(camera_mutex_);
+    if (!locateFrame(frame)) {
+      return false;
     }
   }
+  // The lock is not held while waiting on TF, the depthInfoCallback would stall the ROS thread.
+  ros::Time stamp;
+  stamp.fromNSec(frame.stamps.stamp);
+  if (!points2Pose(frame.points, stamp)) {
+    ROS_WARN_THROTTLE(1.0, "No transform from %s to %s at %.3f, the frame is skipped (%u frames skipped).",
+                      camera_frame_.c_str(), global_frame_.c_str(), stamp.toSec(), tf_cache_.getMisses());
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(camera_mutex_);
+    make3DBoundingBoxes(frame.points, frame.bboxes, frame.bboxes3D);
+  }
+  printProfilingLocalization();
+  return true;
 }
 
 /**
- * @brief 
+ * @brief Tracking stage. Every located frame is tracked.
  * 
- * @param msg 
+ * @param frame 
+ * @return Always true.
  */
-void ROSDetectAndTrack3D::imageCallback(const sensor_msgs::ImageConstPtr& msg){
-  t2_ = t1_;
-  t1_ = ros::Time::now();
-  if (!depth_received_) {
+bool ROSDetectAndTrack3D::trackStage(PipelineFrame& frame) {
+  ros::Time stamp;
+  stamp.fromNSec(frame.stamps.stamp);
+  if (use_frustum_) {
+    updateCameraFrustum(*this, tf_cache_, global_frame_, camera_frame_, stamp);
+  }
+  trackFrame(frame);
+  printProfilingTracking();
+  return true;
+}
+
+/**
+ * @brief Publication stage.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSDetectAndTrack3D::publishFrame(PipelineFrame& frame) {
+  ScopedTimer timer(publish_histogram_);
+  std_msgs::Header header;
+  frameHeader(frame, header);
+  exportFrame(frame);
+  if (options_.publish_debug_images) {
+    submitDetectionImage(frame, header);
+  }
+  if (delta_pub_ != nullptr) {
+    delta_pub_->publish(frame.deltas, frame.snapshots, header);
+  }
+  results_pub_->publishTracks(frame.tracker_states, frame.track_points, frame.snapshots, header);
+  printProfilingPipeline(frame);
+  return true;
+}
+
+/**
+ * @brief Construct a new ROSPipelineGraph::ROSPipelineGraph object
+ * 
+ */
+ROSPipelineGraph::ROSPipelineGraph() : ROSPipelineGraph(ros::NodeHandle("~")) {}
+
+/**
+ * @brief Construct a new ROSPipelineGraph::ROSPipelineGraph object
+ * @details Reads the description, builds the trackers and the transform listener it uses, and registers the stages.
+ * The pipeline itself is built on the first image.
+ * 
+ * @param nh The private node handle of the node.
+ */
+ROSPipelineGraph::ROSPipelineGraph(const ros::NodeHandle& nh) : ROSDetectAndLocate(nh) {
+  track2D_ = nullptr;
+  track3D_ = nullptr;
+  delta_pub_ = nullptr;
+  use_frustum_ = false;
+  tf_buffer_ = nullptr;
+  listener_ = nullptr;
+  tf_cache_ = nullptr;
+  int arena_size;
+  nh_.param("frame_arena_size", arena_size, 1 << 20);
+  graph_.setArenaSize(std::max(arena_size, 0));
+  readDescription();
+  addStages();
+  // The depth images are only paired with the frames if a stage reads them.
+  ingested_ = FIELD_IMAGE;
+  if (PipelineGraph::uses(description_, "locate") || PipelineGraph::uses(description_, "locate_tracks")) {
+    ingested_ |= FIELD_DEPTH;
+  }
+  unsigned int available;
+  bool valid = graph_.validate(description_, ingested_, available);
+  if (valid && PipelineGraph::uses(description_, "track2D") && PipelineGraph::uses(description_, "track3D")) {
+    ROS_ERROR("The pipeline cannot use both track2D and track3D.");
+    valid = false;
+  }
+  if (!valid) {
+    ROS_ERROR("Invalid pipeline %s, only the detection is run.", PipelineGraph::toString(description_).c_str());
+    parseGraphDescription("[detect, [publish, log]]", description_);
+    ingested_ = FIELD_IMAGE;
+    graph_.validate(description_, ingested_, available);
+  }
+  publish_tracks_ = (available & FIELD_TRACKS) != 0;
+  publish_positions_ = (available & FIELD_POSITIONS) != 0;
+
+  // Trackers
+  DetectionParameters det_p;
+  KalmanParameters kal_p;
+  TrackingParameters tra_p;
+  BBoxRejectionParameters bbo_p;
+  if (PipelineGraph::uses(description_, "track2D")) {
+    readTrackingParameters(nh_, false, det_p, kal_p, tra_p, bbo_p);
+    track2D_ = new Track2D();
+    track2D_->buildTrack2D(det_p, kal_p, tra_p, bbo_p);
+    track2D_->setTrackingProfiling(options_.profile);
+    track2D_->setTrackingInstrumentation(instrumentation_);
+  }
+  if (PipelineGraph::uses(description_, "track3D")) {
+    readTrackingParameters(nh_, true, det_p, kal_p, tra_p, bbo_p);
+    track3D_ = new Track3D();
+    track3D_->buildTrack3D(det_p, kal_p, tra_p, bbo_p);
+    track3D_->setTrackingProfiling(options_.profile);
+    track3D_->setTrackingInstrumentation(instrumentation_);
+    use_frustum_ = tra_p.use_frustum;
+  }
+  if (publish_tracks_) {
+    bool publish_track_deltas;
+    int keyframe_period;
+    nh_.param("publish_track_deltas", publish_track_deltas, false);
+    nh_.param("keyframe_period", keyframe_period, 30);
+    if (publish_track_deltas) {
+      delta_pub_ = new TrackDeltaPublisher(nh_, "tracks", keyframe_period, options_.profile);
+    }
+  }
+  // Transforms
+  if (PipelineGraph::uses(description_, "tf") || use_frustum_) {
+    nh_.param("global_frame", global_frame_, std::string("map"));
+    nh_.param("camera_frame", camera_frame_, std::string("camera_color_optical_frame"));
+    tf_buffer_ = new tf2_ros::Buffer();
+    listener_ = new tf2_ros::TransformListener(*tf_buffer_);
+    tf_cache_ = new TransformCache(*tf_buffer_, 8);
+    setupTransformCache(*tf_cache_);
+  }
+
+  if (track3D_ != nullptr) {
+    record_mode_ = "track3D";
+  } else if ((track2D_ != nullptr) && (available & FIELD_TRACK_POSITIONS)) {
+    record_mode_ = "track2D_locate";
+  } else if (track2D_ != nullptr) {
+    record_mode_ = "track2D";
+  } else if (publish_positions_) {
+    record_mode_ = "locate";
+  } else {
+    record_mode_ = "detect";
+  }
+  ROS_INFO("Pipeline: %s", PipelineGraph::toString(description_).c_str());
+}
+
+ROSPipelineGraph::~ROSPipelineGraph() {
+  stopInputs();
+  pipeline_->stop();
+  graph_.stop();
+  visualization_->stop();
+  delete delta_pub_;
+  delete track2D_;
+  delete track3D_;
+  delete tf_cache_;
+  delete listener_;
+  delete tf_buffer_;
+}
+
+/**
+ * @brief Reads the description of the pipeline.
+ * @details The pipeline parameter is either a YAML list, whose items are the names of the stages or lists of
+ * stages run in parallel, or the same list written as a string. Without it, only the detection is run.
+ * 
+ */
+void ROSPipelineGraph::readDescription() {
+  XmlRpc::XmlRpcValue value;
+  if (!nh_.getParam("pipeline", value)) {
+    parseGraphDescription("[detect, [publish, log]]", description_);
     return;
   }
-  ros::Duration dt = t1_ - t2_; 
-  dt_ = (float) (dt.toSec());
-#ifdef PROFILE
-  auto start_inference = std::chrono::system_clock::now();
-#endif
-  cv_bridge::CvImagePtr cv_ptr;
-  try {
-    cv_ptr = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
-  } catch (cv_bridge::Exception &e) {
-    ROS_ERROR("cv_bridge exception: %s", e.what());
+  if (value.getType() == XmlRpc::XmlRpcValue::TypeString) {
+    parseGraphDescription(static_cast<std::string>(value), description_);
     return;
   }
-  cv::Mat image = cv_ptr->image;
-  cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
-  // Run detection and find the position of the objects in the local frame
-  std::vector<std::vector<BoundingBox>> bboxes(num_classes_);
-  std::vector<std::vector<BoundingBox3D>> bboxes3D(num_classes_);
-  printf("detecting stuff\n");
-  detectObjects(image, bboxes);
-  std::vector<std::vector<float>> distances;
-  std::vector<std::vector<std::vector<float>>> points;
-  printf("locating stuff\n");
-  locate(depth_image_, bboxes, distances, points);
-  // Project the objects into the global frame
-  printf("projecting points to global frame\n");
-  points2Pose(points);
-  printf("making 3D bboxes\n");
-  make3DBoundingBoxes(points, bboxes, bboxes3D);
-  // Run the tracking on the 3D objects
-  std::vector<std::map<unsigned int, std::vector<float>>> tracker_states;
-  tracker_states.resize(num_classes_);
-  track(bboxes3D, tracker_states, dt_);
-#ifdef PROFILE
-  auto end_inference = std::chrono::system_clock::now();
-  ROS_INFO("Full inference done in %ld ms", std::chrono::duration_cast<std::chrono::milliseconds>(end_inference - start_inference).count());
-  printProfilingDetection();
-  printProfilingTracking();
-  printProfilingLocalization();
-#endif
-
-#ifdef PUBLISH_DETECTION_IMAGE
-  publishDetectionImage(image, bboxes);
-#endif
-#ifdef PUBLISH_DETECTION_WITH_POSITION
-  //publishDetectionsAndPositions(tracker_states, points, cv_ptr->header);
-  //publishDetectionsAndPositions(bboxes, points, cv_ptr->header);
-#else
-  //publishDetections(bboxes,cv_ptr->header);
-  //publishPositions(bboxes, points, cv_ptr->header);
-  //publishDetections(tracker_states, cv_ptr->header);
-  //publishPositions(points, cv_ptr->header);
-#endif
-}
\ No newline at end of file
+  description_.clear();
+  if (value.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+    ROS_ERROR("The pipeline parameter must be a list.");
+    return;
+  }
+  for (int s = 0; s < value.size(); s++) {
+    description_.emplace_back();
+    if (value[s].getType() == XmlRpc::XmlRpcValue::TypeString) {
+      description_.back().push_back(static_cast<std::string>(value[s]));
+    } else if (value[s].getType() == XmlRpc::XmlRpcValue::TypeArray) {
+      for (int b = 0; b < value[s].size(); b++) {
+        if (value[s][b].getType() == XmlRpc::XmlRpcValue::TypeString) {
+          description_.back().push_back(static_cast<std::string>(value[s][b]));
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Registers the stages the descriptions can use, with the fields they read and write.
+ * 
+ */
+void ROSPipelineGraph::addStages() {
+  graph_.addStage({"detect", FIELD_IMAGE, FIELD_IMAGE | FIELD_DETECTIONS, true,
+                   [this](PipelineFrame& frame){return detectStage(frame);}});
+  graph_.addStage({"locate", FIELD_DEPTH | FIELD_DETECTIONS, FIELD_POSITIONS, false,
+                   [this](PipelineFrame& frame){return locateStage(frame);}});
+  graph_.addStage({"locate_tracks", FIELD_DEPTH | FIELD_TRACKS, FIELD_TRACK_POSITIONS, false,
+                   [this](PipelineFrame& frame){return locateTracksStage(frame);}});
+  graph_.addStage({"tf", FIELD_POSITIONS, FIELD_POSITIONS, false,
+                   [this](PipelineFrame& frame){return tfStage(frame);}});
+  graph_.addStage({"track2D", FIELD_DETECTIONS, FIELD_TRACKS, false,
+                   [this](PipelineFrame& frame){return track2DStage(frame);}});
+  graph_.addStage({"track3D", FIELD_DETECTIONS | FIELD_POSITIONS, FIELD_BOXES3D | FIELD_TRACKS, false,
+                   [this](PipelineFrame& frame){return track3DStage(frame);}});
+  graph_.addStage({"publish", 0, 0, false, [this](PipelineFrame& frame){return publishStage(frame);}});
+  graph_.addStage({"log", 0, 0, false, [this](PipelineFrame& frame){return logStage(frame);}});
+}
+
+/**
+ * @brief Attaches the depth image closest in time to a new frame, if a stage reads it.
+ * 
+ * @param frame 
+ * @return False if the depth is read, and no depth image was received within the tolerance.
+ */
+bool ROSPipelineGraph::prepareFrame(PipelineFrame& frame) {
+  if (!(ingested_ & FIELD_DEPTH)) {
+    return true;
+  }
+  return ROSDetectAndLocate::prepareFrame(frame);
+}
+
+/**
+ * @brief Builds the stages of the pipeline from the description.
+ * 
+ */
+void ROSPipelineGraph::buildPipeline() {
+  graph_.build(description_, ingested_, *pipeline_);
+}
+
+/**
+ * @brief Transform stage. Projects the positions of the objects from the camera frame into the global frame.
+ * 
+ * @param frame 
+ * @return False if the camera pose is not known at the stamp of the frame.
+ */
+bool ROSPipelineGraph::tfStage(PipelineFrame& frame) {
+  ros::Time stamp;
+  stamp.fromNSec(frame.stamps.stamp);
+  RigidTransform transform;
+  if (!tf_cache_->lookup(global_frame_, camera_frame_, stamp, transform)) {
+    ROS_WARN_THROTTLE(1.0, "No transform from %s to %s at %.3f, the frame is skipped (%u frames skipped).",
+                      camera_frame_.c_str(), global_frame_.c_str(), stamp.toSec(), tf_cache_->getMisses());
+    return false;
+  }
+  transformPoints(transform, frame.points);
+  return true;
+}
+
+/**
+ * @brief 2D tracking stage. Every detected frame is tracked.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSPipelineGraph::track2DStage(PipelineFrame& frame) {
+  track2D_->trackFrame(frame);
+  track2D_->printProfilingTracking();
+  return true;
+}
+
+/**
+ * @brief 3D tracking stage.
+ * @details Builds the 3D bounding boxes of the located objects, updates the frustum of the camera if it is used,
+ * and tracks the boxes.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSPipelineGraph::track3DStage(PipelineFrame& frame) {
+  {
+    std::lock_guard<std::mutex> lock(camera_mutex_);
+    make3DBoundingBoxes(frame.points, frame.bboxes, frame.bboxes3D);
+  }
+  if (use_frustum_) {
+    ros::Time stamp;
+    stamp.fromNSec(frame.stamps.stamp);
+    updateCameraFrustum(*track3D_, *tf_cache_, global_frame_, camera_frame_, stamp);
+  }
+  track3D_->trackFrame(frame);
+  track3D_->printProfilingTracking();
+  return true;
+}
+
+/**
+ * @brief Publication stage.
+ * @details Publishes the tracks if the pipeline tracks the objects, the detections otherwise.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSPipelineGraph::publishStage(PipelineFrame& frame) {
+  ScopedTimer timer(publish_histogram_);
+  std_msgs::Header header;
+  frameHeader(frame, header);
+  if (options_.publish_debug_images) {
+    submitDetectionImage(frame, header);
+  }
+  if (publish_tracks_) {
+    if (delta_pub_ != nullptr) {
+      delta_pub_->publish(frame.deltas, frame.snapshots, header);
+    }
+    results_pub_->publishTracks(frame.tracker_states, frame.track_points, frame.snapshots, header);
+  } else {
+    if (options_.publish_legacy_topics && !publish_positions_) {
+      publishDetections(frame.bboxes, header);
+    } else if (options_.publish_legacy_topics && options_.publish_positions_with_bboxes) {
+      publishDetectionsAndPositions(frame.bboxes, frame.points, header);
+    } else if (options_.publish_legacy_topics) {
+      publishDetections(frame.bboxes, header);
+      publishPositions(frame.bboxes, frame.points, header);
+    }
+    results_pub_->publishDetections(frame.bboxes, frame.points, header);
+  }
+  printProfilingPipeline(frame);
+  return true;
+}
+
+/**
+ * @brief Logging stage. Exports, records, and logs the frame, if enabled.
+ * 
+ * @param frame 
+ * @return Always true.
+ */
+bool ROSPipelineGraph::logStage(PipelineFrame& frame) {
+  exportFrame(frame);
+  return true;
+}
+
+/**
+ * @brief Returns the pose of the camera the positions of a frame were projected with.
+ * 
+ * @param frame The reference to the frame.
+ * @param pose The reference to the transform in which the pose will be stored.
+ * @return False if the positions are not projected, or if the pose is not known at the stamp of the frame.
+ */
+bool ROSPipelineGraph::getRecordedPose(const PipelineFrame& frame, RigidTransform& pose) {
+  if (!PipelineGraph::uses(description_, "tf")) {
+    return false;
+  }
+  ros::Time stamp;
+  stamp.fromNSec(frame.stamps.stamp);
+  return tf_cache_->lookup(global_frame_, camera_frame_, stamp, pose);
+}
+
+/**
+ * @brief Construct a new InputQueue object
+ * 
+ * @param nh The reference to the node handle of the node.
+ * @param name The reference to the name of the input, used in the logs.
+ * @param threads The reference to the number of threads servicing the queue.
+ * @param separate The reference to the flag enabling the separate queue. If false, the queue of the node is used.
+ * @param profile The reference to the flag enabling the statistics of the callback delays.
+ */
+InputQueue::InputQueue(const ros::NodeHandle& nh, const std::string& name, const int& threads, const bool& separate,
+                       const bool& profile) :
+    name_(name), spinner_(std::max(threads, 1), &queue_), nh_(nh), separate_(separate), running_(false), profile_(profile) {
+  if (separate_) {
+    nh_.setCallbackQueue(&queue_);
+  }
+  delay_sum_ = 0;
+  delay_max_ = 0;
+  delay_count_ = 0;
+}
+
+InputQueue::~InputQueue() {
+  stop();
+}
+
+/**
+ * @brief Returns the node handle to subscribe to the input with.
+ * 
+ * @return The reference to the node handle.
+ */
+ros::NodeHandle& InputQueue::getNodeHandle() {
+  return nh_;
+}
+
+/**
+ * @brief Starts the threads servicing the queue, if it is a separate queue.
+ * 
+ */
+void InputQueue::start() {
+  if (separate_ && !running_) {
+    spinner_.start();
+    running_ = true;
+  }
+}
+
+/**
+ * @brief Stops the threads servicing the queue, and waits for the running callbacks.
+ * 
+ */
+void InputQueue::stop() {
+  if (running_) {
+    spinner_.stop();
+    running_ = false;
+  }
+}
+
+/**
+ * @brief Records the delay in between the acquisition of a message and the start of its callback.
+ * @details If profiling is enabled, the mean and maximum delays are printed every 100 messages.
+ * 
+ * @param stamp The reference to the acquisition time of the message.
+ */
+void InputQueue::recordDelay(const ros::Time& stamp) {
+  if (!profile_) {
+    return;
+  }
+  const double delay = (ros::Time::now() - stamp).toSec() * 1000;
+  std::lock_guard<std::mutex> lock(mutex_);
+  delay_sum_ += delay;
+  delay_max_ = std::max(delay_max_, delay);
+  delay_count_ ++;
+  if (delay_count_ == 100) {
+    ROS_INFO("%s callbacks started %.2f ms (mean), %.2f ms (max) after the data was acquired, %s queue",
+             name_.c_str(), delay_sum_ / delay_count_, delay_max_, separate_ ? "separate" : "shared");
+    delay_sum_ = 0;
+    delay_max_ = 0;
+    delay_count_ = 0;
+  }
+}
+
+/**
+ * @brief Construct a new VisualizationWorker object, and starts its thread.
+ * 
+ * @param rate The reference to the maximum rate of the debug images, in Hz. 0 renders every frame.
+ * @param scale The reference to the ratio in between the size of the debug images and the size of the input images.
+ */
+VisualizationWorker::VisualizationWorker(const float& rate, const float& scale) {
+  scale_ = ((scale > 0) && (scale < 1)) ? scale : 1.0;
+  period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(rate > 0 ? 1.0 / rate : 0.0));
+  last_submit_ = std::chrono::steady_clock::now() - period_;
+  running_ = true;
+  thread_ = std::thread(&VisualizationWorker::run, this);
+}
+
+VisualizationWorker::~VisualizationWorker() {
+  stop();
+}
+
+/**
+ * @brief Checks if a new frame can be rendered. If true, the period restarts.
+ * @details Must be called from a single thread, the publication stage.
+ * 
+ * @return True if the last frame was handed over more than a period ago.
+ */
+bool VisualizationWorker::isDue() {
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now - last_submit_ < period_) {
+    return false;
+  }
+  last_submit_ = now;
+  return true;
+}
+
+/**
+ * @brief Hands a frame over to the worker, replacing the one it did not start rendering yet.
+ * 
+ * @param job The rendering and publication of the frame.
+ */
+void VisualizationWorker::submit(std::function<void()>&& job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = std::move(job);
+  }
+  condition_.notify_one();
+}
+
+/**
+ * @brief Stops the worker, and waits for the image being rendered, if any.
+ * 
+ */
+void VisualizationWorker::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+      return;
+    }
+    running_ = false;
+  }
+  condition_.notify_one();
+  thread_.join();
+}
+
+/**
+ * @brief Returns the ratio in between the size of the debug images and the size of the input images.
+ * 
+ * @return The scale.
+ */
+float VisualizationWorker::getScale() const {
+  return scale_;
+}
+
+/**
+ * @brief Makes the copy of an image the debug image is drawn on.
+ * 
+ * @param image The reference to the input image.
+ * @return A new image, downscaled if required.
+ */
+cv::Mat VisualizationWorker::render(const cv::Mat& image) const {
+  cv::Mat copy;
+  if (scale_ < 1) {
+    cv::resize(image, copy, cv::Size(), scale_, scale_, cv::INTER_AREA);
+  } else {
+    copy = image.clone();
+  }
+  return copy;
+}
+
+/**
+ * @brief The loop of the worker: renders the last frame handed over, at the lowest scheduling priority.
+ * 
+ */
+void VisualizationWorker::run() {
+  sched_param parameters;
+  parameters.sched_priority = 0;
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &parameters);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(lock, [this]{return !running_ || job_;});
+    if (!running_) {
+      return;
+    }
+    std::function<void()> job = std::move(job_);
+    job_ = nullptr;
+    lock.unlock();
+    job();
+    lock.lock();
+  }
+}
+
+/**
+ * @brief Construct a new DepthBuffer object
+ * 
+ * @param size The reference to the number of depth images kept.
+ * @param tolerance The reference to the maximum time in between a colour and a depth image, in seconds.
+ */
+DepthBuffer::DepthBuffer(const unsigned int& size, const float& tolerance) {
+  ring_.resize(std::max(size, 1u));
+  for (unsigned int i=0; i < ring_.size(); i++) {
+    ring_[i].stamp = -1;
+  }
+  next_ = 0;
+  tolerance_ = (int64_t) (tolerance * 1e9);
+  matched_ = 0;
+  missed_ = 0;
+}
+
+/**
+ * @brief Adds a depth image, replacing the oldest one.
+ * 
+ * @param stamp The reference to the acquisition time of the image, in nanoseconds.
+ * @param depth The reference to the image.
+ * @param owner The reference to the owner of the data of the image.
+ */
+void DepthBuffer::push(const int64_t& stamp, const cv::Mat& depth, const std::shared_ptr<const void>& owner) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ring_[next_].stamp = stamp;
+  ring_[next_].depth = depth;
+  ring_[next_].owner = owner;
+  next_ = (next_ + 1) % ring_.size();
+}
+
+/**
+ * @brief Finds the depth image closest in time to a colour image.
+ * 
+ * @param stamp The reference to the acquisition time of the colour image, in nanoseconds.
+ * @param depth The reference to the matched depth image.
+ * @return False if no depth image is within the tolerance.
+ */
+bool DepthBuffer::match(const int64_t& stamp, StampedDepth& depth) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  int best = -1;
+  int64_t best_gap = tolerance_;
+  for (unsigned int i=0; i < ring_.size(); i++) {
+    if (ring_[i].stamp < 0) {
+      continue;
+    }
+    const int64_t gap = std::abs(ring_[i].stamp - stamp);
+    if (gap <= best_gap) {
+      best = i;
+      best_gap = gap;
+    }
+  }
+  if (best < 0) {
+    missed_ ++;
+    return false;
+  }
+  depth = ring_[best];
+  matched_ ++;
+  return true;
+}
+
+/**
+ * @brief Returns the number of colour images paired, and dropped.
+ * 
+ * @param matched The reference to the number of colour images paired with a depth image.
+ * @param missed The reference to the number of colour images without a depth image.
+ */
+void DepthBuffer::getStatistics(uint64_t& matched, uint64_t& missed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  matched = matched_;
+  missed = missed_;
+}
+
+/**
+ * @brief Construct a new TransformCache object
+ * 
+ * @param buffer The reference to the TF buffer the transforms are looked up in.
+ * @param size The reference to the number of transforms kept in the cache.
+ */
+TransformCache::TransformCache(tf2_ros::Buffer& buffer, const unsigned int& size) : buffer_(buffer), timeout_(0.0), histogram_(nullptr), trace_(nullptr) {
+  cache_.resize(std::max(size, 1u));
+  next_ = 0;
+  misses_ = 0;
+}
+
+/**
+ * @brief Sets the maximum time a lookup waits for TF.
+ * 
+ * @param timeout The reference to the timeout, in seconds. 0 never waits.
+ */
+void TransformCache::setTimeout(const float& timeout) {
+  timeout_ = ros::Duration(std::max(timeout, 0.0f));
+}
+
+/**
+ * @brief Sets the histogram in which the duration of the lookups is recorded.
+ * 
+ * @param histogram The pointer to the histogram, nullptr to disable the timer.
+ */
+void TransformCache::setHistogram(LatencyHistogram* histogram) {
+  histogram_ = histogram;
+}
+
+/**
+ * @brief Sets the buffer in which the waits on TF are recorded, as spans of the frames being looked up.
+ * 
+ * @param trace The pointer to the buffer, nullptr to disable the tracing.
+ */
+void TransformCache::setTrace(TraceBuffer* trace) {
+  trace_ = trace;
+}
+
+/**
+ * @brief Returns the number of failed lookups.
+ * 
+ * @return The number of failed lookups.
+ */
+unsigned int TransformCache::getMisses() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+/**
+ * @brief Looks up a transform, from the cache if it was already looked up at this stamp.
+ * 
+ * @param target The reference to the frame the points are moved to.
+ * @param source The reference to the frame the points are expressed in.
+ * @param stamp The reference to the time of the transform.
+ * @param transform The reference to the transform.
+ * @return False if TF cannot provide the transform yet.
+ */
+bool TransformCache::lookup(const std::string& target, const std::string& source, const ros::Time& stamp, RigidTransform& transform) {
+  ScopedTimer timer(histogram_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (unsigned int i=0; i < cache_.size(); i++) {
+      if ((cache_[i].stamp == stamp) && (cache_[i].source == source) && (cache_[i].target == target)) {
+        transform = cache_[i].transform;
+        return true;
+      }
+    }
+  }
+  // The cache lock is not held while waiting on TF.
+  ScopedSpan span(trace_, "tf_wait", stamp.toNSec(), 0);
+  geometry_msgs::TransformStamped transform_msg;
+  try {
+    if (!buffer_.canTransform(target, source, stamp, timeout_)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      misses_ ++;
+      return false;
+    }
+    transform_msg = buffer_.lookupTransform(target, source, stamp);
+  } catch (tf2::TransformException &ex) {
+    ROS_WARN_THROTTLE(1.0, "%s", ex.what());
+    std::lock_guard<std::mutex> lock(mutex_);
+    misses_ ++;
+    return false;
+  }
+  Eigen::Quaternionf rotation(transform_msg.transform.rotation.w, transform_msg.transform.rotation.x,
+                              transform_msg.transform.rotation.y, transform_msg.transform.rotation.z);
+  transform.rotation = rotation.normalized().toRotationMatrix();
+  transform.translation = Eigen::Vector3f(transform_msg.transform.translation.x, transform_msg.transform.translation.y,
+                                          transform_msg.transform.translation.z);
+  std::lock_guard<std::mutex> lock(mutex_);
+  cache_[next_].target = target;
+  cache_[next_].source = source;
+  cache_[next_].stamp = stamp;
+  cache_[next_].transform = transform;
+  next_ = (next_ + 1) % cache_.size();
+  return true;
+}
+
+/**
+ * @brief Construct a new TrackDeltaPublisher object
+ * 
+ * @param nh The reference to the node handle used to advertise the topic.
+ * @param topic The reference to the name of the topic.
+ * @param keyframe_period The reference to the number of messages in between two keyframes.
+ * @param profile The reference to the flag enabling the size statistics of the messages.
+ */
+TrackDeltaPublisher::TrackDeltaPublisher(ros::NodeHandle& nh, const std::string& topic, const int& keyframe_period, const bool& profile) {
+  pub_ = nh.advertise<detect_and_track::TrackStateDelta>(topic, 10);
+  keyframe_period_ = keyframe_period;
+  profile_ = profile;
+  last_update_ = 0;
+}
+
+/**
+ * @brief Converts a set of tracks to ROS messages.
+ * 
+ * @param states The reference to the states of the tracks.
+ * @param class_id The reference to the class of the tracks.
+ * @param ros_states The reference to the vector in which the messages are appended.
+ */
+void TrackDeltaPublisher::addStates(const std::map<unsigned int, std::vector<float>>& states, const int& class_id,
+                                    std::vector<detect_and_track::TrackState>& ros_states) {
+  detect_and_track::TrackState ros_state;
+  ros_state.class_id = class_id;
+  for (auto & element : states) {
+    ros_state.track_id = element.first;
+    ros_state.state = element.second;
+    ros_states.push_back(ros_state);
+  }
+}
+
+/**
+ * @brief Publishes the changes made by the last update, or a keyframe.
+ * @details A keyframe is published every keyframe_period updates, and whenever the deltas do not follow the
+ * last published update: the changes of the skipped updates are lost, the subscribers must resynchronize.
+ * 
+ * @param deltas The reference to the changes made by each tracker.
+ * @param snapshots The reference to the tracks of each tracker, used to build the keyframes.
+ * @param header The reference to the header of the message.
+ */
+void TrackDeltaPublisher::publish(const std::vector<TrackDelta>& deltas,
+                                  const std::vector<std::shared_ptr<const TrackSnapshot>>& snapshots,
+                                  const std_msgs::Header& header) {
+  detect_and_track::TrackStateDelta msg;
+  detect_and_track::TrackState ros_state;
+  msg.header = header;
+  const uint64_t update = deltas.empty() ? last_update_ + 1 : deltas[0].update;
+  bool skipped = last_update_ == 0;
+  for (unsigned int i=0; i < deltas.size(); i++) {
+    skipped |= deltas[i].update != last_update_ + 1;
+  }
+  msg.sequence = update;
+  msg.keyframe = skipped || (keyframe_period_ <= 1) || (update % keyframe_period_ == 0);
+  for (unsigned int i=0; i < deltas.size(); i++) {
+    if (msg.keyframe) {
+      addStates(snapshots[i]->states, i, msg.updated);
+    } else {
+      addStates(deltas[i].created, i, msg.created);
+      addStates(deltas[i].updated, i, msg.updated);
+    }
+    ros_state.class_id = i;
+    for (unsigned int j=0; j < deltas[i].removed.size(); j++) {
+      ros_state.track_id = deltas[i].removed[j];
+      msg.removed.push_back(ros_state);
+    }
+  }
+  if (profile_) {
+    ROS_INFO("Track delta %ld: %d created, %d updated, %d removed, %d bytes%s", update, (int) msg.created.size(),
+             (int) msg.updated.size(), (int) msg.removed.size(), (int) ros::serialization::serializationLength(msg),
+             msg.keyframe ? " (keyframe)" : "");
+  }
+  publishShared(pub_, msg);
+  last_update_ = update;
+}
+
+/**
+ * @brief Construct a new FrameResultPublisher object, and publishes the class names.
+ * 
+ * @param nh The reference to the node handle used to advertise the topics.
+ * @param class_map The reference to the names of the classes.
+ * @param instrumentation The pointer to the histograms of the node, nullptr if disabled.
+ * @param sample_period The reference to the time in between two frames measured for the histograms, in seconds.
+ * @param profile The reference to the flag enabling the size and time statistics of every message.
+ */
+FrameResultPublisher::FrameResultPublisher(ros::NodeHandle& nh, const std::vector<std::string>& class_map,
+                                           Instrumentation* instrumentation, const float& sample_period, const bool& profile) {
+  pub_ = nh.advertise<detect_and_track::FrameResult>("results", 10);
+  class_pub_ = nh.advertise<detect_and_track::ClassNames>("class_names", 1, true);
+  sequence_ = 0;
+  profile_ = profile;
+  results_histogram_ = nullptr;
+  legacy_histogram_ = nullptr;
+  if (instrumentation != nullptr) {
+    results_histogram_ = instrumentation->getHistogram("serialize_results");
+    legacy_histogram_ = instrumentation->getHistogram("serialize_legacy");
+  }
+  sample_period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(sample_period));
+  next_sample_ = std::chrono::steady_clock::now();
+  measure_ = profile_ || (results_histogram_ != nullptr);
+  legacy_messages_ = 0;
+  legacy_bytes_ = 0;
+  legacy_time_ = 0;
+  detect_and_track::ClassNames class_names;
+  class_names.class_names = class_map;
+  class_pub_.publish(class_names);
+}
+
+/**
+ * @brief Appends the position of an object, NaN if it was not located.
+ * 
+ * @param point The reference to the position of the object, empty if it was not located.
+ * @param msg The reference to the message.
+ */
+void FrameResultPublisher::addPosition(const std::vector<float>& point, detect_and_track::FrameResult& msg) {
+  for (unsigned int k=0; k < 3; k++) {
+    msg.positions.push_back(point.size() >= 3 ? point[k] : std::numeric_limits<float>::quiet_NaN());
+  }
+}
+
+/**
+ * @brief Publishes the valid detections of a frame, with their positions if they were located.
+ * 
+ * @param bboxes The reference to the detections.
+ * @param points The reference to the positions of the detections, empty if they were not located.
+ * @param header The reference to the header of the message.
+ */
+void FrameResultPublisher::publishDetections(const std::vector<std::vector<BoundingBox>>& bboxes,
+                                             const std::vector<std::vector<std::vector<float>>>& points,
+                                             const std_msgs::Header& header) {
+  static const std::vector<float> not_located;
+  detect_and_track::FrameResult msg;
+  msg.header = header;
+  bool located = false;
+  for (unsigned int i=0; i < bboxes.size(); i++) {
+    for (unsigned int j=0; j < bboxes[i].size(); j++) {
+      if (!bboxes[i][j].valid_) {
+        continue;
+      }
+      msg.boxes.insert(msg.boxes.end(), {bboxes[i][j].x_min_, bboxes[i][j].y_min_, bboxes[i][j].w_, bboxes[i][j].h_});
+      msg.confidences.push_back(bboxes[i][j].confidence_);
+      msg.class_ids.push_back(i);
+      const bool has_point = (i < points.size()) && (j < points[i].size());
+      located |= has_point;
+      addPosition(has_point ? points[i][j] : not_located, msg);
+    }
+  }
+  if (!located) {
+    msg.positions.clear();
+  }
+  send(msg);
+}
+
+/**
+ * @brief Publishes the tracks of a frame.
+ * @details The 2D tracks are published with their boxes, and with their positions if they were located.
+ * The 3D tracks are published with their positions, and with the variances of their positions on the diagonal
+ * of the covariances.
+ * 
+ * @param tracker_states The reference to the states of the tracks.
+ * @param track_points The reference to the positions of the 2D tracks, empty if they were not located.
+ * @param snapshots The reference to the snapshots of the trackers, empty if the covariances are not published.
+ * @param header The reference to the header of the message.
+ */
+void FrameResultPublisher::publishTracks(const std::vector<std::map<unsigned int, std::vector<float>>>& tracker_states,
+                                         const std::vector<std::map<unsigned int, std::vector<float>>>& track_points,
+                                         const std::vector<std::shared_ptr<const TrackSnapshot>>& snapshots,
+                                         const std_msgs::Header& header) {
+  static const std::vector<float> not_located;
+  detect_and_track::FrameResult msg;
+  msg.header = header;
+  bool located = false;
+  bool estimated = false;
+  for (unsigned int i=0; i < tracker_states.size(); i++) {
+    for (auto & element : tracker_states[i]) {
+      const std::vector<float>& state = element.second;
+      msg.class_ids.push_back(i);
+      msg.track_ids.push_back(element.first);
+      if (state.size() >= 9) {
+        // 3D tracks: x, y, z, vx, vy, vz, w, d, h.
+        std::vector<float> variances;
+        if ((i < snapshots.size()) && snapshots[i]) {
+          auto uncertainty = snapshots[i]->uncertainties.find(element.first);
+          if ((uncertainty != snapshots[i]->uncertainties.end()) && (uncertainty->second.size() >= 3)) {
+            variances = uncertainty->second;
+          }
+        }
+        estimated |= !variances.empty();
+        located = true;
+        addPosition(state, msg);
+        // Only the variances are known, the diagonal is NaN if the tracker did not provide them.
+        for (unsigned int k=0; k < 9; k++) {
+          if (k % 4 != 0) {
+            msg.covariances.push_back(0);
+          } else {
+            msg.covariances.push_back(variances.empty() ? std::numeric_limits<float>::quiet_NaN() : variances[k / 4]);
+          }
+        }
+      } else {
+        // 2D tracks: x, y, vx, vy, w, h.
+        msg.boxes.insert(msg.boxes.end(), {state[0] - state[4]/2, state[1] - state[5]/2, state[4], state[5]});
+        std::map<unsigned int, std::vector<float>>::const_iterator point;
+        const bool has_point = (i < track_points.size()) &&
+                               ((point = track_points[i].find(element.first)) != track_points[i].end());
+        located |= has_point;
+        addPosition(has_point ? point->second : not_located, msg);
+      }
+    }
+  }
+  if (!located) {
+    msg.positions.clear();
+  }
+  if (!estimated) {
+    msg.covariances.clear();
+  }
+  send(msg);
+}
+
+/**
+ * @brief Publishes a frame result, and prints its statistics if profiling is enabled.
+ * @details Then decides whether the next frame is measured: always when profiling, otherwise once
+ * the sample period has elapsed since the last measured frame.
+ * 
+ * @param msg The reference to the message, moved into the publication.
+ */
+void FrameResultPublisher::send(detect_and_track::FrameResult& msg) {
+  msg.sequence = sequence_;
+  if (measure_) {
+    uint64_t time;
+    const uint32_t bytes = measure(msg, results_histogram_, time);
+    if (profile_) {
+      ROS_INFO("Frame result %ld: %d objects, %u bytes, serialized in %.3f ms", sequence_, (int) msg.class_ids.size(),
+               bytes, time * 1e-6);
+      if (legacy_messages_ > 0) {
+        ROS_INFO(" - per-object topics: %u messages, %lu bytes, serialized in %.3f ms", legacy_messages_, legacy_bytes_,
+                 legacy_time_ * 1e-6);
+      }
+    }
+    legacy_messages_ = 0;
+    legacy_bytes_ = 0;
+    legacy_time_ = 0;
+    next_sample_ = std::chrono::steady_clock::now() + sample_period_;
+  }
+  publishShared(pub_, msg);
+  sequence_ ++;
+  measure_ = profile_ || ((results_histogram_ != nullptr) && (std::chrono::steady_clock::now() >= next_sample_));
+}
+
+/**
+ * @brief Construct a new DiagnosticsPublisher object, and starts its timer.
+ * 
+ * @param nh The reference to the node handle whose queue services the timer.
+ * @param name The reference to the name of the node, used as a prefix of the names of the statuses.
+ * @param period The reference to the time in between two messages, in seconds.
+ * @param instrumentation The pointer to the histograms of the node.
+ * @param pipeline The pointer to the pipeline of the node, nullptr if it has none.
+ */
+DiagnosticsPublisher::DiagnosticsPublisher(ros::NodeHandle& nh, const std::string& name, const float& period,
+                                           Instrumentation* instrumentation, Pipeline<PipelineFrame>* pipeline) {
+  name_ = name;
+  instrumentation_ = instrumentation;
+  pipeline_ = pipeline;
+  last_time_ = ros::WallTime::now();
+  pub_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+  timer_ = nh.createWallTimer(ros::WallDuration(period), &DiagnosticsPublisher::timerCallback, this);
+}
+
+/**
+ * @brief Stops the timer.
+ * 
+ */
+void DiagnosticsPublisher::stop() {
+  timer_.stop();
+}
+
+/**
+ * @brief Adds a value to a status.
+ * 
+ * @param status The reference to the status.
+ * @param key The reference to the name of the value.
+ * @param value The reference to the value.
+ */
+void DiagnosticsPublisher::addValue(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, const double& value) {
+  diagnostic_msgs::KeyValue key_value;
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.6g", value);
+  key_value.key = key;
+  key_value.value = buffer;
+  status.values.push_back(key_value);
+}
+
+/**
+ * @brief Collects the histograms, and the statistics of the pipeline, and publishes them.
+ * @details The percentiles and rates cover the last period only, the totals of the pipeline cover the life of the node.
+ * If the allocation hooks are linked, the allocations made by each stage per frame are added to its status,
+ * and the allocations made outside of the stages (in the callbacks) are published per second.
+ * 
+ * @param event The reference to the timer event.
+ */
+void DiagnosticsPublisher::timerCallback(const ros::WallTimerEvent& event) {
+  const ros::WallTime now = ros::WallTime::now();
+  const double elapsed = std::max((now - last_time_).toSec(), 1e-6);
+  last_time_ = now;
+  diagnostic_msgs::DiagnosticArray msg;
+  msg.header.stamp = ros::Time::now();
+  char message[128];
+
+  std::vector<LatencySummary> summaries;
+  instrumentation_->collect(summaries);
+  for (unsigned int i=0; i < summaries.size(); i++) {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = name_ + ": " + summaries[i].name;
+    status.hardware_id = name_;
+    snprintf(message, sizeof(message), "p50 %.2f ms, p99 %.2f ms, max %.2f ms", summaries[i].p50, summaries[i].p99, summaries[i].max);
+    status.message = message;
+    addValue(status, "p50 (ms)", summaries[i].p50);
+    addValue(status, "p90 (ms)", summaries[i].p90);
+    addValue(status, "p99 (ms)", summaries[i].p99);
+    addValue(status, "max (ms)", summaries[i].max);
+    addValue(status, "mean (ms)", summaries[i].mean);
+    addValue(status, "count", summaries[i].count);
+    addValue(status, "rate (Hz)", summaries[i].count / elapsed);
+    msg.status.push_back(status);
+  }
+
+  std::vector<AllocationStatistics> allocations;
+  std::vector<bool> reported;
+  if (AllocationAccounting::isHooked()) {
+    AllocationAccounting::collect(allocations);
+    reported.resize(allocations.size(), false);
+  }
+
+  if (pipeline_ != nullptr) {
+    std::vector<StageStatistics> statistics;
+    pipeline_->getStatistics(statistics);
+    for (unsigned int i=0; i < statistics.size(); i++) {
+      StageStatistics previous{statistics[i].name, 0, 0, 0, 0, 0.0, 0, 0};
+      if (i < last_statistics_.size()) {
+        previous = last_statistics_[i];
+      }
+      const uint64_t processed = statistics[i].processed - previous.processed;
+      const uint64_t dropped = statistics[i].dropped - previous.dropped;
+      const uint64_t overflow = statistics[i].overflow - previous.overflow;
+      diagnostic_msgs::DiagnosticStatus status;
+      status.level = overflow > 0 ? diagnostic_msgs::DiagnosticStatus::WARN : diagnostic_msgs::DiagnosticStatus::OK;
+      status.name = name_ + ": stage " + statistics[i].name;
+      status.hardware_id = name_;
+      snprintf(message, sizeof(message), "%.1f Hz, %lu dropped, %lu overflowed", processed / elapsed, (unsigned long) dropped, (unsigned long) overflow);
+      status.message = message;
+      addValue(status, "throughput (Hz)", processed / elapsed);
+      addValue(status, "dropped", dropped);
+      addValue(status, "overflowed", overflow);
+      addValue(status, "queue depth", statistics[i].queue_depth);
+      addValue(status, "mean (ms)", statistics[i].mean_time);
+      addValue(status, "total processed", statistics[i].processed);
+      addValue(status, "total dropped", statistics[i].dropped);
+      addValue(status, "total overflowed", statistics[i].overflow);
+      addValue(status, "arena high water (bytes)", statistics[i].arena_high_water);
+      addValue(status, "arena overflows", statistics[i].arena_overflow - previous.arena_overflow);
+      for (unsigned int j=0; j < allocations.size(); j++) {
+        if (allocations[j].name == statistics[i].name) {
+          addValue(status, "allocations per frame", processed > 0 ? (double) allocations[j].count / processed : 0.0);
+          addValue(status, "allocated bytes per frame", processed > 0 ? (double) allocations[j].bytes / processed : 0.0);
+          reported[j] = true;
+        }
+      }
+      msg.status.push_back(status);
+    }
+    last_statistics_ = statistics;
+  }
+  for (unsigned int i=0; i < allocations.size(); i++) {
+    if (reported[i]) {
+      continue;
+    }
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = name_ + ": allocations " + allocations[i].name;
+    status.hardware_id = name_;
+    snprintf(message, sizeof(message), "%.1f allocations per second", allocations[i].count / elapsed);
+    status.message = message;
+    addValue(status, "allocations per second", allocations[i].count / elapsed);
+    addValue(status, "allocated bytes per second", allocations[i].bytes / elapsed);
+    msg.status.push_back(status);
+  }
+  pub_.publish(msg);
+}
+
+/**
+ * @brief Construct a new TraceService object, and advertises the dump_trace service.
+ * 
+ * @param nh The reference to the node handle of the node.
+ * @param path The reference to the path of the trace file, empty to use the default path.
+ * @param trace The pointer to the buffer of the node.
+ */
+TraceService::TraceService(ros::NodeHandle& nh, const std::string& path, TraceBuffer* trace) {
+  trace_ = trace;
+  path_ = path;
+  if (path_.empty()) {
+    std::string name = nh.getNamespace();
+    std::replace(name.begin(), name.end(), '/', '_');
+    const size_t first = name.find_first_not_of('_');
+    path_ = "/tmp/" + (first == std::string::npos ? std::string("detect_and_track") : name.substr(first)) + "_trace.json";
+  }
+  server_ = nh.advertiseService("dump_trace", &TraceService::dumpCallback, this);
+}
+
+/**
+ * @brief Writes the trace to the file.
+ * 
+ * @param request The reference to the request, empty.
+ * @param response The reference to the response, with the path of the file, and the number of spans written.
+ * @return Always true, a failure is reported in the response.
+ */
+bool TraceService::dumpCallback(std_srvs::Trigger::Request& request, std_srvs::Trigger::Response& response) {
+  size_t count = 0;
+  response.success = trace_->dump(path_, count);
+  if (response.success) {
+    response.message = "Wrote " + std::to_string(count) + " spans to " + path_;
+    ROS_INFO("%s", response.message.c_str());
+  } else {
+    response.message = "Could not write the trace to " + path_;
+    ROS_ERROR("%s", response.message.c_str());
+  }
+  return true;
+}
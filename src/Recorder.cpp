@@ -0,0 +1,765 @@
+/**
+ * @file Recorder.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The source code of the detection recorder.
+ * @details This file implements a compact binary log of the inputs of the localization and the tracking:
+ * the detections, the parts of the depth images under them, the camera info, and the pose of the camera,
+ * and the results of the offline processing.
+ */
+
+#include <detect_and_track/Recorder.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+
+static const char RecordMagic[8] = {'D','T','R','E','C','\0','\0','\0'};
+
+/**
+ * @brief Copies all the fields of a bounding box into its record.
+ *
+ */
+static void packBox(const BoundingBox& bbox, BoxRecord& box) {
+  box.x = bbox.x_;
+  box.y = bbox.y_;
+  box.w = bbox.w_;
+  box.h = bbox.h_;
+  box.x_min = bbox.x_min_;
+  box.x_max = bbox.x_max_;
+  box.y_min = bbox.y_min_;
+  box.y_max = bbox.y_max_;
+  box.area = bbox.area_;
+  box.confidence = bbox.confidence_;
+  box.class_id = bbox.class_id_;
+  box.valid = bbox.valid_;
+}
+
+/**
+ * @brief Rebuilds a bounding box from its record.
+ *
+ */
+static void unpackBox(const BoxRecord& box, BoundingBox& bbox) {
+  bbox.x_ = box.x;
+  bbox.y_ = box.y;
+  bbox.w_ = box.w;
+  bbox.h_ = box.h;
+  bbox.x_min_ = box.x_min;
+  bbox.x_max_ = box.x_max;
+  bbox.y_min_ = box.y_min;
+  bbox.y_max_ = box.y_max;
+  bbox.area_ = box.area;
+  bbox.confidence_ = box.confidence;
+  bbox.class_id_ = box.class_id;
+  bbox.valid_ = box.valid != 0;
+}
+
+/**
+ * @brief Prefered constructor.
+ * @details Prefered constructor. Creates the recording and writes its header, or reopens it to append to it,
+ * and starts the writer thread.
+ *
+ * @param path The reference to the path of the recording.
+ * @param max_buffer_size The reference to the maximum size, in bytes, of the records waiting to be written.
+ * @param append_offset The reference to the end of the last complete record of the recording, see RecordReader::tell.
+ * The recording is truncated there and appended to. If 0, the recording is overwritten.
+ * @param blocking The reference to whether the records are waited for, instead of dropped, when the buffer is full.
+ * @param flush_period The reference to the maximum time, in seconds, the records wait in the front buffer before they
+ * are written, when it does not reach the flush size. 0 writes them only when the flush size is reached.
+ */
+RecordWriter::RecordWriter(const std::string& path, const size_t& max_buffer_size, const size_t& append_offset,
+                           const bool& blocking, const float& flush_period) {
+  path_ = path;
+  max_buffer_size_ = max_buffer_size;
+  flush_size_ = std::min(max_buffer_size_ / 4, (size_t) (1 << 20));
+  flush_period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(std::max(flush_period, 0.0f)));
+  last_write_ = std::chrono::steady_clock::now();
+  dropped_ = 0;
+  blocking_ = blocking;
+  pending_ = false;
+  running_ = true;
+  front_.reserve(flush_size_);
+  back_.reserve(flush_size_);
+  if (append_offset > 0) {
+    std::error_code error;
+    std::filesystem::resize_file(path_, append_offset, error);
+    file_ = error ? nullptr : fopen(path_.c_str(), "ab");
+  } else {
+    file_ = fopen(path_.c_str(), "wb");
+  }
+  if (file_ == nullptr) {
+    printf("[ERROR ] RecordWriter::%s::l%d Could not open %s.\n", __func__, __LINE__, path_.c_str());
+    return;
+  }
+  if (append_offset == 0) {
+    RecordFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RecordMagic, sizeof(header.magic));
+    header.version = RECORD_VERSION;
+    fwrite(&header, sizeof(header), 1, file_);
+  }
+  thread_ = std::thread(&RecordWriter::run, this);
+}
+
+/**
+ * @brief Destructor.
+ * @details Destructor. Writes the records left in the buffers, stops the writer thread, and closes the recording.
+ *
+ */
+RecordWriter::~RecordWriter() {
+  if (file_ == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_.join();
+  fclose(file_);
+  if (dropped_ > 0) {
+    printf("[WARN  ] RecordWriter::%s::l%d %lu records were dropped from %s.\n", __func__, __LINE__, dropped_, path_.c_str());
+  }
+}
+
+/**
+ * @brief Checks if the recording could be created.
+ *
+ * @return True if the records are written.
+ */
+bool RecordWriter::isOpen() const {
+  return file_ != nullptr;
+}
+
+/**
+ * @brief Returns the number of records dropped because the disk could not keep up.
+ *
+ * @return The number of dropped records.
+ */
+uint64_t RecordWriter::getDropped() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_;
+}
+
+/**
+ * @brief Starts a new record in the front buffer. Must be called with the mutex held.
+ * @details In blocking mode, if the record does not fit, the front buffer is handed over to the writer thread
+ * as soon as it is idle, and the caller waits for it to be written. A record larger than the buffer is accepted
+ * when the front buffer is empty.
+ *
+ * @param lock The reference to the lock on the mutex, released while waiting.
+ * @param type The reference to the type of the record.
+ * @param size The reference to the size of its payload, in bytes.
+ * @param stamp The reference to the acquisition time of the data, in nanoseconds.
+ * @param sequence The reference to the sequence number of the data.
+ * @return False if the record does not fit in the front buffer, it is then dropped.
+ */
+bool RecordWriter::reserve(std::unique_lock<std::mutex>& lock, const RecordType& type, const size_t& size,
+                           const int64_t& stamp, const uint64_t& sequence) {
+  const size_t record_size = sizeof(RecordHeader) + size;
+  while ((file_ != nullptr) && blocking_ && !front_.empty() && (front_.size() + record_size > max_buffer_size_)) {
+    if (!pending_) {
+      front_.swap(back_);
+      pending_ = true;
+      cv_.notify_one();
+      continue;
+    }
+    written_cv_.wait(lock);
+  }
+  if ((file_ == nullptr) || (!blocking_ && (front_.size() + record_size > max_buffer_size_))) {
+    dropped_ ++;
+    return false;
+  }
+  RecordHeader header;
+  header.type = type;
+  header.size = size;
+  header.stamp = stamp;
+  header.sequence = sequence;
+  put(&header, sizeof(header));
+  return true;
+}
+
+/**
+ * @brief Appends bytes to the front buffer. Must be called with the mutex held.
+ *
+ * @param data The pointer to the bytes.
+ * @param size The reference to the number of bytes.
+ */
+void RecordWriter::put(const void* data, const size_t& size) {
+  const char* bytes = static_cast<const char*>(data);
+  front_.insert(front_.end(), bytes, bytes + size);
+}
+
+/**
+ * @brief Hands the front buffer over to the writer thread, if it is large enough and the writer is idle.
+ * Must be called with the mutex held.
+ *
+ */
+void RecordWriter::handOver() {
+  if (pending_ || (front_.size() < flush_size_)) {
+    return;
+  }
+  front_.swap(back_);
+  pending_ = true;
+  cv_.notify_one();
+}
+
+/**
+ * @brief Records the parameters of the node.
+ *
+ * @param stamp The reference to the time at which the parameters were read, in nanoseconds.
+ * @param parameters The reference to the parameters, as text.
+ */
+void RecordWriter::writeParameters(const int64_t& stamp, const std::map<std::string, std::string>& parameters) {
+  std::string text;
+  for (auto & element : parameters) {
+    text += element.first + "=" + element.second + "\n";
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!reserve(lock, RECORD_PARAMETERS, text.size(), stamp, 0)) {
+    return;
+  }
+  put(text.data(), text.size());
+  handOver();
+}
+
+/**
+ * @brief Records the camera info.
+ *
+ * @param stamp The reference to the time at which the camera info was received, in nanoseconds.
+ * @param camera_parameters The reference to the intrinsics matrix of the camera, 9 floats, row major.
+ * @param lens_parameters The reference to the distortion coefficients of the lens.
+ */
+void RecordWriter::writeCameraInfo(const int64_t& stamp, const std::vector<float>& camera_parameters,
+                                   const std::vector<float>& lens_parameters) {
+  const uint32_t num_camera = camera_parameters.size();
+  const uint32_t num_lens = lens_parameters.size();
+  const size_t size = 2 * sizeof(uint32_t) + (num_camera + num_lens) * sizeof(float);
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!reserve(lock, RECORD_CAMERA_INFO, size, stamp, 0)) {
+    return;
+  }
+  put(&num_camera, sizeof(num_camera));
+  put(camera_parameters.data(), num_camera * sizeof(float));
+  put(&num_lens, sizeof(num_lens));
+  put(lens_parameters.data(), num_lens * sizeof(float));
+  handOver();
+}
+
+/**
+ * @brief Records the inputs of the localization and the tracking for a frame.
+ * @details The regions of interest are clipped to the depth image, the empty ones are skipped.
+ *
+ * @param frame The reference to the frame, its detections and depth image are recorded.
+ * @param rois The reference to the regions of the depth image to record.
+ * @param pose The pointer to the pose of the camera in the global frame, nullptr if the node does not use one.
+ */
+void RecordWriter::writeFrame(const PipelineFrame& frame, const std::vector<cv::Rect>& rois, const RigidTransform* pose) {
+  const uint32_t frame_id_size = frame.frame_id.size();
+  const uint32_t num_classes = frame.bboxes.size();
+  size_t size = sizeof(uint32_t) + frame_id_size + sizeof(PoseRecord) + sizeof(uint32_t) + sizeof(DepthRecord);
+  for (unsigned int i=0; i < frame.bboxes.size(); i++) {
+    size += sizeof(uint32_t) + frame.bboxes[i].size() * sizeof(BoxRecord);
+  }
+  DepthRecord depth;
+  depth.rows = frame.depth.rows;
+  depth.cols = frame.depth.cols;
+  depth.type = frame.depth.type();
+  std::vector<cv::Rect> clipped;
+  clipped.reserve(rois.size());
+  const cv::Rect image(0, 0, frame.depth.cols, frame.depth.rows);
+  for (unsigned int i=0; i < rois.size(); i++) {
+    const cv::Rect roi = rois[i] & image;
+    if (roi.area() > 0) {
+      clipped.push_back(roi);
+      size += sizeof(RoiRecord) + roi.area() * frame.depth.elemSize();
+    }
+  }
+  depth.num_rois = clipped.size();
+
+  PoseRecord pose_record;
+  std::memset(&pose_record, 0, sizeof(pose_record));
+  if (pose != nullptr) {
+    pose_record.valid = 1;
+    std::memcpy(pose_record.rotation, pose->rotation.data(), sizeof(pose_record.rotation));
+    std::memcpy(pose_record.translation, pose->translation.data(), sizeof(pose_record.translation));
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!reserve(lock, RECORD_FRAME, size, frame.stamps.stamp, frame.stamps.sequence)) {
+    return;
+  }
+  put(&frame_id_size, sizeof(frame_id_size));
+  put(frame.frame_id.data(), frame_id_size);
+  put(&pose_record, sizeof(pose_record));
+  put(&num_classes, sizeof(num_classes));
+  BoxRecord box;
+  for (unsigned int i=0; i < frame.bboxes.size(); i++) {
+    const uint32_t num_boxes = frame.bboxes[i].size();
+    put(&num_boxes, sizeof(num_boxes));
+    for (unsigned int j=0; j < num_boxes; j++) {
+      packBox(frame.bboxes[i][j], box);
+      put(&box, sizeof(box));
+    }
+  }
+  put(&depth, sizeof(depth));
+  const size_t element_size = frame.depth.elemSize();
+  for (unsigned int i=0; i < clipped.size(); i++) {
+    RoiRecord roi{clipped[i].x, clipped[i].y, clipped[i].width, clipped[i].height};
+    put(&roi, sizeof(roi));
+    for (int row = roi.y; row < roi.y + roi.height; row++) {
+      put(frame.depth.ptr(row) + roi.x * element_size, roi.width * element_size);
+    }
+  }
+  handOver();
+}
+
+/**
+ * @brief Returns the size of the tracks of a result record.
+ *
+ */
+static size_t tracksSize(const std::vector<std::map<unsigned int, std::vector<float>>>& tracks) {
+  size_t size = sizeof(uint32_t);
+  for (unsigned int i=0; i < tracks.size(); i++) {
+    size += sizeof(uint32_t);
+    for (auto & element : tracks[i]) {
+      size += 2 * sizeof(uint32_t) + element.second.size() * sizeof(float);
+    }
+  }
+  return size;
+}
+
+/**
+ * @brief Records the results of a frame processed offline.
+ * @details The sequence number of the record is the index of the frame in its folder or video.
+ *
+ * @param frame The reference to the frame, its detections, positions, and tracks are recorded.
+ * @param name The reference to the name of the frame: the name of the image, or the index of the frame in the video.
+ */
+void RecordWriter::writeResult(const PipelineFrame& frame, const std::string& name) {
+  const uint32_t name_size = name.size();
+  const uint32_t num_classes = frame.bboxes.size();
+  const uint32_t num_point_classes = frame.points.size();
+  size_t size = sizeof(uint32_t) + name_size + 2 * sizeof(uint32_t);
+  for (unsigned int i=0; i < frame.bboxes.size(); i++) {
+    size += sizeof(uint32_t) + frame.bboxes[i].size() * sizeof(BoxRecord);
+  }
+  for (unsigned int i=0; i < frame.points.size(); i++) {
+    size += sizeof(uint32_t);
+    for (unsigned int j=0; j < frame.points[i].size(); j++) {
+      size += sizeof(uint32_t) + frame.points[i][j].size() * sizeof(float);
+    }
+  }
+  size += tracksSize(frame.tracker_states) + tracksSize(frame.track_points);
+
+  auto putFloats = [this](const std::vector<float>& values) {
+    const uint32_t num_values = values.size();
+    put(&num_values, sizeof(num_values));
+    put(values.data(), num_values * sizeof(float));
+  };
+  auto putTracks = [this, &putFloats](const std::vector<std::map<unsigned int, std::vector<float>>>& tracks) {
+    const uint32_t num_track_classes = tracks.size();
+    put(&num_track_classes, sizeof(num_track_classes));
+    for (unsigned int i=0; i < tracks.size(); i++) {
+      const uint32_t num_tracks = tracks[i].size();
+      put(&num_tracks, sizeof(num_tracks));
+      for (auto & element : tracks[i]) {
+        const uint32_t id = element.first;
+        put(&id, sizeof(id));
+        putFloats(element.second);
+      }
+    }
+  };
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!reserve(lock, RECORD_RESULT, size, frame.stamps.stamp, frame.stamps.sequence)) {
+    return;
+  }
+  put(&name_size, sizeof(name_size));
+  put(name.data(), name_size);
+  put(&num_classes, sizeof(num_classes));
+  BoxRecord box;
+  for (unsigned int i=0; i < frame.bboxes.size(); i++) {
+    const uint32_t num_boxes = frame.bboxes[i].size();
+    put(&num_boxes, sizeof(num_boxes));
+    for (unsigned int j=0; j < num_boxes; j++) {
+      packBox(frame.bboxes[i][j], box);
+      put(&box, sizeof(box));
+    }
+  }
+  put(&num_point_classes, sizeof(num_point_classes));
+  for (unsigned int i=0; i < frame.points.size(); i++) {
+    const uint32_t num_points = frame.points[i].size();
+    put(&num_points, sizeof(num_points));
+    for (unsigned int j=0; j < num_points; j++) {
+      putFloats(frame.points[i][j]);
+    }
+  }
+  putTracks(frame.tracker_states);
+  putTracks(frame.track_points);
+  handOver();
+}
+
+/**
+ * @brief The loop of the writer thread.
+ * @details Waits for the front buffer to be handed over, and appends it to the recording. If nothing was written
+ * for the flush period, the front buffer is taken over even if it is smaller than the flush size, such that a slow
+ * stream of records reaches the disk within the flush period. When stopped, the records left in the front buffer are written too.
+ *
+ */
+void RecordWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (flush_period_.count() > 0) {
+      cv_.wait_until(lock, last_write_ + flush_period_, [this]{return pending_ || !running_;});
+    } else {
+      cv_.wait(lock, [this]{return pending_ || !running_;});
+    }
+    const bool timed_out = (flush_period_.count() > 0) && (std::chrono::steady_clock::now() >= last_write_ + flush_period_);
+    if (!pending_ && (!running_ || timed_out) && !front_.empty()) {
+      front_.swap(back_);
+      pending_ = true;
+    }
+    if (pending_) {
+      // The back buffer is not touched by the threads of the node while pending_ is set.
+      lock.unlock();
+      if (fwrite(back_.data(), 1, back_.size(), file_) != back_.size()) {
+        printf("[ERROR ] RecordWriter::%s::l%d Could not write %s.\n", __func__, __LINE__, path_.c_str());
+      }
+      fflush(file_);
+      lock.lock();
+      back_.clear();
+      pending_ = false;
+      last_write_ = std::chrono::steady_clock::now();
+      written_cv_.notify_all();
+      continue;
+    }
+    if (!running_) {
+      break;
+    }
+    if (timed_out) {
+      // Nothing to write: the next period starts now.
+      last_write_ = std::chrono::steady_clock::now();
+    }
+  }
+  fflush(file_);
+}
+
+/**
+ * @brief Default constructor.
+ * @details Nothing is loaded, see open.
+ *
+ */
+RecordReader::RecordReader() : offset_(0) {}
+
+/**
+ * @brief Loads a recording in memory.
+ *
+ * @param path The reference to the path of the recording.
+ * @return False if the file could not be read, or is not a recording of this version.
+ */
+bool RecordReader::open(const std::string& path) {
+  std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+  if (!ifs.is_open()) {
+    printf("[ERROR ] RecordReader::%s::l%d Could not open %s.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+  data_.resize(ifs.tellg());
+  ifs.seekg(0);
+  ifs.read(data_.data(), data_.size());
+  RecordFileHeader header;
+  if (!ifs || (data_.size() < sizeof(header))) {
+    printf("[ERROR ] RecordReader::%s::l%d Could not read %s.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+  std::memcpy(&header, data_.data(), sizeof(header));
+  if ((std::memcmp(header.magic, RecordMagic, sizeof(header.magic)) != 0) || (header.version != RECORD_VERSION)) {
+    printf("[ERROR ] RecordReader::%s::l%d %s is not a recording of version %d.\n", __func__, __LINE__, path.c_str(), RECORD_VERSION);
+    return false;
+  }
+  rewind();
+  return true;
+}
+
+/**
+ * @brief Goes back to the first record.
+ *
+ */
+void RecordReader::rewind() {
+  offset_ = sizeof(RecordFileHeader);
+}
+
+/**
+ * @brief Reads the next record.
+ * @details A truncated last record, left by a node that did not stop cleanly, is ignored.
+ *
+ * @param entry The reference to the entry in which the record will be stored.
+ * @return False once all the records were read.
+ */
+bool RecordReader::next(RecordEntry& entry) {
+  if (offset_ + sizeof(RecordHeader) > data_.size()) {
+    return false;
+  }
+  std::memcpy(&entry.header, data_.data() + offset_, sizeof(RecordHeader));
+  if (offset_ + sizeof(RecordHeader) + entry.header.size > data_.size()) {
+    return false;
+  }
+  entry.payload = data_.data() + offset_ + sizeof(RecordHeader);
+  offset_ += sizeof(RecordHeader) + entry.header.size;
+  return true;
+}
+
+/**
+ * @brief Returns the end of the last record read.
+ * @details After reading all the records, this is the size of the complete part of the recording,
+ * from which it can be appended to, see RecordWriter.
+ *
+ * @return The offset of the end of the last record read, in bytes.
+ */
+size_t RecordReader::tell() const {
+  return offset_;
+}
+
+/**
+ * @brief Copies bytes out of the payload of a record, checking its bounds.
+ *
+ */
+static bool get(const RecordEntry& entry, size_t& offset, void* data, const size_t& size) {
+  if (offset + size > entry.header.size) {
+    return false;
+  }
+  std::memcpy(data, entry.payload + offset, size);
+  offset += size;
+  return true;
+}
+
+/**
+ * @brief Reads a parameters record.
+ *
+ * @param entry The reference to the record.
+ * @param parameters The reference to the map in which the parameters will be stored, as text.
+ * @return False if the record is not a parameters record.
+ */
+bool RecordReader::readParameters(const RecordEntry& entry, std::map<std::string, std::string>& parameters) {
+  if (entry.header.type != RECORD_PARAMETERS) {
+    return false;
+  }
+  std::istringstream text(std::string(entry.payload, entry.header.size));
+  std::string line;
+  while (std::getline(text, line)) {
+    const size_t separator = line.find('=');
+    if (separator != std::string::npos) {
+      parameters[line.substr(0, separator)] = line.substr(separator + 1);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Reads a camera info record.
+ *
+ * @param entry The reference to the record.
+ * @param camera_parameters The reference to the vector in which the intrinsics matrix will be stored.
+ * @param lens_parameters The reference to the vector in which the distortion coefficients will be stored.
+ * @return False if the record is not a camera info record, or is corrupted.
+ */
+bool RecordReader::readCameraInfo(const RecordEntry& entry, std::vector<float>& camera_parameters, std::vector<float>& lens_parameters) {
+  if (entry.header.type != RECORD_CAMERA_INFO) {
+    return false;
+  }
+  size_t offset = 0;
+  uint32_t size;
+  if (!get(entry, offset, &size, sizeof(size))) {
+    return false;
+  }
+  camera_parameters.resize(size);
+  if (!get(entry, offset, camera_parameters.data(), size * sizeof(float)) || !get(entry, offset, &size, sizeof(size))) {
+    return false;
+  }
+  lens_parameters.resize(size);
+  return get(entry, offset, lens_parameters.data(), size * sizeof(float));
+}
+
+/**
+ * @brief Reads a frame record.
+ * @details The depth image of the frame is reused if it has the recorded size and type, else it is allocated.
+ *
+ * @param entry The reference to the record.
+ * @param frame The reference to the frame in which the stamps, the detections, and the depth image will be stored.
+ * @param pose The reference to the transform in which the pose of the camera will be stored.
+ * @param has_pose The reference to the flag set if the pose of the camera was recorded.
+ * @return False if the record is not a frame record, or is corrupted.
+ */
+bool RecordReader::readFrame(const RecordEntry& entry, PipelineFrame& frame, RigidTransform& pose, bool& has_pose) {
+  if (entry.header.type != RECORD_FRAME) {
+    return false;
+  }
+  frame.stamps.stamp = entry.header.stamp;
+  frame.stamps.sequence = entry.header.sequence;
+  size_t offset = 0;
+  uint32_t size;
+  if (!get(entry, offset, &size, sizeof(size)) || (offset + size > entry.header.size)) {
+    return false;
+  }
+  frame.frame_id.assign(entry.payload + offset, size);
+  offset += size;
+
+  PoseRecord pose_record;
+  if (!get(entry, offset, &pose_record, sizeof(pose_record))) {
+    return false;
+  }
+  has_pose = pose_record.valid != 0;
+  std::memcpy(pose.rotation.data(), pose_record.rotation, sizeof(pose_record.rotation));
+  std::memcpy(pose.translation.data(), pose_record.translation, sizeof(pose_record.translation));
+
+  uint32_t num_classes;
+  if (!get(entry, offset, &num_classes, sizeof(num_classes))) {
+    return false;
+  }
+  frame.bboxes.resize(num_classes);
+  BoxRecord box;
+  for (unsigned int i=0; i < num_classes; i++) {
+    if (!get(entry, offset, &size, sizeof(size))) {
+      return false;
+    }
+    frame.bboxes[i].resize(size);
+    for (unsigned int j=0; j < size; j++) {
+      if (!get(entry, offset, &box, sizeof(box))) {
+        return false;
+      }
+      unpackBox(box, frame.bboxes[i][j]);
+    }
+  }
+
+  DepthRecord depth;
+  if (!get(entry, offset, &depth, sizeof(depth))) {
+    return false;
+  }
+  if ((depth.rows <= 0) || (depth.cols <= 0)) {
+    frame.depth = cv::Mat();
+    return true;
+  }
+  if ((frame.depth.rows == depth.rows) && (frame.depth.cols == depth.cols) && (frame.depth.type() == depth.type)) {
+    frame.depth.setTo(0);
+  } else {
+    frame.depth = cv::Mat::zeros(depth.rows, depth.cols, depth.type);
+  }
+  const cv::Rect image(0, 0, depth.cols, depth.rows);
+  const size_t element_size = frame.depth.elemSize();
+  RoiRecord roi;
+  for (unsigned int i=0; i < depth.num_rois; i++) {
+    if (!get(entry, offset, &roi, sizeof(roi))) {
+      return false;
+    }
+    const cv::Rect rect(roi.x, roi.y, roi.width, roi.height);
+    if ((rect & image) != rect) {
+      return false;
+    }
+    for (int row = roi.y; row < roi.y + roi.height; row++) {
+      if (!get(entry, offset, frame.depth.ptr(row) + roi.x * element_size, roi.width * element_size)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Reads a vector of floats, prefixed with its size, out of the payload of a record.
+ *
+ */
+static bool getFloats(const RecordEntry& entry, size_t& offset, std::vector<float>& values) {
+  uint32_t size;
+  if (!get(entry, offset, &size, sizeof(size)) || (offset + size * sizeof(float) > entry.header.size)) {
+    return false;
+  }
+  values.resize(size);
+  return get(entry, offset, values.data(), size * sizeof(float));
+}
+
+/**
+ * @brief Reads the tracks of a result record.
+ *
+ */
+static bool getTracks(const RecordEntry& entry, size_t& offset, std::vector<std::map<unsigned int, std::vector<float>>>& tracks) {
+  uint32_t num_classes;
+  if (!get(entry, offset, &num_classes, sizeof(num_classes))) {
+    return false;
+  }
+  tracks.assign(num_classes, std::map<unsigned int, std::vector<float>>());
+  uint32_t num_tracks;
+  uint32_t id;
+  for (unsigned int i=0; i < num_classes; i++) {
+    if (!get(entry, offset, &num_tracks, sizeof(num_tracks))) {
+      return false;
+    }
+    for (unsigned int j=0; j < num_tracks; j++) {
+      if (!get(entry, offset, &id, sizeof(id)) || !getFloats(entry, offset, tracks[i][id])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Reads a result record.
+ *
+ * @param entry The reference to the record.
+ * @param frame The reference to the frame in which the stamps, the detections, the positions, and the tracks will be stored.
+ * @param name The reference to the string in which the name of the frame will be stored.
+ * @return False if the record is not a result record, or is corrupted.
+ */
+bool RecordReader::readResult(const RecordEntry& entry, PipelineFrame& frame, std::string& name) {
+  if (entry.header.type != RECORD_RESULT) {
+    return false;
+  }
+  frame.stamps.stamp = entry.header.stamp;
+  frame.stamps.sequence = entry.header.sequence;
+  size_t offset = 0;
+  uint32_t size;
+  if (!get(entry, offset, &size, sizeof(size)) || (offset + size > entry.header.size)) {
+    return false;
+  }
+  name.assign(entry.payload + offset, size);
+  offset += size;
+
+  uint32_t num_classes;
+  if (!get(entry, offset, &num_classes, sizeof(num_classes))) {
+    return false;
+  }
+  frame.bboxes.resize(num_classes);
+  BoxRecord box;
+  for (unsigned int i=0; i < num_classes; i++) {
+    if (!get(entry, offset, &size, sizeof(size))) {
+      return false;
+    }
+    frame.bboxes[i].resize(size);
+    for (unsigned int j=0; j < size; j++) {
+      if (!get(entry, offset, &box, sizeof(box))) {
+        return false;
+      }
+      unpackBox(box, frame.bboxes[i][j]);
+    }
+  }
+
+  if (!get(entry, offset, &num_classes, sizeof(num_classes))) {
+    return false;
+  }
+  frame.points.resize(num_classes);
+  for (unsigned int i=0; i < num_classes; i++) {
+    if (!get(entry, offset, &size, sizeof(size))) {
+      return false;
+    }
+    frame.points[i].resize(size);
+    for (unsigned int j=0; j < size; j++) {
+      if (!getFloats(entry, offset, frame.points[i][j])) {
+        return false;
+      }
+    }
+  }
+  return getTracks(entry, offset, frame.tracker_states) && getTracks(entry, offset, frame.track_points);
+}
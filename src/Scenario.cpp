@@ -0,0 +1,226 @@
+/**
+ * @file Scenario.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The source code of the scenario generator.
+ * @details This file implements a generator of synthetic multi-object scenarios: ground-truth trajectories,
+ * and the noisy detections a detector would make of them, to exercise the trackers without camera nor network.
+ */
+
+#include <detect_and_track/Scenario.h>
+
+/**
+ * @brief Prefered constructor.
+ * @details Prefered constructor. Draws the initial state of the objects.
+ *
+ * @param p The reference to the parameters of the scenario.
+ */
+ScenarioGenerator::ScenarioGenerator(const ScenarioParameters& p) {
+  p_ = p;
+  dimensions_ = p_.three_dimensional ? 3 : 2;
+  initialize();
+}
+
+/**
+ * @brief Restarts the scenario from its first frame.
+ * @details The same seed is used, such that the same frames are generated again.
+ *
+ */
+void ScenarioGenerator::reset() {
+  initialize();
+}
+
+/**
+ * @brief The size of the states of the frames.
+ *
+ * @return 6 in 2D, 9 in 3D.
+ */
+unsigned int ScenarioGenerator::getStateSize() const {
+  return p_.three_dimensional ? 9 : 6;
+}
+
+/**
+ * @brief Draws the initial state of the objects.
+ * @details The objects are spread uniformly, with a random heading and speed. The objects of a crossing pair
+ * are placed such that they meet at a random point of the central part of the square (or cube), at a random frame:
+ * they are both at the meeting point at that frame. Their speed is limited such that they start inside.
+ *
+ */
+void ScenarioGenerator::initialize() {
+  generator_.seed(p_.seed);
+  frame_ = 0;
+  std::uniform_real_distribution<float> uniform(0.0, 1.0);
+  std::normal_distribution<float> normal(0.0, 1.0);
+  positions_.resize(p_.num_objects * dimensions_);
+  velocities_.resize(p_.num_objects * dimensions_);
+  sizes_.resize(p_.num_objects * 3);
+
+  // Draws a random velocity, in a uniformly distributed direction.
+  auto drawVelocity = [&](const unsigned int& i, const float& max_speed) {
+    float norm = 0;
+    for (unsigned int d = 0; d < dimensions_; d++) {
+      velocities_[i * dimensions_ + d] = normal(generator_);
+      norm += velocities_[i * dimensions_ + d] * velocities_[i * dimensions_ + d];
+    }
+    const float speed = (0.2 + 0.8 * uniform(generator_)) * max_speed / std::max(sqrtf(norm), 1e-6f);
+    for (unsigned int d = 0; d < dimensions_; d++) {
+      velocities_[i * dimensions_ + d] *= speed;
+    }
+  };
+
+  for (unsigned int i = 0; i < p_.num_objects; i++) {
+    for (unsigned int d = 0; d < dimensions_; d++) {
+      positions_[i * dimensions_ + d] = uniform(generator_) * p_.extent;
+      velocities_[i * dimensions_ + d] = 0;
+    }
+    if (!p_.static_objects) {
+      drawVelocity(i, p_.speed);
+    }
+    for (unsigned int k = 0; k < 3; k++) {
+      sizes_[i * 3 + k] = p_.size * (0.8 + 0.4 * uniform(generator_));
+    }
+  }
+
+  if (p_.static_objects || (p_.crossing_frames == 0)) {
+    return;
+  }
+  const unsigned int num_pairs = (unsigned int) (p_.crossing_ratio * p_.num_objects / 2);
+  std::uniform_int_distribution<unsigned int> crossing_frame(1, p_.crossing_frames);
+  std::vector<float> meeting_point(dimensions_);
+  for (unsigned int k = 0; k < num_pairs; k++) {
+    const float time = crossing_frame(generator_) * p_.dt;
+    const float max_speed = std::min(p_.speed, 0.25f * p_.extent / time);
+    for (unsigned int d = 0; d < dimensions_; d++) {
+      meeting_point[d] = (0.25 + 0.5 * uniform(generator_)) * p_.extent;
+    }
+    for (unsigned int i = 2 * k; i < 2 * k + 2; i++) {
+      drawVelocity(i, max_speed);
+      for (unsigned int d = 0; d < dimensions_; d++) {
+        positions_[i * dimensions_ + d] = meeting_point[d] - velocities_[i * dimensions_ + d] * time;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Moves the objects by one frame.
+ * @details The objects bounce on the sides of the square (or cube).
+ *
+ */
+void ScenarioGenerator::move() {
+  for (unsigned int i = 0; i < p_.num_objects * dimensions_; i++) {
+    positions_[i] += velocities_[i] * p_.dt;
+    if (positions_[i] < 0) {
+      positions_[i] = -positions_[i];
+      velocities_[i] = -velocities_[i];
+    } else if (positions_[i] > p_.extent) {
+      positions_[i] = 2 * p_.extent - positions_[i];
+      velocities_[i] = -velocities_[i];
+    }
+  }
+}
+
+/**
+ * @brief Writes the state of an object in the layout of the observations of the trackers.
+ *
+ * @param i The reference to the id of the object.
+ * @param with_velocity The reference to whether the velocity is written, or set to 0.
+ * @param state The reference to the vector in which the state will be stored.
+ */
+void ScenarioGenerator::writeState(const unsigned int& i, const bool& with_velocity, std::vector<float>& state) {
+  state.resize(getStateSize());
+  for (unsigned int d = 0; d < dimensions_; d++) {
+    state[d] = positions_[i * dimensions_ + d];
+    state[dimensions_ + d] = with_velocity ? velocities_[i * dimensions_ + d] : 0;
+  }
+  if (p_.three_dimensional) {
+    state[6] = sizes_[i * 3];
+    state[7] = sizes_[i * 3 + 1];
+    state[8] = sizes_[i * 3 + 2];
+  } else {
+    state[4] = sizes_[i * 3];
+    state[5] = sizes_[i * 3 + 2];
+  }
+}
+
+/**
+ * @brief Generates the detections of the current frame.
+ * @details Each object is detected with the detection probability, with gaussian noise on its position and size.
+ * The number of false detections follows a Poisson distribution. The detections are then shuffled.
+ *
+ * @param frame The reference to the frame in which the detections will be stored.
+ */
+void ScenarioGenerator::detect(ScenarioFrame& frame) {
+  std::uniform_real_distribution<float> uniform(0.0, 1.0);
+  std::normal_distribution<float> position_noise(0.0, std::max(p_.position_noise, 1e-6f));
+  std::normal_distribution<float> size_noise(0.0, std::max(p_.size_noise, 1e-6f));
+  const unsigned int size_offset = 2 * dimensions_;
+  const unsigned int num_sizes = getStateSize() - size_offset;
+
+  unsigned int count = 0;
+  auto addDetection = [&](const int& id) {
+    if (count == frame.detections.size()) {
+      frame.detections.emplace_back();
+      frame.detection_ids.emplace_back();
+    }
+    frame.detection_ids[count] = id;
+    return &frame.detections[count++];
+  };
+
+  for (unsigned int i = 0; i < p_.num_objects; i++) {
+    if (uniform(generator_) >= p_.detection_probability) {
+      continue;
+    }
+    std::vector<float>* state = addDetection(i);
+    writeState(i, false, *state);
+    for (unsigned int d = 0; d < dimensions_; d++) {
+      (*state)[d] += position_noise(generator_);
+    }
+    for (unsigned int k = size_offset; k < size_offset + num_sizes; k++) {
+      (*state)[k] = std::max((*state)[k] + size_noise(generator_), 0.1f * p_.size);
+    }
+  }
+
+  const float clutter_mean = p_.clutter_rate * p_.num_objects;
+  const unsigned int num_clutter = clutter_mean > 0 ? std::poisson_distribution<unsigned int>(clutter_mean)(generator_) : 0;
+  for (unsigned int i = 0; i < num_clutter; i++) {
+    std::vector<float>* state = addDetection(-1);
+    state->assign(getStateSize(), 0);
+    for (unsigned int d = 0; d < dimensions_; d++) {
+      (*state)[d] = uniform(generator_) * p_.extent;
+    }
+    for (unsigned int k = size_offset; k < size_offset + num_sizes; k++) {
+      (*state)[k] = p_.size * (0.8 + 0.4 * uniform(generator_));
+    }
+  }
+  frame.detections.resize(count);
+  frame.detection_ids.resize(count);
+
+  // Fisher-Yates shuffle of the detections and their ids.
+  for (unsigned int i = count; i > 1; i--) {
+    const unsigned int j = std::uniform_int_distribution<unsigned int>(0, i - 1)(generator_);
+    std::swap(frame.detections[i - 1], frame.detections[j]);
+    std::swap(frame.detection_ids[i - 1], frame.detection_ids[j]);
+  }
+}
+
+/**
+ * @brief Generates the next frame of the scenario.
+ *
+ * @param frame The reference to the frame in which the ground truth and the detections will be stored.
+ */
+void ScenarioGenerator::next(ScenarioFrame& frame) {
+  if (frame_ > 0) {
+    move();
+  }
+  frame.index = frame_;
+  frame.truth.resize(p_.num_objects);
+  for (unsigned int i = 0; i < p_.num_objects; i++) {
+    writeState(i, true, frame.truth[i]);
+  }
+  detect(frame);
+  frame_ ++;
+}
@@ -0,0 +1,439 @@
+/**
+ * @file SharedMemory.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The source code of the shared-memory ring buffers.
+ * @details This file implements a single-producer multi-consumer ring buffer living in POSIX shared memory (/dev/shm).
+ */
+
+#include <detect_and_track/SharedMemory.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const uint64_t SharedMemoryMagic = 0x474e495248535444ULL; // "DTSHRING" in little endian.
+
+/**
+ * @brief Rounds a size up to a multiple of a cache line.
+ *
+ * @param size The reference to the size, in bytes.
+ * @return The rounded size, in bytes.
+ */
+static uint64_t alignToCacheLine(const uint64_t& size) {
+  return (size + 63) & ~((uint64_t) 63);
+}
+
+/**
+ * @brief Default constructor.
+ *
+ */
+SharedMemoryWriter::SharedMemoryWriter() {
+  map_ = nullptr;
+  map_size_ = 0;
+  header_ = nullptr;
+  slot_ = nullptr;
+  next_ = 0;
+  pending_size_ = 0;
+}
+
+/**
+ * @brief Destructor. Unmaps and removes the segment.
+ *
+ */
+SharedMemoryWriter::~SharedMemoryWriter() {
+  close();
+}
+
+/**
+ * @brief Creates the shared-memory segment.
+ * @details Creates, or replaces, the segment /dev/shm/<name>. A segment left behind by a previous
+ * writer is replaced: the readers still mapping it must reopen the new one.
+ *
+ * @param name The reference to the name of the segment, it must start with a "/".
+ * @param slot_count The reference to the number of records kept in the ring.
+ * @param slot_size The reference to the maximum size of a record, in bytes.
+ * @return True if the segment was created.
+ */
+bool SharedMemoryWriter::create(const std::string& name, const uint32_t& slot_count, const uint64_t& slot_size) {
+  close();
+  if (slot_count == 0) {
+    printf("[ERROR ] SharedMemoryWriter::%s::l%d The ring must have at least one slot.\n", __func__, __LINE__);
+    return false;
+  }
+  const uint64_t header_size = alignToCacheLine(sizeof(SharedMemoryHeader));
+  const uint64_t slot_stride = alignToCacheLine(sizeof(SharedMemorySlot) + slot_size);
+  const size_t map_size = header_size + slot_count * slot_stride;
+
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0) {
+    printf("[ERROR ] SharedMemoryWriter::%s::l%d Could not create %s.\n", __func__, __LINE__, name.c_str());
+    return false;
+  }
+  if (ftruncate(fd, map_size) != 0) {
+    printf("[ERROR ] SharedMemoryWriter::%s::l%d Could not allocate %lu bytes for %s.\n", __func__, __LINE__, map_size, name.c_str());
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+  void* map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    printf("[ERROR ] SharedMemoryWriter::%s::l%d Could not map %s.\n", __func__, __LINE__, name.c_str());
+    shm_unlink(name.c_str());
+    return false;
+  }
+  name_ = name;
+  map_ = static_cast<char*>(map);
+  map_size_ = map_size;
+  // The segment is zeroed by ftruncate: all the slots are empty.
+  header_ = reinterpret_cast<SharedMemoryHeader*>(map_);
+  header_->version = SHARED_MEMORY_VERSION;
+  header_->slot_count = slot_count;
+  header_->slot_size = slot_size;
+  header_->slot_stride = slot_stride;
+  header_->sequence.store(0, std::memory_order_relaxed);
+  // The magic is written last, the readers ignore the segment until then.
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = SharedMemoryMagic;
+  next_ = 0;
+  slot_ = nullptr;
+  return true;
+}
+
+/**
+ * @brief Unmaps and removes the segment.
+ *
+ */
+void SharedMemoryWriter::close() {
+  if (map_ == nullptr) {
+    return;
+  }
+  munmap(map_, map_size_);
+  shm_unlink(name_.c_str());
+  map_ = nullptr;
+  header_ = nullptr;
+  slot_ = nullptr;
+}
+
+/**
+ * @brief Checks if the segment was created.
+ *
+ * @return True if the segment can be written.
+ */
+bool SharedMemoryWriter::isOpen() const {
+  return map_ != nullptr;
+}
+
+/**
+ * @brief Returns the maximum size of a record.
+ *
+ * @return The maximum size of a record, in bytes.
+ */
+uint64_t SharedMemoryWriter::getSlotSize() const {
+  return header_ == nullptr ? 0 : header_->slot_size;
+}
+
+/**
+ * @brief Returns the slot holding a given record.
+ *
+ * @param sequence The reference to the sequence number of the record.
+ * @return The pointer to the slot.
+ */
+SharedMemorySlot* SharedMemoryWriter::getSlot(const uint64_t& sequence) {
+  const uint64_t offset = alignToCacheLine(sizeof(SharedMemoryHeader)) + (sequence % header_->slot_count) * header_->slot_stride;
+  return reinterpret_cast<SharedMemorySlot*>(map_ + offset);
+}
+
+/**
+ * @brief Starts writing the next record.
+ * @details Marks the next slot as being written, and returns its payload. The readers reading this slot
+ * will see their record invalidated.
+ *
+ * @param size The reference to the size of the record, in bytes.
+ * @return The pointer to the payload, nullptr if the record does not fit in a slot.
+ */
+char* SharedMemoryWriter::beginWrite(const uint32_t& size) {
+  if ((map_ == nullptr) || (size > header_->slot_size)) {
+    return nullptr;
+  }
+  slot_ = getSlot(next_);
+  slot_->lock.store(2 * next_ + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  pending_size_ = size;
+  return reinterpret_cast<char*>(slot_) + sizeof(SharedMemorySlot);
+}
+
+/**
+ * @brief Publishes the record started by beginWrite.
+ *
+ * @param type The reference to the type of the record.
+ * @param stamp The reference to the acquisition time of the data, in nanoseconds.
+ * @return The sequence number of the record.
+ */
+uint64_t SharedMemoryWriter::commitWrite(const uint32_t& type, const int64_t& stamp) {
+  if (slot_ == nullptr) {
+    printf("[ERROR ] SharedMemoryWriter::%s::l%d commitWrite called without beginWrite.\n", __func__, __LINE__);
+    return next_;
+  }
+  slot_->type = type;
+  slot_->size = pending_size_;
+  slot_->stamp = stamp;
+  slot_->lock.store(2 * next_ + 2, std::memory_order_release);
+  header_->sequence.store(next_ + 1, std::memory_order_release);
+  slot_ = nullptr;
+  return next_++;
+}
+
+/**
+ * @brief Default constructor.
+ *
+ */
+SharedMemoryReader::SharedMemoryReader() {
+  map_ = nullptr;
+  map_size_ = 0;
+  header_ = nullptr;
+}
+
+/**
+ * @brief Destructor. Unmaps the segment.
+ *
+ */
+SharedMemoryReader::~SharedMemoryReader() {
+  close();
+}
+
+/**
+ * @brief Maps an existing segment.
+ *
+ * @param name The reference to the name of the segment, it must start with a "/".
+ * @return False if the segment does not exist, or is not a ring buffer of the same version.
+ */
+bool SharedMemoryReader::open(const std::string& name) {
+  close();
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if ((fstat(fd, &file_stat) != 0) || (file_stat.st_size < (off_t) alignToCacheLine(sizeof(SharedMemoryHeader)))) {
+    ::close(fd);
+    return false;
+  }
+  void* map = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    printf("[ERROR ] SharedMemoryReader::%s::l%d Could not map %s.\n", __func__, __LINE__, name.c_str());
+    return false;
+  }
+  const SharedMemoryHeader* header = static_cast<const SharedMemoryHeader*>(map);
+  const bool ready = header->magic == SharedMemoryMagic;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (!ready || (header->version != SHARED_MEMORY_VERSION) ||
+      ((uint64_t) file_stat.st_size < alignToCacheLine(sizeof(SharedMemoryHeader)) + header->slot_count * header->slot_stride)) {
+    if (ready) {
+      printf("[ERROR ] SharedMemoryReader::%s::l%d %s is not a ring buffer of version %d.\n", __func__, __LINE__, name.c_str(), SHARED_MEMORY_VERSION);
+    }
+    munmap(map, file_stat.st_size);
+    return false;
+  }
+  map_ = static_cast<const char*>(map);
+  map_size_ = file_stat.st_size;
+  header_ = header;
+  return true;
+}
+
+/**
+ * @brief Unmaps the segment.
+ *
+ */
+void SharedMemoryReader::close() {
+  if (map_ == nullptr) {
+    return;
+  }
+  munmap(const_cast<char*>(map_), map_size_);
+  map_ = nullptr;
+  header_ = nullptr;
+}
+
+/**
+ * @brief Checks if a segment is mapped.
+ *
+ * @return True if the segment can be read.
+ */
+bool SharedMemoryReader::isOpen() const {
+  return map_ != nullptr;
+}
+
+/**
+ * @brief Returns the number of records kept in the ring.
+ *
+ * @return The number of slots.
+ */
+uint32_t SharedMemoryReader::getSlotCount() const {
+  return header_ == nullptr ? 0 : header_->slot_count;
+}
+
+/**
+ * @brief Returns the number of records written so far.
+ * @details The most recent record has the sequence number getSequence() - 1.
+ *
+ * @return The number of records written so far.
+ */
+uint64_t SharedMemoryReader::getSequence() const {
+  return header_ == nullptr ? 0 : header_->sequence.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Returns the slot holding a given record.
+ *
+ * @param sequence The reference to the sequence number of the record.
+ * @return The pointer to the slot.
+ */
+const SharedMemorySlot* SharedMemoryReader::getSlot(const uint64_t& sequence) const {
+  const uint64_t offset = alignToCacheLine(sizeof(SharedMemoryHeader)) + (sequence % header_->slot_count) * header_->slot_stride;
+  return reinterpret_cast<const SharedMemorySlot*>(map_ + offset);
+}
+
+/**
+ * @brief Gives access to a record, without copying it.
+ * @details The view points into the shared memory. Once done with the data, the reader must call isValid:
+ * if it returns false, the record was overwritten while it was being read, and the data must be discarded.
+ *
+ * @param sequence The reference to the sequence number of the record.
+ * @param view The reference to the view.
+ * @return False if the record is not written yet, or was already overwritten.
+ */
+bool SharedMemoryReader::read(const uint64_t& sequence, SharedMemoryView& view) const {
+  if (header_ == nullptr) {
+    return false;
+  }
+  const SharedMemorySlot* slot = getSlot(sequence);
+  if (slot->lock.load(std::memory_order_acquire) != 2 * sequence + 2) {
+    return false;
+  }
+  view.sequence = sequence;
+  view.type = slot->type;
+  view.size = slot->size;
+  view.stamp = slot->stamp;
+  view.data = reinterpret_cast<const char*>(slot) + sizeof(SharedMemorySlot);
+  if (view.size > header_->slot_size) {
+    return false;
+  }
+  return isValid(view);
+}
+
+/**
+ * @brief Checks that a record was not overwritten since it was read.
+ *
+ * @param view The reference to the view.
+ * @return True if the data of the view can be trusted.
+ */
+bool SharedMemoryReader::isValid(const SharedMemoryView& view) const {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return getSlot(view.sequence)->lock.load(std::memory_order_relaxed) == 2 * view.sequence + 2;
+}
+
+/**
+ * @brief Copies a record.
+ * @details Copies the record, and checks that it was not overwritten during the copy.
+ * The view points to the copy.
+ *
+ * @param sequence The reference to the sequence number of the record.
+ * @param buffer The reference to the buffer in which the record is copied.
+ * @param view The reference to the view.
+ * @return False if the record is not written yet, or was overwritten.
+ */
+bool SharedMemoryReader::copy(const uint64_t& sequence, std::vector<char>& buffer, SharedMemoryView& view) const {
+  if (!read(sequence, view)) {
+    return false;
+  }
+  buffer.resize(view.size);
+  memcpy(buffer.data(), view.data, view.size);
+  if (!isValid(view)) {
+    return false;
+  }
+  view.data = buffer.data();
+  return true;
+}
+
+/**
+ * @brief Decodes an image record.
+ *
+ * @param view The reference to the view on the record.
+ * @param image The reference to the header of the image.
+ * @param pixels The reference to the pointer to the pixels, rows*step bytes.
+ * @return False if the record is not a valid image.
+ */
+bool SharedMemoryReader::parseImage(const SharedMemoryView& view, SharedImageHeader& image, const char*& pixels) {
+  if ((view.type != SHARED_MEMORY_IMAGE) || (view.size < sizeof(SharedImageHeader))) {
+    return false;
+  }
+  memcpy(&image, view.data, sizeof(SharedImageHeader));
+  if ((image.rows < 0) || (image.step < 0) || (view.size < sizeof(SharedImageHeader) + (uint64_t) image.rows * image.step)) {
+    return false;
+  }
+  pixels = view.data + sizeof(SharedImageHeader);
+  return true;
+}
+
+/**
+ * @brief Decodes a detections record.
+ *
+ * @param view The reference to the view on the record.
+ * @param count The reference to the number of detections.
+ * @param detections The reference to the pointer to the detections.
+ * @return False if the record is not a valid detections record.
+ */
+bool SharedMemoryReader::parseDetections(const SharedMemoryView& view, uint64_t& count, const SharedDetection*& detections) {
+  if ((view.type != SHARED_MEMORY_DETECTIONS) || (view.size < sizeof(uint64_t))) {
+    return false;
+  }
+  memcpy(&count, view.data, sizeof(uint64_t));
+  if (view.size < sizeof(uint64_t) + count * sizeof(SharedDetection)) {
+    return false;
+  }
+  detections = reinterpret_cast<const SharedDetection*>(view.data + sizeof(uint64_t));
+  return true;
+}
+
+/**
+ * @brief Decodes a tracks record.
+ *
+ * @param view The reference to the view on the record.
+ * @param tracks The reference to the vector in which the tracks are stored. Their states point into the record.
+ * @return False if the record is not a valid tracks record.
+ */
+bool SharedMemoryReader::parseTracks(const SharedMemoryView& view, std::vector<SharedTrack>& tracks) {
+  tracks.clear();
+  if ((view.type != SHARED_MEMORY_TRACKS) || (view.size < sizeof(uint64_t))) {
+    return false;
+  }
+  uint64_t count;
+  memcpy(&count, view.data, sizeof(uint64_t));
+  const char* data = view.data + sizeof(uint64_t);
+  const char* end = view.data + view.size;
+  SharedTrackHeader header;
+  SharedTrack track;
+  for (uint64_t i = 0; i < count; i++) {
+    if ((uint64_t) (end - data) < sizeof(SharedTrackHeader)) {
+      return false;
+    }
+    memcpy(&header, data, sizeof(SharedTrackHeader));
+    data += sizeof(SharedTrackHeader);
+    if ((uint64_t) (end - data) < header.state_size * sizeof(float)) {
+      return false;
+    }
+    track.class_id = header.class_id;
+    track.track_id = header.track_id;
+    track.state_size = header.state_size;
+    track.state = reinterpret_cast<const float*>(data);
+    data += header.state_size * sizeof(float);
+    tracks.push_back(track);
+  }
+  return true;
+}
@@ -133,6 +133,48 @@ int Object::getSkippedFrames() {
   return nb_skipped_frames_;
 }
 
+/**
+ * @brief Get the size of the state.
+ * @details Accessor function, returns the number of variables in the state of the Kalman filter.
+ * 
+ * @return The size of the state.
+ */
+unsigned int Object::getStateSize() const {
+  return KF_->getStateSize();
+}
+
+/**
+ * @brief Copies the raw state of the object.
+ * @details Copies the counters of the object, and the raw state and covariance of its Kalman filter.
+ * 
+ * @param record The reference to the record in which the counters will be stored.
+ * @param X A pointer to an array of getStateSize() floats.
+ * @param P A pointer to an array of getStateSize()^2 floats.
+ */
+void Object::exportState(ObjectRecord& record, float* X, float* P) const {
+  record.id = id_;
+  record.nb_frames = nb_frames_;
+  record.nb_skipped_frames = nb_skipped_frames_;
+  record.nb_consecutive_frames = nb_consecutive_frames_;
+  KF_->exportState(X, P);
+}
+
+/**
+ * @brief Restores the raw state of the object.
+ * @details Restores the counters of the object, and the raw state and covariance of its Kalman filter.
+ * 
+ * @param record The reference to the record containing the counters.
+ * @param X A pointer to an array of getStateSize() floats.
+ * @param P A pointer to an array of getStateSize()^2 floats.
+ */
+void Object::importState(const ObjectRecord& record, const float* X, const float* P) {
+  id_ = record.id;
+  nb_frames_ = record.nb_frames;
+  nb_skipped_frames_ = record.nb_skipped_frames;
+  nb_consecutive_frames_ = record.nb_consecutive_frames;
+  KF_->importState(X, P);
+}
+
 /**
  * @brief Default constructor.
  * @details Default constructor.
@@ -161,6 +203,7 @@ Object2D::Object2D(const unsigned int& id, const float& dt, const bool& use_dim,
   id_ = id;
   nb_frames_ = 0;
   nb_skipped_frames_ = 0;
+  nb_consecutive_frames_ = 0;
 }
 
 /**
@@ -188,6 +231,24 @@ Object3D::Object3D(const unsigned int& id, const float& dt, const bool& use_dim,
   id_ = id;
   nb_frames_ = 0;
   nb_skipped_frames_ = 0;
+  nb_consecutive_frames_ = 0;
+}
+
+/**
+ * @brief Sets the state of the objects.
+ * @details An accessor function to set the state of the Kalman filter.
+ * The state can either be given in the measurement layout (R9): x, y, z, vx, vy, vz, w, d, h.
+ * Or in the layout of the filter (R8), which matches the first 8 variables of the measurement.
+ * 
+ * @param state The reference to the state.
+ */
+void Object3D::setState(const std::vector<float>& state){
+  if (state.size() == 9) {
+    std::vector<float> filter_state(state.begin(), state.begin() + 8);
+    KF_->resetFilter(filter_state);
+  } else {
+    KF_->resetFilter(state);
+  }
 }
 
 /**
@@ -213,6 +274,47 @@ Object3DF::Object3DF(const unsigned int& id, const float& dt, const bool& use_di
   id_ = id;
   nb_frames_ = 0;
   nb_skipped_frames_ = 0;
+  nb_consecutive_frames_ = 0;
+}
+
+/**
+ * @brief Sets the state of the objects.
+ * @details An accessor function to set the state of the Kalman filter.
+ * The state can either be given in the measurement layout (R9): x, y, z, vx, vy, vz, w, d, h.
+ * Or in the layout of the filter (R5): x, y, z, w, h.
+ * 
+ * @param state The reference to the state.
+ */
+void Object3DF::setState(const std::vector<float>& state){
+  if (state.size() == 9) {
+    std::vector<float> fixed_state{state[0], state[1], state[2], state[6], state[8]};
+    KF_->resetFilter(fixed_state);
+  } else {
+    KF_->resetFilter(state);
+  }
+}
+
+/**
+ * @brief Gets the state of the object.
+ * @details Accessor function to fetch the state of the Kalman filter inside the object.
+ * The state is returned in the measurement layout (R9): x, y, z, vx, vy, vz, w, d, h.
+ * The object being fixed, the velocities are always 0, and the depth is assumed to be equal to the width.
+ * 
+ * @param state The reference to the vector in which the state will be stored.
+ */
+void Object3DF::getState(std::vector<float>& state) {
+  std::vector<float> fixed_state;
+  KF_->getState(fixed_state);
+  state.resize(9);
+  state[0] = fixed_state[0];
+  state[1] = fixed_state[1];
+  state[2] = fixed_state[2];
+  state[3] = 0;
+  state[4] = 0;
+  state[5] = 0;
+  state[6] = fixed_state[3];
+  state[7] = fixed_state[3];
+  state[8] = fixed_state[4];
 }
 
 /**
@@ -220,7 +322,7 @@ Object3DF::Object3DF(const unsigned int& id, const float& dt, const bool& use_di
  * @details Default constructor.
  * 
  */
-BaseTracker::BaseTracker() : HA_(nullptr) {}
+BaseTracker::BaseTracker() : HA_(nullptr), update_count_(0), epoch_(0), snapshot_(std::make_shared<const TrackSnapshot>()) {}
 
 /**
  * @brief Prefered constructor
@@ -241,7 +343,8 @@ BaseTracker::BaseTracker(const int& max_frames_to_skip, const float& dist_tresho
                          const float& center_threshold, const float& area_threshold,
                          const float& body_ratio, const float& dt, const bool& use_dim,
                          const bool& use_vel, const std::vector<float>& Q,
-                         const std::vector<float>& R) : HA_(nullptr) {
+                         const std::vector<float>& R) : HA_(nullptr), update_count_(0), epoch_(0),
+                         snapshot_(std::make_shared<const TrackSnapshot>()) {
 
   max_frames_to_skip_ = max_frames_to_skip;
   distance_threshold_ = dist_treshold;
@@ -283,7 +386,7 @@ Tracker2D::Tracker2D(const int& max_frames_to_skip, const float& dist_treshold,
                      dist_treshold, center_threshold, area_threshold, body_ratio,
                      dt, use_dim, use_vel, Q, R) {}
 
-Tracker3D::Tracker3D() {}
+Tracker3D::Tracker3D() : frustum_(nullptr) {}
 
 /**
  * @brief Prefered constructor
@@ -306,7 +409,56 @@ Tracker3D::Tracker3D(const int& max_frames_to_skip, const float& dist_treshold,
                      const bool& use_vel, const std::vector<float>& Q,
                      const std::vector<float>& R) : BaseTracker::BaseTracker(max_frames_to_skip,
                      dist_treshold, center_threshold, area_threshold, body_ratio,
-                     dt, use_dim, use_vel, Q, R) {}
+                     dt, use_dim, use_vel, Q, R), frustum_(nullptr) {}
+
+Tracker3DF::Tracker3DF() {}
+
+/**
+ * @brief Prefered constructor
+ * @details Pefered constructor. The size of the voxels is set to the distance threshold.
+ * 
+ * @param max_frames_to_skip The maximum number of frames, in which the landmark should have been seen, that can be skipped before it is deleted.
+ * @param dist_treshold The maximum distance between an object's position and an observation before the distance is considered infinite.
+ * @param center_threshold The maximum distance between an object's position and an observation to be considered a match.
+ * @param area_threshold The maximum area difference between an objetc's area and an observation to be considered a match.
+ * @param body_ratio Unused for now.
+ * @param dt The time, in seconds, in between to filter updates.
+ * @param use_dim Whether or not the Kalman filter should use the height and width of the object in its observations.
+ * @param use_vel Unused, the objects are fixed.
+ * @param Q Unused, the process noise of fixed objects is constant.
+ * @param R The reference to the measurement noise vector (R9).
+ */
+Tracker3DF::Tracker3DF(const int& max_frames_to_skip, const float& dist_treshold,
+                       const float& center_threshold, const float& area_threshold,
+                       const float& body_ratio, const float& dt, const bool& use_dim,
+                       const bool& use_vel, const std::vector<float>& Q,
+                       const std::vector<float>& R) : BaseTracker::BaseTracker(max_frames_to_skip,
+                       dist_treshold, center_threshold, area_threshold, body_ratio,
+                       dt, use_dim, use_vel, Q, R), grid_(dist_treshold) {}
+
+/**
+ * @brief Prefered constructor
+ * @details Pefered constructor
+ * 
+ * @param max_frames_to_skip The maximum number of frames, in which the landmark should have been seen, that can be skipped before it is deleted.
+ * @param dist_treshold The maximum distance between an object's position and an observation before the distance is considered infinite.
+ * @param center_threshold The maximum distance between an object's position and an observation to be considered a match.
+ * @param area_threshold The maximum area difference between an objetc's area and an observation to be considered a match.
+ * @param body_ratio Unused for now.
+ * @param dt The time, in seconds, in between to filter updates.
+ * @param use_dim Whether or not the Kalman filter should use the height and width of the object in its observations.
+ * @param use_vel Unused, the objects are fixed.
+ * @param Q Unused, the process noise of fixed objects is constant.
+ * @param R The reference to the measurement noise vector (R9).
+ * @param voxel_size The size of the voxels used to index the landmarks.
+ */
+Tracker3DF::Tracker3DF(const int& max_frames_to_skip, const float& dist_treshold,
+                       const float& center_threshold, const float& area_threshold,
+                       const float& body_ratio, const float& dt, const bool& use_dim,
+                       const bool& use_vel, const std::vector<float>& Q,
+                       const std::vector<float>& R, const float& voxel_size) : BaseTracker::BaseTracker(max_frames_to_skip,
+                       dist_treshold, center_threshold, area_threshold, body_ratio,
+                       dt, use_dim, use_vel, Q, R), grid_(voxel_size) {}
 
 /**
  * @brief Collect the states of all the tracked objects.
@@ -322,6 +474,260 @@ void BaseTracker::getStates(std::map<unsigned int, std::vector<float>>& tracks){
   }
 }
 
+/**
+ * @brief Collect the uncertainties of all the tracked objects.
+ * @details Accessor function, provides the variances of the Kalman filters of all tracked objects.
+ * 
+ * @param uncertainties The reference to the map in which the variances of the tracked objects will be stored.
+ */
+void BaseTracker::getUncertainties(std::map<unsigned int, std::vector<float>>& uncertainties){
+  std::vector<float> uncertainty;
+  for (auto & element : Objects_) {
+    element.second->getUncertainty(uncertainty);
+    uncertainties[element.first] = uncertainty;
+  }
+}
+
+/**
+ * @brief Starts a new update.
+ * @details Increments the update counter, and resets the ids of the tracks created, corrected, and removed
+ * during the previous update.
+ * 
+ */
+void BaseTracker::startUpdate() {
+  update_count_ ++;
+  created_ids_.clear();
+  updated_ids_.clear();
+  removed_ids_.clear();
+}
+
+/**
+ * @brief Collects the changes made by the last update.
+ * @details Collects the tracks that were created, corrected, or removed during the last update.
+ * The tracks that were only predicted, or frozen, are not included: their last published state remains valid
+ * until the next keyframe. Only the tracks recorded by the update are visited, not all the tracks.
+ * This does not modify the tracker, and can be called multiple times.
+ * 
+ * @param delta The reference to the delta in which the changes will be stored.
+ */
+void BaseTracker::getDelta(TrackDelta& delta) const {
+  delta.update = update_count_;
+  delta.created.clear();
+  delta.updated.clear();
+  delta.removed = removed_ids_;
+  std::vector<float> state;
+  for (unsigned int i=0; i < created_ids_.size(); i++) {
+    auto it = Objects_.find(created_ids_[i]);
+    if (it != Objects_.end()) {
+      it->second->getState(state);
+      delta.created[it->first] = state;
+    }
+  }
+  for (unsigned int i=0; i < updated_ids_.size(); i++) {
+    auto it = Objects_.find(updated_ids_[i]);
+    if (it != Objects_.end()) {
+      it->second->getState(state);
+      delta.updated[it->first] = state;
+    }
+  }
+}
+
+/**
+ * @brief Seeks the entry of a track in a map that is overwritten in increasing id order.
+ * @details The tracks skipped on the way are removed, and the entry is inserted if it does not exist.
+ * 
+ * @param tracks The reference to the map being overwritten.
+ * @param position The position reached in the map.
+ * @param id The reference to the id of the track.
+ * @return The position of the entry of the track.
+ */
+static std::map<unsigned int, std::vector<float>>::iterator seekTrack(std::map<unsigned int, std::vector<float>>& tracks,
+                                                                   std::map<unsigned int, std::vector<float>>::iterator position,
+                                                                   const unsigned int& id) {
+  while ((position != tracks.end()) && (position->first < id)) {
+    position = tracks.erase(position);
+  }
+  if ((position == tracks.end()) || (position->first != id)) {
+    position = tracks.emplace_hint(position, id, std::vector<float>());
+  }
+  return position;
+}
+
+/**
+ * @brief Publishes the current tracks.
+ * @details Builds an immutable, epoch-tagged, snapshot of the tracks and atomically swaps it with the previous one.
+ * Must be called from the thread that updates the tracker. Readers holding the previous snapshot keep it alive
+ * until they release it: the memory is reclaimed by the last owner, never by the tracker.
+ * The states are the ones the caller already collected with getStates, they are not read from the tracks again.
+ * Once the readers released the snapshot replaced by the previous publication, it is reused: the entries of the
+ * tracks that still exist are overwritten in place, instead of being allocated again.
+ * 
+ * @param states The reference to the states of the tracks, as collected by getStates.
+ */
+void BaseTracker::publishSnapshot(const std::map<unsigned int, std::vector<float>>& states) {
+  std::shared_ptr<TrackSnapshot> snapshot;
+  // A retired snapshot can no longer be acquired by the readers: if the tracker is its only owner, it is free.
+  if (retired_snapshot_ && (retired_snapshot_.use_count() == 1)) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    snapshot = std::const_pointer_cast<TrackSnapshot>(std::move(retired_snapshot_));
+  } else {
+    snapshot = std::make_shared<TrackSnapshot>();
+  }
+  snapshot->epoch = ++epoch_;
+  std::map<unsigned int, std::vector<float>>::iterator position = snapshot->states.begin();
+  for (auto & element : states) {
+    position = seekTrack(snapshot->states, position, element.first);
+    position->second = element.second;
+    position ++;
+  }
+  snapshot->states.erase(position, snapshot->states.end());
+  position = snapshot->uncertainties.begin();
+  for (auto & element : Objects_) {
+    position = seekTrack(snapshot->uncertainties, position, element.first);
+    element.second->getUncertainty(position->second);
+    position ++;
+  }
+  snapshot->uncertainties.erase(position, snapshot->uncertainties.end());
+  retired_snapshot_ = std::atomic_exchange_explicit(&snapshot_, std::shared_ptr<const TrackSnapshot>(std::move(snapshot)),
+                                                    std::memory_order_acq_rel);
+}
+
+/**
+ * @brief Gets the last published tracks.
+ * @details Accessor function, can be called from any thread. It does not copy the tracks, and
+ * never waits on the tracker update.
+ * 
+ * @return A shared pointer to the last published snapshot.
+ */
+std::shared_ptr<const TrackSnapshot> BaseTracker::getSnapshot() const {
+  return std::atomic_load_explicit(&snapshot_, std::memory_order_acquire);
+}
+
+/**
+ * @brief Hashes the parameters of the tracker.
+ * @details Computes a 64 bits FNV-1a hash of the parameters of the tracker.
+ * It is stored in the checkpoints, to prevent restoring tracks built with different settings.
+ * 
+ * @return The hash of the parameters.
+ */
+uint64_t BaseTracker::hashParameters() const {
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i=0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+  };
+  mix(&max_frames_to_skip_, sizeof(max_frames_to_skip_));
+  mix(&distance_threshold_, sizeof(distance_threshold_));
+  mix(&center_threshold_, sizeof(center_threshold_));
+  mix(&area_threshold_, sizeof(area_threshold_));
+  mix(&body_ratio_, sizeof(body_ratio_));
+  mix(&dt_, sizeof(dt_));
+  mix(&use_dim_, sizeof(use_dim_));
+  mix(&use_vel_, sizeof(use_vel_));
+  mix(Q_.data(), Q_.size() * sizeof(float));
+  mix(R_.data(), R_.size() * sizeof(float));
+  return hash;
+}
+
+/**
+ * @brief Appends the state of the tracker to a buffer.
+ * @details Appends a TrackerRecord, followed by one ObjectRecord, state and covariance per tracked object.
+ * The filters are copied directly into the buffer, there are no intermediate allocations.
+ * 
+ * @param buffer The reference to the buffer.
+ */
+void BaseTracker::serialize(std::vector<char>& buffer) const {
+  TrackerRecord record;
+  record.track_id_count = track_id_count_;
+  record.num_objects = Objects_.size();
+  record.state_size = Objects_.empty() ? 0 : Objects_.begin()->second->getStateSize();
+  record.padding = 0;
+  size_t offset = buffer.size();
+  const size_t object_size = sizeof(ObjectRecord) + (record.state_size + record.state_size * record.state_size) * sizeof(float);
+  buffer.resize(offset + sizeof(TrackerRecord) + record.num_objects * object_size);
+  memcpy(buffer.data() + offset, &record, sizeof(TrackerRecord));
+  offset += sizeof(TrackerRecord);
+  ObjectRecord object_record;
+  for (auto & element : Objects_) {
+    float* X = reinterpret_cast<float*>(buffer.data() + offset + sizeof(ObjectRecord));
+    float* P = X + record.state_size;
+    element.second->exportState(object_record, X, P);
+    memcpy(buffer.data() + offset, &object_record, sizeof(ObjectRecord));
+    offset += object_size;
+  }
+}
+
+/**
+ * @brief Restores the state of the tracker from a buffer.
+ * @details Reads a TrackerRecord and the objects that follow it, and moves the pointer past them.
+ * The current tracks are discarded. The states are read in place, the buffer can be memory-mapped.
+ * 
+ * @param data The reference to the pointer to the start of the record.
+ * @param end The pointer to the end of the buffer.
+ * @return True if the tracker was restored, false if the record is truncated, has duplicate ids, or does not match the tracker.
+ */
+bool BaseTracker::deserialize(const char*& data, const char* end) {
+  if (end - data < (long) sizeof(TrackerRecord)) {
+    return false;
+  }
+  TrackerRecord record;
+  memcpy(&record, data, sizeof(TrackerRecord));
+  // The sizes are bounded before they are multiplied, such that a corrupt record cannot overflow the bounds check.
+  if (record.state_size > CHECKPOINT_MAX_STATE_SIZE) {
+    return false;
+  }
+  const size_t object_size = sizeof(ObjectRecord) + (record.state_size + record.state_size * record.state_size) * sizeof(float);
+  if (record.num_objects > ((size_t) (end - data) - sizeof(TrackerRecord)) / object_size) {
+    return false;
+  }
+  data += sizeof(TrackerRecord);
+  clear();
+
+  ObjectRecord object_record;
+  for (unsigned int i=0; i < record.num_objects; i++) {
+    memcpy(&object_record, data, sizeof(ObjectRecord));
+    if (Objects_.count(object_record.id) != 0) {
+      printf("[ERROR ] Tracker::%s::l%d Checkpoint has the track %d twice.\n", __func__, __LINE__, object_record.id);
+      clear();
+      return false;
+    }
+    track_id_count_ = object_record.id;
+    addNewObject();
+    Object* object = Objects_[object_record.id];
+    if (object->getStateSize() != record.state_size) {
+      printf("[ERROR ] Tracker::%s::l%d Checkpoint state size %d does not match the tracker state size %d.\n", __func__, __LINE__, record.state_size, object->getStateSize());
+      clear();
+      return false;
+    }
+    const float* X = reinterpret_cast<const float*>(data + sizeof(ObjectRecord));
+    object->importState(object_record, X, X + record.state_size);
+    data += object_size;
+  }
+  track_id_count_ = record.track_id_count;
+  return true;
+}
+
+/**
+ * @brief Removes all the tracks.
+ * @details Removes all the tracked objects, and resets the track ids. The removal is not recorded as a change:
+ * the update counter is incremented instead, such that the next delta does not follow the previous one.
+ * 
+ */
+void BaseTracker::clear() {
+  for (auto & element : Objects_) {
+    delete element.second;
+  }
+  Objects_.clear();
+  track_id_count_ = 0;
+  update_count_ ++;
+  created_ids_.clear();
+  updated_ids_.clear();
+  removed_ids_.clear();
+}
+
 /**
  * @brief Creates a new frame for all the tracked objects.
  * @details Creates a new frame for all the tracked objects.
@@ -415,6 +821,7 @@ void BaseTracker::hungarianMatching(std::vector<std::vector<double>>& cost, std:
  * @param states The reference to the observations.
  */
 void BaseTracker::update(const float& dt, const std::vector<std::vector<float>>& states){
+  startUpdate();
   // Update the Kalman filters.
 #ifdef DEBUG_TRACKER
   printf("\e[1;33m[DEBUG  ]\e[0m Tracker::%s::l%d Updating Kalman filters.\n", __func__, __LINE__);
@@ -447,6 +854,7 @@ void BaseTracker::update(const float& dt, const std::vector<std::vector<float>>&
     for (unsigned int i=0; i < states.size(); i++) {
       addNewObject();
       Objects_[track_id_count_]->setState(states[i]);
+      created_ids_.push_back(track_id_count_);
       track_id_count_ ++;
     }
   }
@@ -518,7 +926,7 @@ void BaseTracker::update(const float& dt, const std::vector<std::vector<float>>&
   for (unsigned int i=0; i < states.size(); i++) {
     assigned = false;
     for (unsigned int j=0; j < assignments.size(); j++) {
-      if (assignments[j] == i) {
+      if (assignments[j] == (int) i) {
         assigned = true;
       }
     }
@@ -535,6 +943,7 @@ void BaseTracker::update(const float& dt, const std::vector<std::vector<float>>&
   for (unsigned int i=0; i < unassigned_detections.size(); i++) {
     addNewObject();
     Objects_[track_id_count_]->setState(states[unassigned_detections[i]]);
+    created_ids_.push_back(track_id_count_);
     track_id_count_ ++;
   }
 
@@ -555,6 +964,7 @@ void BaseTracker::update(const float& dt, const std::vector<std::vector<float>>&
       printf("\e[1;33m[DEBUG  ]\e[0m Tracker::%s::l%d %ld\n", __func__, __LINE__, Objects_.size());
 #endif
       Objects_[tracks_mapping[i]]->correct(states[assignments[i]]);
+      updated_ids_.push_back(tracks_mapping[i]);
     }
   }
 
@@ -573,8 +983,10 @@ void BaseTracker::removeOldTracks(){
 #endif
   for (auto it = Objects_.cbegin(); it != Objects_.cend();)
   {
-    if (it->second->getSkippedFrames() > max_frames_to_skip_)
+    if (it->second->getSkippedFrames() > (int) max_frames_to_skip_)
     {
+      removed_ids_.push_back(it->first);
+      delete it->second;
       it = Objects_.erase(it);
     }
     else
@@ -594,7 +1006,7 @@ void BaseTracker::removeOldTracks(){
  * @param s2 The reference to the second state.
  * @return The euclidean distance.
  */
-float BaseTracker::centroidsError(const std::vector<float>& s1, const std::vector<float>& s2) const {
+float BaseTracker::centroidsError(const std::vector<float>& /*s1*/, const std::vector<float>& /*s2*/) const {
    return 0.0;
 }
 
@@ -607,7 +1019,7 @@ float BaseTracker::centroidsError(const std::vector<float>& s1, const std::vecto
  * @param s2 The reference to the second state.
  * @return The area ratio.
  */
-float BaseTracker::areaRatio(const std::vector<float>& s1, const std::vector<float>& s2) const {
+float BaseTracker::areaRatio(const std::vector<float>& /*s1*/, const std::vector<float>& /*s2*/) const {
   return 0.0;
 }
 
@@ -746,6 +1158,69 @@ void Tracker3D::addNewObject() {
   Objects_.insert(std::make_pair(track_id_count_, new Object3D(track_id_count_, dt_, use_dim_, use_vel_, Q_, R_)));
 }
 
+/**
+ * @brief Sets the frustum of the camera.
+ * @details Sets the frustum used to cull the tracks that are outside the field of view of the camera.
+ * The frustum is not owned by the tracker, it must outlive it. Setting a nullptr disables the culling.
+ * 
+ * @param frustum The pointer to the frustum of the camera.
+ */
+void Tracker3D::setFrustum(Frustum* frustum) {
+  frustum_ = frustum;
+}
+
+/**
+ * @brief Freezes the tracks that cannot be seen by the camera.
+ * @details Moves the tracks located outside the frustum of the camera out of the list of tracked objects.
+ * 
+ */
+void Tracker3D::freezeHiddenTracks() {
+  std::vector<float> state;
+  for (auto it = Objects_.begin(); it != Objects_.end();) {
+    it->second->getState(state);
+    if (frustum_->isVisible(state)) {
+      it ++;
+    } else {
+      frozen_.insert(*it);
+      it = Objects_.erase(it);
+    }
+  }
+}
+
+/**
+ * @brief Unfreezes all the tracks.
+ * @details Moves the frozen tracks back in the list of tracked objects.
+ * 
+ */
+void Tracker3D::unfreezeTracks() {
+  Objects_.insert(frozen_.begin(), frozen_.end());
+  frozen_.clear();
+}
+
+/**
+ * @brief Applied the tracker.
+ * @details This function applies on step of the tracker.
+ * If a valid frustum is set, the tracks outside the field of view of the camera are frozen:
+ * they are neither predicted, aged, nor offered for association. The regular update is then applied
+ * on the visible tracks only. Once done, the frozen tracks are put back, such that they are
+ * reactivated as soon as they re-enter the field of view of the camera.
+ * 
+ * @param dt The time delta in seconds, between this update and the last one.
+ * @param states The reference to the observations.
+ */
+void Tracker3D::update(const float& dt, const std::vector<std::vector<float>>& states){
+  if ((frustum_ == nullptr) || (!frustum_->isValid())) {
+    BaseTracker::update(dt, states);
+    return;
+  }
+  freezeHiddenTracks();
+#ifdef DEBUG_TRACKER
+  printf("\e[1;33m[DEBUG  ]\e[0m Tracker::%s::l%d %ld visible tracks, %ld frozen tracks.\n", __func__, __LINE__, Objects_.size(), frozen_.size());
+#endif
+  BaseTracker::update(dt, states);
+  unfreezeTracks();
+}
+
 /**
  * @brief The distance between two states.
  * @details Computes the distance between two states using the euclidean distance.
@@ -810,4 +1285,155 @@ float Tracker3DF::areaRatio(const std::vector<float>& s1, const std::vector<floa
  */
 void Tracker3DF::addNewObject() {
   Objects_.insert(std::make_pair(track_id_count_, new Object3DF(track_id_count_, dt_, use_dim_, R_)));
+}
+
+/**
+ * @brief Restores the state of the tracker from a buffer.
+ * @details Restores the landmarks, and rebuilds the voxel grid used to index them.
+ * 
+ * @param data The reference to the pointer to the start of the record.
+ * @param end The pointer to the end of the buffer.
+ * @return True if the tracker was restored.
+ */
+bool Tracker3DF::deserialize(const char*& data, const char* end) {
+  if (!BaseTracker::deserialize(data, end)) {
+    return false;
+  }
+  std::vector<float> state;
+  for (auto & element : Objects_) {
+    element.second->getState(state);
+    grid_.insert(element.first, state[0], state[1], state[2]);
+  }
+  return true;
+}
+
+/**
+ * @brief Removes all the landmarks.
+ * @details Removes all the landmarks, and empties the voxel grid.
+ * 
+ */
+void Tracker3DF::clear() {
+  BaseTracker::clear();
+  grid_.clear();
+}
+
+/**
+ * @brief Collects the landmarks located around the observations.
+ * @details Queries the voxel grid around every observation, and stores the ids of the
+ * landmarks that could be matched with them. Each id is only stored once.
+ * 
+ * @param states The reference to the observations.
+ */
+void Tracker3DF::collectCandidates(const std::vector<std::vector<float>>& states) {
+  candidates_.clear();
+  for (unsigned int i=0; i < states.size(); i++) {
+    grid_.query(states[i][0], states[i][1], states[i][2], distance_threshold_, candidates_);
+  }
+  std::sort(candidates_.begin(), candidates_.end());
+  candidates_.erase(std::unique(candidates_.begin(), candidates_.end()), candidates_.end());
+}
+
+/**
+ * @brief Removes the landmarks that have not been seen in a while.
+ * @details Removes the landmarks that have not been seen in a while.
+ * Only the landmarks that were located around the observations are checked:
+ * a landmark is only considered as missed if an observation could have matched it.
+ * 
+ */
+void Tracker3DF::removeOldCandidates() {
+#ifdef DEBUG_TRACKER
+  printf("\e[1;33m[DEBUG  ]\e[0m Tracker::%s::l%d Removing old landmarks.\n", __func__, __LINE__);
+#endif
+  for (unsigned int i=0; i < candidates_.size(); i++) {
+    auto it = Objects_.find(candidates_[i]);
+    if (it->second->getSkippedFrames() > (int) max_frames_to_skip_) {
+      grid_.remove(it->first);
+      removed_ids_.push_back(it->first);
+      delete it->second;
+      Objects_.erase(it);
+    }
+  }
+}
+
+/**
+ * @brief Applied the tracker.
+ * @details This function applies on step of the tracker.
+ * It first collects the landmarks located around the observations using the voxel grid.
+ * Then it computes the cost of each possible matches between these landmarks and the observations,
+ * and applies the association algorithm. Finally, it checks if the matches are possible.
+ * The landmarks that are far from every observation are not modified.
+ * 
+ * @param dt The time delta in seconds, between this update and the last one.
+ * @param states The reference to the observations.
+ */
+void Tracker3DF::update(const float& dt, const std::vector<std::vector<float>>& states){
+  startUpdate();
+  // If there are no observations, nothing can be seen, and the map is left untouched.
+  if (states.empty()) {
+    return;
+  }
+
+  // Only the landmarks around the observations are predicted and aged.
+  collectCandidates(states);
+#ifdef DEBUG_TRACKER
+  printf("\e[1;33m[DEBUG  ]\e[0m Tracker::%s::l%d %ld candidates out of %ld landmarks.\n", __func__, __LINE__, candidates_.size(), Objects_.size());
+#endif
+  for (unsigned int i=0; i < candidates_.size(); i++) {
+    Objects_[candidates_[i]]->predict(dt);
+    Objects_[candidates_[i]]->newFrame();
+  }
+
+  std::vector<std::vector<double>> cost;
+  std::vector<int> assignments;
+  std::vector<bool> assigned(states.size(), false);
+  std::vector<float> state;
+
+  if (!candidates_.empty()) {
+    // Computes the cost between the candidates and the observations.
+    cost.resize(candidates_.size(), std::vector<double>(states.size()));
+    for (unsigned int i=0; i < candidates_.size(); i++) {
+      Objects_[candidates_[i]]->getState(state);
+      for (unsigned int j=0; j < states.size(); j++) {
+        float error = centroidsError(state, states[j]);
+        if (error < distance_threshold_) {
+          cost[i][j] = (double) error;
+        } else {
+          cost[i][j] = 1e6; // Large value
+        }
+      }
+    }
+    hungarianMatching(cost, assignments);
+
+    // Correct the matched landmarks, and move them in the grid.
+    for (unsigned int i=0; i < assignments.size(); i++) {
+      if (assignments[i] == -1) {
+        continue;
+      }
+      Object* object = Objects_[candidates_[i]];
+      object->getState(state);
+      if (!isMatch(state, states[assignments[i]])) {
+        continue;
+      }
+      object->correct(states[assignments[i]]);
+      updated_ids_.push_back(candidates_[i]);
+      object->getState(state);
+      grid_.update(candidates_[i], state[0], state[1], state[2]);
+      assigned[assignments[i]] = true;
+    }
+  }
+
+  // Start new landmarks.
+  for (unsigned int i=0; i < states.size(); i++) {
+    if (assigned[i]) {
+      continue;
+    }
+    addNewObject();
+    Objects_[track_id_count_]->setState(states[i]);
+    created_ids_.push_back(track_id_count_);
+    grid_.insert(track_id_count_, states[i][0], states[i][1], states[i][2]);
+    track_id_count_ ++;
+  }
+
+  // Remove the landmarks that should have been seen but were not.
+  removeOldCandidates();
 }
\ No newline at end of file
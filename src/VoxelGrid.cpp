@@ -0,0 +1,190 @@
+/**
+ * @file VoxelGrid.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The source code of the voxel grid class.
+ * @details This file implements a sparse voxel hash used to index static objects in space.
+ */
+
+#include <detect_and_track/VoxelGrid.h>
+
+/**
+ * @brief Default constructor.
+ * @details Default constructor. Uses voxels of 1 meter.
+ *
+ */
+VoxelGrid::VoxelGrid() : voxel_size_(1.0), voxel_size_inv_(1.0) {}
+
+/**
+ * @brief Prefered constructor.
+ * @details Prefered constructor.
+ *
+ * @param voxel_size The size of the side of a voxel. Ideally, it should be close to the association distance.
+ */
+VoxelGrid::VoxelGrid(const float& voxel_size) {
+  voxel_size_ = voxel_size;
+  voxel_size_inv_ = 1.0 / voxel_size;
+}
+
+/**
+ * @brief Computes the index of the voxel along one axis.
+ * @details Computes the index of the voxel along one axis.
+ *
+ * @param v The reference to the coordinate along the axis.
+ * @return The index of the voxel.
+ */
+int VoxelGrid::toCell(const float& v) const {
+  return (int) floor(v * voxel_size_inv_);
+}
+
+/**
+ * @brief Packs the coordinates of a voxel into a single key.
+ * @details Packs the coordinates of a voxel into a single 64 bits key.
+ * Each axis is stored on 21 bits, which allows for 2 million voxels per axis.
+ *
+ * @param i The reference to the index of the voxel along the x axis.
+ * @param j The reference to the index of the voxel along the y axis.
+ * @param k The reference to the index of the voxel along the z axis.
+ * @return The key of the voxel.
+ */
+int64_t VoxelGrid::hashKey(const int& i, const int& j, const int& k) const {
+  return (((int64_t) i & 0x1FFFFF) << 42) | (((int64_t) j & 0x1FFFFF) << 21) | ((int64_t) k & 0x1FFFFF);
+}
+
+/**
+ * @brief Removes an id from a voxel.
+ * @details Removes an id from a voxel. If the voxel becomes empty, it is released.
+ *
+ * @param key The reference to the key of the voxel.
+ * @param id The reference to the id to be removed.
+ */
+void VoxelGrid::eraseFromCell(const int64_t& key, const unsigned int& id) {
+  auto cell = cells_.find(key);
+  if (cell == cells_.end()) {
+    return;
+  }
+  std::vector<unsigned int>& ids = cell->second;
+  for (unsigned int i=0; i < ids.size(); i++) {
+    if (ids[i] == id) {
+      // Order does not matter, swap with the last element.
+      ids[i] = ids.back();
+      ids.pop_back();
+      break;
+    }
+  }
+  if (ids.empty()) {
+    cells_.erase(cell);
+  }
+}
+
+/**
+ * @brief Adds an id to the grid.
+ * @details Adds an id to the grid. If the id is already in the grid, it is moved instead.
+ *
+ * @param id The reference to the id of the object.
+ * @param x The reference to the position of the object on the x axis.
+ * @param y The reference to the position of the object on the y axis.
+ * @param z The reference to the position of the object on the z axis.
+ */
+void VoxelGrid::insert(const unsigned int& id, const float& x, const float& y, const float& z) {
+  if (keys_.count(id)) {
+    update(id, x, y, z);
+    return;
+  }
+  int64_t key = hashKey(toCell(x), toCell(y), toCell(z));
+  cells_[key].push_back(id);
+  keys_[id] = key;
+}
+
+/**
+ * @brief Moves an id inside the grid.
+ * @details Moves an id inside the grid. Nothing is done if the object remains in the same voxel.
+ *
+ * @param id The reference to the id of the object.
+ * @param x The reference to the new position of the object on the x axis.
+ * @param y The reference to the new position of the object on the y axis.
+ * @param z The reference to the new position of the object on the z axis.
+ */
+void VoxelGrid::update(const unsigned int& id, const float& x, const float& y, const float& z) {
+  auto it = keys_.find(id);
+  if (it == keys_.end()) {
+    insert(id, x, y, z);
+    return;
+  }
+  int64_t key = hashKey(toCell(x), toCell(y), toCell(z));
+  if (key == it->second) {
+    return;
+  }
+  eraseFromCell(it->second, id);
+  cells_[key].push_back(id);
+  it->second = key;
+}
+
+/**
+ * @brief Removes an id from the grid.
+ * @details Removes an id from the grid.
+ *
+ * @param id The reference to the id of the object.
+ */
+void VoxelGrid::remove(const unsigned int& id) {
+  auto it = keys_.find(id);
+  if (it == keys_.end()) {
+    return;
+  }
+  eraseFromCell(it->second, id);
+  keys_.erase(it);
+}
+
+/**
+ * @brief Collects the ids around a point.
+ * @details Collects the ids stored in all the voxels that overlap the cube of half-side radius
+ * centered on the given point. The ids are appended to the output vector, it is not cleared.
+ * The returned ids are candidates, the exact distance must be checked by the caller.
+ *
+ * @param x The reference to the position of the point on the x axis.
+ * @param y The reference to the position of the point on the y axis.
+ * @param z The reference to the position of the point on the z axis.
+ * @param radius The reference to the radius of the query.
+ * @param ids The reference to the vector in which the ids will be stored.
+ */
+void VoxelGrid::query(const float& x, const float& y, const float& z, const float& radius, std::vector<unsigned int>& ids) const {
+  const int i_min = toCell(x - radius);
+  const int i_max = toCell(x + radius);
+  const int j_min = toCell(y - radius);
+  const int j_max = toCell(y + radius);
+  const int k_min = toCell(z - radius);
+  const int k_max = toCell(z + radius);
+  for (int i = i_min; i <= i_max; i++) {
+    for (int j = j_min; j <= j_max; j++) {
+      for (int k = k_min; k <= k_max; k++) {
+        auto cell = cells_.find(hashKey(i, j, k));
+        if (cell != cells_.end()) {
+          ids.insert(ids.end(), cell->second.begin(), cell->second.end());
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Empties the grid.
+ * @details Empties the grid.
+ *
+ */
+void VoxelGrid::clear() {
+  cells_.clear();
+  keys_.clear();
+}
+
+/**
+ * @brief The number of ids in the grid.
+ * @details Accessor function, returns the number of ids stored in the grid.
+ *
+ * @return The number of ids.
+ */
+size_t VoxelGrid::size() const {
+  return keys_.size();
+}
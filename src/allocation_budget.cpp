@@ -0,0 +1,115 @@
+/**
+ * @file allocation_budget.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief A check of the heap allocations made by the stages of the pipeline.
+ * @details Runs synthetic frames through a locate -> track pipeline, with the allocation hooks linked.
+ * After a warm-up, the allocations made by each stage on the steady-state frames are counted, and compared
+ * with the budget of the stage, in allocations per frame. The exit code is 1 if a stage exceeds its budget,
+ * such that it can guard against regressions while the allocations are eliminated. The budgets should be
+ * lowered as the stages get cheaper, down to 0.
+ * Usage: allocation_budget [num_frames] [num_objects] [stage=budget ...]
+ */
+
+#include <detect_and_track/DetectionUtils.h>
+#include <detect_and_track/BenchmarkFixture.h>
+#include <detect_and_track/Pipeline.h>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The default budgets, in allocations per frame, with the default 10 objects per frame.
+ * @details Measured at 66 (locate) and 346 (track) allocations per frame, the count does not vary in between runs.
+ * The budgets leave a margin of about 10%, such that a new allocation per object fails the check.
+ */
+static const std::map<std::string, double> default_budgets {{"locate", 72.0}, {"track", 380.0}};
+
+/**
+ * @brief Pushes the frames one at a time, and waits for each of them to be tracked.
+ *
+ */
+static void run(Pipeline<PipelineFrame>& pipeline, std::atomic<uint64_t>& tracked, const cv::Mat& depth,
+                const std::vector<std::vector<std::vector<BoundingBox>>>& frames, const int& first, const int& last) {
+  for (int f = first; f < last; f++) {
+    std::unique_ptr<PipelineFrame> frame(new PipelineFrame);
+    frame->depth = depth;
+    frame->bboxes = frames[f];
+    const uint64_t target = tracked.load() + 1;
+    if (!pipeline.push(frame, (int64_t) f * 33000000)) {
+      printf("[ERROR ] allocation_budget::%s::l%d Frame %d was not accepted.\n", __func__, __LINE__, f);
+      continue;
+    }
+    while (tracked.load() < target) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  const int num_frames = argc > 1 ? atoi(argv[1]) : 1000;
+  const int num_objects = argc > 2 ? atoi(argv[2]) : 10;
+  std::map<std::string, double> budgets = default_budgets;
+  for (int i = 3; i < argc; i++) {
+    const char* separator = strchr(argv[i], '=');
+    if (separator == nullptr) {
+      printf("[ERROR ] allocation_budget::%s::l%d Expected stage=budget, got %s.\n", __func__, __LINE__, argv[i]);
+      return 2;
+    }
+    budgets[std::string(argv[i], separator - argv[i])] = atof(separator + 1);
+  }
+  if (!AllocationAccounting::isHooked()) {
+    printf("[ERROR ] allocation_budget::%s::l%d The allocation hooks are not linked.\n", __func__, __LINE__);
+    return 2;
+  }
+
+  BenchmarkParameters p;
+  getBenchmarkParameters(p);
+
+  const int warmup_frames = 100;
+  cv::Mat depth;
+  std::vector<std::vector<std::vector<BoundingBox>>> frames;
+  generateBenchmarkFrames(warmup_frames + num_frames, num_objects, p.glo_p.image_height, p.glo_p.image_width, depth, frames);
+
+  Locate locate(p.glo_p, p.loc_p, p.cam_p);
+  Track2D track(p.det_p, p.kal_p, p.tra_p, p.bbo_p);
+  std::atomic<uint64_t> tracked(0);
+  Pipeline<PipelineFrame> pipeline(4);
+  pipeline.addStage("locate", [&locate](PipelineFrame& frame){return locate.locateFrame(frame);}, false);
+  pipeline.addStage("track", [&track, &tracked](PipelineFrame& frame){
+    track.trackFrame(frame);
+    tracked.fetch_add(1);
+    return true;
+  }, false);
+  pipeline.start();
+
+  // The tracks, and the buffers that are reused, are created during the warm-up.
+  std::vector<AllocationStatistics> statistics;
+  run(pipeline, tracked, depth, frames, 0, warmup_frames);
+  AllocationAccounting::collect(statistics);
+  run(pipeline, tracked, depth, frames, warmup_frames, warmup_frames + num_frames);
+  AllocationAccounting::collect(statistics);
+  pipeline.stop();
+
+  printf("[INFO  ] %d steady-state frames, %d objects per frame\n", num_frames, num_objects);
+  bool passed = true;
+  for (unsigned int i = 0; i < statistics.size(); i++) {
+    const double count = (double) statistics[i].count / num_frames;
+    const double bytes = (double) statistics[i].bytes / num_frames;
+    std::map<std::string, double>::const_iterator budget = budgets.find(statistics[i].name);
+    if (budget == budgets.end()) {
+      printf("[INFO  ] %-8s %10.1f allocations per frame, %12.1f bytes per frame\n", statistics[i].name.c_str(), count, bytes);
+    } else if (count <= budget->second) {
+      printf("[INFO  ] %-8s %10.1f allocations per frame, %12.1f bytes per frame, budget %.1f: passed\n",
+             statistics[i].name.c_str(), count, bytes, budget->second);
+    } else {
+      printf("[ERROR ] %-8s %10.1f allocations per frame, %12.1f bytes per frame, budget %.1f: FAILED\n",
+             statistics[i].name.c_str(), count, bytes, budget->second);
+      passed = false;
+    }
+  }
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file benchmarks.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The microbenchmarks of the kernels of the pipeline.
+ * @details Measures the decoding and the non maximum suppression of the output of the network, the assignment of
+ * the Hungarian algorithm, the prediction and correction of the Kalman filters, and the distance modes of the
+ * position estimator, over sweeps of realistic sizes. The inputs are synthetic, and generated with fixed seeds,
+ * such that the runs can be compared: neither a GPU nor a ROS master is needed.
+ * The allocation hooks are linked, each benchmark reports its heap allocations and allocated bytes per operation.
+ * Usage: detect_and_track_benchmarks [--benchmark_filter=regex] [--benchmark_out=file.json --benchmark_out_format=json]
+ */
+
+#include <detect_and_track/utils.h>
+#include <detect_and_track/PoseEstimator.h>
+#include <detect_and_track/KalmanFilter.h>
+#include <detect_and_track/Hungarian.h>
+#include <detect_and_track/Instrumentation.h>
+#include <benchmark/benchmark.h>
+#include <random>
+
+/**
+ * @brief Counts the heap allocations made in between its creation and report, and sets them as counters of the benchmark.
+ *
+ */
+class AllocationCounter {
+  private:
+    std::vector<AllocationStatistics> statistics_;
+
+    void sum(uint64_t& count, uint64_t& bytes) {
+      AllocationAccounting::collect(statistics_);
+      count = 0;
+      bytes = 0;
+      for (unsigned int i = 0; i < statistics_.size(); i++) {
+        count += statistics_[i].count;
+        bytes += statistics_[i].bytes;
+      }
+    }
+
+  public:
+    AllocationCounter() {
+      // Clears the allocations made before the measured loop.
+      uint64_t count, bytes;
+      sum(count, bytes);
+    }
+
+    void report(benchmark::State& state) {
+      uint64_t count, bytes;
+      sum(count, bytes);
+      state.counters["allocs_per_op"] = benchmark::Counter((double) count, benchmark::Counter::kAvgIterations);
+      state.counters["bytes_per_op"] = benchmark::Counter((double) bytes, benchmark::Counter::kAvgIterations);
+    }
+};
+
+/**
+ * @brief Generates the raw output of the network: x, y, width, height, confidence, and the probability of each class,
+ * for each anchor. Most of the anchors are below the confidence threshold, the others are clustered around a few objects.
+ *
+ */
+static void generateOutput(const int& num_anchors, const int& num_classes, std::vector<float>& output) {
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> uniform(0.0, 1.0);
+  std::normal_distribution<float> jitter(0.0, 4.0);
+  const int stride = num_classes + 5;
+  std::vector<float> centers(40);
+  for (unsigned int k = 0; k < centers.size(); k++) {
+    centers[k] = uniform(generator) * 600.0;
+  }
+  output.resize(num_anchors * stride);
+  for (int i = 0; i < num_anchors; i++) {
+    float* anchor = output.data() + i * stride;
+    const unsigned int object = generator() % (centers.size() / 2);
+    anchor[0] = centers[2 * object] + jitter(generator);
+    anchor[1] = centers[2 * object + 1] * 0.75 + jitter(generator);
+    anchor[2] = 40.0 + jitter(generator);
+    anchor[3] = 40.0 + jitter(generator);
+    // About 2% of the anchors are above the threshold, like in a busy scene.
+    anchor[4] = uniform(generator) < 0.02 ? 0.5 + 0.5 * uniform(generator) : 0.3 * uniform(generator);
+    for (int j = 0; j < num_classes; j++) {
+      anchor[5 + j] = uniform(generator);
+    }
+  }
+}
+
+/**
+ * @brief Generates a cost matrix in between tracks and detections, in pixels.
+ *
+ */
+static void generateCosts(const int& size, std::vector<std::vector<double>>& costs) {
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<double> uniform(0.0, 500.0);
+  costs.assign(size, std::vector<double>(size));
+  for (int i = 0; i < size; i++) {
+    for (int j = 0; j < size; j++) {
+      costs[i][j] = uniform(generator);
+    }
+  }
+}
+
+/**
+ * @brief Generates a depth image, in meters.
+ *
+ */
+static void generateDepth(const int& rows, const int& cols, cv::Mat& depth) {
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> distance(1.0, 5.0);
+  depth = cv::Mat(rows, cols, CV_32FC1);
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      depth.at<float>(i, j) = distance(generator);
+    }
+  }
+}
+
+/**
+ * @brief The decoding of the output of the network. Arguments: the number of anchors, the number of classes.
+ *
+ */
+static void BM_DecodeDetections(benchmark::State& state) {
+  const int num_anchors = state.range(0);
+  const int num_classes = state.range(1);
+  std::vector<float> output;
+  generateOutput(num_anchors, num_classes, output);
+  std::vector<std::vector<BoundingBox>> bboxes;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    bboxes.clear();
+    decodeDetections(output.data(), output.size(), num_classes, 0.5, bboxes);
+    benchmark::DoNotOptimize(bboxes.data());
+  }
+  allocations.report(state);
+}
+BENCHMARK(BM_DecodeDetections)->ArgsProduct({{6300, 25200}, {1, 4}});
+
+/**
+ * @brief The non maximum suppression of the decoded bounding boxes. Arguments: the number of anchors, the number of classes.
+ *
+ */
+static void BM_SuppressOverlaps(benchmark::State& state) {
+  const int num_anchors = state.range(0);
+  const int num_classes = state.range(1);
+  std::vector<float> output;
+  generateOutput(num_anchors, num_classes, output);
+  std::vector<std::vector<BoundingBox>> decoded;
+  decodeDetections(output.data(), output.size(), num_classes, 0.5, decoded);
+  std::vector<std::vector<BoundingBox>> bboxes(num_classes);
+  for (int c = 0; c < num_classes; c++) {
+    bboxes[c].reserve(decoded[c].size());
+  }
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    // The suppression marks the bounding boxes as invalid, they are restored before each run.
+    for (int c = 0; c < num_classes; c++) {
+      bboxes[c].assign(decoded[c].begin(), decoded[c].end());
+    }
+    suppressOverlaps(bboxes, 0.45, 100);
+    benchmark::DoNotOptimize(bboxes.data());
+  }
+  allocations.report(state);
+}
+BENCHMARK(BM_SuppressOverlaps)->ArgsProduct({{6300, 25200}, {1, 4}});
+
+/**
+ * @brief The assignment of the Hungarian algorithm. Argument: the number of tracks, and of detections.
+ *
+ */
+static void BM_HungarianSolve(benchmark::State& state) {
+  std::vector<std::vector<double>> costs;
+  generateCosts(state.range(0), costs);
+  HungarianAlgorithm hungarian;
+  std::vector<int> assignments;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(hungarian.Solve(costs, assignments));
+  }
+  allocations.report(state);
+}
+BENCHMARK(BM_HungarianSolve)->Arg(2)->Arg(5)->Arg(10)->Arg(20)->Arg(50);
+
+// The noises and states of the filters, as set in the default parameters of the nodes.
+static const std::vector<float> Q_2D {9.0, 9.0, 200.0, 200.0, 5.0, 5.0};
+static const std::vector<float> R_2D {2.0, 2.0, 200.0, 200.0, 2.0, 2.0};
+static const std::vector<float> state_2D {320.0, 240.0, 0.0, 0.0, 80.0, 80.0};
+static const std::vector<float> Q_3D {9.0, 9.0, 9.0, 200.0, 200.0, 200.0, 5.0, 5.0};
+static const std::vector<float> R_3D {2.0, 2.0, 2.0, 200.0, 200.0, 200.0, 2.0, 2.0};
+static const std::vector<float> state_3D {2.0, 1.0, 0.5, 0.0, 0.0, 0.0, 80.0, 80.0};
+
+/**
+ * @brief The prediction and correction of a Kalman filter, as done for each track on each frame.
+ *
+ */
+template<class Filter>
+static void runKalmanPredictCorrect(benchmark::State& state, const std::vector<float>& Q, const std::vector<float>& R,
+                                    const std::vector<float>& initial_state) {
+  Filter filter(0.033, true, false, Q, R);
+  filter.resetFilter(initial_state);
+  std::mt19937 generator(0);
+  std::normal_distribution<float> noise(0.0, 1.0);
+  std::vector<std::vector<float>> measurements(256, initial_state);
+  for (unsigned int i = 0; i < measurements.size(); i++) {
+    for (unsigned int j = 0; j < measurements[i].size(); j++) {
+      measurements[i][j] += noise(generator);
+    }
+  }
+  unsigned int i = 0;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    filter.predict(0.033);
+    filter.correct(measurements[i]);
+    i = (i + 1) % measurements.size();
+  }
+  allocations.report(state);
+}
+
+static void BM_KalmanFilter2D(benchmark::State& state) {
+  runKalmanPredictCorrect<KalmanFilter2D>(state, Q_2D, R_2D, state_2D);
+}
+BENCHMARK(BM_KalmanFilter2D);
+
+static void BM_KalmanFilter3D(benchmark::State& state) {
+  runKalmanPredictCorrect<KalmanFilter3D>(state, Q_3D, R_3D, state_3D);
+}
+BENCHMARK(BM_KalmanFilter3D);
+
+/**
+ * @brief The distance to an object, from a 640x480 depth image. Argument: the size of the bounding box, in pixels.
+ *
+ */
+static void BM_PoseEstimatorDistance(benchmark::State& state, const std::string mode) {
+  GlobalParameters glo_p{480, 640};
+  LocalizationParameters loc_p{0.1, 0.1, mode};
+  CameraParameters cam_p{{600, 600, 320, 240}, {0, 0, 0, 0, 0}, "pin_hole"};
+  PoseEstimator estimator(glo_p, loc_p, cam_p);
+  cv::Mat depth;
+  generateDepth(glo_p.image_height, glo_p.image_width, depth);
+  const int size = state.range(0);
+  const int x_min = (glo_p.image_width - size) / 2;
+  const int y_min = (glo_p.image_height - size) / 2;
+  AllocationCounter allocations;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(estimator.getDistance(depth, x_min, y_min, size, size));
+  }
+  allocations.report(state);
+}
+BENCHMARK_CAPTURE(BM_PoseEstimatorDistance, min_distance, "min_distance")->Arg(40)->Arg(80)->Arg(160)->Arg(320);
+BENCHMARK_CAPTURE(BM_PoseEstimatorDistance, center, "center")->Arg(40)->Arg(80)->Arg(160)->Arg(320);
+BENCHMARK_CAPTURE(BM_PoseEstimatorDistance, average_min_distance, "average_min_distance")->Arg(40)->Arg(80)->Arg(160)->Arg(320);
+
+BENCHMARK_MAIN();
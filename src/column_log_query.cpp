@@ -0,0 +1,102 @@
+/**
+ * @file column_log_query.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief Queries the columnar logs of the nodes.
+ * @details Prints the time range and the number of rows of a log (see ColumnLogWriter), and the number of detections
+ * and of tracks in a time range. Only the stamps of the segments overlapping the range are read. The rows in the
+ * range can be exported to a CSV file.
+ * Usage: column_log_query <log> [start=<seconds>] [end=<seconds>] [csv=<path>]
+ * where start and end are in seconds since the epoch, like the stamps of the messages. They default to the range of the log.
+ */
+
+#include <detect_and_track/ColumnLog.h>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("Usage: column_log_query <log> [start=<seconds>] [end=<seconds>] [csv=<path>]\n");
+    return 2;
+  }
+  ColumnLogReader reader;
+  if (!reader.open(argv[1])) {
+    return 2;
+  }
+  int64_t start, end;
+  if (!reader.getTimeRange(start, end)) {
+    printf("[INFO  ] %s: no rows\n", argv[1]);
+    return 0;
+  }
+  printf("[INFO  ] %s: %lu segments, %lu rows, from %.3f s to %.3f s\n", argv[1], reader.getNumSegments(),
+         reader.getNumRows(), start * 1e-9, end * 1e-9);
+
+  std::string csv;
+  for (int i = 2; i < argc; i++) {
+    const char* separator = strchr(argv[i], '=');
+    if (separator == nullptr) {
+      printf("[ERROR ] column_log_query::%s::l%d Expected key=value, got %s.\n", __func__, __LINE__, argv[i]);
+      return 2;
+    }
+    const std::string key(argv[i], separator - argv[i]);
+    const std::string value(separator + 1);
+    if (key == "start") {
+      start = (int64_t) (atof(value.c_str()) * 1e9);
+    } else if (key == "end") {
+      end = (int64_t) (atof(value.c_str()) * 1e9);
+    } else if (key == "csv") {
+      csv = value;
+    } else {
+      printf("[ERROR ] column_log_query::%s::l%d Unknown option %s.\n", __func__, __LINE__, key.c_str());
+      return 2;
+    }
+  }
+
+  const auto query_start = std::chrono::steady_clock::now();
+  std::vector<ColumnLogSpan> spans;
+  reader.findRange(start, end, spans);
+  uint64_t counts[2] = {0, 0};
+  for (unsigned int s = 0; s < spans.size(); s++) {
+    const uint32_t* kinds = static_cast<const uint32_t*>(reader.getColumn(spans[s].segment, COLUMN_KIND));
+    for (uint64_t r = spans[s].begin; r < spans[s].end; r++) {
+      counts[kinds[r] == COLUMN_LOG_TRACK] ++;
+    }
+  }
+  const float query_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - query_start).count();
+  printf("[INFO  ] From %.3f s to %.3f s: %lu detections, %lu tracks, in %u spans, found in %.3f ms\n",
+         start * 1e-9, end * 1e-9, counts[0], counts[1], (unsigned int) spans.size(), query_ms);
+
+  if (csv.empty()) {
+    return 0;
+  }
+  FILE* file = fopen(csv.c_str(), "w");
+  if (file == nullptr) {
+    printf("[ERROR ] column_log_query::%s::l%d Could not open %s.\n", __func__, __LINE__, csv.c_str());
+    return 2;
+  }
+  fprintf(file, "stamp,sequence,kind,class_id,id,confidence");
+  for (unsigned int s = 0; s < COLUMN_LOG_NUM_STATES; s++) {
+    fprintf(file, ",state_%u", s);
+  }
+  fprintf(file, ",position_x,position_y,position_z\n");
+  ColumnLogRow row;
+  for (unsigned int s = 0; s < spans.size(); s++) {
+    for (uint64_t r = spans[s].begin; r < spans[s].end; r++) {
+      reader.readRow(spans[s].segment, r, row);
+      fprintf(file, "%ld,%lu,%s,%u,%u,%g", row.stamp, row.sequence, row.kind == COLUMN_LOG_TRACK ? "track" : "detection",
+              row.class_id, row.id, row.confidence);
+      for (unsigned int k = 0; k < COLUMN_LOG_NUM_STATES; k++) {
+        fprintf(file, ",%g", row.state[k]);
+      }
+      fprintf(file, ",%g,%g,%g\n", row.position[0], row.position[1], row.position[2]);
+    }
+  }
+  fclose(file);
+  return 0;
+}
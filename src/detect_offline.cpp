@@ -0,0 +1,107 @@
+/**
+ * @file detect_offline.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The offline processing of folders of images and videos.
+ * @details Runs the detection, and the localization or the tracking, on a folder of images or on a video,
+ * without ROS, as fast as the GPU allows (see OfflineRunner). The results are written to a recording,
+ * which can be read with RecordReader::readResult.
+ * Usage: detect_offline <mode> <input> <output> [config.yaml ...] [key=value ...]
+ * where mode is detect, locate, track2D, track2D_locate, or track3D, input is a folder of images or a video,
+ * and output is the recording. The parameters are read from the yaml files, with the names of the parameters
+ * of the nodes, then from the key=value arguments. The options of the processing are: save_images (false),
+ * resume (false), verbose (true), and num_threads (0, one per core).
+ */
+
+#include <detect_and_track/Offline.h>
+#include <filesystem>
+#include <string>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Processes the input with the detection class of a mode.
+ *
+ * @param detector The reference to the detection class.
+ * @param parameters The reference to the parameters.
+ * @param input The reference to the folder of images, or the video.
+ * @param output The reference to the recording.
+ * @param is_video The reference to whether the input is a video.
+ */
+template <typename T>
+static void process(T& detector, const ParameterMap& parameters, const std::string& input,
+                    const std::string& output, const bool& is_video) {
+  detector.setOfflineThreads(std::max(getInt(parameters, "num_threads", 0), 0));
+  const bool save_images = getBool(parameters, "save_images", false);
+  const bool resume = getBool(parameters, "resume", false);
+  const bool verbose = getBool(parameters, "verbose", true);
+  if (is_video) {
+    detector.applyOnVideo(input, output, save_images, resume, verbose);
+  } else {
+    detector.applyOnFolder(input, output, save_images, resume, verbose);
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    printf("Usage: detect_offline <mode> <input> <output> [config.yaml ...] [key=value ...]\n");
+    return 2;
+  }
+  const std::string mode(argv[1]);
+  const std::string input(argv[2]);
+  const std::string output(argv[3]);
+  ParameterMap parameters;
+  for (int i = 4; i < argc; i++) {
+    const char* separator = strchr(argv[i], '=');
+    if (separator != nullptr) {
+      parameters[std::string(argv[i], separator - argv[i])] = std::string(separator + 1);
+    } else if (!loadParameters(argv[i], parameters)) {
+      return 2;
+    }
+  }
+  if (!std::filesystem::exists(input)) {
+    printf("[ERROR ] detect_offline::%s::l%d No such file or folder: %s.\n", __func__, __LINE__, input.c_str());
+    return 2;
+  }
+  const bool is_video = !std::filesystem::is_directory(input);
+
+  GlobalParameters glo_p;
+  DetectionParameters det_p;
+  NMSParameters nms_p;
+  LocalizationParameters loc_p;
+  CameraParameters cam_p;
+  KalmanParameters kal_p;
+  TrackingParameters tra_p;
+  BBoxRejectionParameters bbo_p;
+  getDetectionParameters(parameters, glo_p, det_p, nms_p);
+  getLocalizationParameters(parameters, glo_p, loc_p, cam_p);
+  getTrackingParameters(parameters, mode == "track3D", det_p, kal_p, tra_p, bbo_p);
+  // The trackers restart with each run, a restored checkpoint would carry the tracks of another input.
+  tra_p.checkpoint_path = "";
+
+  if (mode == "detect") {
+    Detect detector(glo_p, det_p, nms_p);
+    process(detector, parameters, input, output, is_video);
+  } else if (mode == "locate") {
+    DetectAndLocate detector(glo_p, det_p, nms_p, loc_p, cam_p);
+    process(detector, parameters, input, output, is_video);
+  } else if (mode == "track2D") {
+    DetectAndTrack2D detector(glo_p, det_p, nms_p, kal_p, tra_p, bbo_p);
+    process(detector, parameters, input, output, is_video);
+  } else if (mode == "track2D_locate") {
+    DetectTrack2DAndLocate detector(glo_p, det_p, nms_p, kal_p, tra_p, bbo_p, loc_p, cam_p);
+    process(detector, parameters, input, output, is_video);
+  } else if (mode == "track3D") {
+    DetectAndTrack3D detector(glo_p, det_p, nms_p, kal_p, tra_p, bbo_p, loc_p, cam_p);
+    process(detector, parameters, input, output, is_video);
+  } else {
+    printf("[ERROR ] detect_offline::%s::l%d Unknown mode \"%s\", expected detect, locate, track2D, track2D_locate, or track3D.\n",
+           __func__, __LINE__, mode.c_str());
+    return 2;
+  }
+  return 0;
+}
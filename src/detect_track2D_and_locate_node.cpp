@@ -4,6 +4,7 @@ int main(int argc, char** argv)
 {
   ros::init(argc, argv, "drone_detector");
   ROSDetectTrack2DAndLocate rdt2dal;
+  rdt2dal.start();
   ros::spin();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+/**
+ * @file nodelets.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The nodelet versions of the ROS nodes.
+ * @details This file wraps each ROS node in a nodelet. Nodelets loaded in the same manager exchange
+ * their messages as shared pointers, the images and detections are neither serialized nor copied.
+ */
+
+#include <detect_and_track/ROSWrappers.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <memory>
+
+namespace detect_and_track {
+
+/**
+ * @brief A nodelet owning one of the ROS nodes.
+ * @details The node is built in onInit with the private node handle of the nodelet, such that the parameters
+ * are read from the namespace of the nodelet. The inputs are serviced by the callback queues of the node,
+ * see InputQueue, the callback queue of the manager is only used if they are disabled.
+ */
+template <typename T>
+class NodeletWrapper : public nodelet::Nodelet {
+  private:
+    std::unique_ptr<T> node_;
+
+    virtual void onInit() override {
+      node_.reset(new T(getPrivateNodeHandle()));
+      node_->start();
+    }
+};
+
+class DetectNodelet : public NodeletWrapper<ROSDetect> {};
+class DetectAndLocateNodelet : public NodeletWrapper<ROSDetectAndLocate> {};
+class Track2DNodelet : public NodeletWrapper<ROSTrack2D> {};
+class DetectAndTrack2DNodelet : public NodeletWrapper<ROSDetectAndTrack2D> {};
+class DetectTrack2DAndLocateNodelet : public NodeletWrapper<ROSDetectTrack2DAndLocate> {};
+class DetectAndTrack3DNodelet : public NodeletWrapper<ROSDetectAndTrack3D> {};
+class PipelineGraphNodelet : public NodeletWrapper<ROSPipelineGraph> {};
+
+} // namespace detect_and_track
+
+PLUGINLIB_EXPORT_CLASS(detect_and_track::DetectNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(detect_and_track::DetectAndLocateNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(detect_and_track::Track2DNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(detect_and_track::DetectAndTrack2DNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(detect_and_track::DetectTrack2DAndLocateNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(detect_and_track::DetectAndTrack3DNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(detect_and_track::PipelineGraphNodelet, nodelet::Nodelet)
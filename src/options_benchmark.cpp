@@ -0,0 +1,133 @@
+/**
+ * @file options_benchmark.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief A benchmark of the runtime options.
+ * @details Runs the localization and the 2D tracking on synthetic frames, with profiling and the debug prints
+ * disabled, and then enabled. The prints of the enabled run are sent to /dev/null. The same file is also built with
+ * RUNTIME_OPTIONS_COMPILED_OUT as options_benchmark_baseline, in which the code of the options is removed, like in
+ * the nodes built without the former compile-time flags. options_benchmark runs the baseline found next to it, such
+ * that the time per frame of the three runs is printed: the disabled run should be as fast as the baseline.
+ * Usage: options_benchmark [num_frames] [num_objects]
+ */
+
+#include <detect_and_track/DetectionUtils.h>
+#include <detect_and_track/BenchmarkFixture.h>
+#include <chrono>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/**
+ * @brief Locates and tracks every frame.
+ *
+ * @return The mean time per frame, in microseconds.
+ */
+static double run(Locate& locate, Track2D& track, const cv::Mat& depth, const std::vector<std::vector<std::vector<BoundingBox>>>& frames) {
+  std::vector<std::vector<float>> distances;
+  std::vector<std::vector<std::vector<float>>> points;
+  std::vector<std::map<unsigned int, std::vector<float>>> tracker_states(1);
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int f = 0; f < frames.size(); f++) {
+    locate.locate(depth, frames[f], distances, points);
+    locate.printProfilingLocalization();
+    track.track(frames[f], tracker_states, 0.033);
+    track.printProfilingTracking();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / frames.size();
+}
+
+#ifndef RUNTIME_OPTIONS_COMPILED_OUT
+/**
+ * @brief Runs options_benchmark_baseline, from the directory of this executable.
+ *
+ * @param argv0 The path of this executable.
+ * @param num_frames The reference to the number of frames.
+ * @param num_objects The reference to the number of objects per frame.
+ * @param baseline The reference to the double in which the time per frame of the baseline will be stored, in microseconds.
+ * @return False if the baseline could not be run.
+ */
+static bool runBaseline(const char* argv0, const int& num_frames, const int& num_objects, double& baseline) {
+  std::string path(argv0);
+  const size_t separator = path.find_last_of('/');
+  path = (separator == std::string::npos ? std::string(".") : path.substr(0, separator)) + "/options_benchmark_baseline";
+  if (access(path.c_str(), X_OK) != 0) {
+    return false;
+  }
+  const std::string command = path + " " + std::to_string(num_frames) + " " + std::to_string(num_objects);
+  FILE* pipe = popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    return false;
+  }
+  bool found = false;
+  char line[256];
+  while (fgets(line, sizeof(line), pipe) != nullptr) {
+    found |= sscanf(line, "[INFO  ] options compiled out: %lf", &baseline) == 1;
+  }
+  return (pclose(pipe) == 0) && found;
+}
+#endif
+
+int main(int argc, char** argv) {
+  const int num_frames = argc > 1 ? atoi(argv[1]) : 2000;
+  const int num_objects = argc > 2 ? atoi(argv[2]) : 10;
+  BenchmarkParameters p;
+  getBenchmarkParameters(p);
+
+  cv::Mat depth;
+  std::vector<std::vector<std::vector<BoundingBox>>> frames;
+  generateBenchmarkFrames(num_frames, num_objects, p.glo_p.image_height, p.glo_p.image_width, depth, frames);
+
+#ifdef RUNTIME_OPTIONS_COMPILED_OUT
+  // The setters are kept, but the code of the options is not compiled.
+  Locate locate(p.glo_p, p.loc_p, p.cam_p);
+  Track2D track(p.det_p, p.kal_p, p.tra_p, p.bbo_p);
+  run(locate, track, depth, frames); // Warm-up
+  const double baseline = run(locate, track, depth, frames);
+  printf("[INFO  ] options compiled out: %.2f us per frame\n", baseline);
+  return 0;
+#else
+  // Disabled: the default of the nodes.
+  Locate locate_off(p.glo_p, p.loc_p, p.cam_p);
+  Track2D track_off(p.det_p, p.kal_p, p.tra_p, p.bbo_p);
+  locate_off.setLocalizationProfiling(false, false);
+  track_off.setTrackingProfiling(false);
+  run(locate_off, track_off, depth, frames); // Warm-up
+  const double disabled = run(locate_off, track_off, depth, frames);
+
+  // Enabled, the prints are discarded.
+  Locate locate_on(p.glo_p, p.loc_p, p.cam_p);
+  Track2D track_on(p.det_p, p.kal_p, p.tra_p, p.bbo_p);
+  locate_on.setLocalizationProfiling(true, true);
+  track_on.setTrackingProfiling(true);
+  fflush(stdout);
+  const int saved_stdout = dup(STDOUT_FILENO);
+  const int null_fd = open("/dev/null", O_WRONLY);
+  dup2(null_fd, STDOUT_FILENO);
+  run(locate_on, track_on, depth, frames); // Warm-up
+  const double enabled = run(locate_on, track_on, depth, frames);
+  fflush(stdout);
+  dup2(saved_stdout, STDOUT_FILENO);
+  close(null_fd);
+  close(saved_stdout);
+
+  double baseline;
+  const bool has_baseline = runBaseline(argv[0], num_frames, num_objects, baseline);
+  printf("[INFO  ] %d frames, %d objects per frame\n", num_frames, num_objects);
+  if (has_baseline) {
+    printf("[INFO  ] options compiled out (baseline):       %.2f us per frame\n", baseline);
+    printf("[INFO  ] profiling and debug prints disabled: %.2f us per frame (%+.1f%%)\n", disabled, (disabled / baseline - 1.0) * 100);
+    printf("[INFO  ] profiling and debug prints enabled:  %.2f us per frame (%+.1f%%)\n", enabled, (enabled / baseline - 1.0) * 100);
+  } else {
+    printf("[WARN  ] options_benchmark::%s::l%d options_benchmark_baseline could not be run, the baseline is not measured.\n", __func__, __LINE__);
+    printf("[INFO  ] profiling and debug prints disabled: %.2f us per frame\n", disabled);
+    printf("[INFO  ] profiling and debug prints enabled:  %.2f us per frame (%+.1f%%)\n", enabled, (enabled / disabled - 1.0) * 100);
+  }
+  return 0;
+#endif
+}
@@ -0,0 +1,10 @@
+#include <detect_and_track/ROSWrappers.h>
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "pipeline");
+  ROSPipelineGraph rpg;
+  rpg.start();
+  ros::spin();
+  return 0;
+}
@@ -0,0 +1,321 @@
+/**
+ * @file replay.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The replay of the recordings of the nodes.
+ * @details Feeds the detections recorded by a node (see RecordWriter) through the localization and the tracking,
+ * like the stages of the node did, without camera, GPU, nor ROS master. The recording is replayed several times,
+ * each time with new trackers: the outputs of each frame are hashed, and the runs must give bit-identical outputs.
+ * The frames are replayed as fast as possible, or at a multiple of the recorded speed. The throughput of each run,
+ * and the latency percentiles of the processing of a frame, are printed. The recorded parameters can be overridden,
+ * for instance to compare tracker settings on the same traffic.
+ * Usage: replay <recording> [speed=0] [runs=2] [key=value ...]
+ * where speed is the playback rate (0, the default, replays as fast as possible, 1 at the recorded speed), and the
+ * other keys override the recorded parameters of the node, with the same names.
+ */
+
+#include <detect_and_track/Recorder.h>
+#include <detect_and_track/Instrumentation.h>
+#include <sstream>
+#include <string>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * @brief The stages of the recorded node.
+ *
+ */
+enum ReplayMode {
+  REPLAY_UNSUPPORTED = 0,
+  REPLAY_LOCATE = 1, // detect_and_locate: locate.
+  REPLAY_TRACK2D = 2, // detect_and_track2D: track.
+  REPLAY_TRACK2D_LOCATE = 3, // detect_track2D_and_locate: track -> locate the tracks.
+  REPLAY_TRACK3D = 4 // detect_and_track3D: locate -> project -> track.
+};
+
+/**
+ * @brief Returns the stages of a recorded node.
+ *
+ */
+static ReplayMode getReplayMode(const std::string& mode) {
+  if (mode == "locate") {
+    return REPLAY_LOCATE;
+  } else if (mode == "track2D") {
+    return REPLAY_TRACK2D;
+  } else if (mode == "track2D_locate") {
+    return REPLAY_TRACK2D_LOCATE;
+  } else if (mode == "track3D") {
+    return REPLAY_TRACK3D;
+  }
+  return REPLAY_UNSUPPORTED;
+}
+
+/**
+ * @brief Runs the localization and the tracking of a recorded node.
+ * @details Built from the recorded parameters, with the defaults of the nodes. The trackers are never checkpointed.
+ *
+ */
+class ReplayNode : public Locate, public Track2D, public Track3D {
+  private:
+    ReplayMode mode_;
+
+  public:
+    ReplayNode(const ParameterMap&);
+    bool process(PipelineFrame&, const RigidTransform&, const bool&);
+};
+
+/**
+ * @brief Prefered constructor.
+ * @details Builds the position estimator and the trackers of the recorded node.
+ *
+ * @param parameters The reference to the recorded parameters, with the overrides.
+ */
+ReplayNode::ReplayNode(const ParameterMap& parameters) {
+  mode_ = getReplayMode(getString(parameters, "mode", ""));
+  if (mode_ == REPLAY_UNSUPPORTED) {
+    return;
+  }
+
+  if (mode_ != REPLAY_TRACK2D) {
+    GlobalParameters glo_p;
+    LocalizationParameters loc_p;
+    CameraParameters cam_p;
+    getLocalizationParameters(parameters, glo_p, loc_p, cam_p);
+    buildLocate(glo_p, loc_p, cam_p);
+  }
+  if (mode_ == REPLAY_LOCATE) {
+    return;
+  }
+
+  DetectionParameters det_p;
+  KalmanParameters kal_p;
+  TrackingParameters tra_p;
+  BBoxRejectionParameters bbo_p;
+  getTrackingParameters(parameters, mode_ == REPLAY_TRACK3D, det_p, kal_p, tra_p, bbo_p);
+  // A restored checkpoint would make the runs differ.
+  tra_p.checkpoint_path = "";
+  if (mode_ == REPLAY_TRACK3D) {
+    buildTrack3D(det_p, kal_p, tra_p, bbo_p);
+  } else {
+    buildTrack2D(det_p, kal_p, tra_p, bbo_p);
+  }
+}
+
+/**
+ * @brief Processes a frame, like the stages of the recorded node.
+ *
+ * @param frame The reference to the frame.
+ * @param pose The reference to the recorded pose of the camera in the global frame.
+ * @param has_pose The reference to the flag set if the pose was recorded.
+ * @return False if the frame was skipped.
+ */
+bool ReplayNode::process(PipelineFrame& frame, const RigidTransform& pose, const bool& has_pose) {
+  switch (mode_) {
+    case REPLAY_LOCATE:
+      return locateFrame(frame);
+    case REPLAY_TRACK2D:
+      return Track2D::trackFrame(frame);
+    case REPLAY_TRACK2D_LOCATE:
+      Track2D::trackFrame(frame);
+      return locateTracksFrame(frame);
+    case REPLAY_TRACK3D:
+      if (!has_pose || !locateFrame(frame)) {
+        return false;
+      }
+      transformPoints(pose, frame.points);
+      make3DBoundingBoxes(frame.points, frame.bboxes, frame.bboxes3D);
+      if (use_frustum_) {
+        setCameraIntrinsics(PE_->getFx(), PE_->getFy(), PE_->getCx(), PE_->getCy(), PE_->getImageWidth(), PE_->getImageHeight());
+        Eigen::Quaternionf rotation(pose.rotation);
+        std::vector<float> position {pose.translation.x(), pose.translation.y(), pose.translation.z()};
+        std::vector<float> orientation {rotation.x(), rotation.y(), rotation.z(), rotation.w()};
+        setCameraPose(position, orientation);
+      }
+      return Track3D::trackFrame(frame);
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Adds bytes to a FNV-1a hash.
+ *
+ */
+static void hashBytes(uint64_t& hash, const void* data, const size_t& size) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+}
+
+/**
+ * @brief Hashes the outputs of a frame: the distances and positions of the objects, and the states of the tracks.
+ *
+ */
+static uint64_t hashOutputs(const PipelineFrame& frame, const bool& processed) {
+  uint64_t hash = 14695981039346656037ULL;
+  hashBytes(hash, &processed, sizeof(processed));
+  for (unsigned int i = 0; i < frame.distances.size(); i++) {
+    hashBytes(hash, frame.distances[i].data(), frame.distances[i].size() * sizeof(float));
+  }
+  for (unsigned int i = 0; i < frame.points.size(); i++) {
+    for (unsigned int j = 0; j < frame.points[i].size(); j++) {
+      hashBytes(hash, frame.points[i][j].data(), frame.points[i][j].size() * sizeof(float));
+    }
+  }
+  for (unsigned int i = 0; i < frame.tracker_states.size(); i++) {
+    for (auto & element : frame.tracker_states[i]) {
+      hashBytes(hash, &element.first, sizeof(element.first));
+      hashBytes(hash, element.second.data(), element.second.size() * sizeof(float));
+    }
+  }
+  for (unsigned int i = 0; i < frame.track_distances.size(); i++) {
+    for (auto & element : frame.track_distances[i]) {
+      hashBytes(hash, &element.first, sizeof(element.first));
+      hashBytes(hash, &element.second, sizeof(element.second));
+    }
+  }
+  for (unsigned int i = 0; i < frame.track_points.size(); i++) {
+    for (auto & element : frame.track_points[i]) {
+      hashBytes(hash, &element.first, sizeof(element.first));
+      hashBytes(hash, element.second.data(), element.second.size() * sizeof(float));
+    }
+  }
+  return hash;
+}
+
+/**
+ * @brief Replays a recording once.
+ *
+ * @param reader The reference to the recording.
+ * @param parameters The reference to the parameters of the node.
+ * @param speed The reference to the playback rate, 0 to replay as fast as possible.
+ * @param run The reference to the index of the run, for the prints.
+ * @param hashes The reference to the vector in which the hash of the outputs of each frame will be stored.
+ */
+static void replay(RecordReader& reader, const ParameterMap& parameters, const float& speed, const int& run,
+                   std::vector<uint64_t>& hashes) {
+  ReplayNode node(parameters);
+  LatencyHistogram histogram("process");
+  RecordEntry entry;
+  RigidTransform pose;
+  bool has_pose;
+  std::vector<float> camera_parameters;
+  std::vector<float> lens_parameters;
+  cv::Mat depth;
+  unsigned int num_skipped = 0;
+  int64_t first_stamp = -1;
+  hashes.clear();
+  reader.rewind();
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  while (reader.next(entry)) {
+    if (RecordReader::readCameraInfo(entry, camera_parameters, lens_parameters)) {
+      node.updateCameraInfo(camera_parameters, lens_parameters);
+      continue;
+    }
+    PipelineFrame frame;
+    // The depth image of the previous frame is reused.
+    frame.depth = depth;
+    if (!RecordReader::readFrame(entry, frame, pose, has_pose)) {
+      continue;
+    }
+    depth = frame.depth;
+    if (first_stamp < 0) {
+      first_stamp = frame.stamps.stamp;
+    }
+    if (speed > 0) {
+      std::this_thread::sleep_until(start + std::chrono::nanoseconds((int64_t) ((frame.stamps.stamp - first_stamp) / speed)));
+    }
+    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    const bool processed = node.process(frame, pose, has_pose);
+    histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+    if (!processed) {
+      num_skipped ++;
+    }
+    hashes.push_back(hashOutputs(frame, processed));
+  }
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  LatencySummary summary;
+  histogram.collect(summary);
+  printf("[INFO  ] run %d: %lu frames (%u skipped) in %.3f s, %.1f frames/s, processing p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+         run, hashes.size(), num_skipped, elapsed, hashes.size() / std::max(elapsed, 1e-9), summary.p50, summary.p99, summary.max);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("Usage: replay <recording> [speed=0] [runs=2] [key=value ...]\n");
+    return 2;
+  }
+  float speed = 0;
+  int runs = 2;
+  ParameterMap overrides;
+  for (int i = 2; i < argc; i++) {
+    const char* separator = strchr(argv[i], '=');
+    if (separator == nullptr) {
+      printf("[ERROR ] replay::%s::l%d Expected key=value, got %s.\n", __func__, __LINE__, argv[i]);
+      return 2;
+    }
+    const std::string key(argv[i], separator - argv[i]);
+    const std::string value(separator + 1);
+    if (key == "speed") {
+      speed = atof(value.c_str());
+    } else if (key == "runs") {
+      runs = std::max(atoi(value.c_str()), 1);
+    } else {
+      overrides[key] = value;
+    }
+  }
+
+  RecordReader reader;
+  if (!reader.open(argv[1])) {
+    return 2;
+  }
+  ParameterMap parameters;
+  RecordEntry entry;
+  unsigned int num_frames = 0;
+  while (reader.next(entry)) {
+    RecordReader::readParameters(entry, parameters);
+    num_frames += entry.header.type == RECORD_FRAME;
+  }
+  for (auto & element : overrides) {
+    parameters[element.first] = element.second;
+  }
+  if (getReplayMode(getString(parameters, "mode", "")) == REPLAY_UNSUPPORTED) {
+    printf("[ERROR ] replay::%s::l%d Cannot replay the mode \"%s\", expected locate, track2D, track2D_locate, or track3D.\n",
+           __func__, __LINE__, getString(parameters, "mode", "").c_str());
+    return 2;
+  }
+  printf("[INFO  ] %s: mode %s, %u frames\n", argv[1], parameters["mode"].c_str(), num_frames);
+
+  std::vector<uint64_t> reference;
+  std::vector<uint64_t> hashes;
+  bool identical = true;
+  for (int run = 0; run < runs; run++) {
+    replay(reader, parameters, speed, run, run == 0 ? reference : hashes);
+    if (run == 0) {
+      continue;
+    }
+    for (unsigned int f = 0; f < std::max(reference.size(), hashes.size()); f++) {
+      if ((f >= reference.size()) || (f >= hashes.size()) || (hashes[f] != reference[f])) {
+        printf("[ERROR ] replay::%s::l%d Run %d differs from run 0 at frame %u.\n", __func__, __LINE__, run, f);
+        identical = false;
+        break;
+      }
+    }
+  }
+  if (!identical) {
+    return 1;
+  }
+  if (runs > 1) {
+    printf("[INFO  ] The outputs of the %d runs are bit-identical.\n", runs);
+  }
+  return 0;
+}
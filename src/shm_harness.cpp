@@ -0,0 +1,196 @@
+/**
+ * @file shm_harness.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief A harness for the shared-memory ring buffers.
+ * @details Runs a producer and several consumer processes on the same machine. The producer writes synthetic
+ * images and detections as fast as requested, the consumers follow it with the reader library and check
+ * every record they read. Usage: shm_harness [num_consumers] [num_records] [period_us] [slot_count]
+ * The exit code is not 0 if a consumer accepted a corrupted record.
+ */
+
+#include <detect_and_track/SharedMemory.h>
+#include <chrono>
+#include <thread>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define HARNESS_END 0xFFFF
+
+static const char* HarnessName = "/detect_and_track_harness";
+static const int HarnessRows = 120;
+static const int HarnessCols = 160;
+
+/**
+ * @brief Fills a synthetic image, every byte depends on the sequence number.
+ *
+ * @param pixels The pointer to the pixels.
+ * @param size The size of the image, in bytes.
+ * @param sequence The sequence number of the record.
+ */
+static void fillImage(char* pixels, const size_t& size, const uint64_t& sequence) {
+  for (size_t i = 0; i < size; i++) {
+    pixels[i] = (char) ((sequence * 31 + i) & 0xFF);
+  }
+}
+
+/**
+ * @brief Checks a synthetic image.
+ *
+ * @param pixels The pointer to the pixels.
+ * @param size The size of the image, in bytes.
+ * @param sequence The sequence number of the record.
+ * @return True if the image is the one written by the producer.
+ */
+static bool checkImage(const char* pixels, const size_t& size, const uint64_t& sequence) {
+  for (size_t i = 0; i < size; i++) {
+    if (pixels[i] != (char) ((sequence * 31 + i) & 0xFF)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief The producer: writes num_records images, each followed by its detections, and an end record.
+ *
+ */
+static void produce(SharedMemoryWriter& writer, const uint64_t& num_records, const int& period_us) {
+  const int step = HarnessCols * 3;
+  const uint32_t image_size = sizeof(SharedImageHeader) + HarnessRows * step;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < num_records; i++) {
+    const int64_t stamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    // Image
+    char* data = writer.beginWrite(image_size);
+    SharedImageHeader header{HarnessRows, HarnessCols, 16, step}; // 16 is CV_8UC3.
+    memcpy(data, &header, sizeof(SharedImageHeader));
+    fillImage(data + sizeof(SharedImageHeader), HarnessRows * step, i);
+    writer.commitWrite(SHARED_MEMORY_IMAGE, stamp);
+    // Detections, as many as the index modulo 8, each one carries the index.
+    const uint64_t count = i % 8;
+    data = writer.beginWrite(sizeof(uint64_t) + count * sizeof(SharedDetection));
+    memcpy(data, &count, sizeof(uint64_t));
+    for (uint64_t j = 0; j < count; j++) {
+      SharedDetection detection{(uint32_t) j, (float) i, 0, 10, 10, 0.5};
+      memcpy(data + sizeof(uint64_t) + j * sizeof(SharedDetection), &detection, sizeof(SharedDetection));
+    }
+    writer.commitWrite(SHARED_MEMORY_DETECTIONS, stamp);
+    if (period_us > 0) {
+      std::this_thread::sleep_until(start + std::chrono::microseconds(period_us * (i + 1)));
+    }
+  }
+  writer.beginWrite(0);
+  writer.commitWrite(HARNESS_END, 0);
+}
+
+/**
+ * @brief A consumer: follows the producer, and checks every record it manages to read.
+ *
+ * @return The number of corrupted records that were accepted.
+ */
+static int consume(const int& id) {
+  SharedMemoryReader reader;
+  while (!reader.open(HarnessName)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  uint64_t next = 0;
+  uint64_t images = 0;
+  uint64_t detections = 0;
+  uint64_t lost = 0;
+  uint64_t torn = 0;
+  uint64_t corrupted = 0;
+  double latency = 0;
+  SharedMemoryView view;
+  while (true) {
+    const uint64_t sequence = reader.getSequence();
+    if (next >= sequence) {
+      std::this_thread::yield();
+      continue;
+    }
+    // Skip the records that were overwritten.
+    if (sequence - next > reader.getSlotCount()) {
+      lost += sequence - reader.getSlotCount() - next;
+      next = sequence - reader.getSlotCount();
+    }
+    if (!reader.read(next, view)) {
+      lost ++;
+      next ++;
+      continue;
+    }
+    if (view.type == HARNESS_END) {
+      break;
+    }
+    bool ok = true;
+    if (view.type == SHARED_MEMORY_IMAGE) {
+      SharedImageHeader header;
+      const char* pixels;
+      ok = SharedMemoryReader::parseImage(view, header, pixels) && checkImage(pixels, header.rows * header.step, next / 2);
+      images ++;
+      const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+      latency += (now - view.stamp) * 1e-3;
+    } else if (view.type == SHARED_MEMORY_DETECTIONS) {
+      uint64_t count;
+      const SharedDetection* boxes;
+      ok = SharedMemoryReader::parseDetections(view, count, boxes) && (count == (next / 2) % 8);
+      for (uint64_t j = 0; ok && (j < count); j++) {
+        ok = (boxes[j].class_id == j) && (boxes[j].x_min == (float) (next / 2));
+      }
+      detections ++;
+    }
+    // The data is only trusted if the record was not overwritten while it was checked.
+    if (!reader.isValid(view)) {
+      torn ++;
+    } else if (!ok) {
+      corrupted ++;
+    }
+    next ++;
+  }
+  printf("[INFO  ] consumer %d: %lu images, %lu detections, %lu lost, %lu overwritten while read, %lu corrupted, mean latency %.1f us\n",
+         id, images, detections, lost, torn, corrupted, images > 0 ? latency / images : 0.0);
+  return corrupted > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  const int num_consumers = argc > 1 ? atoi(argv[1]) : 2;
+  const uint64_t num_records = argc > 2 ? strtoull(argv[2], nullptr, 10) : 10000;
+  const int period_us = argc > 3 ? atoi(argv[3]) : 100;
+  const uint32_t slot_count = argc > 4 ? atoi(argv[4]) : 16;
+
+  SharedMemoryWriter writer;
+  if (!writer.create(HarnessName, slot_count, sizeof(SharedImageHeader) + HarnessRows * HarnessCols * 3)) {
+    return 1;
+  }
+  std::vector<pid_t> consumers;
+  for (int i = 0; i < num_consumers; i++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      exit(consume(i));
+    }
+    consumers.push_back(pid);
+  }
+  // Give the consumers some time to map the ring.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto start = std::chrono::steady_clock::now();
+  produce(writer, num_records, period_us);
+  const float duration = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+  printf("[INFO  ] producer: %lu images and detections written in %.3f s\n", num_records, duration);
+
+  int failures = 0;
+  for (unsigned int i = 0; i < consumers.size(); i++) {
+    int status;
+    waitpid(consumers[i], &status, 0);
+    if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+      failures ++;
+    }
+  }
+  if (failures > 0) {
+    printf("[ERROR ] %d consumers accepted corrupted records.\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -4,6 +4,7 @@ int main(int argc, char** argv)
 {
   ros::init(argc, argv, "drone_detector");
   ROSTrack2D rt2d;
+  rt2d.start();
   ros::spin();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,484 @@
+/**
+ * @file tracker_scaling.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief A benchmark of the scaling of the trackers with the number of objects.
+ * @details Drives Tracker2D, Tracker3D, and Tracker3DF with synthetic scenarios (see ScenarioGenerator) of a growing
+ * number of objects, with missed detections, false detections, and crossing trajectories. The density of the objects
+ * is kept constant: the square (or cube) they move in grows with their number. For each tracker and number of objects,
+ * the latency percentiles of BaseTracker::update, the allocations it makes, the resident memory of the process, and
+ * basic association metrics are printed, with the time taken to collect the changes of each update (the delta) and to
+ * publish all the tracks (the snapshot):
+ *  - recall: the fraction of the objects matched with a track.
+ *  - id switches: the number of times the track matched with an object changed, per 100 objects per 100 frames.
+ *  - false tracks: the fraction of the tracks not matched with any object.
+ * The objects and the tracks are matched one-to-one in each frame, by minimizing the total distance in between them,
+ * and only within the matching distance (the center threshold).
+ * Each run stops once the updates took more than a time budget, the larger numbers of objects are then skipped.
+ * Usage: tracker_scaling [trackers=2D,3D,3DF] [objects=10,100,1000,10000] [frames=300] [seconds=20] [miss=0.1]
+ *                        [clutter=0.02] [crossing=0.2] [seed=0] [csv=path]
+ */
+
+#include <detect_and_track/Tracker.h>
+#include <detect_and_track/Scenario.h>
+#include <detect_and_track/Instrumentation.h>
+#include <detect_and_track/Hungarian.h>
+#include <unordered_map>
+#include <sstream>
+#include <string>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief The results of a run.
+ *
+ */
+typedef struct ScalingResult{
+  std::string tracker;
+  unsigned int num_objects;
+  unsigned int num_frames; // The number of frames run, lower than requested if the time budget was exceeded.
+  LatencySummary latency;
+  double tracks; // The mean number of tracks.
+  double allocations; // Per update.
+  double bytes; // Per update.
+  double delta_us; // The mean time to collect the delta of an update.
+  double snapshot_us; // The mean time to collect and publish all the tracks.
+  double resident; // In MB, at the end of the run.
+  double recall;
+  double id_switches; // Per 100 objects per 100 frames.
+  double false_tracks;
+  bool truncated;
+} ScalingResult;
+
+/**
+ * @brief The options of the benchmark, given as key=value arguments.
+ *
+ */
+typedef struct ScalingOptions{
+  std::vector<std::string> trackers;
+  std::vector<unsigned int> objects;
+  unsigned int frames;
+  double seconds;
+  float miss;
+  float clutter;
+  float crossing;
+  unsigned int seed;
+  std::string csv;
+} ScalingOptions;
+
+/**
+ * @brief Splits a comma separated list.
+ *
+ */
+static std::vector<std::string> split(const std::string& list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+/**
+ * @brief Returns the resident memory of the process.
+ *
+ * @return The resident memory, in MB.
+ */
+static double getResidentMemory() {
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  long pages = 0;
+  long resident = 0;
+  if (fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(file);
+  return (double) resident * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+/**
+ * @brief Sets up the scenario of a tracker. The 2D scenarios are in pixels, and the 3D ones in meters.
+ *
+ */
+static ScenarioParameters makeScenario(const std::string& tracker, const unsigned int& num_objects, const ScalingOptions& options) {
+  ScenarioParameters p;
+  p.num_objects = num_objects;
+  p.three_dimensional = tracker != "2D";
+  p.static_objects = tracker == "3DF";
+  p.dt = 0.033;
+  if (p.three_dimensional) {
+    // One object per 8 cubic meters.
+    p.extent = 2.0 * cbrtf(num_objects);
+    p.speed = 1.0;
+    p.size = 0.5;
+    p.position_noise = 0.05;
+    p.size_noise = 0.02;
+  } else {
+    // One object per 100x100 pixels.
+    p.extent = 100.0 * sqrtf(num_objects);
+    p.speed = 90.0;
+    p.size = 40.0;
+    p.position_noise = 2.0;
+    p.size_noise = 2.0;
+  }
+  p.detection_probability = 1.0 - options.miss;
+  p.clutter_rate = options.clutter;
+  p.crossing_ratio = options.crossing;
+  p.crossing_frames = options.frames;
+  p.seed = options.seed;
+  return p;
+}
+
+/**
+ * @brief Returns the root of a node in a union-find forest, and compresses its path.
+ *
+ */
+static unsigned int findRoot(std::vector<unsigned int>& parents, unsigned int node) {
+  while (parents[node] != node) {
+    parents[node] = parents[parents[node]];
+    node = parents[node];
+  }
+  return node;
+}
+
+/**
+ * @brief Matches the objects with the tracks, one-to-one.
+ * @details The pairs of an object and a track within the matching distance form a bipartite graph. The assignment
+ * minimizing the total distance is computed with the Hungarian algorithm on each connected component of that graph,
+ * which are small as long as the objects are not all within the matching distance of each other.
+ *
+ * @param truth The reference to the true states of the objects.
+ * @param tracks The reference to the states of the tracks.
+ * @param grid The reference to a grid holding the positions of the tracks, with cells of the matching distance.
+ * @param matching_distance The distance under which a track can be matched with an object.
+ * @param planar If true, the z coordinate is ignored.
+ * @param matches The reference to the vector in which the track of each object will be stored, -1 if unmatched.
+ */
+static void matchTracks(const std::vector<std::vector<float>>& truth, const std::map<unsigned int, std::vector<float>>& tracks,
+                        const VoxelGrid& grid, const float& matching_distance, const bool& planar, std::vector<int>& matches) {
+  typedef struct Pair{
+    unsigned int object;
+    unsigned int track; // The index of the track in track_ids.
+    double distance;
+  } Pair;
+  std::vector<Pair> pairs;
+  std::vector<unsigned int> track_ids;
+  std::unordered_map<unsigned int, unsigned int> track_indices;
+  std::vector<unsigned int> candidates;
+  for (unsigned int i = 0; i < truth.size(); i++) {
+    const float z = planar ? 0 : truth[i][2];
+    candidates.clear();
+    grid.query(truth[i][0], truth[i][1], z, matching_distance, candidates);
+    for (unsigned int j = 0; j < candidates.size(); j++) {
+      const std::vector<float>& state = tracks.at(candidates[j]);
+      const float dx = state[0] - truth[i][0];
+      const float dy = state[1] - truth[i][1];
+      const float dz = planar ? 0 : state[2] - z;
+      const float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+      if (distance >= matching_distance) {
+        continue;
+      }
+      auto index = track_indices.find(candidates[j]);
+      if (index == track_indices.end()) {
+        index = track_indices.insert(std::make_pair(candidates[j], (unsigned int) track_ids.size())).first;
+        track_ids.push_back(candidates[j]);
+      }
+      pairs.push_back({i, index->second, distance});
+    }
+  }
+
+  // The objects are the nodes [0, truth.size()), the tracks the nodes after them.
+  const unsigned int num_objects = truth.size();
+  std::vector<unsigned int> parents(num_objects + track_ids.size());
+  for (unsigned int n = 0; n < parents.size(); n++) {
+    parents[n] = n;
+  }
+  for (const Pair& pair : pairs) {
+    parents[findRoot(parents, pair.object)] = findRoot(parents, num_objects + pair.track);
+  }
+  std::unordered_map<unsigned int, std::vector<unsigned int>> components; // The pairs of each component.
+  for (unsigned int p = 0; p < pairs.size(); p++) {
+    components[findRoot(parents, pairs[p].object)].push_back(p);
+  }
+
+  matches.assign(truth.size(), -1);
+  HungarianAlgorithm hungarian;
+  std::vector<unsigned int> rows;
+  std::vector<unsigned int> columns;
+  std::unordered_map<unsigned int, unsigned int> row_indices;
+  std::unordered_map<unsigned int, unsigned int> column_indices;
+  std::vector<std::vector<double>> cost;
+  std::vector<int> assignments;
+  for (auto & component : components) {
+    const std::vector<unsigned int>& members = component.second;
+    if (members.size() == 1) {
+      matches[pairs[members[0]].object] = track_ids[pairs[members[0]].track];
+      continue;
+    }
+    rows.clear();
+    columns.clear();
+    row_indices.clear();
+    column_indices.clear();
+    for (const unsigned int& p : members) {
+      if (row_indices.insert(std::make_pair(pairs[p].object, (unsigned int) rows.size())).second) {
+        rows.push_back(pairs[p].object);
+      }
+      if (column_indices.insert(std::make_pair(pairs[p].track, (unsigned int) columns.size())).second) {
+        columns.push_back(pairs[p].track);
+      }
+    }
+    // The pairs beyond the matching distance are given a prohibitive cost, and rejected after the assignment.
+    const double prohibitive = 1e6;
+    cost.assign(rows.size(), std::vector<double>(columns.size(), prohibitive));
+    for (const unsigned int& p : members) {
+      cost[row_indices[pairs[p].object]][column_indices[pairs[p].track]] = pairs[p].distance;
+    }
+    hungarian.Solve(cost, assignments);
+    for (unsigned int r = 0; r < assignments.size(); r++) {
+      if ((assignments[r] >= 0) && (cost[r][assignments[r]] < prohibitive)) {
+        matches[rows[r]] = track_ids[columns[assignments[r]]];
+      }
+    }
+  }
+}
+
+/**
+ * @brief Runs a scenario through a tracker, and measures it.
+ *
+ * @param matching_distance The distance under which a track can be the track of an object.
+ */
+static void run(BaseTracker& tracker, ScenarioGenerator& scenario, const float& dt, const float& matching_distance,
+                const ScalingOptions& options, ScalingResult& result) {
+  // The metrics are not counted during the first frames, while the tracks are created.
+  const unsigned int warmup_frames = 10;
+  const unsigned int scope = AllocationAccounting::getScope("tracker");
+  std::unique_ptr<LatencyHistogram> histogram(new LatencyHistogram("update"));
+  std::vector<AllocationStatistics> statistics;
+  AllocationAccounting::collect(statistics);
+
+  ScenarioFrame frame;
+  std::map<unsigned int, std::vector<float>> tracks;
+  TrackDelta delta;
+  VoxelGrid grid(matching_distance);
+  std::vector<int> matches;
+  std::vector<int> previous_match;
+  uint64_t elapsed = 0;
+  uint64_t delta_elapsed = 0;
+  uint64_t snapshot_elapsed = 0;
+  uint64_t num_tracks = 0;
+  uint64_t num_truths = 0;
+  uint64_t num_matches = 0;
+  uint64_t num_switches = 0;
+  uint64_t num_evaluated_tracks = 0;
+  uint64_t num_false_tracks = 0;
+
+  result.num_frames = 0;
+  result.truncated = false;
+  for (unsigned int f = 0; f < options.frames; f++) {
+    scenario.next(frame);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+      AllocationScope allocation_scope(scope);
+      tracker.update(dt, frame.detections);
+    }
+    const uint64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    histogram->record(duration);
+    elapsed += duration;
+    result.num_frames ++;
+
+    std::chrono::steady_clock::time_point step = std::chrono::steady_clock::now();
+    tracker.getDelta(delta);
+    delta_elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - step).count();
+    step = std::chrono::steady_clock::now();
+    tracks.clear();
+    tracker.getStates(tracks);
+    tracker.publishSnapshot(tracks);
+    snapshot_elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - step).count();
+    num_tracks += tracks.size();
+    if (f >= warmup_frames) {
+      // Each object is matched with at most one track, and each track with at most one object.
+      grid.clear();
+      for (auto & track : tracks) {
+        grid.insert(track.first, track.second[0], track.second[1], result.tracker == "2D" ? 0 : track.second[2]);
+      }
+      matchTracks(frame.truth, tracks, grid, matching_distance, result.tracker == "2D", matches);
+      previous_match.resize(frame.truth.size(), -1);
+      unsigned int num_frame_matches = 0;
+      for (unsigned int i = 0; i < matches.size(); i++) {
+        num_truths ++;
+        if (matches[i] == -1) {
+          continue;
+        }
+        num_frame_matches ++;
+        if ((previous_match[i] != -1) && (previous_match[i] != matches[i])) {
+          num_switches ++;
+        }
+        previous_match[i] = matches[i];
+      }
+      num_matches += num_frame_matches;
+      num_evaluated_tracks += tracks.size();
+      num_false_tracks += tracks.size() - num_frame_matches;
+    }
+    if (elapsed > options.seconds * 1e9) {
+      result.truncated = result.num_frames < options.frames;
+      break;
+    }
+  }
+
+  histogram->collect(result.latency);
+  AllocationAccounting::collect(statistics);
+  result.allocations = 0;
+  result.bytes = 0;
+  for (unsigned int i = 0; i < statistics.size(); i++) {
+    if (statistics[i].name == "tracker") {
+      result.allocations = (double) statistics[i].count / result.num_frames;
+      result.bytes = (double) statistics[i].bytes / result.num_frames;
+    }
+  }
+  result.delta_us = 1e-3 * delta_elapsed / result.num_frames;
+  result.snapshot_us = 1e-3 * snapshot_elapsed / result.num_frames;
+  result.resident = getResidentMemory();
+  result.tracks = (double) num_tracks / result.num_frames;
+  result.recall = num_truths > 0 ? (double) num_matches / num_truths : 0;
+  const uint64_t evaluated_frames = result.num_frames > warmup_frames ? result.num_frames - warmup_frames : 0;
+  result.id_switches = evaluated_frames > 0 ? 1e4 * num_switches / ((double) evaluated_frames * result.num_objects) : 0;
+  result.false_tracks = num_evaluated_tracks > 0 ? (double) num_false_tracks / num_evaluated_tracks : 0;
+}
+
+/**
+ * @brief Builds a tracker with the parameters of the nodes, runs a scenario through it, and destroys it.
+ *
+ * @return False if the tracker is unknown.
+ */
+static bool runTracker(const std::string& name, const unsigned int& num_objects, const ScalingOptions& options, ScalingResult& result) {
+  result.tracker = name;
+  result.num_objects = num_objects;
+  const ScenarioParameters p = makeScenario(name, num_objects, options);
+  ScenarioGenerator scenario(p);
+  if (name == "2D") {
+    const std::vector<float> Q {9.0, 9.0, 200.0, 200.0, 5.0, 5.0};
+    const std::vector<float> R {2.0, 2.0, 200.0, 200.0, 2.0, 2.0};
+    Tracker2D tracker(10, 150.0, 80.0, 2.0, 0.5, p.dt, true, false, Q, R);
+    run(tracker, scenario, p.dt, 80.0, options, result);
+    tracker.clear();
+    return true;
+  }
+  const std::vector<float> Q {0.25, 0.25, 0.25, 25.0, 25.0, 25.0, 0.25, 0.25, 0.25};
+  const std::vector<float> R {0.125, 0.125, 0.125, 25.0, 25.0, 25.0, 0.125, 0.125, 0.125};
+  if (name == "3D") {
+    Tracker3D tracker(10, 1.0, 0.5, 2.0, 0.5, p.dt, true, false, Q, R);
+    run(tracker, scenario, p.dt, 0.5, options, result);
+    tracker.clear();
+    return true;
+  }
+  if (name == "3DF") {
+    Tracker3DF tracker(10, 1.0, 0.5, 2.0, 0.5, p.dt, true, false, Q, R, 1.0);
+    run(tracker, scenario, p.dt, 0.5, options, result);
+    tracker.clear();
+    return true;
+  }
+  return false;
+}
+
+int main(int argc, char** argv) {
+  ScalingOptions options;
+  options.trackers = {"2D", "3D", "3DF"};
+  options.objects = {10, 100, 1000, 10000};
+  options.frames = 300;
+  options.seconds = 20.0;
+  options.miss = 0.1;
+  options.clutter = 0.02;
+  options.crossing = 0.2;
+  options.seed = 0;
+  for (int i = 1; i < argc; i++) {
+    const char* separator = strchr(argv[i], '=');
+    if (separator == nullptr) {
+      printf("[ERROR ] tracker_scaling::%s::l%d Expected key=value, got %s.\n", __func__, __LINE__, argv[i]);
+      return 2;
+    }
+    const std::string key(argv[i], separator - argv[i]);
+    const std::string value(separator + 1);
+    if (key == "trackers") {
+      options.trackers = split(value);
+    } else if (key == "objects") {
+      options.objects.clear();
+      for (const std::string& count : split(value)) {
+        options.objects.push_back(atoi(count.c_str()));
+      }
+    } else if (key == "frames") {
+      options.frames = atoi(value.c_str());
+    } else if (key == "seconds") {
+      options.seconds = atof(value.c_str());
+    } else if (key == "miss") {
+      options.miss = atof(value.c_str());
+    } else if (key == "clutter") {
+      options.clutter = atof(value.c_str());
+    } else if (key == "crossing") {
+      options.crossing = atof(value.c_str());
+    } else if (key == "seed") {
+      options.seed = atoi(value.c_str());
+    } else if (key == "csv") {
+      options.csv = value;
+    } else {
+      printf("[ERROR ] tracker_scaling::%s::l%d Unknown option %s.\n", __func__, __LINE__, key.c_str());
+      return 2;
+    }
+  }
+  if (!AllocationAccounting::isHooked()) {
+    printf("[WARN  ] tracker_scaling::%s::l%d The allocation hooks are not linked, the allocations are not counted.\n", __func__, __LINE__);
+  }
+
+  FILE* csv = nullptr;
+  if (!options.csv.empty()) {
+    csv = fopen(options.csv.c_str(), "w");
+    if (csv == nullptr) {
+      printf("[ERROR ] tracker_scaling::%s::l%d Could not open %s.\n", __func__, __LINE__, options.csv.c_str());
+      return 2;
+    }
+    fprintf(csv, "tracker,objects,frames,p50_ms,p90_ms,p99_ms,max_ms,mean_ms,tracks,allocations,bytes,delta_us,snapshot_us,resident_mb,recall,id_switches,false_tracks,truncated\n");
+  }
+
+  printf("[INFO  ] %d frames, %.0f%% missed detections, %.0f%% false detections, %.0f%% crossing objects, seed %d\n",
+         options.frames, 100 * options.miss, 100 * options.clutter, 100 * options.crossing, options.seed);
+  printf("[INFO  ] tracker  objects frames   p50 ms   p90 ms   p99 ms   max ms   tracks  allocs/f  delta us  snap. us  resident MB  recall  id sw.  false tr.\n");
+  for (const std::string& name : options.trackers) {
+    bool skip = false;
+    for (const unsigned int& num_objects : options.objects) {
+      if (skip) {
+        printf("[INFO  ] %-8s %7u skipped, the previous run exceeded the time budget\n", name.c_str(), num_objects);
+        continue;
+      }
+      ScalingResult result;
+      if (!runTracker(name, num_objects, options, result)) {
+        printf("[ERROR ] tracker_scaling::%s::l%d Unknown tracker %s, expected 2D, 3D, or 3DF.\n", __func__, __LINE__, name.c_str());
+        break;
+      }
+      printf("[INFO  ] %-8s %7u %6u %8.3f %8.3f %8.3f %8.3f %8.1f %9.1f %9.1f %9.1f %12.1f %7.3f %7.2f %10.3f%s\n",
+             name.c_str(), num_objects, result.num_frames, result.latency.p50, result.latency.p90, result.latency.p99,
+             result.latency.max, result.tracks, result.allocations, result.delta_us, result.snapshot_us, result.resident,
+             result.recall, result.id_switches, result.false_tracks, result.truncated ? "  (time budget exceeded)" : "");
+      fflush(stdout);
+      if (csv != nullptr) {
+        fprintf(csv, "%s,%u,%u,%.6f,%.6f,%.6f,%.6f,%.6f,%.1f,%.1f,%.1f,%.3f,%.3f,%.1f,%.4f,%.4f,%.4f,%d\n", name.c_str(), num_objects,
+                result.num_frames, result.latency.p50, result.latency.p90, result.latency.p99, result.latency.max,
+                result.latency.mean, result.tracks, result.allocations, result.bytes, result.delta_us, result.snapshot_us, result.resident, result.recall,
+                result.id_switches, result.false_tracks, result.truncated ? 1 : 0);
+      }
+      skip = result.truncated;
+    }
+  }
+  if (csv != nullptr) {
+    fclose(csv);
+  }
+  return 0;
+}
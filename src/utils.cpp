@@ -1,113 +1,240 @@
 #include <detect_and_track/utils.h>
+#include <sstream>
+#include <charconv>
+#include <limits>
+#include <algorithm>
 
 /**
  * @brief Construct a new csv Writer::csv Writer object
+ * @details Writes text.
  * 
- * @param filename 
- * @param separator 
- * @param endline 
- * @param header 
- * @param max_buffer_size 
- */
-csvWriter::csvWriter(std::string&  filename, std::string& separator, std::string& endline, std::vector<std::string>& header, unsigned int& max_buffer_size) : ofs_() {
-    ofs_.exceptions(std::ios::failbit | std::ios::badbit);
+ * @param filename The path to the file, it is truncated.
+ * @param separator The string written after each value.
+ * @param endline The string written after each row.
+ * @param header The names of the columns.
+ * @param max_buffer_size The number of rows per staging buffer.
+ */
+csvWriter::csvWriter(const std::string& filename, const std::string& separator, const std::string& endline,
+                     const std::vector<std::string>& header, const unsigned int& max_buffer_size)
+    : csvWriter(filename, separator, endline, header, max_buffer_size, false) {
+}
+
+/**
+ * @brief Construct a new csv Writer::csv Writer object
+ * 
+ * @param filename The path to the file, it is truncated.
+ * @param separator The string written after each value, in text mode.
+ * @param endline The string written after each row, in text mode.
+ * @param header The names of the columns.
+ * @param max_buffer_size The number of rows per staging buffer.
+ * @param binary Whether the rows are written as floats rather than text.
+ */
+csvWriter::csvWriter(const std::string& filename, const std::string& separator, const std::string& endline,
+                     const std::vector<std::string>& header, const unsigned int& max_buffer_size, const bool& binary)
+    : file_(nullptr), current_(0), dropped_(0), running_(false) {
     separator_ = separator;
     endline_ = endline;
     filename_ = filename;
+    binary_ = binary;
+    num_columns_ = std::max((unsigned int) header.size(), 1u);
+    max_buffer_size_ = std::max(max_buffer_size, 1u);
+    for (unsigned int b = 0; b < 2; b++) {
+        staging_[b].resize((size_t) max_buffer_size_ * num_columns_);
+        staged_rows_[b] = 0;
+        full_[b].store(false);
+    }
     createFile();
+    if (file_ == nullptr) {
+        full_[0].store(true);
+        full_[1].store(true);
+        return;
+    }
     makeHeader(header);
+    running_.store(true);
+    thread_ = std::thread(&csvWriter::run, this);
 }
 
 /**
  * @brief Construct a new csv Writer::csv Writer object
+ * @details The rows added to a default constructed writer are dropped.
  * 
  */
-csvWriter::csvWriter() : ofs_() {
+csvWriter::csvWriter() : file_(nullptr), binary_(false), num_columns_(1), max_buffer_size_(1), current_(0), dropped_(0), running_(false) {
+    staged_rows_[0] = 0;
+    staged_rows_[1] = 0;
+    full_[0].store(true);
+    full_[1].store(true);
 }
 
 /**
  * @brief Destroy the csv Writer::csv Writer object
+ * @details Writes the rows staged so far, and closes the file.
  * 
  */
 csvWriter::~csvWriter() {
+    if (file_ == nullptr) {
+        return;
+    }
     flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_.store(false);
+    }
+    cv_.notify_one();
+    thread_.join();
+    fclose(file_);
+    if (dropped_.load() > 0) {
+        printf("[WARN  ] csvWriter::%s::l%d %lu rows were dropped from %s, the disk could not keep up.\n",
+               __func__, __LINE__, dropped_.load(), filename_.c_str());
+    }
 }
 
 /**
- * @brief 
+ * @brief Writes the names of the columns.
  * 
- * @param header 
+ * @param header The names of the columns.
  */
-void csvWriter::makeHeader(std::vector<std::string> header) {
-    openFile();
-    for (unsigned int row=0; row < header.size(); row ++) {
-        ofs_ << header[row] << separator_;
+void csvWriter::makeHeader(const std::vector<std::string>& header) {
+    if (binary_) {
+        const char magic[8] = "DTCOLS";
+        const uint32_t fields[2] = {num_columns_, 0};
+        fwrite(magic, 1, sizeof(magic), file_);
+        fwrite(fields, sizeof(uint32_t), 2, file_);
+        for (unsigned int column = 0; column < num_columns_; column++) {
+            const std::string name = column < header.size() ? header[column] : std::string();
+            const uint32_t length = name.size();
+            fwrite(&length, sizeof(length), 1, file_);
+            fwrite(name.data(), 1, length, file_);
+        }
+    } else {
+        for (unsigned int column = 0; column < header.size(); column++) {
+            fputs(header[column].c_str(), file_);
+            fputs(separator_.c_str(), file_);
+        }
+        fputs(endline_.c_str(), file_);
     }
-    ofs_ << endline_;
-    closeFile();
+    fflush(file_);
 }
 
 /**
- * @brief 
+ * @brief Opens the file, truncating it. It stays open until the writer is destroyed.
  * 
  */
 void csvWriter::createFile() {
-    ofs_.open(filename_, std::ofstream::out | std::ofstream::trunc); 
-    closeFile();
+    file_ = fopen(filename_.c_str(), binary_ ? "wb" : "w");
+    if (file_ == nullptr) {
+        printf("[ERROR ] csvWriter::%s::l%d Could not open %s, the rows will be dropped.\n", __func__, __LINE__, filename_.c_str());
+    }
 }
 
 /**
- * @brief 
+ * @brief Writes a staging buffer to the file. Called by the writer thread.
+ * @details In text mode, the values are formatted with std::to_chars, in their shortest exact form,
+ * into a single buffer, which is written at once.
  * 
+ * @param buffer The index of the staging buffer.
  */
-void csvWriter::writeToFile() {
-    for (unsigned int line=0; line < buffer_.size(); line ++) {
-        for (unsigned int row=0; row < buffer_[line].size(); row ++) {
-            ofs_ << std::to_string(buffer_[line][row]) << separator_;
+void csvWriter::writeToFile(const unsigned int& buffer) {
+    const size_t num_values = (size_t) staged_rows_[buffer] * num_columns_;
+    const float* values = staging_[buffer].data();
+    if (binary_) {
+        fwrite(values, sizeof(float), num_values, file_);
+    } else {
+        // The longest float is 15 characters, e.g. -1.17549435e-38.
+        text_.resize(num_values * (16 + separator_.size()) + staged_rows_[buffer] * endline_.size());
+        char* cursor = text_.data();
+        char* const end = text_.data() + text_.size();
+        for (size_t value = 0; value < num_values; value++) {
+            cursor = std::to_chars(cursor, end, values[value]).ptr;
+            cursor = std::copy(separator_.begin(), separator_.end(), cursor);
+            if ((value + 1) % num_columns_ == 0) {
+                cursor = std::copy(endline_.begin(), endline_.end(), cursor);
+            }
         }
-        ofs_ << endline_;
+        fwrite(text_.data(), 1, cursor - text_.data(), file_);
     }
-    buffer_.clear();
+    fflush(file_);
 }
 
 /**
- * @brief 
+ * @brief Hands the current staging buffer over to the writer thread, and switches to the other one.
  * 
  */
-void csvWriter::openFile() {
-    ofs_.open(filename_, std::ofstream::out | std::ofstream::app);
+void csvWriter::handOver() {
+    if (staged_rows_[current_] == 0) {
+        return;
+    }
+    full_[current_].store(true, std::memory_order_release);
+    cv_.notify_one();
+    current_ ^= 1;
 }
 
 /**
- * @brief 
+ * @brief The loop of the writer thread.
+ * @details Writes the staging buffers in the order they were handed over. The calling thread does not take the mutex,
+ * a wake-up can be missed: the thread also checks the buffers periodically.
  * 
  */
-void csvWriter::closeFile() {
-    ofs_.close();
+void csvWriter::run() {
+    unsigned int next = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, std::chrono::milliseconds(100), [this, &next]{
+                return full_[next].load(std::memory_order_acquire) || !running_.load();});
+        }
+        while (full_[next].load(std::memory_order_acquire)) {
+            writeToFile(next);
+            staged_rows_[next] = 0;
+            full_[next].store(false, std::memory_order_release);
+            next ^= 1;
+        }
+        if (!running_.load() && !full_[next].load(std::memory_order_acquire)) {
+            break;
+        }
+    }
 }
 
 /**
- * @brief 
+ * @brief Hands the rows staged so far over to the writer thread. Does not wait for them to be written.
  * 
  */
 void csvWriter::flush() {
-    openFile();
-    writeToFile();
-    closeFile();
+    if (!full_[current_].load(std::memory_order_acquire)) {
+        handOver();
+    }
 }
 
 /**
- * @brief 
+ * @brief Stages a row. Never waits: the row is dropped if both staging buffers are waiting to be written.
+ * @details The missing values of a short row are written as NaN, the extra values of a long row are ignored.
  * 
- * @param data 
+ * @param data The values of the row, one per column.
  */
-void csvWriter::addToBuffer(std::vector<float> data) {
-    buffer_.push_back(data);
-    if (buffer_.size() >= max_buffer_size_) {
-        flush();
+void csvWriter::addToBuffer(const std::vector<float>& data) {
+    if (full_[current_].load(std::memory_order_acquire)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    float* row = staging_[current_].data() + (size_t) staged_rows_[current_] * num_columns_;
+    const unsigned int num_values = std::min((unsigned int) data.size(), num_columns_);
+    std::copy(data.begin(), data.begin() + num_values, row);
+    std::fill(row + num_values, row + num_columns_, std::numeric_limits<float>::quiet_NaN());
+    staged_rows_[current_] ++;
+    if (staged_rows_[current_] >= max_buffer_size_) {
+        handOver();
     }
 }
 
+/**
+ * @brief Returns the number of rows dropped because both staging buffers were waiting to be written.
+ * 
+ * @return The number of rows dropped.
+ */
+uint64_t csvWriter::getDropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
 /**
  * @brief Construct a new Bounding Box:: Bounding Box object
  * 
@@ -213,6 +340,68 @@ void BoundingBox::cast2state(std::vector<float>& state) {
     state[5] = h_;
 }
 
+/**
+ * @brief Decodes the raw output of the network into bounding boxes.
+ * @details Keeps the candidates whose confidence is above the threshold, and sorts them by class,
+ * the class of a candidate being the one with the highest probability.
+ * It does not depend on TensorRT, such that it can be benchmarked without a GPU.
+ * 
+ * @param output The pointer to the output of the network. Each candidate is x, y, width, height, confidence, and the probability of each class.
+ * @param output_size The reference to the number of floats in the output.
+ * @param num_classes The reference to the number of classes.
+ * @param conf_thresh The reference to the confidence threshold.
+ * @param bboxes The reference to the bounding boxes of each class.
+ */
+void decodeDetections(float* output, const int& output_size, const int& num_classes, const float& conf_thresh,
+                      std::vector<std::vector<BoundingBox>>& bboxes) {
+    const int stride = num_classes + 5;
+    bboxes.resize(num_classes);
+    for (int c = 0; c < num_classes; ++c) {
+        bboxes[c].reserve(output_size / stride);
+    }
+    for (int i = 0; i < output_size; i += stride) {
+        const float conf = output[i + 4];
+        if (conf > conf_thresh) {
+            assert(conf <= 1.0f);
+            // Take the class with the highest probability, they follow x, y, width, height, and confidence.
+            int class_id = 0;
+            for (int j = 1; j < num_classes; j++) {
+                if (output[i + 5 + j] > output[i + 5 + class_id]) {
+                    class_id = j;
+                }
+            }
+            bboxes[class_id].push_back(BoundingBox(output + i, class_id));
+        }
+    }
+}
+
+/**
+ * @brief Applies Non Maximum Suppression (NMS) to the bounding boxes of each class.
+ * @details The bounding boxes are sorted by decreasing confidence, and the ones overlapping
+ * a more confident bounding box of the same class are marked as invalid.
+ * 
+ * @param bboxes The reference to the bounding boxes of each class.
+ * @param nms_thresh The reference to the IOU above which two bounding boxes are considered duplicates.
+ * @param max_output_bbox_count The reference to the maximum number of valid bounding boxes per class.
+ */
+void suppressOverlaps(std::vector<std::vector<BoundingBox>>& bboxes, const float& nms_thresh, const size_t& max_output_bbox_count) {
+    for (unsigned int c = 0; c < bboxes.size(); ++c) {
+        std::sort(bboxes[c].begin(), bboxes[c].end(), sortComparisonFunction);
+        const size_t bboxes_size = bboxes[c].size();
+        size_t valid_count = 0;
+
+        for (size_t i = 0; i < bboxes_size && valid_count < max_output_bbox_count; ++i) {
+            if (!bboxes[c][i].valid_) {
+                continue;
+            }
+            for (size_t j = i + 1; j < bboxes_size; ++j) {
+                bboxes[c][i].compareWith(bboxes[c][j], nms_thresh);
+            }
+            ++valid_count;
+        }
+    }
+}
+
 /**
  * @brief Construct a new Bounding Box 3 D:: Bounding Box 3 D object
  * 
@@ -407,4 +596,194 @@ void compareWith(RotatedBoundingBox& bbox, const float thred_IOU) {
         bbox.valid_ = false;
     }
 }
-*/
\ No newline at end of file
+*/
+
+/**
+ * @brief Removes the spaces and the quotes around a value.
+ *
+ */
+static std::string trimValue(const std::string& value) {
+  const size_t first = value.find_first_not_of(" \t\r\"'");
+  if (first == std::string::npos) {
+    return "";
+  }
+  const size_t last = value.find_last_not_of(" \t\r\"'");
+  return value.substr(first, last - first + 1);
+}
+
+/**
+ * @brief Loads the parameters of a flat YAML file, like the config files of the nodes.
+ * @details Each line is a "key: value" pair, the comments are ignored. The lists, "[a, b, c]", are stored
+ * comma separated. The nested keys are not supported. The parameters already in the map are overwritten.
+ *
+ * @param path The reference to the path of the file.
+ * @param parameters The reference to the map in which the parameters will be stored.
+ * @return False if the file could not be read.
+ */
+bool loadParameters(const std::string& path, ParameterMap& parameters) {
+  std::ifstream ifs(path);
+  if (!ifs.is_open()) {
+    printf("[ERROR ] utils::%s::l%d Could not open %s.\n", __func__, __LINE__, path.c_str());
+    return false;
+  }
+  std::string line;
+  while (std::getline(ifs, line)) {
+    line = line.substr(0, line.find('#'));
+    const size_t separator = line.find(':');
+    if ((separator == std::string::npos) || (line.find_first_not_of(" \t") != 0)) {
+      continue;
+    }
+    std::string value = trimValue(line.substr(separator + 1));
+    if (!value.empty() && (value.front() == '[')) {
+      std::string list;
+      for (const std::string& item : splitList(value.substr(1, value.find(']') - 1))) {
+        list += (list.empty() ? "" : ",") + trimValue(item);
+      }
+      value = list;
+    }
+    parameters[trimValue(line.substr(0, separator))] = value;
+  }
+  return true;
+}
+
+/**
+ * @brief Splits a comma separated list.
+ *
+ * @param list The reference to the list.
+ * @return The items of the list, the empty ones are skipped.
+ */
+std::vector<std::string> splitList(const std::string& list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+/**
+ * @brief Reads a parameter, or returns its default value if it was not set.
+ *
+ * @param parameters The reference to the parameters.
+ * @param key The reference to the name of the parameter.
+ * @param default_value The reference to the value returned if the parameter was not set.
+ * @return The value of the parameter.
+ */
+std::string getString(const ParameterMap& parameters, const std::string& key, const std::string& default_value) {
+  auto element = parameters.find(key);
+  return element != parameters.end() ? element->second : default_value;
+}
+
+float getFloat(const ParameterMap& parameters, const std::string& key, const float& default_value) {
+  auto element = parameters.find(key);
+  return element != parameters.end() ? atof(element->second.c_str()) : default_value;
+}
+
+int getInt(const ParameterMap& parameters, const std::string& key, const int& default_value) {
+  auto element = parameters.find(key);
+  return element != parameters.end() ? atoi(element->second.c_str()) : default_value;
+}
+
+bool getBool(const ParameterMap& parameters, const std::string& key, const bool& default_value) {
+  auto element = parameters.find(key);
+  return element != parameters.end() ? (element->second == "true") || (element->second == "1") : default_value;
+}
+
+std::vector<float> getFloats(const ParameterMap& parameters, const std::string& key, const std::vector<float>& default_value) {
+  auto element = parameters.find(key);
+  if (element == parameters.end()) {
+    return default_value;
+  }
+  std::vector<float> values;
+  for (const std::string& item : splitList(element->second)) {
+    values.push_back(atof(item.c_str()));
+  }
+  return values;
+}
+
+/**
+ * @brief Reads the parameters of the object detector, with the defaults of the nodes.
+ *
+ * @param parameters The reference to the parameters, named as the parameters of the nodes.
+ * @param glo_p The reference to the global parameters.
+ * @param det_p The reference to the parameters of the network.
+ * @param nms_p The reference to the parameters of the non maximum suppression.
+ */
+void getDetectionParameters(const ParameterMap& parameters, GlobalParameters& glo_p, DetectionParameters& det_p, NMSParameters& nms_p) {
+  glo_p.image_height = getInt(parameters, "image_rows", 480);
+  glo_p.image_width = getInt(parameters, "image_cols", 640);
+  nms_p.nms_thresh = getFloat(parameters, "nms_thresh", 0.45);
+  nms_p.conf_thresh = getFloat(parameters, "conf_thresh", 0.25);
+  nms_p.max_output_bbox_count = getInt(parameters, "max_output_bbox_count", 1000);
+  det_p.engine_path = getString(parameters, "path_to_engine", "None");
+  det_p.num_classes = getInt(parameters, "num_classes", 1);
+  det_p.class_map = splitList(getString(parameters, "class_map", "object"));
+  det_p.num_buffers = getInt(parameters, "num_buffers", 2);
+}
+
+/**
+ * @brief Reads the parameters of the position estimator, with the defaults of the nodes.
+ *
+ * @param parameters The reference to the parameters, named as the parameters of the nodes.
+ * @param glo_p The reference to the global parameters.
+ * @param loc_p The reference to the parameters of the localization.
+ * @param cam_p The reference to the parameters of the camera.
+ */
+void getLocalizationParameters(const ParameterMap& parameters, GlobalParameters& glo_p, LocalizationParameters& loc_p, CameraParameters& cam_p) {
+  glo_p.image_height = getInt(parameters, "image_rows", 480);
+  glo_p.image_width = getInt(parameters, "image_cols", 640);
+  loc_p.reject_thresh = getFloat(parameters, "rejection_threshold", 0.1);
+  loc_p.keep_thresh = getFloat(parameters, "keep_threshold", 0.1);
+  loc_p.mode = getString(parameters, "position_mode", "min_distance");
+  cam_p.camera_parameters = getFloats(parameters, "camera_parameters", std::vector<float>(5, 0));
+  cam_p.lens_distortion = getFloats(parameters, "K", std::vector<float>(5, 0));
+  cam_p.distortion_model = getString(parameters, "lens_distortion_model", "pin_hole");
+}
+
+/**
+ * @brief Reads the parameters of the trackers, with the defaults of the nodes.
+ * @details The quirks of the nodes in reading them are not reproduced: each parameter goes to the field of the same name.
+ *
+ * @param parameters The reference to the parameters, named as the parameters of the nodes.
+ * @param three_dimensional The reference to whether the defaults of the 3D tracker are used.
+ * @param det_p The reference to the parameters of the network, only the classes are read.
+ * @param kal_p The reference to the parameters of the Kalman filters.
+ * @param tra_p The reference to the parameters of the tracking.
+ * @param bbo_p The reference to the parameters of the rejection of the bounding boxes.
+ */
+void getTrackingParameters(const ParameterMap& parameters, const bool& three_dimensional, DetectionParameters& det_p,
+                           KalmanParameters& kal_p, TrackingParameters& tra_p, BBoxRejectionParameters& bbo_p) {
+  det_p.num_classes = getInt(parameters, "num_classes", 1);
+  det_p.class_map = splitList(getString(parameters, "class_map", "object"));
+  if (three_dimensional) {
+    kal_p.Q = getFloats(parameters, "Q", {0.25, 0.25, 0.25, 25.0, 25.0, 25.0, 0.25, 0.25, 0.25});
+    kal_p.R = getFloats(parameters, "R", {0.125, 0.125, 0.125, 25.0, 25.0, 25.0, 0.125, 0.125, 0.125});
+  } else {
+    kal_p.Q = getFloats(parameters, "Q", {9.0, 9.0, 200.0, 200.0, 5.0, 5.0});
+    kal_p.R = getFloats(parameters, "R", {2.0, 2.0, 200.0, 200.0, 2.0, 2.0});
+  }
+  kal_p.use_vel = getBool(parameters, "use_vel", false);
+  kal_p.use_dim = getBool(parameters, "use_dim", true);
+  tra_p.center_thresh = getFloat(parameters, "center_threshold", 80.0);
+  tra_p.distance_thresh = getFloat(parameters, "dist_threshold", 150.0);
+  tra_p.body_ratio = getFloat(parameters, "body_ratio", 0.5);
+  tra_p.area_thresh = getFloat(parameters, "area_threshold", 2.0);
+  tra_p.dt = getFloat(parameters, "dt", 0.02);
+  tra_p.max_frames_to_skip = getInt(parameters, "max_frames_to_skip", 10);
+  tra_p.static_objects = getBool(parameters, "static_objects", false);
+  tra_p.voxel_size = getFloat(parameters, "voxel_size", tra_p.distance_thresh);
+  tra_p.use_frustum = getBool(parameters, "use_frustum", false);
+  tra_p.frustum_min_depth = getFloat(parameters, "frustum_min_depth", 0.1);
+  tra_p.frustum_max_depth = getFloat(parameters, "frustum_max_depth", 20.0);
+  tra_p.frustum_margin = getFloat(parameters, "frustum_margin", 0.0);
+  tra_p.checkpoint_path = getString(parameters, "checkpoint_path", "");
+  tra_p.checkpoint_period = getFloat(parameters, "checkpoint_period", 5.0);
+  tra_p.checkpoint_max_age = getFloat(parameters, "checkpoint_max_age", 30.0);
+  bbo_p.min_bbox_width = getInt(parameters, "min_bbox_width", 60);
+  bbo_p.max_bbox_width = getInt(parameters, "max_bbox_width", 400);
+  bbo_p.min_bbox_height = getInt(parameters, "min_bbox_height", 60);
+  bbo_p.max_bbox_height = getInt(parameters, "max_bbox_height", 300);
+}
@@ -0,0 +1,120 @@
+/**
+ * @file test_detection_decoding.cpp
+ * @author antoine.richard@uni.lu
+ * @version 0.1
+ * @date 2022-09-21
+ *
+ * @copyright University of Luxembourg | SnT | SpaceR 2022--2022
+ * @brief The regression tests of the decoding of the network output, and of the non maximum suppression.
+ * @details The decoding used to loop on the index of the candidate instead of the index of the class, read the
+ * scores of the classes one float too early, over the confidence, and could only return the first class.
+ */
+
+#include <detect_and_track/utils.h>
+#include <gtest/gtest.h>
+
+/**
+ * @brief Appends a candidate to a synthetic network output.
+ *
+ */
+static void addCandidate(std::vector<float>& output, const float& x, const float& y, const float& w, const float& h,
+                         const float& conf, const std::vector<float>& scores) {
+  output.push_back(x);
+  output.push_back(y);
+  output.push_back(w);
+  output.push_back(h);
+  output.push_back(conf);
+  output.insert(output.end(), scores.begin(), scores.end());
+}
+
+/**
+ * @brief Counts the bounding boxes left valid by the non maximum suppression.
+ *
+ */
+static unsigned int countValid(const std::vector<BoundingBox>& bboxes) {
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < bboxes.size(); i++) {
+    count += bboxes[i].valid_ ? 1 : 0;
+  }
+  return count;
+}
+
+TEST(DecodeDetections, TakesTheClassWithTheHighestScore) {
+  std::vector<float> output;
+  addCandidate(output, 100, 100, 20, 20, 0.9, {0.7, 0.2, 0.1});
+  addCandidate(output, 200, 100, 20, 20, 0.9, {0.1, 0.8, 0.1});
+  addCandidate(output, 300, 100, 20, 20, 0.9, {0.1, 0.2, 0.7});
+  std::vector<std::vector<BoundingBox>> bboxes;
+  decodeDetections(output.data(), output.size(), 3, 0.5, bboxes);
+  ASSERT_EQ(bboxes.size(), 3u);
+  for (int c = 0; c < 3; c++) {
+    ASSERT_EQ(bboxes[c].size(), 1u);
+    EXPECT_EQ(bboxes[c][0].class_id_, c);
+    EXPECT_FLOAT_EQ(bboxes[c][0].x_, 100.0 * (c + 1));
+  }
+}
+
+TEST(DecodeDetections, DoesNotReadTheConfidenceAsAScore) {
+  // The confidence is larger than every score: read as the score of the first class, it would win.
+  std::vector<float> output;
+  addCandidate(output, 100, 100, 20, 20, 0.95, {0.3, 0.6});
+  std::vector<std::vector<BoundingBox>> bboxes;
+  decodeDetections(output.data(), output.size(), 2, 0.5, bboxes);
+  ASSERT_EQ(bboxes.size(), 2u);
+  EXPECT_TRUE(bboxes[0].empty());
+  ASSERT_EQ(bboxes[1].size(), 1u);
+  EXPECT_FLOAT_EQ(bboxes[1][0].confidence_, 0.95);
+}
+
+TEST(DecodeDetections, DecodesEveryCandidate) {
+  // The loop on the scores tested the index of the candidate: the scores of the later candidates were never read.
+  std::vector<float> output;
+  for (int i = 0; i < 8; i++) {
+    addCandidate(output, 50 * i, 100, 20, 20, 0.6, {0.4, 0.6});
+  }
+  addCandidate(output, 500, 100, 20, 20, 0.4, {0.4, 0.6});
+  std::vector<std::vector<BoundingBox>> bboxes;
+  decodeDetections(output.data(), output.size(), 2, 0.5, bboxes);
+  ASSERT_EQ(bboxes.size(), 2u);
+  EXPECT_TRUE(bboxes[0].empty());
+  EXPECT_EQ(bboxes[1].size(), 8u);
+}
+
+TEST(SuppressOverlaps, SuppressesTheOverlapsOfEveryClass) {
+  std::vector<float> output;
+  addCandidate(output, 100, 100, 40, 40, 0.9, {0.9, 0.1, 0.1});
+  addCandidate(output, 102, 101, 40, 40, 0.8, {0.9, 0.1, 0.1});
+  addCandidate(output, 300, 300, 40, 40, 0.7, {0.1, 0.1, 0.9});
+  addCandidate(output, 301, 302, 40, 40, 0.9, {0.1, 0.1, 0.9});
+  addCandidate(output, 600, 300, 40, 40, 0.9, {0.1, 0.1, 0.9});
+  std::vector<std::vector<BoundingBox>> bboxes;
+  decodeDetections(output.data(), output.size(), 3, 0.5, bboxes);
+  suppressOverlaps(bboxes, 0.45, 100);
+  ASSERT_EQ(bboxes.size(), 3u);
+  EXPECT_EQ(countValid(bboxes[0]), 1u);
+  EXPECT_FLOAT_EQ(bboxes[0][0].confidence_, 0.9);
+  EXPECT_EQ(countValid(bboxes[1]), 0u);
+  EXPECT_EQ(countValid(bboxes[2]), 2u);
+  for (unsigned int i = 0; i < bboxes[2].size(); i++) {
+    if (bboxes[2][i].x_ < 500) {
+      EXPECT_EQ(bboxes[2][i].valid_, bboxes[2][i].confidence_ > 0.8);
+    }
+  }
+}
+
+TEST(SuppressOverlaps, KeepsOverlapsOfDifferentClasses) {
+  std::vector<float> output;
+  addCandidate(output, 100, 100, 40, 40, 0.9, {0.9, 0.1});
+  addCandidate(output, 100, 100, 40, 40, 0.8, {0.1, 0.9});
+  std::vector<std::vector<BoundingBox>> bboxes;
+  decodeDetections(output.data(), output.size(), 2, 0.5, bboxes);
+  suppressOverlaps(bboxes, 0.45, 100);
+  ASSERT_EQ(bboxes.size(), 2u);
+  EXPECT_EQ(countValid(bboxes[0]), 1u);
+  EXPECT_EQ(countValid(bboxes[1]), 1u);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}